@@ -15,6 +15,7 @@ EXPORTS
 	NSUnloadModule
 	NSGetModuleName
 	NSGetModuleDescription
+	NSGetModuleDependencies
 	NSGetModuleVersion
 	NSHasCommandHandler
 	NSHasMessageHandler
@@ -614,6 +615,9 @@ BOOL APIENTRY DllMain(HANDLE hModule, DWORD  ul_reason_for_call, LPVOID lpReserv
 	extern int NSGetModuleDescription(char* buf, int buflen) {
 		return nscapi::basic_wrapper_static<plugin_impl_class>::NSGetModuleDescription(buf, buflen);
 	}
+	extern int NSGetModuleDependencies(char* buf, int buflen) {
+		return nscapi::basic_wrapper_static<plugin_impl_class>::NSGetModuleDependencies(buf, buflen);
+	}
 	extern int NSGetModuleVersion(int *major, int *minor, int *revision) {
 		return nscapi::basic_wrapper_static<plugin_impl_class>::NSGetModuleVersion(major, minor, revision);
 	}
@@ -702,6 +706,7 @@ extern "C" int NSLoadModuleEx(unsigned int plugin_id, char* alias, int mode);
 extern "C" void NSDeleteBuffer(char**buffer);
 extern "C" int NSGetModuleName(char* buf, int buflen);
 extern "C" int NSGetModuleDescription(char* buf, int buflen);
+extern "C" int NSGetModuleDependencies(char* buf, int buflen);
 extern "C" int NSGetModuleVersion(int *major, int *minor, int *revision);
 extern "C" NSCAPI::boolReturn NSHasCommandHandler(unsigned int plugin_id);
 extern "C" NSCAPI::boolReturn NSHasMessageHandler(unsigned int plugin_id);
@@ -762,6 +767,12 @@ public:
 	static std::string getModuleDescription() {
 		return "{{module.description|cstring}}";
 	}
+	/**
+	 * Modules which has to be started before this module (comma separated)
+	 */
+	static std::string getModuleDependencies() {
+		return "{{module.depends|join(',')|cstring}}";
+	}
 
 {% if module.commands or module.command_fallback%}
 	bool hasCommandHandler() { return true; }
@@ -863,6 +874,7 @@ class Module:
 	version = None
 	loaders = "both"
 	managed = False
+	depends = []
 	
 	def __init__(self, data):
 		if data['name']:
@@ -890,6 +902,13 @@ class Module:
 			self.reload = data['reload']
 		else:
 			self.reload = False
+		if 'depends' in data and data['depends']:
+			if isinstance(data['depends'], basestring):
+				self.depends = [data['depends']]
+			else:
+				self.depends = data['depends']
+		else:
+			self.depends = []
 
 	def __repr__(self):
 		return self.name
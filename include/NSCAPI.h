@@ -137,6 +137,7 @@ namespace nscapi {
 	namespace plugin_api {
 		typedef NSCAPI::errorReturn(*lpGetName)(char*, unsigned int);
 		typedef NSCAPI::errorReturn(*lpGetDescription)(char*, unsigned int);
+		typedef NSCAPI::errorReturn(*lpGetDependencies)(char*, unsigned int);
 		typedef NSCAPI::errorReturn(*lpModuleHelperInit)(unsigned int, ::nscapi::core_api::lpNSAPILoader f);
 		typedef NSCAPI::errorReturn(*lpGetVersion)(int* major, int* minor, int* revision);
 		typedef NSCAPI::errorReturn(*lpDeleteBuffer)(char** buffer);
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cgroup/cgroup.hpp>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+	const std::size_t buffer_size = 4096;
+	// Marks a file the cgroup does not have (the controller is not enabled), probed again every reprobe_interval samples
+	const int fd_absent = -2;
+	const unsigned int reprobe_interval = 16;
+
+	const char *file_names[] = {
+		"cpu.stat",
+		"memory.current",
+		"memory.max",
+		"memory.events",
+		"cpu.pressure",
+		"memory.pressure",
+		"io.pressure"
+	};
+
+	double monotonic_seconds() {
+		struct timespec ts;
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+			return 0.0;
+		return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+	}
+
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\t';
+	}
+	inline void skip_space(const char *&p, const char *end) {
+		while (p < end && is_space(*p))
+			p++;
+	}
+	inline unsigned long long parse_ull(const char *&p, const char *end) {
+		skip_space(p, end);
+		unsigned long long ret = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			ret = ret * 10 + (*p++ - '0');
+		return ret;
+	}
+	inline double parse_double(const char *&p, const char *end) {
+		double ret = static_cast<double>(parse_ull(p, end));
+		if (p < end && *p == '.') {
+			p++;
+			double scale = 0.1;
+			while (p < end && *p >= '0' && *p <= '9') {
+				ret += (*p++ - '0') * scale;
+				scale /= 10.0;
+			}
+		}
+		return ret;
+	}
+	inline const char* line_end(const char *p, const char *end) {
+		const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		return eol ? eol : end;
+	}
+	inline bool starts_with(const char *p, const char *end, const char *key, std::size_t len) {
+		return static_cast<std::size_t>(end - p) >= len && memcmp(p, key, len) == 0;
+	}
+
+	struct key_field {
+		const char *key;
+		std::size_t len;
+		unsigned long long cgroup::sample::*field;
+	};
+	const key_field cpu_stat_keys[] = {
+		{ "usage_usec", 10, &cgroup::sample::usage_usec },
+		{ "user_usec", 9, &cgroup::sample::user_usec },
+		{ "system_usec", 11, &cgroup::sample::system_usec },
+		{ "nr_periods", 10, &cgroup::sample::nr_periods },
+		{ "nr_throttled", 12, &cgroup::sample::nr_throttled },
+		{ "throttled_usec", 14, &cgroup::sample::throttled_usec }
+	};
+	const key_field memory_events_keys[] = {
+		{ "low", 3, &cgroup::sample::events_low },
+		{ "high", 4, &cgroup::sample::events_high },
+		{ "max", 3, &cgroup::sample::events_max },
+		{ "oom", 3, &cgroup::sample::events_oom },
+		{ "oom_kill", 8, &cgroup::sample::events_oom_kill }
+	};
+
+	// Flat keyed files: one "key value" pair per line
+	template<std::size_t N>
+	void parse_flat_keyed(const char *p, const char *end, const key_field (&keys)[N], cgroup::sample &s) {
+		while (p < end) {
+			const char *eol = line_end(p, end);
+			const char *sep = p;
+			while (sep < eol && !is_space(*sep))
+				sep++;
+			std::size_t len = sep - p;
+			for (std::size_t i = 0; i < N; i++) {
+				if (keys[i].len == len && memcmp(keys[i].key, p, len) == 0) {
+					s.*(keys[i].field) = parse_ull(sep, eol);
+					break;
+				}
+			}
+			p = eol + 1;
+		}
+	}
+
+	// Nested keyed files: "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" (and the same for full)
+	void parse_pressure_lines(const char *p, const char *end, cgroup::pressure &pressure) {
+		while (p < end) {
+			const char *eol = line_end(p, end);
+			bool some = starts_with(p, eol, "some", 4);
+			if (some || starts_with(p, eol, "full", 4)) {
+				double *avg10 = some ? &pressure.some_avg10 : &pressure.full_avg10;
+				double *avg60 = some ? &pressure.some_avg60 : &pressure.full_avg60;
+				double *avg300 = some ? &pressure.some_avg300 : &pressure.full_avg300;
+				unsigned long long *total = some ? &pressure.some_total : &pressure.full_total;
+				p += 4;
+				while (p < eol) {
+					skip_space(p, eol);
+					const char *eq = static_cast<const char*>(memchr(p, '=', eol - p));
+					if (!eq)
+						break;
+					const char *v = eq + 1;
+					std::size_t len = eq - p;
+					if (len == 5 && memcmp(p, "avg10", 5) == 0)
+						*avg10 = parse_double(v, eol);
+					else if (len == 5 && memcmp(p, "avg60", 5) == 0)
+						*avg60 = parse_double(v, eol);
+					else if (len == 6 && memcmp(p, "avg300", 6) == 0)
+						*avg300 = parse_double(v, eol);
+					else if (len == 5 && memcmp(p, "total", 5) == 0)
+						*total = parse_ull(v, eol);
+					p = v;
+					while (p < eol && !is_space(*p))
+						p++;
+				}
+			}
+			p = eol + 1;
+		}
+	}
+
+	std::size_t depth_of(const std::string &name) {
+		if (name.empty())
+			return 0;
+		std::size_t depth = 1;
+		for (std::string::const_iterator it = name.begin(); it != name.end(); ++it) {
+			if (*it == '/')
+				depth++;
+		}
+		return depth;
+	}
+}
+
+namespace cgroup {
+
+	void parse_cpu_stat(const char *data, std::size_t len, sample &s) {
+		parse_flat_keyed(data, data + len, cpu_stat_keys, s);
+	}
+
+	void parse_memory_events(const char *data, std::size_t len, sample &s) {
+		parse_flat_keyed(data, data + len, memory_events_keys, s);
+	}
+
+	void parse_pressure(const char *data, std::size_t len, pressure &p) {
+		parse_pressure_lines(data, data + len, p);
+	}
+
+	cgroup_scanner::node::node(const std::string &name, std::size_t history_size) : name(name), history(history_size), generation(0), samples(0) {
+		for (int i = 0; i < file_count; i++)
+			fds[i] = -1;
+	}
+
+	cgroup_scanner::cgroup_scanner(const std::string &root_path, std::size_t history_size, std::size_t max_open_fds)
+		: root_path_(root_path)
+		, root_fd_(-1)
+		, buffer_(buffer_size + 1)
+		, history_size_(history_size < 2 ? 2 : history_size)
+		, generation_(0)
+		, open_fds_(0)
+		, max_open_fds_(max_open_fds) {
+		// Leave most descriptors for the rest of the process
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+			max_open_fds_ = std::min<std::size_t>(max_open_fds_, limit.rlim_cur / 4);
+	}
+
+	cgroup_scanner::~cgroup_scanner() {
+		for (node_map::iterator it = nodes_.begin(); it != nodes_.end(); ++it)
+			close_node(*it->second);
+		if (root_fd_ >= 0)
+			close(root_fd_);
+	}
+
+	bool cgroup_scanner::open_root() {
+		if (root_fd_ < 0)
+			root_fd_ = open(root_path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		return root_fd_ >= 0;
+	}
+
+	bool cgroup_scanner::is_available() {
+		return open_root() && faccessat(root_fd_, "cgroup.controllers", F_OK, 0) == 0;
+	}
+
+	void cgroup_scanner::close_node(node &n) {
+		for (int i = 0; i < file_count; i++) {
+			if (n.fds[i] >= 0) {
+				close(n.fds[i]);
+				open_fds_--;
+			}
+			n.fds[i] = -1;
+		}
+	}
+
+	cgroup_scanner::node_type cgroup_scanner::get_node(const std::string &name) {
+		node_map::iterator it = nodes_.find(name);
+		if (it != nodes_.end())
+			return it->second;
+		node_type n(new node(name, history_size_));
+		nodes_[name] = n;
+		return n;
+	}
+
+	long cgroup_scanner::read_file(node &n, file_index file) {
+		char *buf = &buffer_[0];
+		int &fd = n.fds[file];
+		if (fd == fd_absent) {
+			if (n.samples % reprobe_interval != 0)
+				return -1;
+			fd = -1;
+		}
+		if (fd >= 0) {
+			ssize_t r = pread(fd, buf, buffer_size, 0);
+			if (r >= 0) {
+				buf[r] = 0;
+				return static_cast<long>(r);
+			}
+			// The cgroup has been removed (and might have been created again with the same name)
+			close(fd);
+			fd = -1;
+			open_fds_--;
+		}
+		std::string path = n.name.empty() ? std::string(file_names[file]) : n.name + "/" + file_names[file];
+		int new_fd = openat(root_fd_, path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (new_fd < 0) {
+			fd = fd_absent;
+			return -1;
+		}
+		ssize_t r = pread(new_fd, buf, buffer_size, 0);
+		if (r >= 0 && open_fds_ < max_open_fds_) {
+			fd = new_fd;
+			open_fds_++;
+		} else {
+			close(new_fd);
+		}
+		if (r < 0)
+			return -1;
+		buf[r] = 0;
+		return static_cast<long>(r);
+	}
+
+	bool cgroup_scanner::sample_node(node &n, double window, cgroup_stats &stats) {
+		sample s;
+		s.time = monotonic_seconds();
+		const char *buf = &buffer_[0];
+		long r;
+		if ((r = read_file(n, file_cpu_stat)) > 0) {
+			parse_cpu_stat(buf, r, s);
+			s.files |= sample::has_cpu_stat;
+		}
+		if ((r = read_file(n, file_memory_current)) > 0) {
+			const char *p = buf;
+			s.memory_current = parse_ull(p, buf + r);
+			s.files |= sample::has_memory_current;
+		}
+		if ((r = read_file(n, file_memory_max)) > 0) {
+			const char *p = buf;
+			// "max" means no limit
+			s.memory_max = parse_ull(p, buf + r);
+			s.files |= sample::has_memory_max;
+		}
+		if ((r = read_file(n, file_memory_events)) > 0) {
+			parse_memory_events(buf, r, s);
+			s.files |= sample::has_memory_events;
+		}
+		if ((r = read_file(n, file_cpu_pressure)) > 0) {
+			parse_pressure(buf, r, s.cpu);
+			s.files |= sample::has_cpu_pressure;
+		}
+		if ((r = read_file(n, file_memory_pressure)) > 0) {
+			parse_pressure(buf, r, s.memory);
+			s.files |= sample::has_memory_pressure;
+		}
+		if ((r = read_file(n, file_io_pressure)) > 0) {
+			parse_pressure(buf, r, s.io);
+			s.files |= sample::has_io_pressure;
+		}
+		n.samples++;
+		if (s.files == 0)
+			return false;
+
+		n.history.push_back(s);
+		stats.name = n.name.empty() ? "/" : n.name;
+		stats.current = s;
+		stats.has_previous = n.history.size() > 1;
+		if (stats.has_previous) {
+			// The newest sample which is at least window seconds old (or the oldest one we have)
+			std::size_t index = 0;
+			for (std::size_t i = n.history.size() - 1; i-- > 0;) {
+				if (s.time - n.history[i].time >= window) {
+					index = i;
+					break;
+				}
+			}
+			stats.previous = n.history[index];
+		}
+		return true;
+	}
+
+	void cgroup_scanner::walk(const std::string &name, std::size_t depth, std::size_t max_depth, double window, stats_list &result) {
+		node_type n = get_node(name);
+		n->generation = generation_;
+		cgroup_stats stats;
+		if (sample_node(*n, window, stats))
+			result.push_back(stats);
+		if (depth >= max_depth)
+			return;
+
+		int fd = openat(root_fd_, name.empty() ? "." : name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0)
+			return;
+		DIR *dir = fdopendir(fd);
+		if (!dir) {
+			close(fd);
+			return;
+		}
+		std::vector<std::string> children;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry->d_name[0] == '.')
+				continue;
+			if (entry->d_type == DT_UNKNOWN) {
+				struct stat st;
+				if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(st.st_mode))
+					continue;
+			} else if (entry->d_type != DT_DIR) {
+				continue;
+			}
+			children.push_back(entry->d_name);
+		}
+		closedir(dir);
+		for (std::vector<std::string>::const_iterator it = children.begin(); it != children.end(); ++it)
+			walk(name.empty() ? *it : name + "/" + *it, depth + 1, max_depth, window, result);
+	}
+
+	stats_list cgroup_scanner::scan(std::size_t max_depth, double window) {
+		stats_list ret;
+		if (!open_root())
+			return ret;
+		generation_++;
+		walk("", 0, max_depth, window, ret);
+		// Drop the cgroups which are gone (deeper ones are only sampled by read so leave them be)
+		for (node_map::iterator it = nodes_.begin(); it != nodes_.end();) {
+			if (it->second->generation != generation_ && depth_of(it->first) <= max_depth) {
+				close_node(*it->second);
+				it = nodes_.erase(it);
+			} else {
+				++it;
+			}
+		}
+		return ret;
+	}
+
+	bool cgroup_scanner::read(const std::string &name, double window, cgroup_stats &stats) {
+		if (name.find("..") != std::string::npos || !open_root())
+			return false;
+		std::string key = name;
+		while (!key.empty() && key[0] == '/')
+			key.erase(0, 1);
+		while (!key.empty() && key[key.size() - 1] == '/')
+			key.erase(key.size() - 1);
+		node_type n = get_node(key);
+		n->generation = generation_;
+		if (sample_node(*n, window, stats))
+			return true;
+		close_node(*n);
+		nodes_.erase(key);
+		return false;
+	}
+
+	std::size_t cgroup_scanner::drop_unread(unsigned int passes) {
+		std::size_t count = 0;
+		for (node_map::iterator it = nodes_.begin(); it != nodes_.end();) {
+			if (generation_ - it->second->generation >= passes) {
+				close_node(*it->second);
+				it = nodes_.erase(it);
+				count++;
+			} else {
+				++it;
+			}
+		}
+		return count;
+	}
+}
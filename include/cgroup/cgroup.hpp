@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/circular_buffer.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <list>
+#include <string>
+#include <vector>
+
+/**
+ * Reader for the cgroup v2 (unified) hierarchy.
+ *
+ * Every cgroup gets a node with the descriptors for its cpu.stat, memory.* and *.pressure files kept
+ * open (up to a limit) so sampling a cgroup is a handful of preads, and a small ring buffer of samples
+ * so rates (cpu usage, throttling, stall time, oom kills, ...) can be calculated over a window.
+ * Not thread safe: callers have to serialize access.
+ */
+namespace cgroup {
+
+	struct pressure {
+		double some_avg10;
+		double some_avg60;
+		double some_avg300;
+		unsigned long long some_total;
+		double full_avg10;
+		double full_avg60;
+		double full_avg300;
+		unsigned long long full_total;
+		pressure() : some_avg10(0.0), some_avg60(0.0), some_avg300(0.0), some_total(0), full_avg10(0.0), full_avg60(0.0), full_avg300(0.0), full_total(0) {}
+	};
+
+	struct sample {
+		enum file_flags {
+			has_cpu_stat = 1,
+			has_memory_current = 2,
+			has_memory_max = 4,
+			has_memory_events = 8,
+			has_cpu_pressure = 16,
+			has_memory_pressure = 32,
+			has_io_pressure = 64
+		};
+		// Monotonic time (seconds) when the sample was taken
+		double time;
+		unsigned int files;
+		// cpu.stat (all times in micro seconds)
+		unsigned long long usage_usec;
+		unsigned long long user_usec;
+		unsigned long long system_usec;
+		unsigned long long nr_periods;
+		unsigned long long nr_throttled;
+		unsigned long long throttled_usec;
+		// memory.current and memory.max (0 means no limit)
+		unsigned long long memory_current;
+		unsigned long long memory_max;
+		// memory.events
+		unsigned long long events_low;
+		unsigned long long events_high;
+		unsigned long long events_max;
+		unsigned long long events_oom;
+		unsigned long long events_oom_kill;
+		pressure cpu;
+		pressure memory;
+		pressure io;
+
+		sample() : time(0.0), files(0), usage_usec(0), user_usec(0), system_usec(0), nr_periods(0), nr_throttled(0), throttled_usec(0)
+			, memory_current(0), memory_max(0), events_low(0), events_high(0), events_max(0), events_oom(0), events_oom_kill(0) {}
+	};
+
+	// The latest sample of a cgroup and the sample the rates are calculated against
+	struct cgroup_stats {
+		std::string name;
+		sample current;
+		sample previous;
+		bool has_previous;
+		cgroup_stats() : has_previous(false) {}
+
+		double get_elapsed() const {
+			return has_previous ? current.time - previous.time : 0.0;
+		}
+		// Percent of one core
+		double get_cpu() const { return usec_rate(previous.usage_usec, current.usage_usec); }
+		double get_cpu_user() const { return usec_rate(previous.user_usec, current.user_usec); }
+		double get_cpu_system() const { return usec_rate(previous.system_usec, current.system_usec); }
+		// Percent of the enforcement periods which were throttled
+		double get_throttled() const {
+			unsigned long long periods = delta(previous.nr_periods, current.nr_periods);
+			return periods == 0 ? 0.0 : 100.0 * delta(previous.nr_throttled, current.nr_throttled) / periods;
+		}
+		unsigned long long get_throttled_usec() const { return delta(previous.throttled_usec, current.throttled_usec); }
+		unsigned long long get_high_events() const { return delta(previous.events_high, current.events_high); }
+		unsigned long long get_max_events() const { return delta(previous.events_max, current.events_max); }
+		unsigned long long get_oom() const { return delta(previous.events_oom, current.events_oom); }
+		unsigned long long get_oom_kill() const { return delta(previous.events_oom_kill, current.events_oom_kill); }
+		// Percent of the time some (or all) tasks were stalled, uses avg10 until there is a window to measure
+		double get_some(const pressure sample::*resource) const {
+			if (!has_previous)
+				return (current.*resource).some_avg10;
+			return usec_rate((previous.*resource).some_total, (current.*resource).some_total);
+		}
+		double get_full(const pressure sample::*resource) const {
+			if (!has_previous)
+				return (current.*resource).full_avg10;
+			return usec_rate((previous.*resource).full_total, (current.*resource).full_total);
+		}
+
+	private:
+		unsigned long long delta(unsigned long long previous_value, unsigned long long current_value) const {
+			return has_previous && current_value > previous_value ? current_value - previous_value : 0;
+		}
+		double usec_rate(unsigned long long previous_value, unsigned long long current_value) const {
+			double elapsed = get_elapsed();
+			return elapsed <= 0.0 ? 0.0 : delta(previous_value, current_value) / (elapsed * 10000.0);
+		}
+	};
+	typedef std::list<cgroup_stats> stats_list;
+
+	// Parsers for the contents of the cgroup files (fields missing from the data are left as is)
+	void parse_cpu_stat(const char *data, std::size_t len, sample &s);
+	void parse_memory_events(const char *data, std::size_t len, sample &s);
+	void parse_pressure(const char *data, std::size_t len, pressure &p);
+
+	class cgroup_scanner : boost::noncopyable {
+	public:
+		enum file_index {
+			file_cpu_stat,
+			file_memory_current,
+			file_memory_max,
+			file_memory_events,
+			file_cpu_pressure,
+			file_memory_pressure,
+			file_io_pressure,
+			file_count
+		};
+
+	private:
+		struct node : boost::noncopyable {
+			std::string name;
+			int fds[file_count];
+			boost::circular_buffer<sample> history;
+			unsigned int generation;
+			unsigned int samples;
+			node(const std::string &name, std::size_t history_size);
+		};
+		typedef boost::shared_ptr<node> node_type;
+		typedef boost::unordered_map<std::string, node_type> node_map;
+
+		std::string root_path_;
+		int root_fd_;
+		node_map nodes_;
+		std::vector<char> buffer_;
+		std::size_t history_size_;
+		unsigned int generation_;
+		std::size_t open_fds_;
+		std::size_t max_open_fds_;
+
+	public:
+		cgroup_scanner(const std::string &root_path = "/sys/fs/cgroup", std::size_t history_size = 64, std::size_t max_open_fds = 2048);
+		~cgroup_scanner();
+
+		// True if the root is a cgroup v2 hierarchy
+		bool is_available();
+		// Sample all cgroups down to max_depth levels below the root (0 is only the root), cgroups which
+		// no longer exist are dropped. Rates are calculated against the newest sample at least window
+		// seconds old (or the oldest sample we have), a window of 0 means the previous sample.
+		stats_list scan(std::size_t max_depth, double window);
+		// Sample a single cgroup (the name is relative to the root)
+		bool read(const std::string &name, double window, cgroup_stats &stats);
+		// Start a new pass of read() calls
+		void begin_pass() { generation_++; }
+		// Drop the cgroups which have not been read during the last passes passes (including the current one)
+		// so cgroups which are gone do not keep their files open, returns the number dropped
+		std::size_t drop_unread(unsigned int passes);
+		std::size_t get_cached_count() const { return nodes_.size(); }
+
+	private:
+		bool open_root();
+		void walk(const std::string &name, std::size_t depth, std::size_t max_depth, double window, stats_list &result);
+		node_type get_node(const std::string &name);
+		bool sample_node(node &n, double window, cgroup_stats &stats);
+		long read_file(node &n, file_index file);
+		void close_node(node &n);
+	};
+}
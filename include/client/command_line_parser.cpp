@@ -27,6 +27,9 @@
 #include <utf8.hpp>
 
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/iterator.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -38,6 +41,12 @@
 
 namespace po = boost::program_options;
 
+namespace {
+	const std::size_t max_cached_targets = 256;
+	// Threads (for each client) submitting to several targets at once
+	const std::size_t max_submit_threads = 8;
+}
+
 
 struct payload_builder {
 	enum types {
@@ -261,6 +270,14 @@ std::string client::configuration::add_command(std::string name, std::string arg
 }
 
 client::destination_container client::configuration::get_target(const std::string name) const {
+	{
+		boost::unique_lock<boost::mutex> lock(cache_mutex_);
+		std::map<std::string, cached_target>::iterator it = target_cache_.find(name);
+		if (it != target_cache_.end()) {
+			target_lru_.splice(target_lru_.begin(), target_lru_, it->second.lru);
+			return it->second.target;
+		}
+	}
 	destination_container d;
 	object_handler_type::object_instance op = targets.find_object(name);
 	if (op)
@@ -270,9 +287,32 @@ client::destination_container client::configuration::get_target(const std::strin
 		if (op)
 			d.apply(op);
 	}
+	boost::unique_lock<boost::mutex> lock(cache_mutex_);
+	std::map<std::string, cached_target>::iterator it = target_cache_.find(name);
+	if (it != target_cache_.end()) {
+		// Resolved by someone else while we were at it
+		target_lru_.splice(target_lru_.begin(), target_lru_, it->second.lru);
+		it->second.target = d;
+		return d;
+	}
+	// Target names can come from the request so we do not let the cache grow forever
+	if (target_cache_.size() >= max_cached_targets) {
+		target_cache_.erase(target_lru_.back());
+		target_lru_.pop_back();
+	}
+	target_lru_.push_front(name);
+	cached_target &c = target_cache_[name];
+	c.target = d;
+	c.lru = target_lru_.begin();
 	return d;
 }
 
+void client::configuration::invalidate_targets() const {
+	boost::unique_lock<boost::mutex> lock(cache_mutex_);
+	target_cache_.clear();
+	target_lru_.clear();
+}
+
 client::destination_container client::configuration::get_sender() const {
 	destination_container s;
 	s.set_address(default_sender);
@@ -594,65 +634,244 @@ bool client::configuration::i_do_exec(destination_container &s, destination_cont
 }
 
 
-void client::configuration::do_submit_item(const PB::Commands::SubmitRequestMessage &request, destination_container s, destination_container d, PB::Commands::SubmitResponseMessage &response) {
-	// Parse each objects command and execute them
-	BOOST_FOREACH(const ::PB::Commands::QueryResponseMessage::Response &local_request, request.payload()) {
-		::PB::Commands::SubmitRequestMessage local_request_message;
-		local_request_message.mutable_header()->CopyFrom(request.header());
-		local_request_message.add_payload()->CopyFrom(local_request);
-		::PB::Commands::SubmitResponseMessage local_response_message;
-		i_do_submit(s, d, "forward_raw", local_request_message, local_response_message, false);
-		BOOST_FOREACH(const ::PB::Commands::SubmitResponseMessage_Response &p, local_response_message.payload()) {
-			response.add_payload()->CopyFrom(p);
+namespace {
+	// Submits a message to one target (from its own thread when there are several targets).
+	// Everything is copied as a job can outlive the call (if the target misses its deadline).
+	struct submit_job : boost::noncopyable {
+		client::handler_type handler;
+		client::destination_container s;
+		client::destination_container d;
+		std::string command;
+		boost::shared_ptr<const PB::Commands::SubmitRequestMessage> request;
+		PB::Commands::SubmitResponseMessage response;
+
+		void run() {
+			if (!command.empty()) {
+				// If we have a header command treat the data as a batch
+				submit(command, *request, response);
+				return;
+			}
+			// Parse each objects command and execute them
+			BOOST_FOREACH(const ::PB::Commands::QueryResponseMessage::Response &local_request, request->payload()) {
+				::PB::Commands::SubmitRequestMessage local_request_message;
+				local_request_message.mutable_header()->CopyFrom(request->header());
+				local_request_message.add_payload()->CopyFrom(local_request);
+				::PB::Commands::SubmitResponseMessage local_response_message;
+				submit("forward_raw", local_request_message, local_response_message);
+				BOOST_FOREACH(const ::PB::Commands::SubmitResponseMessage_Response &p, local_response_message.payload()) {
+					response.add_payload()->CopyFrom(p);
+				}
+			}
+		}
+
+		void submit(const std::string &cmd, const PB::Commands::SubmitRequestMessage &request_message, PB::Commands::SubmitResponseMessage &response_message) {
+			try {
+				if (cmd.substr(0, 8) == "forward_") {
+					if (!handler->submit(s, d, request_message, response_message))
+						return nscapi::protobuf::functions::set_response_bad(*response_message.add_payload(), cmd + " failed");
+				} else {
+					return nscapi::protobuf::functions::set_response_bad(*response_message.add_payload(), cmd + " not found");
+				}
+			} catch (const std::exception &e) {
+				return nscapi::protobuf::functions::set_response_bad(*response_message.add_payload(), "Exception processing command line: " + utf8::utf8_from_native(e.what()));
+			} catch (...) {
+				return nscapi::protobuf::functions::set_response_bad(*response_message.add_payload(), "Exception processing command line");
+			}
 		}
+	};
+	typedef boost::shared_ptr<submit_job> submit_job_type;
+
+	// A job which is done (result is copied to the caller) or abandoned (the caller gave up)
+	struct submit_state {
+		boost::mutex mutex;
+		boost::condition_variable cond;
+		bool done;
+		bool abandoned;
+		submit_state() : done(false), abandoned(false) {}
+	};
+
+	void run_submit_job(submit_job_type job, boost::shared_ptr<submit_state> state) {
+		{
+			boost::unique_lock<boost::mutex> lock(state->mutex);
+			// Still queued when the deadline passed
+			if (state->abandoned)
+				return;
+		}
+		job->run();
+		boost::unique_lock<boost::mutex> lock(state->mutex);
+		state->done = true;
+		state->cond.notify_all();
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// A bounded set of threads running submissions.
+/// Threads are started (up to max_submit_threads) when there is more work than idle threads and
+/// live until stop() which discards queued work and joins them.
+class client::submit_pool : boost::noncopyable {
+	typedef boost::function<void()> task_type;
+	typedef boost::shared_ptr<boost::thread> thread_type;
+	boost::mutex mutex_;
+	boost::condition_variable cond_;
+	std::list<task_type> queue_;
+	std::list<thread_type> threads_;
+	std::size_t idle_;
+	bool stopping_;
+
+public:
+	submit_pool() : idle_(0), stopping_(false) {}
+	~submit_pool() {
+		stop();
+	}
 
-void client::configuration::do_submit(const PB::Commands::SubmitRequestMessage &request, PB::Commands::SubmitResponseMessage &response) {
-	PB::Commands::ExecuteResponseMessage local_response;
+	// Returns false if there is no thread to run the task (the caller has to run it)
+	bool post(task_type task) {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (stopping_)
+			return false;
+		if (idle_ <= queue_.size() && threads_.size() < max_submit_threads) {
+			try {
+				threads_.push_back(thread_type(new boost::thread(boost::bind(&submit_pool::thread_proc, this))));
+			} catch (const std::exception &) {
+				if (threads_.empty())
+					return false;
+			}
+		}
+		queue_.push_back(task);
+		cond_.notify_one();
+		return true;
+	}
 
+	void stop() {
+		std::list<thread_type> threads;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			stopping_ = true;
+			queue_.clear();
+			threads.swap(threads_);
+			cond_.notify_all();
+		}
+		BOOST_FOREACH(thread_type t, threads) {
+			t->join();
+		}
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		stopping_ = false;
+	}
+
+private:
+	void thread_proc() {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		while (true) {
+			while (queue_.empty() && !stopping_) {
+				idle_++;
+				cond_.wait(lock);
+				idle_--;
+			}
+			if (stopping_)
+				return;
+			task_type task = queue_.front();
+			queue_.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+};
+
+client::configuration::configuration(std::string caption, handler_type handler, options_reader_type reader)
+	: handler(handler)
+	, reader(reader)
+	, targets(reader)
+	, pool_(new submit_pool()) {}
+
+client::configuration::~configuration() {
+	stop();
+}
+
+void client::configuration::stop() {
+	pool_->stop();
+}
+
+void client::configuration::do_submit_item(const PB::Commands::SubmitRequestMessage &request, destination_container s, destination_container d, PB::Commands::SubmitResponseMessage &response) {
+	submit_job job;
+	job.handler = handler;
+	job.s = s;
+	job.d = d;
+	job.request.reset(new PB::Commands::SubmitRequestMessage(request));
+	job.run();
+	BOOST_FOREACH(const ::PB::Commands::SubmitResponseMessage_Response &p, job.response.payload()) {
+		response.add_payload()->CopyFrom(p);
+	}
+}
+
+
+void client::configuration::do_submit(const PB::Commands::SubmitRequestMessage &request, PB::Commands::SubmitResponseMessage &response) {
 	std::string target = "default";
-	if (!request.header().recipient_id().empty() && !request.header().recipient_id().empty())
+	if (!request.header().recipient_id().empty())
 		target = request.header().recipient_id();
-	else if (!request.header().destination_id().empty() && !request.header().destination_id().empty())
+	else if (!request.header().destination_id().empty())
 		target = request.header().destination_id();
 
+	boost::shared_ptr<const PB::Commands::SubmitRequestMessage> shared_request(new PB::Commands::SubmitRequestMessage(request));
+	std::vector<submit_job_type> jobs;
 	BOOST_FOREACH(const std::string t, str::utils::split_lst(target, std::string(","))) {
-		destination_container d = get_target(t);
-		destination_container s = get_sender();
+		submit_job_type job(new submit_job());
+		job->handler = handler;
+		job->d = get_target(t);
+		job->s = get_sender();
+		job->request = shared_request;
 
 		// Next apply the header object
-		d.apply(t, request.header());
-		s.apply(request.header().sender_id(), request.header());
-
-		if (d.has_data("command")) {
-			std::string command = d.get_string_data("command");
-			// If we have a header command treat the data as a batch
-			i_do_submit(s, d, command, request, response, true);
-		} else {
-			do_submit_item(request, s, d, response);
+		job->d.apply(t, request.header());
+		job->s.apply(request.header().sender_id(), request.header());
+
+		if (job->d.has_data("command")) {
+			job->command = job->d.get_string_data("command");
+			command_type::const_iterator cit = commands.find(job->command);
+			if (cit != commands.end())
+				job->command = cit->second.command;
 		}
+		jobs.push_back(job);
 	}
-}
 
-void client::configuration::i_do_submit(destination_container &s, destination_container &d, std::string command, const PB::Commands::SubmitRequestMessage &request, PB::Commands::SubmitResponseMessage &response, bool use_header) {
-	try {
-		boost::program_options::variables_map vm;
+	if (jobs.size() == 1) {
+		jobs.front()->run();
+		response.mutable_payload()->MergeFrom(jobs.front()->response.payload());
+		return;
+	}
 
-		command_type::const_iterator cit = commands.find(command);
-		if (cit != commands.end()) {
-			command = cit->second.command;
-			// TODO: Build argument vector here!
+	// Submit to all targets at once, each target gets its own deadline (timeout for each attempt, none if timeout is 0)
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	std::vector<boost::shared_ptr<submit_state> > states;
+	BOOST_FOREACH(submit_job_type job, jobs) {
+		boost::shared_ptr<submit_state> state(new submit_state());
+		states.push_back(state);
+		if (!pool_->post(boost::bind(&run_submit_job, job, state))) {
+			// Could not create a thread: do it ourselves
+			run_submit_job(job, state);
 		}
-		if (command.substr(0, 8) == "forward_") {
-			if (!handler->submit(s, d, request, response))
-				return nscapi::protobuf::functions::set_response_bad(*response.add_payload(), command + " failed");
+	}
+	for (std::size_t i = 0; i < jobs.size(); i++) {
+		const destination_container &d = jobs[i]->d;
+		boost::unique_lock<boost::mutex> lock(states[i]->mutex);
+		if (d.timeout <= 0) {
+			// No timeout configured: wait for the target to finish
+			while (!states[i]->done)
+				states[i]->cond.wait(lock);
 		} else {
-			return nscapi::protobuf::functions::set_response_bad(*response.add_payload(), command + " not found");
+			boost::posix_time::ptime deadline = start + boost::posix_time::seconds(d.timeout * (std::max(d.retry, 0) + 1));
+			while (!states[i]->done) {
+				if (!states[i]->cond.timed_wait(lock, deadline))
+					break;
+			}
+		}
+		if (states[i]->done) {
+			response.mutable_payload()->MergeFrom(jobs[i]->response.payload());
+		} else {
+			// A queued job is skipped, a running one finishes in the background and the result is discarded
+			states[i]->abandoned = true;
+			nscapi::protobuf::functions::set_response_bad(*response.add_payload(), "Timeout submitting to " + d.to_string());
 		}
-	} catch (const std::exception &e) {
-		return nscapi::protobuf::functions::set_response_bad(*response.add_payload(), "Exception processing command line: " + utf8::utf8_from_native(e.what()));
 	}
 }
 
@@ -678,6 +897,7 @@ void client::configuration::do_metrics(const PB::Metrics::MetricsMessage &reques
 void client::configuration::finalize(boost::shared_ptr<nscapi::settings_proxy> settings) {
 	targets.add_samples(settings);
 	targets.add_missing(settings, "default", "");
+	invalidate_targets();
 }
 void payload_builder::set_result(const std::string &value) {
 	if (is_submit()) {
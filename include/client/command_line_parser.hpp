@@ -28,8 +28,13 @@
 #include <NSCAPI.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <list>
+#include <map>
 
 namespace client {
 	struct cli_exception : public std::exception {
@@ -208,6 +213,8 @@ namespace client {
 	};
 	typedef boost::shared_ptr<handler_interface> handler_type;
 
+	class submit_pool;
+
 	struct configuration : public boost::noncopyable {
 		typedef boost::unordered_map<std::string, command_container> command_type;
 
@@ -221,10 +228,8 @@ namespace client {
 		std::string default_sender;
 		command_type commands;
 
-		configuration(std::string caption, handler_type handler, options_reader_type reader)
-			: handler(handler)
-			, reader(reader)
-			, targets(reader) {}
+		configuration(std::string caption, handler_type handler, options_reader_type reader);
+		~configuration();
 
 		std::string to_string() {
 			std::stringstream ss;
@@ -235,10 +240,12 @@ namespace client {
 
 		void set_path(std::string path) {
 			targets.set_path(path);
+			invalidate_targets();
 		}
 
 		void set_sender(std::string _sender) {
 			default_sender = _sender;
+			invalidate_targets();
 		}
 
 		destination_container get_target(const std::string name) const;
@@ -246,13 +253,17 @@ namespace client {
 
 		void add_target(boost::shared_ptr<nscapi::settings_proxy> proxy, std::string key, std::string value) {
 			targets.add(proxy, key, value);
+			invalidate_targets();
 		}
 		std::string add_command(std::string name, std::string args);
 		void clear() {
 			targets.clear();
 			commands.clear();
+			invalidate_targets();
 		}
 		void finalize(boost::shared_ptr<nscapi::settings_proxy> settings);
+		// Wait for submissions running in the background (call when the module is unloaded)
+		void stop();
 
 		void do_query(const PB::Commands::QueryRequestMessage &request, PB::Commands::QueryResponseMessage &response);
 		bool do_exec(const PB::Commands::ExecuteRequestMessage &request, PB::Commands::ExecuteResponseMessage &response, const std::string &default_command);
@@ -268,9 +279,23 @@ namespace client {
 		client_pre_fun client_pre;
 
 	private:
+		// Resolved targets (by name) valid until the targets or the sender changes, the least recently
+		// used target is evicted when the cache is full.
+		typedef std::list<std::string> target_lru_type;
+		struct cached_target {
+			destination_container target;
+			target_lru_type::iterator lru;
+		};
+		mutable boost::mutex cache_mutex_;
+		mutable std::map<std::string, cached_target> target_cache_;
+		mutable target_lru_type target_lru_;
+		void invalidate_targets() const;
+
+		// Threads used to submit to several targets at once
+		boost::scoped_ptr<submit_pool> pool_;
+
 		boost::program_options::options_description create_descriptor(const std::string command, client::destination_container &source, client::destination_container &destination);
 		void i_do_query(destination_container &s, destination_container &d, std::string command, const PB::Commands::QueryRequestMessage &request, PB::Commands::QueryResponseMessage &response, bool use_header);
 		bool i_do_exec(destination_container &s, destination_container &d, std::string command, const PB::Commands::ExecuteRequestMessage &request, PB::Commands::ExecuteResponseMessage &response, bool use_header);
-		void i_do_submit(destination_container &s, destination_container &d, std::string command, const PB::Commands::SubmitRequestMessage &request, PB::Commands::SubmitResponseMessage &response, bool use_header);
 	};
 }
\ No newline at end of file
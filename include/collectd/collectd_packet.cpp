@@ -27,6 +27,239 @@
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
 
+#ifdef USE_SSL
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#endif
+
+const std::size_t collectd::encoder::max_packet_size;
+
+namespace {
+	// Smallest datagram we accept: room for the identifiers and a few values
+	const std::size_t min_packet_size = 256;
+	const std::string empty_string;
+
+	const std::string& optional_string(const boost::optional<std::string> &value) {
+		return value ? *value : empty_string;
+	}
+}
+
+collectd::encoder::encoder(std::size_t packet_size, security_level security, const std::string &username, const std::string &password)
+	: limit_(packet_size), header_(0), pos_(0), count_(0), security_(security), username_(username), password_(password), time_hr_(0), interval_hr_(0) {
+	if (limit_ > max_packet_size || limit_ == 0)
+		limit_ = max_packet_size;
+	if (limit_ < min_packet_size)
+		limit_ = min_packet_size;
+#ifdef USE_SSL
+	if (security_ == security_sign)
+		header_ = 4 + SHA256_DIGEST_LENGTH + username_.size();
+	else if (security_ == security_encrypt)
+		header_ = 4 + 2 + username_.size() + 16 + SHA_DIGEST_LENGTH;
+#else
+	if (security_ != security_none)
+		throw collectd_exception("Signed and encrypted packets require SSL support");
+#endif
+	if (security_ != security_none && username_.empty())
+		throw collectd_exception("A username is required for signed and encrypted packets");
+	if (header_ + min_packet_size / 2 > limit_)
+		throw collectd_exception("Username is too long: " + username_);
+	reset();
+}
+
+collectd::encoder::security_level collectd::encoder::parse_security_level(const std::string &level) {
+	std::string l = boost::algorithm::to_lower_copy(level);
+	if (l.empty() || l == "none")
+		return security_none;
+	if (l == "sign")
+		return security_sign;
+	if (l == "encrypt")
+		return security_encrypt;
+	throw collectd_exception("Invalid security level: " + level + " (should be none, sign or encrypt)");
+}
+
+void collectd::encoder::reset() {
+	pos_ = header_;
+	count_ = 0;
+	host_.clear();
+	time_hr_ = 0;
+	interval_hr_ = 0;
+	plugin_.clear();
+	plugin_instance_.clear();
+	type_.clear();
+	type_instance_.clear();
+}
+
+bool collectd::encoder::add(const std::string &host, const value_list &vl) {
+	const std::string &plugin_instance = optional_string(vl.plugin_instance);
+	const std::string &type_instance = optional_string(vl.type_instance);
+	bool fresh = count_ == 0;
+
+	// The receiver starts each datagram with empty instances so those only need to be sent when they change
+	bool w_host = fresh || host != host_;
+	bool w_time = fresh || vl.time_hr != time_hr_;
+	bool w_interval = fresh || vl.interval_hr != interval_hr_;
+	bool w_plugin = fresh || vl.plugin_name != plugin_;
+	bool w_plugin_instance = plugin_instance != plugin_instance_;
+	bool w_type = fresh || vl.type_name != type_;
+	bool w_type_instance = type_instance != type_instance_;
+
+	std::size_t need = values_size(vl.gauges.size() + vl.derives.size());
+	if (w_host)
+		need += string_size(host);
+	if (w_time)
+		need += 12;
+	if (w_interval)
+		need += 12;
+	if (w_plugin)
+		need += string_size(vl.plugin_name);
+	if (w_plugin_instance)
+		need += string_size(plugin_instance);
+	if (w_type)
+		need += string_size(vl.type_name);
+	if (w_type_instance)
+		need += string_size(type_instance);
+
+	if (pos_ + need > limit_) {
+		if (fresh)
+			throw collectd_exception("Value list too large for a packet: " + vl.to_string());
+		return false;
+	}
+
+	if (w_host) {
+		put_string(part_host, host);
+		host_ = host;
+	}
+	if (w_time) {
+		put_int(part_time_hr, vl.time_hr);
+		time_hr_ = vl.time_hr;
+	}
+	if (w_interval) {
+		put_int(part_interval_hr, vl.interval_hr);
+		interval_hr_ = vl.interval_hr;
+	}
+	if (w_plugin) {
+		put_string(part_plugin, vl.plugin_name);
+		plugin_ = vl.plugin_name;
+	}
+	if (w_plugin_instance) {
+		put_string(part_plugin_instance, plugin_instance);
+		plugin_instance_ = plugin_instance;
+	}
+	if (w_type) {
+		put_string(part_type, vl.type_name);
+		type_ = vl.type_name;
+	}
+	if (w_type_instance) {
+		put_string(part_type_instance, type_instance);
+		type_instance_ = type_instance;
+	}
+	put_values(vl);
+	count_++;
+	return true;
+}
+
+void collectd::encoder::put_values(const value_list &vl) {
+	std::size_t count = vl.gauges.size() + vl.derives.size();
+	put_header(pos_, part_values, values_size(count));
+	put<uint16_t>(pos_, swap_bytes::hton<uint16_t>(static_cast<uint16_t>(count)));
+	for (std::size_t i = 0; i < vl.gauges.size(); i++)
+		buffer_[pos_++] = value_gauge;
+	for (std::size_t i = 0; i < vl.derives.size(); i++)
+		buffer_[pos_++] = value_derive;
+	// Gauges are little endian doubles, derives are big endian (like every other integer)
+	BOOST_FOREACH(const double &v, vl.gauges) {
+		put<double>(pos_, swap_bytes::htol<double>(v));
+	}
+	BOOST_FOREACH(const long long &v, vl.derives) {
+		put<uint64_t>(pos_, swap_bytes::hton<uint64_t>(static_cast<uint64_t>(v)));
+	}
+}
+
+const char* collectd::encoder::finish(std::size_t &length) {
+	if (security_ == security_sign)
+		sign();
+	else if (security_ == security_encrypt)
+		encrypt();
+	length = pos_;
+	return buffer_;
+}
+
+#ifdef USE_SSL
+void collectd::encoder::sign() {
+	// [type][length][hmac][username][payload...] where the hmac covers the username and the payload
+	std::size_t pos = 0;
+	put_header(pos, part_signature, header_);
+	unsigned char *hmac = reinterpret_cast<unsigned char*>(&buffer_[pos]);
+	pos += SHA256_DIGEST_LENGTH;
+	unsigned char *data = reinterpret_cast<unsigned char*>(&buffer_[pos]);
+	put_bytes(pos, username_.c_str(), username_.size());
+
+	unsigned int hmac_len = SHA256_DIGEST_LENGTH;
+	if (HMAC(EVP_sha256(), password_.c_str(), static_cast<int>(password_.size()), data, pos_ - (pos - username_.size()), hmac, &hmac_len) == NULL)
+		throw collectd_exception("Failed to sign packet");
+}
+
+void collectd::encoder::encrypt() {
+	// [type][length][username length][username][iv][sha1(payload)][payload...] where everything from the sha1 is encrypted
+	std::size_t pos = 0;
+	put_header(pos, part_encryption, pos_);
+	put<uint16_t>(pos, swap_bytes::hton<uint16_t>(static_cast<uint16_t>(username_.size())));
+	put_bytes(pos, username_.c_str(), username_.size());
+	unsigned char *iv = reinterpret_cast<unsigned char*>(&buffer_[pos]);
+	pos += 16;
+	unsigned char *encrypted = reinterpret_cast<unsigned char*>(&buffer_[pos]);
+
+	if (iv_.size() == 16)
+		memcpy(iv, iv_.c_str(), 16);
+	else if (RAND_bytes(iv, 16) != 1)
+		throw collectd_exception("Failed to generate IV");
+	SHA1(encrypted + SHA_DIGEST_LENGTH, pos_ - header_, encrypted);
+	unsigned char key[SHA256_DIGEST_LENGTH];
+	SHA256(reinterpret_cast<const unsigned char*>(password_.c_str()), password_.size(), key);
+
+	int len = static_cast<int>(pos_ - pos);
+	int out_len = 0;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	bool ok = ctx != NULL
+		&& EVP_EncryptInit_ex(ctx, EVP_aes_256_ofb(), NULL, key, iv) == 1
+		&& EVP_EncryptUpdate(ctx, encrypted, &out_len, encrypted, len) == 1
+		&& EVP_EncryptFinal_ex(ctx, encrypted + out_len, &out_len) == 1;
+	if (ctx != NULL)
+		EVP_CIPHER_CTX_free(ctx);
+	if (!ok)
+		throw collectd_exception("Failed to encrypt packet");
+}
+#else
+void collectd::encoder::sign() {}
+void collectd::encoder::encrypt() {}
+#endif
+
+std::size_t collectd::collectd_builder::render(encoder &enc, packet_sink sink) {
+	std::size_t packets = 0;
+	std::size_t length = 0;
+	enc.reset();
+	BOOST_FOREACH(const metric_container &m, rendererd_metrics) {
+		if (m.gauges.empty() && m.derives.empty())
+			continue;
+		if (!enc.add(host, m)) {
+			const char *data = enc.finish(length);
+			sink(data, length);
+			packets++;
+			enc.reset();
+			enc.add(host, m);
+		}
+	}
+	if (!enc.empty()) {
+		const char *data = enc.finish(length);
+		sink(data, length);
+		packets++;
+		enc.reset();
+	}
+	return packets;
+}
+
 
 std::list<collectd::collectd_builder::expanded_keys> collectd::collectd_builder::expand_keyword(const std::string &keyword, const std::string &value) {
 	parsers::simple_expression::result_type expr;
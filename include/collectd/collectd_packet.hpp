@@ -17,6 +17,7 @@
  * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #pragma once
 
 #include <types.hpp>
@@ -24,7 +25,9 @@
 #include <str/utils.hpp>
 #include <str/xtos.hpp>
 #include <stdint.h>
+#include <string.h>
 
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
 #include <boost/foreach.hpp>
@@ -35,33 +38,6 @@
 #include <sstream>
 
 namespace collectd {
-	class data {
-	public:
-		struct string_part : public boost::noncopyable {
-			int16_t   type;
-			int16_t   length;
-			char      data[];
-
-			char* get_data() {
-				return &data[0];
-			}
-		};
-		struct int64_part : public boost::noncopyable {
-			int16_t   type;
-			int16_t   length;
-			int64_t data;
-		};
-		struct value_part : public boost::noncopyable {
-			int16_t   type;
-			int16_t   length;
-			int16_t   count;
-		};
-		struct derive_value_part : public boost::noncopyable {
-			int8_t   type;
-			int64_t   value;
-		};
-	};
-
 
 	class collectd_exception : public std::exception {
 		std::string msg_;
@@ -72,202 +48,183 @@ namespace collectd {
 		const char* what() const throw () { return msg_.c_str(); }
 	};
 
-	class packet {
-	public:
-
-		std::string buffer;
-	public:
-		packet() {}
-		packet(const packet &other) : buffer(other.buffer) {}
-		packet operator =(const packet &other) {
-			buffer = other.buffer;
-			return *this;
+	struct value_list {
+		long long time_hr;
+		long long interval_hr;
+		std::string plugin_name;
+		boost::optional<std::string> plugin_instance;
+		std::string type_name;
+		boost::optional<std::string> type_instance;
+		std::list<double> gauges;
+		std::list<long long> derives;
+
+		value_list(long long time_hr, long long interval_hr) : time_hr(time_hr), interval_hr(interval_hr) {}
+
+		void set_type(const std::string &type_name_, const std::string &type_instance_) {
+			type_name = type_name_;
+			type_instance = type_instance_;
+		}
+		void set_type(const std::string &type_name_) {
+			type_name = type_name_;
+		}
+		void set_plugin(const std::string &plugin_name_, const boost::optional<std::string> &plugin_instance_) {
+			plugin_name = plugin_name_;
+			plugin_instance = plugin_instance_;
+		}
+		void set_plugin(const std::string &plugin_name_) {
+			plugin_name = plugin_name_;
 		}
-
 		std::string to_string() const {
 			std::stringstream ss;
-			ss << "TODO";
+			ss << plugin_name << "-";
+			if (plugin_instance)
+				ss << *plugin_instance;
+			ss << "/" << type_name << "-";
+			if (type_instance)
+				ss << *type_instance;
+			ss << "=";
+			if (!gauges.empty()) {
+				ss << " gagues: ";
+				BOOST_FOREACH(const double &d, gauges) {
+					ss << d << ", ";
+				}
+			}
+			if (!derives.empty()) {
+				ss << " derives: ";
+				BOOST_FOREACH(const long long &d, derives) {
+					ss << d << ", ";
+				}
+			}
 			return ss.str();
 		}
+	};
 
-		void add_host(std::string value) {
-			append_string(0x0000, value);
-		}
-		void add_plugin(std::string value) {
-			append_string(0x0002, value);
-		}
-		void add_plugin_instance(std::string value) {
-			append_string(0x0003, value);
-		}
-		void add_type(std::string value) {
-			append_string(0x0004, value);
-		}
-		void add_type_instance(std::string value) {
-			append_string(0x0005, value);
-		}
-		void add_gauge_value(std::list<double> values) {
-			append_values(0x00006, 0x01, values);
-		}
-		void add_derive_value(std::list<long long> values) {
-			append_values(0x00006, 0x02, values);
-		}
-		void add_time_hr(unsigned long long time) {
-			append_int(0x0008, time);
-		}
-		void add_interval_hr(unsigned long long time) {
-			append_int(0x0009, time);
-		}
+	/**
+	 * Encodes value lists (collectd binary protocol) into a fixed size buffer.
+	 *
+	 * As many value lists as fit are packed into one datagram and the host, time, interval, plugin and type
+	 * parts are only written when they differ from the previous value list in the same datagram (the receiver
+	 * keeps them as state while parsing a packet). Datagrams can optionally be signed (HMAC-SHA256) or
+	 * encrypted (AES-256-OFB) as the collectd network plugin expects, this requires SSL support.
+	 */
+	class encoder : public boost::noncopyable {
+	public:
+		// Default MaxPacketSize of the collectd network plugin (fits an ethernet MTU)
+		static const std::size_t max_packet_size = 1452;
+		enum security_level {
+			security_none,
+			security_sign,
+			security_encrypt
+		};
 
-		bool is_full() const {
-			return buffer.size() > 200;
-		}
+		enum part_type {
+			part_host = 0x0000,
+			part_plugin = 0x0002,
+			part_plugin_instance = 0x0003,
+			part_type = 0x0004,
+			part_type_instance = 0x0005,
+			part_values = 0x0006,
+			part_time_hr = 0x0008,
+			part_interval_hr = 0x0009,
+			part_signature = 0x0200,
+			part_encryption = 0x0210
+		};
+		enum value_type {
+			value_derive = 0x02,
+			value_gauge = 0x01
+		};
 
+	private:
+		char buffer_[max_packet_size];
+		std::size_t limit_;
+		// Bytes reserved at the start of the buffer for the signature/encryption part
+		std::size_t header_;
+		std::size_t pos_;
+		std::size_t count_;
+		security_level security_;
+		std::string username_;
+		std::string password_;
+		std::string iv_;
+
+		// The identifiers the receiver has seen so far in this datagram
+		std::string host_;
+		long long time_hr_;
+		long long interval_hr_;
+		std::string plugin_;
+		std::string plugin_instance_;
+		std::string type_;
+		std::string type_instance_;
 
-		template<class T>
-		inline void set_byte(std::string &buffer, const std::string::size_type pos, const T value) {
-			T *b_value = reinterpret_cast<T*>(&buffer[pos]);
-			*b_value = swap_bytes::hton<T>(value);
-		}
+	public:
+		encoder(std::size_t packet_size = max_packet_size, security_level security = security_none, const std::string &username = "", const std::string &password = "");
+
+		static security_level parse_security_level(const std::string &level);
 
-		void append_string(int16_t type, std::string &string_data) {
-			int16_t len = static_cast<int16_t>(string_data.length()) + 5;
-			std::string::size_type pos = buffer.length();
-			buffer.append(sizeof(collectd::data::string_part), '\0');
-			collectd::data::string_part *data = reinterpret_cast<collectd::data::string_part*>(&buffer[pos]);
-			data->type = swap_bytes::hton<int16_t>(type);
-			data->length = swap_bytes::hton<int16_t>(len);
-			buffer.append(string_data.c_str(), string_data.length() + 1);
+		// Adds a value list to the current datagram.
+		// Returns false (and leaves the datagram unchanged) if it does not fit, the caller should then send
+		// the datagram (finish) and add the value list again.
+		bool add(const std::string &host, const value_list &vl);
+
+		// Finalizes (signs/encrypts) the current datagram, the returned buffer is valid until the next reset.
+		const char* finish(std::size_t &length);
+		void reset();
+
+		// Use a fixed IV instead of a random one when encrypting (only for tests)
+		void set_iv(const std::string &iv) {
+			iv_ = iv;
 		}
-		void append_int(int16_t type, unsigned long long int_data) {
-			std::string::size_type pos = buffer.length();
-			buffer.append(sizeof(int16_t) + sizeof(int16_t) + sizeof(int64_t), '\0');
-			int16_t len = static_cast<int16_t>(buffer.length() - pos);
-			set_byte<uint16_t>(buffer, pos, type);
-			set_byte<uint16_t>(buffer, pos + sizeof(int16_t), len);
-			set_byte<uint64_t>(buffer, pos + sizeof(int16_t) + sizeof(int16_t), int_data);
+
+		bool empty() const {
+			return count_ == 0;
 		}
-		void append_values(int16_t base_type, int value_type, const std::list<double> &value_data) {
-			std::string::size_type pos = buffer.length();
-			buffer.append(sizeof(collectd::data::value_part), '\0');
-			for (std::size_t i = 0;  i < value_data.size(); i++) {
-				append_value_type(value_type);
-			}
-			BOOST_FOREACH(const double &v, value_data) {
-				append_value_value(v);
-			}
-			int16_t len = static_cast<int16_t>(buffer.length() - pos);
-			collectd::data::value_part *data = reinterpret_cast<collectd::data::value_part*>(&buffer[pos]);
-			data->type = swap_bytes::hton<int16_t>(base_type);
-			data->count = swap_bytes::hton<int16_t>(value_data.size());
-			data->length = swap_bytes::hton<int16_t>(len);
+		std::size_t count() const {
+			return count_;
 		}
-		void append_values(int16_t base_type, int value_type, const std::list<long long> &value_data) {
-			std::string::size_type pos = buffer.length();
-			buffer.append(sizeof(collectd::data::value_part), '\0');
-			for (std::size_t i = 0; i < value_data.size(); i++) {
-				append_value_type(value_type);
-			}
-			BOOST_FOREACH(const long long &v, value_data) {
-				append_value_value(v);
-			}
-			int16_t len = static_cast<int16_t>(buffer.length() - pos);
-			collectd::data::value_part *data = reinterpret_cast<collectd::data::value_part*>(&buffer[pos]);
-			data->type = swap_bytes::hton<int16_t>(base_type);
-			data->count = swap_bytes::hton<int16_t>(value_data.size());
-			data->length = swap_bytes::hton<int16_t>(len);
+		std::size_t size() const {
+			return pos_;
 		}
 
-		void append_value_type(int type) {
-			std::string::size_type pos = buffer.length();
-			int sz = sizeof(int8_t);
-			buffer.append(sz, '\0');
-			int8_t *b_type = reinterpret_cast<int8_t*>(&buffer[pos]);
-			*b_type = type;
+	private:
+		static std::size_t string_size(const std::string &value) {
+			return 4 + value.size() + 1;
 		}
-		void append_value_value(const double double_data) {
-			std::string::size_type pos = buffer.length();
-			int sz = sizeof(int64_t);
-			buffer.append(sz, '\0');
-			// 				int64_t *b_value = reinterpret_cast<int64_t*>(&buffer[pos + sizeof(int8_t)]);
-			// 				*b_value = swap_bytes::hton<int64_t>(*int_data);
-			double *b_dvalue = reinterpret_cast<double*>(&buffer[pos]);
-			*b_dvalue = double_data;
+		static std::size_t values_size(std::size_t count) {
+			return 6 + count * 9;
 		}
-		void append_value_value(const long long int_data) {
-			std::string::size_type pos = buffer.length();
-			int sz = sizeof(int64_t);
-			buffer.append(sz, '\0');
-			int64_t *b_value = reinterpret_cast<int64_t*>(&buffer[pos]);
-			*b_value = swap_bytes::hton<int64_t>(int_data);
+		template<class T>
+		void put(std::size_t &pos, const T value) {
+			memcpy(&buffer_[pos], &value, sizeof(T));
+			pos += sizeof(T);
 		}
-
-
-		std::string get_buffer() const {
-			return buffer;
+		void put_bytes(std::size_t &pos, const char *data, std::size_t length) {
+			memcpy(&buffer_[pos], data, length);
+			pos += length;
 		}
-
-		std::size_t get_size() const {
-			return buffer.size();
+		void put_header(std::size_t &pos, uint16_t type, std::size_t length) {
+			put<uint16_t>(pos, swap_bytes::hton<uint16_t>(type));
+			put<uint16_t>(pos, swap_bytes::hton<uint16_t>(static_cast<uint16_t>(length)));
+		}
+		void put_string(uint16_t type, const std::string &value) {
+			put_header(pos_, type, string_size(value));
+			put_bytes(pos_, value.c_str(), value.size() + 1);
 		}
+		void put_int(uint16_t type, long long value) {
+			put_header(pos_, type, 12);
+			put<uint64_t>(pos_, swap_bytes::hton<uint64_t>(static_cast<uint64_t>(value)));
+		}
+		void put_values(const value_list &vl);
+		void sign();
+		void encrypt();
 	};
 
 	struct collectd_builder {
 
-		struct metric_container {
-			long long time_hr;
-			long long interval_hr;
-			std::string plugin_name;
-			boost::optional<std::string> plugin_instance;
-			std::string type_name;
-			boost::optional<std::string> type_instance;
-			std::list<double> gauges;
-			std::list<long long> derives;
-
-			metric_container(long long time_hr, long long interval_hr) : time_hr(time_hr), interval_hr(interval_hr) {}
-
-			void set_type(const std::string &type_name_, const std::string &type_instance_) {
-				type_name = type_name_;
-				type_instance = type_instance_;
-			}
-			void set_type(const std::string &type_name_) {
-				type_name = type_name_;
-			}
-			void set_plugin(const std::string &plugin_name_, const boost::optional<std::string> &plugin_instance_) {
-				plugin_name = plugin_name_;
-				plugin_instance = plugin_instance_;
-			}
-			void set_plugin(const std::string &plugin_name_) {
-				plugin_name = plugin_name_;
-			}
-			std::string to_string() const {
-				std::stringstream ss;
-				ss << plugin_name << "-";
-				if (plugin_instance)
-					ss << *plugin_instance;
-				ss << "/" << type_name << "-";
-				if (type_instance)
-					ss << *type_instance;
-				ss << "=";
-				if (!gauges.empty()) {
-					ss << " gagues: ";
-					BOOST_FOREACH(const double &d, gauges) {
-						ss << d << ", ";
-					}
-				}
-				if (!derives.empty()) {
-					ss << " derives: ";
-					BOOST_FOREACH(const long long &d, derives) {
-						ss << d << ", ";
-					}
-				}
-				return ss.str();
-			}
-		};
-
+		typedef collectd::value_list metric_container;
 		typedef std::map<std::string, std::string> metrics_map;
 		typedef std::multimap<std::string, std::string> variables_map;
 		typedef std::list<metric_container> metrics_list;
-		typedef std::list<collectd::packet> packet_list;
+		// Receives each finished datagram (the buffer is only valid during the call)
+		typedef boost::function<void(const char*, std::size_t)> packet_sink;
 
 		variables_map variables;
 		metrics_map metrics;
@@ -383,64 +340,8 @@ namespace collectd {
 			return ss.str();
 		}
 
-		void render(packet_list &packets) {
-			bool is_new = true;
-			collectd::packet packet;
-
-			std::string last_plugin = "";
-			std::string last_plugin_instance = "";
-			std::string last_type = "";
-			std::string last_type_instance = "";
-			BOOST_FOREACH(const metric_container &m, rendererd_metrics) {
-				if (is_new) {
-					last_plugin = "";
-					last_plugin_instance = "";
-					last_type = "";
-					last_type_instance = "";
-					packet.add_host(host);
-					packet.add_time_hr(time_hr);
-					packet.add_interval_hr(interval_hr);
-					is_new = false;
-				}
-				if (m.plugin_name != last_plugin) {
-					packet.add_plugin(m.plugin_name);
-					last_plugin = m.plugin_name;
-				}
-				if (m.plugin_instance && last_plugin_instance != m.plugin_instance.get()) {
-					packet.add_plugin_instance(m.plugin_instance.get());
-					last_plugin_instance = m.plugin_instance.get();
-				} else if (!m.plugin_instance && last_plugin_instance != "") {
-					packet.add_plugin_instance("");
-					last_plugin_instance = "";
-				}
-
-				if (m.type_name != last_type) {
-					packet.add_type(m.type_name);
-					last_type = m.type_name;
-				}
-				if (m.type_instance && last_type_instance != m.type_instance.get()) {
-					packet.add_type_instance(m.type_instance.get());
-					last_type_instance = m.type_instance.get();
-				} else if (!m.type_instance && last_type_instance != "") {
-					packet.add_type_instance("");
-					last_type_instance = "";
-				}
-
-				if (!m.gauges.empty()) {
-					packet.add_gauge_value(m.gauges);
-				}
-				if (!m.derives.empty()) {
-					packet.add_derive_value(m.derives);
-				}
-				if (packet.is_full()) {
-					packets.push_back(packet);
-					packet = collectd::packet();
-					is_new = true;
-				}
-			}
-			packets.push_back(packet);
-
-		}
+		// Encodes all metrics (packing as many as fit into each datagram) and returns the number of datagrams
+		std::size_t render(encoder &enc, packet_sink sink);
 		void set_metric(const ::std::string& key, const std::string &value);
 	};
 
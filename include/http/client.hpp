@@ -27,12 +27,14 @@
 #include <boost/asio.hpp>
 #include <boost/version.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/algorithm/string.hpp>
 
 
 #include <iostream>
 #include <istream>
 #include <ostream>
 #include <string>
+#include <cstdlib>
 
 
 
@@ -237,28 +239,36 @@ namespace http {
 	class simple_client {
 		boost::asio::io_service io_service_;
 		boost::scoped_ptr<generic_socket> socket_;
+		std::string protocol_;
+		// The server:port we are connected to when the connection is kept open between requests
+		std::string connected_to_;
 	public:
 		simple_client(std::string protocol)
 			: io_service_()
+			, protocol_(protocol)
 		{
-			if (protocol == "https") {
+			create_socket();
+		}
+
+		~simple_client() {
+			socket_.reset();
+
+		}
+
+		void create_socket() {
+			if (protocol_ == "https") {
 #ifdef USE_SSL
 				socket_.reset(new ssl_socket(io_service_));
 #else
 				throw socket_helpers::socket_exception("SSL not supported");
 #endif
-			} else if (protocol == "pipe") {
+			} else if (protocol_ == "pipe") {
 				socket_.reset(new file_socket(io_service_));
 			} else {
 				socket_.reset(new tcp_socket(io_service_));
 			}
 		}
 
-		~simple_client() {
-			socket_.reset();
-
-		}
-
 		void connect(std::string server, std::string port) {
 			socket_->connect(server, port);
 		}
@@ -325,6 +335,122 @@ namespace http {
 			return response;
 		}
 
+		// Execute a request over a persistent (HTTP/1.1 keep-alive) connection which is reused by the next call.
+		// A reused connection which has been closed by the server is reconnected and the request is sent again.
+		// This is only done when sending failed or nothing at all was read back: once the server has started to
+		// reply it may have acted on the request so it is never sent twice.
+		http::response execute_keep_alive(std::ostream &os, const std::string server, const std::string port, http::packet request) {
+			request.set_keep_alive();
+			std::string target = server + ":" + port;
+			bool reused = !connected_to_.empty() && connected_to_ == target && socket_->is_open();
+			if (!reused) {
+				disconnect();
+				connect(server, port);
+				connected_to_ = target;
+			}
+			bool can_retry = false;
+			try {
+				return execute_on_connection(os, server, port, request, can_retry);
+			} catch (const std::exception &) {
+				disconnect();
+				if (!reused || !can_retry)
+					throw;
+			}
+			connect(server, port);
+			connected_to_ = target;
+			try {
+				return execute_on_connection(os, server, port, request, can_retry);
+			} catch (const std::exception &) {
+				disconnect();
+				throw;
+			}
+		}
+
+		void disconnect() {
+			connected_to_.clear();
+			create_socket();
+		}
+
+	private:
+		// can_retry is set when the request failed before anything was read back from the server
+		http::response execute_on_connection(std::ostream &os, const std::string &server, const std::string &port, const http::packet &request, bool &can_retry) {
+			can_retry = true;
+			send_request(request);
+			boost::asio::streambuf response_buffer;
+			try {
+				socket_->read_until(response_buffer, "\r\n");
+			} catch (const std::exception &) {
+				can_retry = response_buffer.size() == 0;
+				throw;
+			}
+			can_retry = false;
+			http::response response = read_result(response_buffer);
+
+			std::string length = response.get_header("Content-Length");
+			boost::system::error_code error;
+			if (boost::algorithm::iequals(response.get_header("Transfer-Encoding"), "chunked")) {
+				read_chunked(os, response_buffer);
+			} else if (!length.empty()) {
+				std::size_t size = str::stox<std::size_t>(length, 0);
+				while (response_buffer.size() < size) {
+					if (socket_->read_some(response_buffer, error) == 0)
+						throw socket_helpers::socket_exception("Connection closed while reading response: " + error.message());
+				}
+				copy_bytes(os, response_buffer, size);
+			} else {
+				// No length: the body ends when the server closes the connection
+				if (response_buffer.size() > 0)
+					os << &response_buffer;
+				while (socket_->read_some(response_buffer, error)) {
+					os << &response_buffer;
+				}
+				connected_to_.clear();
+			}
+			if (boost::algorithm::iequals(response.get_header("Connection"), "close") || response.http_version_ == "HTTP/1.0")
+				connected_to_.clear();
+
+			if (!response.is_2xx()) {
+				connected_to_.clear();
+				throw socket_helpers::socket_exception("Failed to " + request.verb_ + " " + server + ":" + str::xtos(port) + " " + str::xtos(response.status_code_) + ": " + response.status_message_);
+			}
+			return response;
+		}
+
+		void copy_bytes(std::ostream &os, boost::asio::streambuf &buffer, std::size_t size) {
+			const char *data = boost::asio::buffer_cast<const char*>(buffer.data());
+			os.write(data, size);
+			buffer.consume(size);
+		}
+
+		std::string read_line(boost::asio::streambuf &buffer) {
+			socket_->read_until(buffer, "\r\n");
+			std::istream stream(&buffer);
+			std::string line;
+			std::getline(stream, line);
+			boost::algorithm::trim(line);
+			return line;
+		}
+
+		void read_chunked(std::ostream &os, boost::asio::streambuf &buffer) {
+			boost::system::error_code error;
+			while (true) {
+				std::string line = read_line(buffer);
+				std::size_t size = std::strtoul(line.c_str(), NULL, 16);
+				if (size == 0) {
+					// Trailers end with an empty line
+					while (!read_line(buffer).empty()) {}
+					return;
+				}
+				while (buffer.size() < size + 2) {
+					if (socket_->read_some(buffer, error) == 0)
+						throw socket_helpers::socket_exception("Connection closed while reading response: " + error.message());
+				}
+				copy_bytes(os, buffer, size);
+				buffer.consume(2);
+			}
+		}
+
+	public:
 		static bool download(std::string protocol, std::string server, std::string port, std::string path, std::ostream &os, std::string &error_msg) {
 			try {
 				http::packet rq("GET", server, path);
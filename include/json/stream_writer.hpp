@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace json {
+
+	// A sink which appends to a string
+	struct string_sink {
+		std::string &data;
+		string_sink(std::string &data) : data(data) {}
+		void write(const char *buffer, std::size_t len) {
+			data.append(buffer, len);
+		}
+	};
+
+	/**
+	 * Writes JSON to a sink (anything with write(const char*, std::size_t), such as a Mongoose::StreamResponse)
+	 * while it is being produced instead of building a document first.
+	 *
+	 * Output is collected in a fixed buffer and handed to the sink in blocks, nothing is allocated while writing.
+	 * The writer only keeps track of where separators go: it is up to the caller to produce a valid structure
+	 * (matching begin/end calls and a key before every value in an object).
+	 *
+	 *   json::writer<Mongoose::StreamResponse> w(response);
+	 *   w.begin_object().member("name", name).key("lines").begin_array() ... w.end_array().end_object();
+	 */
+	template<class Sink>
+	class writer : boost::noncopyable {
+		static const std::size_t buffer_size = 4096;
+		static const std::size_t max_depth = 64;
+
+		Sink &sink_;
+		char buffer_[buffer_size];
+		std::size_t pos_;
+		// Set when the next value at depth_ is the first one (i.e. it needs no comma)
+		bool first_[max_depth];
+		std::size_t depth_;
+		bool after_key_;
+
+	public:
+		writer(Sink &sink) : sink_(sink), pos_(0), depth_(0), after_key_(false) {
+			first_[0] = true;
+		}
+		~writer() {
+			flush();
+		}
+
+		writer& begin_object() {
+			separator();
+			put('{');
+			push();
+			return *this;
+		}
+		writer& end_object() {
+			pop();
+			put('}');
+			return *this;
+		}
+		writer& begin_array() {
+			separator();
+			put('[');
+			push();
+			return *this;
+		}
+		writer& end_array() {
+			pop();
+			put(']');
+			return *this;
+		}
+
+		writer& key(const char *k) {
+			return key(k, std::strlen(k));
+		}
+		writer& key(const std::string &k) {
+			return key(k.c_str(), k.size());
+		}
+		writer& key(const char *k, std::size_t len) {
+			separator();
+			put_string(k, len);
+			put(':');
+			after_key_ = true;
+			return *this;
+		}
+
+		writer& value(const char *v) {
+			separator();
+			put_string(v, std::strlen(v));
+			return *this;
+		}
+		writer& value(const std::string &v) {
+			separator();
+			put_string(v.c_str(), v.size());
+			return *this;
+		}
+		writer& value(bool v) {
+			separator();
+			if (v)
+				put("true", 4);
+			else
+				put("false", 5);
+			return *this;
+		}
+		writer& value(int v) {
+			return value(static_cast<long long>(v));
+		}
+		writer& value(long v) {
+			return value(static_cast<long long>(v));
+		}
+		writer& value(long long v) {
+			separator();
+			if (v < 0) {
+				put('-');
+				put_unsigned(0ULL - static_cast<unsigned long long>(v));
+			} else {
+				put_unsigned(static_cast<unsigned long long>(v));
+			}
+			return *this;
+		}
+		writer& value(unsigned int v) {
+			return value(static_cast<unsigned long long>(v));
+		}
+		writer& value(unsigned long v) {
+			return value(static_cast<unsigned long long>(v));
+		}
+		writer& value(unsigned long long v) {
+			separator();
+			put_unsigned(v);
+			return *this;
+		}
+		writer& value(double v) {
+			separator();
+			put_double(v);
+			return *this;
+		}
+		writer& null() {
+			separator();
+			put("null", 4);
+			return *this;
+		}
+
+		template<class T>
+		writer& member(const char *k, const T &v) {
+			key(k);
+			return value(v);
+		}
+
+		// Hands everything written so far to the sink
+		void flush() {
+			if (pos_ > 0) {
+				sink_.write(buffer_, pos_);
+				pos_ = 0;
+			}
+		}
+
+	private:
+		void push() {
+			if (depth_ + 1 < max_depth)
+				depth_++;
+			first_[depth_] = true;
+		}
+		void pop() {
+			if (depth_ > 0)
+				depth_--;
+			after_key_ = false;
+		}
+		void separator() {
+			if (after_key_) {
+				after_key_ = false;
+				return;
+			}
+			if (!first_[depth_])
+				put(',');
+			first_[depth_] = false;
+		}
+
+		void put(char c) {
+			if (pos_ == buffer_size)
+				flush();
+			buffer_[pos_++] = c;
+		}
+		void put(const char *data, std::size_t len) {
+			if (len > buffer_size - pos_) {
+				flush();
+				if (len > buffer_size) {
+					sink_.write(data, len);
+					return;
+				}
+			}
+			std::memcpy(buffer_ + pos_, data, len);
+			pos_ += len;
+		}
+		void put_unsigned(unsigned long long v) {
+			char tmp[24];
+			char *end = tmp + sizeof(tmp);
+			char *p = end;
+			do {
+				*--p = static_cast<char>('0' + v % 10);
+				v /= 10;
+			} while (v != 0);
+			put(p, end - p);
+		}
+		void put_double(double v) {
+			if (v != v || v - v != v - v) {
+				// NaN and infinity can not be represented
+				put("null", 4);
+				return;
+			}
+			char tmp[32];
+			// The shortest representation which reads back as the same value
+			int len = snprintf(tmp, sizeof(tmp), "%.15g", v);
+			if (std::strtod(tmp, NULL) != v)
+				len = snprintf(tmp, sizeof(tmp), "%.17g", v);
+			for (int i = 0; i < len; i++) {
+				if (tmp[i] == ',')
+					tmp[i] = '.';
+			}
+			put(tmp, len);
+		}
+		void put_string(const char *s, std::size_t len) {
+			static const char hex[] = "0123456789abcdef";
+			put('"');
+			const char *begin = s;
+			const char *end = s + len;
+			for (const char *p = s; p != end; ++p) {
+				unsigned char c = static_cast<unsigned char>(*p);
+				if (c >= 0x20 && c != '"' && c != '\\')
+					continue;
+				put(begin, p - begin);
+				begin = p + 1;
+				switch (c) {
+				case '"': put("\\\"", 2); break;
+				case '\\': put("\\\\", 2); break;
+				case '\b': put("\\b", 2); break;
+				case '\f': put("\\f", 2); break;
+				case '\n': put("\\n", 2); break;
+				case '\r': put("\\r", 2); break;
+				case '\t': put("\\t", 2); break;
+				default: {
+					char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+					put(u, 6);
+				}
+				}
+			}
+			put(begin, end - begin);
+			put('"');
+		}
+	};
+}
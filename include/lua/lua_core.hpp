@@ -38,6 +38,7 @@ extern "C" {
 #include <str/xtos.hpp>
 #include <scripts/script_interface.hpp>
 #include <lua/lua_script.hpp>
+#include <lua/lua_pool.hpp>
 
 namespace lua {
 	typedef scripts::script_information<lua_traits> script_information;
@@ -51,8 +52,12 @@ namespace lua {
 	struct lua_runtime : public scripts::script_runtime_interface<lua::lua_traits> {
 		std::string base_path;
 		std::list<lua_runtime_plugin_type> plugins;
+		// Maximum number of states per script (1 means all calls to a script are serialized)
+		unsigned int pool_size;
+		// Where compiled scripts are cached (empty to disable)
+		std::string cache_path;
 
-		lua_runtime(std::string base_path) : base_path(base_path) {}
+		lua_runtime(std::string base_path) : base_path(base_path), pool_size(1) {}
 
 		virtual void register_query(const std::string &command, const std::string &description);
 		virtual void register_subscription(const std::string &channel, const std::string &description);
@@ -81,6 +86,16 @@ namespace lua {
 			lua_getglobal(L, f.c_str());
 			return L;
 		}
+		static lua_State * prep_function(lua_State *L, const lua::lua_traits::function_type &c) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, c.function_ref);
+			if (c.object_ref != 0)
+				lua_rawgeti(L, LUA_REGISTRYINDEX, c.object_ref);
+			return L;
+		}
 		void create_user_data(script_information* info);
+
+	private:
+		void init_state(script_information *info, const lua::chunk &c, lua::pooled_state &state);
+		void unload_state(lua_State *L);
 	};
 }
\ No newline at end of file
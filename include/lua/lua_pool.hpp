@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lua/lua_script.hpp>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace lua {
+
+	// A compiled script: loads the bytecode for a script from the on-disk cache (keyed by a hash of the source)
+	// or compiles and stores it.
+	struct chunk {
+		std::string name;
+		std::string bytecode;
+
+		// Compile the script (using L as a scratch state, the stack is left unchanged).
+		// cache_path can be empty in which case nothing is read from or written to disk.
+		static chunk compile(lua_State *L, const std::string &script, const std::string &cache_path);
+		// Push the compiled function on the stack of L (returns 0 on success like luaL_loadbuffer)
+		int load(lua_State *L) const;
+	};
+
+	// One Lua state with the script loaded and the functions the script registered (in this state)
+	struct pooled_state : boost::noncopyable {
+		typedef std::map<std::string, lua_traits::function> function_map;
+		lua_State *L;
+		bool primary;
+		function_map functions;
+		boost::shared_ptr<Lua_State> owned;
+
+		pooled_state(lua_State *L, bool primary) : L(L), primary(primary) {}
+		pooled_state() : L(NULL), primary(false), owned(new Lua_State()) {
+			L = *owned;
+		}
+
+		static std::string make_key(const std::string &type, const std::string &command) {
+			return type + "$$" + command;
+		}
+		bool find(const std::string &type, const std::string &command, lua_traits::function &function) const;
+
+		static const std::string user_data_tag;
+	};
+
+	// A pool of identical states for a script (the primary state plus lazily created copies).
+	// A state is only ever used by one thread at a time.
+	class state_pool : boost::noncopyable {
+	public:
+		// Initializes a new (secondary) state: must load the libraries and run the script
+		typedef boost::function<void(pooled_state&)> initializer_type;
+
+	private:
+		unsigned int max_size_;
+		initializer_type initializer_;
+		boost::mutex mutex_;
+		boost::condition_variable cond_;
+		std::list<boost::shared_ptr<pooled_state> > states_;
+		std::list<pooled_state*> idle_;
+		unsigned int pending_;
+
+	public:
+		state_pool(pooled_state *primary, unsigned int max_size, initializer_type initializer);
+
+		// Borrows a state from the pool for the lifetime of the lease
+		class lease : boost::noncopyable {
+			state_pool &pool_;
+			pooled_state *state_;
+		public:
+			lease(state_pool &pool) : pool_(pool), state_(pool.acquire()) {}
+			~lease() {
+				pool_.release(state_);
+			}
+			pooled_state& operator*() const {
+				return *state_;
+			}
+			pooled_state* operator->() const {
+				return state_;
+			}
+		};
+
+		std::list<lua_State*> get_secondary_states();
+		unsigned int size();
+
+	private:
+		pooled_state* acquire();
+		void release(pooled_state *state);
+	};
+}
@@ -23,6 +23,7 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 
 extern "C" {
 #include <lua.h>
@@ -37,12 +38,17 @@ extern "C" {
 #include <scripts/script_interface.hpp>
 
 namespace lua {
+	struct pooled_state;
+	class state_pool;
+
 	struct lua_traits {
 		static const std::string user_data_tag;
 
 		struct user_data_type {
 			std::string base_path_;
 			Lua_State L;
+			// All states for this script (including L), created when the script is loaded
+			boost::shared_ptr<state_pool> pool;
 		};
 
 		struct function {
@@ -89,6 +95,7 @@ namespace lua {
 	struct registry_wrapper {
 	private:
 		script_information *info;
+		pooled_state *state;
 	public:
 		registry_wrapper(lua_State *L, bool fromLua);
 
@@ -104,6 +111,8 @@ namespace lua {
 		int register_simple_cmdline(lua_State *L);
 		int subscription(lua_State *L);
 		int simple_subscription(lua_State *L);
+	private:
+		void register_command(const std::string type, const std::string &command, const std::string &description, const lua_traits::function &function);
 		//	private:
 		//		boost::shared_ptr<regitration_provider> get();
 	};
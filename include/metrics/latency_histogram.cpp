@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <metrics/latency_histogram.hpp>
+
+#include <nscapi/nscapi_protobuf_metrics.hpp>
+
+#include <boost/foreach.hpp>
+
+namespace {
+	// The buckets exported to the metrics consumers (in ms), the histogram itself is much finer
+	const boost::uint64_t export_buckets_ms[] = { 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000 };
+
+	double to_ms(boost::uint64_t us) {
+		return static_cast<double>(us) / 1000.0;
+	}
+}
+
+void metrics::add_gauge(PB::Metrics::MetricsBundle *bundle, const std::string &key, double value) {
+	PB::Metrics::Metric *m = bundle->add_value();
+	m->set_key(key);
+	m->mutable_gauge_value()->set_value(value);
+}
+
+void metrics::add_counter(PB::Metrics::MetricsBundle *bundle, const std::string &key, double value) {
+	PB::Metrics::Metric *m = bundle->add_value();
+	m->set_key(key);
+	m->mutable_counter_value()->set_value(value);
+}
+
+void metrics::add_latency(PB::Metrics::MetricsBundle *bundle, const std::string &key, const latency_histogram &histogram) {
+	latency_histogram::snapshot s = histogram.get_snapshot();
+	PB::Metrics::MetricsBundle *b = bundle->add_children();
+	b->set_key(key);
+
+	PB::Metrics::Metric *m = b->add_value();
+	m->set_key("time");
+	PB::Metrics::Histogram *h = m->mutable_histogram_value();
+	h->set_sample_count(s.count);
+	h->set_sample_sum(to_ms(s.sum));
+	BOOST_FOREACH(boost::uint64_t limit, export_buckets_ms) {
+		PB::Metrics::Bucket *bucket = h->add_bucket();
+		bucket->set_upper_bound(static_cast<double>(limit));
+		bucket->set_cumulative_count(s.count_below(limit * 1000));
+	}
+
+	add_gauge(b, "count", static_cast<double>(s.count));
+	add_gauge(b, "avg", to_ms(s.average()));
+	add_gauge(b, "p50", to_ms(s.percentile(0.50)));
+	add_gauge(b, "p90", to_ms(s.percentile(0.90)));
+	add_gauge(b, "p99", to_ms(s.percentile(0.99)));
+	add_gauge(b, "max", to_ms(s.max));
+}
+
+void metrics::add_latency(PB::Metrics::MetricsBundle *bundle, const std::string &key, const latency_registry &registry) {
+	PB::Metrics::MetricsBundle *b = bundle->add_children();
+	b->set_key(key);
+	latency_registry::map_instance all = registry.get_all();
+	BOOST_FOREACH(const latency_registry::map_type::value_type &e, *all) {
+		add_latency(b, e.first, *e.second);
+	}
+}
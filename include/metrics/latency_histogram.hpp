@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace PB {
+	namespace Metrics {
+		class MetricsBundle;
+	}
+}
+
+namespace metrics {
+
+	/**
+	 * A fixed size log-linear (HDR style) histogram of latencies in microseconds.
+	 *
+	 * Every power of two is split in sub_buckets linear buckets so the relative error is bounded (12.5%)
+	 * regardless of the magnitude. Recording is a handful of relaxed atomic increments so it can be used
+	 * on the hot path from any number of threads; readers take an (approximately consistent) snapshot.
+	 */
+	class latency_histogram : boost::noncopyable {
+	public:
+		static const unsigned int sub_bucket_bits = 3;
+		static const unsigned int sub_buckets = 1 << sub_bucket_bits;
+		// 2^40us is ~12 days, anything above that ends up in the last bucket
+		static const unsigned int max_magnitude = 40;
+		static const unsigned int bucket_count = (max_magnitude - sub_bucket_bits + 1) * sub_buckets;
+
+		struct snapshot {
+			std::vector<boost::uint64_t> buckets;
+			boost::uint64_t count;
+			boost::uint64_t sum;
+			boost::uint64_t max;
+			snapshot() : buckets(bucket_count, 0), count(0), sum(0), max(0) {}
+
+			// The value (in us) below which the fraction q (0.0-1.0) of the samples fall
+			boost::uint64_t percentile(double q) const {
+				if (count == 0)
+					return 0;
+				boost::uint64_t rank = static_cast<boost::uint64_t>(q * static_cast<double>(count) + 0.5);
+				if (rank < 1)
+					rank = 1;
+				boost::uint64_t seen = 0;
+				for (unsigned int i = 0; i < bucket_count; i++) {
+					seen += buckets[i];
+					if (seen >= rank)
+						return std::min(upper_bound(i) - 1, max);
+				}
+				return max;
+			}
+			// Number of samples which took less than limit us
+			boost::uint64_t count_below(boost::uint64_t limit) const {
+				boost::uint64_t ret = 0;
+				for (unsigned int i = 0; i < bucket_count && upper_bound(i) <= limit; i++)
+					ret += buckets[i];
+				return ret;
+			}
+			boost::uint64_t average() const {
+				return count == 0 ? 0 : sum / count;
+			}
+		};
+
+	private:
+		boost::atomic<boost::uint64_t> buckets_[bucket_count];
+		boost::atomic<boost::uint64_t> count_;
+		boost::atomic<boost::uint64_t> sum_;
+		boost::atomic<boost::uint64_t> max_;
+
+	public:
+		latency_histogram() : count_(0), sum_(0), max_(0) {
+			for (unsigned int i = 0; i < bucket_count; i++)
+				buckets_[i].store(0, boost::memory_order_relaxed);
+		}
+
+		void record(boost::uint64_t us) {
+			buckets_[index_of(us)].fetch_add(1, boost::memory_order_relaxed);
+			sum_.fetch_add(us, boost::memory_order_relaxed);
+			boost::uint64_t current = max_.load(boost::memory_order_relaxed);
+			while (us > current && !max_.compare_exchange_weak(current, us, boost::memory_order_relaxed)) {}
+			count_.fetch_add(1, boost::memory_order_relaxed);
+		}
+		void record(const boost::posix_time::time_duration &duration) {
+			record(duration.is_negative() ? 0 : static_cast<boost::uint64_t>(duration.total_microseconds()));
+		}
+
+		snapshot get_snapshot() const {
+			snapshot ret;
+			for (unsigned int i = 0; i < bucket_count; i++) {
+				ret.buckets[i] = buckets_[i].load(boost::memory_order_relaxed);
+				ret.count += ret.buckets[i];
+			}
+			ret.sum = sum_.load(boost::memory_order_relaxed);
+			ret.max = max_.load(boost::memory_order_relaxed);
+			return ret;
+		}
+		boost::uint64_t get_count() const {
+			return count_.load(boost::memory_order_relaxed);
+		}
+
+		static unsigned int index_of(boost::uint64_t us) {
+			if (us < sub_buckets)
+				return static_cast<unsigned int>(us);
+			unsigned int magnitude = sub_bucket_bits;
+			while (magnitude < max_magnitude - 1 && (us >> (magnitude + 1)) != 0)
+				magnitude++;
+			if ((us >> (magnitude + 1)) != 0)
+				return bucket_count - 1;
+			unsigned int sub = static_cast<unsigned int>(us >> (magnitude - sub_bucket_bits)) & (sub_buckets - 1);
+			return (magnitude - sub_bucket_bits + 1) * sub_buckets + sub;
+		}
+		// The (exclusive) upper limit of a bucket in us
+		static boost::uint64_t upper_bound(unsigned int index) {
+			if (index < sub_buckets)
+				return index + 1;
+			unsigned int magnitude = index / sub_buckets + sub_bucket_bits - 1;
+			boost::uint64_t sub = index % sub_buckets;
+			return (sub_buckets + sub + 1) << (magnitude - sub_bucket_bits);
+		}
+	};
+
+	/**
+	 * Named latency histograms (one per command, plugin, channel, ...).
+	 *
+	 * The name to histogram map is copy-on-write: looking up an existing histogram never takes the lock,
+	 * only the first sample for a new name does. To protect against unbounded names the number of
+	 * histograms is capped and anything beyond that is recorded as "other".
+	 */
+	class latency_registry : boost::noncopyable {
+	public:
+		typedef boost::shared_ptr<latency_histogram> histogram_type;
+		typedef std::map<std::string, histogram_type> map_type;
+		typedef boost::shared_ptr<const map_type> map_instance;
+
+	private:
+		map_instance histograms_;
+		boost::mutex mutex_;
+		std::size_t max_size_;
+
+	public:
+		latency_registry(std::size_t max_size = 500) : histograms_(boost::make_shared<map_type>()), max_size_(max_size) {}
+
+		void record(const std::string &name, boost::uint64_t us) {
+			get(name).record(us);
+		}
+		void record(const std::string &name, const boost::posix_time::time_duration &duration) {
+			get(name).record(duration);
+		}
+		latency_histogram& get(const std::string &name) {
+			map_instance current = boost::atomic_load(&histograms_);
+			map_type::const_iterator cit = current->find(name);
+			if (cit != current->end())
+				return *cit->second;
+			return create(name);
+		}
+		map_instance get_all() const {
+			return boost::atomic_load(&histograms_);
+		}
+
+	private:
+		latency_histogram& create(const std::string &name) {
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			map_instance current = boost::atomic_load(&histograms_);
+			std::string key = current->size() < max_size_ ? name : "other";
+			map_type::const_iterator cit = current->find(key);
+			if (cit != current->end())
+				return *cit->second;
+			boost::shared_ptr<map_type> copy = boost::make_shared<map_type>(*current);
+			histogram_type h = boost::make_shared<latency_histogram>();
+			(*copy)[key] = h;
+			boost::atomic_store(&histograms_, map_instance(copy));
+			return *h;
+		}
+	};
+
+	// Measures the time since construction
+	struct stopwatch {
+		boost::posix_time::ptime start;
+		stopwatch() : start(boost::posix_time::microsec_clock::universal_time()) {}
+		boost::posix_time::time_duration elapsed() const {
+			return boost::posix_time::microsec_clock::universal_time() - start;
+		}
+	};
+
+	// Adds a gauge (a value which goes up and down such as a queue length)
+	void add_gauge(PB::Metrics::MetricsBundle *bundle, const std::string &key, double value);
+	// Adds a counter (a total which only ever increases such as the number of requests)
+	void add_counter(PB::Metrics::MetricsBundle *bundle, const std::string &key, double value);
+
+	// Adds a histogram (as a child bundle called key) with count, avg, p50, p90, p99 and max gauges (in ms)
+	void add_latency(PB::Metrics::MetricsBundle *bundle, const std::string &key, const latency_histogram &histogram);
+	// Adds all histograms from the registry as children of a bundle called key
+	void add_latency(PB::Metrics::MetricsBundle *bundle, const std::string &key, const latency_registry &registry);
+}
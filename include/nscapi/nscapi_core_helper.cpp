@@ -88,6 +88,28 @@ bool nscapi::core_helper::put_storage(std::string context, std::string key, std:
 	return ret;
 }
 
+bool nscapi::core_helper::remove_storage(std::string context, std::string key) {
+	PB::Storage::StorageRequestMessage rrm;
+	PB::Storage::StorageRequestMessage::Request *payload = rrm.add_payload();
+
+	payload->set_plugin_id(plugin_id_);
+	payload->mutable_remove()->set_context(context);
+	payload->mutable_remove()->set_key(key);
+	std::string buffer;
+	get_core()->storage_query(rrm.SerializeAsString(), buffer);
+
+	PB::Storage::StorageResponseMessage resp_msg;
+	resp_msg.ParseFromString(buffer);
+	bool ret = true;
+	BOOST_FOREACH(const ::PB::Storage::StorageResponseMessage::Response &response_payload, resp_msg.payload()) {
+		if (response_payload.result().code() != PB::Common::Result_StatusCodeType_STATUS_OK) {
+			CORE_LOG_ERROR("Failed to remove data " + context + ": " + response_payload.result().message());
+			ret = false;
+		}
+	}
+	return ret;
+}
+
 bool nscapi::core_helper::load_module(std::string name, std::string alias) {
 	PB::Registry::RegistryRequestMessage rrm;
 	PB::Registry::RegistryRequestMessage::Request *payload = rrm.add_payload();
@@ -51,6 +51,7 @@ namespace nscapi {
 
 		typedef std::map<std::string, std::string> storage_map;
 		bool put_storage(std::string context, std::string key, std::string value, bool private_data, bool binary_data);
+		bool remove_storage(std::string context, std::string key);
 		storage_map get_storage_strings(std::string context);
 
 		bool load_module(std::string name, std::string alias = "");
@@ -117,6 +117,14 @@ namespace nscapi {
 			} 
 			return NSCAPI::api_return_codes::hasFailed; 
 		} 
+		static int NSGetModuleDependencies(char* buf, int buflen) {
+			try {
+				return helpers::wrap_string(buf, buflen, impl_class::getModuleDependencies(), NSCAPI::api_return_codes::isSuccess);
+			} catch (...) {
+				NSC_LOG_CRITICAL("Unknown exception in: NSGetModuleDependencies");
+			}
+			return NSCAPI::api_return_codes::hasFailed;
+		}
 		static int NSGetModuleVersion(int *major, int *minor, int *revision) { 
 			try { 
 				nscapi::module_version version = impl_class::getModuleVersion();
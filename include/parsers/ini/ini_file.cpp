@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <parsers/ini/ini_file.hpp>
+
+#include <boost/functional/hash.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <fstream>
+
+#ifdef WIN32
+#define INI_NEWLINE "\r\n"
+#else
+#define INI_NEWLINE "\n"
+#endif
+#define INI_UTF8_SIGNATURE "\xEF\xBB\xBF"
+
+namespace {
+	inline bool is_blank(char c) {
+		return c == ' ' || c == '\t';
+	}
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+	inline bool is_comment(char c) {
+		return c == ';' || c == '#';
+	}
+	inline char to_lower(char c) {
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	// Splits a part of a buffer into lines (without the line endings)
+	struct line_reader {
+		const char *data;
+		std::size_t pos;
+		std::size_t end;
+
+		line_reader(const std::string &data, std::size_t begin, std::size_t end) : data(data.c_str()), pos(begin), end(end) {}
+
+		bool next(std::size_t &line_begin, std::size_t &line_end) {
+			if (pos >= end)
+				return false;
+			line_begin = pos;
+			const char *nl = static_cast<const char*>(std::memchr(data + pos, '\n', end - pos));
+			line_end = nl ? static_cast<std::size_t>(nl - data) : end;
+			pos = nl ? line_end + 1 : end;
+			if (line_end > line_begin && data[line_end - 1] == '\r')
+				line_end--;
+			return true;
+		}
+		// Position of the first non blank character on the line (line_end if the line is blank)
+		std::size_t skip_blank(std::size_t p, std::size_t line_end) const {
+			while (p < line_end && is_blank(data[p]))
+				p++;
+			return p;
+		}
+		std::size_t trim_right(std::size_t begin, std::size_t p) const {
+			while (p > begin && is_space(data[p - 1]))
+				p--;
+			return p;
+		}
+	};
+
+	// Tracks the comment lines preceding an entry.
+	// Blank lines are part of the comment if another comment line follows, any other line ends the comment.
+	struct comment_tracker {
+		std::size_t begin;
+		std::size_t end;
+		bool found;
+		bool open;
+		comment_tracker() : begin(0), end(0), found(false), open(false) {}
+
+		void add_line(std::size_t line_begin, std::size_t line_end) {
+			if (!found || !open)
+				begin = line_begin;
+			end = line_end;
+			found = true;
+			open = true;
+		}
+		void close() {
+			open = false;
+		}
+		std::string take(const line_reader &reader) {
+			if (!found)
+				return "";
+			found = false;
+			open = false;
+			std::string ret;
+			line_reader lines(reader);
+			lines.pos = begin;
+			lines.end = end;
+			std::size_t b, e;
+			bool first = true;
+			while (lines.next(b, e)) {
+				if (!first)
+					ret += '\n';
+				first = false;
+				b = lines.skip_blank(b, e);
+				ret.append(reader.data + b, e - b);
+			}
+			return ret;
+		}
+	};
+
+	void append_lines(std::string &out, const std::string &text) {
+		std::string::size_type pos = 0;
+		while (pos <= text.size()) {
+			std::string::size_type nl = text.find('\n', pos);
+			if (nl == std::string::npos)
+				nl = text.size();
+			out.append(text, pos, nl - pos);
+			out += INI_NEWLINE;
+			pos = nl + 1;
+		}
+	}
+}
+
+std::size_t parsers::ini::nocase_hash::operator()(const std::string &s) const {
+	std::size_t seed = 0;
+	for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+		boost::hash_combine(seed, to_lower(*it));
+	return seed;
+}
+
+bool parsers::ini::nocase_equal::operator()(const std::string &a, const std::string &b) const {
+	if (a.size() != b.size())
+		return false;
+	for (std::string::size_type i = 0; i < a.size(); i++) {
+		if (to_lower(a[i]) != to_lower(b[i]))
+			return false;
+	}
+	return true;
+}
+
+void parsers::ini::ini_file::clear() {
+	data_.clear();
+	file_comment_.clear();
+	index_.clear();
+	sections_.clear();
+}
+
+void parsers::ini::ini_file::load_file(const std::string &file) {
+	clear();
+	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!in.good())
+		throw ini_exception("Failed to open: " + file);
+	std::streamoff size = in.tellg();
+	in.close();
+	if (size > 0) {
+		try {
+			// The data is copied out of the mapping so a file which is truncated while we use it can not hurt us
+			boost::interprocess::file_mapping mapping(file.c_str(), boost::interprocess::read_only);
+			boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+			data_.assign(static_cast<const char*>(region.get_address()), region.get_size());
+		} catch (const boost::interprocess::interprocess_exception &e) {
+			throw ini_exception("Failed to read " + file + ": " + e.what());
+		}
+	}
+	index();
+}
+
+void parsers::ini::ini_file::load_data(const std::string &data) {
+	clear();
+	data_ = data;
+	index();
+}
+
+void parsers::ini::ini_file::index() {
+	line_reader reader(data_, 0, data_.size());
+	if (data_.size() >= 3 && data_.compare(0, 3, INI_UTF8_SIGNATURE) == 0)
+		reader.pos = 3;
+
+	// The file comment is the block of comment lines at the very beginning of the file
+	comment_tracker comment;
+	std::size_t b, e;
+	while (reader.pos < reader.end && is_comment(data_[reader.pos]) && reader.next(b, e))
+		comment.add_line(b, e);
+	file_comment_ = comment.take(reader);
+
+	section *current = NULL;
+	while (reader.next(b, e)) {
+		std::size_t p = reader.skip_blank(b, e);
+		if (p == e)
+			continue;
+		if (is_comment(data_[p])) {
+			comment.add_line(p, e);
+			continue;
+		}
+		if (data_[p] == '[') {
+			std::size_t name_begin = reader.skip_blank(p + 1, e);
+			const char *close = static_cast<const char*>(std::memchr(data_.c_str() + name_begin, ']', e - name_begin));
+			if (close == NULL) {
+				comment.close();
+				continue;
+			}
+			std::size_t name_end = reader.trim_right(name_begin, static_cast<std::size_t>(close - data_.c_str()));
+			if (current)
+				current->ranges.back().end = b;
+			current = &get_or_create(data_.substr(name_begin, name_end - name_begin), comment.take(reader));
+			current->ranges.push_back(range(reader.pos, reader.pos));
+			current->parsed = false;
+			continue;
+		}
+		const char *eq = static_cast<const char*>(std::memchr(data_.c_str() + p, '=', e - p));
+		if (eq == NULL || eq == data_.c_str() + p) {
+			comment.close();
+			continue;
+		}
+		// Keys are parsed when the section is used, keys before the first section belong to the unnamed section
+		comment.found = false;
+		if (!current) {
+			current = &get_or_create("", "");
+			current->ranges.push_back(range(b, b));
+			current->parsed = false;
+		}
+	}
+	if (current)
+		current->ranges.back().end = data_.size();
+}
+
+void parsers::ini::ini_file::parse(section &s) {
+	s.parsed = true;
+	for (std::vector<range>::const_iterator it = s.ranges.begin(); it != s.ranges.end(); ++it) {
+		line_reader reader(data_, it->begin, it->end);
+		comment_tracker comment;
+		std::size_t b, e;
+		while (reader.next(b, e)) {
+			std::size_t p = reader.skip_blank(b, e);
+			if (p == e)
+				continue;
+			if (is_comment(data_[p])) {
+				comment.add_line(p, e);
+				continue;
+			}
+			const char *eq = static_cast<const char*>(std::memchr(data_.c_str() + p, '=', e - p));
+			if (eq == NULL || eq == data_.c_str() + p) {
+				comment.close();
+				continue;
+			}
+			std::size_t eq_pos = static_cast<std::size_t>(eq - data_.c_str());
+			std::size_t key_end = reader.trim_right(p, eq_pos);
+			std::size_t value_begin = reader.skip_blank(eq_pos + 1, e);
+			std::size_t value_end = reader.trim_right(value_begin, e);
+			add_entry(s, data_.substr(p, key_end - p), data_.substr(value_begin, value_end - value_begin), comment.take(reader));
+		}
+	}
+	s.ranges.clear();
+}
+
+void parsers::ini::ini_file::add_entry(section &s, const std::string &key, const std::string &value, const std::string &comment) {
+	entry_index::iterator it = s.index.find(key);
+	if (it != s.index.end()) {
+		it->second->value = value;
+		return;
+	}
+	s.entries.push_back(entry());
+	entry &e = s.entries.back();
+	e.key = key;
+	e.value = value;
+	e.comment = comment;
+	s.index.insert(entry_index::value_type(key, --s.entries.end()));
+}
+
+parsers::ini::ini_file::section& parsers::ini::ini_file::get_or_create(const std::string &name, const std::string &comment) {
+	section_index::iterator it = index_.find(name);
+	if (it != index_.end())
+		return *it->second;
+	sections_.push_back(section());
+	section &s = sections_.back();
+	s.name = name;
+	s.comment = comment;
+	s.parsed = true;
+	index_.insert(section_index::value_type(name, --sections_.end()));
+	return s;
+}
+
+parsers::ini::ini_file::section* parsers::ini::ini_file::find(const std::string &name) {
+	section_index::iterator it = index_.find(name);
+	if (it == index_.end())
+		return NULL;
+	return &*it->second;
+}
+
+parsers::ini::ini_file::section* parsers::ini::ini_file::find_parsed(const std::string &name) {
+	section *s = find(name);
+	if (s && !s->parsed)
+		parse(*s);
+	return s;
+}
+
+const std::string* parsers::ini::ini_file::get_value(const std::string &section, const std::string &key) {
+	ini_file::section *s = find_parsed(section);
+	if (s == NULL)
+		return NULL;
+	entry_index::const_iterator it = s->index.find(key);
+	if (it == s->index.end())
+		return NULL;
+	return &it->second->value;
+}
+
+bool parsers::ini::ini_file::has_key(const std::string &section, const std::string &key) {
+	return get_value(section, key) != NULL;
+}
+
+bool parsers::ini::ini_file::has_section(const std::string &section) const {
+	return index_.find(section) != index_.end();
+}
+
+std::size_t parsers::ini::ini_file::get_section_size(const std::string &section) {
+	ini_file::section *s = find_parsed(section);
+	return s == NULL ? 0 : s->entries.size();
+}
+
+void parsers::ini::ini_file::get_sections(string_list &list) const {
+	for (section_list::const_iterator it = sections_.begin(); it != sections_.end(); ++it)
+		list.push_back(it->name);
+}
+
+void parsers::ini::ini_file::get_keys(const std::string &section, string_list &list) {
+	ini_file::section *s = find_parsed(section);
+	if (s == NULL)
+		return;
+	for (entry_list::const_iterator it = s->entries.begin(); it != s->entries.end(); ++it)
+		list.push_back(it->key);
+}
+
+void parsers::ini::ini_file::set_value(const std::string &section, const std::string &key, const std::string &value, const std::string &comment) {
+	ini_file::section &s = get_or_create(section, "");
+	if (!s.parsed)
+		parse(s);
+	add_entry(s, key, value, comment);
+}
+
+void parsers::ini::ini_file::add_section(const std::string &section, const std::string &comment) {
+	get_or_create(section, comment);
+}
+
+bool parsers::ini::ini_file::remove_key(const std::string &section, const std::string &key, bool remove_empty) {
+	ini_file::section *s = find_parsed(section);
+	if (s == NULL)
+		return false;
+	entry_index::iterator it = s->index.find(key);
+	if (it == s->index.end())
+		return false;
+	s->entries.erase(it->second);
+	s->index.erase(it);
+	if (remove_empty && s->entries.empty())
+		remove_section(section);
+	return true;
+}
+
+bool parsers::ini::ini_file::remove_section(const std::string &section) {
+	section_index::iterator it = index_.find(section);
+	if (it == index_.end())
+		return false;
+	sections_.erase(it->second);
+	index_.erase(it);
+	return true;
+}
+
+std::string parsers::ini::ini_file::render() {
+	std::string out;
+	out.reserve(data_.size() + 4096);
+	out += INI_UTF8_SIGNATURE;
+	bool need_newline = false;
+	if (!file_comment_.empty()) {
+		append_lines(out, file_comment_);
+		need_newline = true;
+	}
+	for (section_list::iterator it = sections_.begin(); it != sections_.end(); ++it) {
+		if (!it->parsed)
+			parse(*it);
+		if (!it->comment.empty()) {
+			if (need_newline)
+				out += INI_NEWLINE INI_NEWLINE;
+			append_lines(out, it->comment);
+			need_newline = false;
+		}
+		if (need_newline)
+			out += INI_NEWLINE INI_NEWLINE;
+		if (!it->name.empty()) {
+			out += "[";
+			out += it->name;
+			out += "]" INI_NEWLINE;
+		}
+		for (entry_list::const_iterator eit = it->entries.begin(); eit != it->entries.end(); ++eit) {
+			if (!eit->comment.empty()) {
+				out += INI_NEWLINE;
+				append_lines(out, eit->comment);
+			}
+			out += eit->key;
+			out += " = ";
+			out += eit->value;
+			out += INI_NEWLINE;
+		}
+		need_newline = true;
+	}
+	return out;
+}
+
+void parsers::ini::ini_file::save_file(const std::string &file) {
+	std::string data = render();
+	std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.good())
+		throw ini_exception("Failed to open: " + file);
+	out.write(data.c_str(), data.size());
+	out.close();
+	if (out.fail())
+		throw ini_exception("Failed to write: " + file);
+}
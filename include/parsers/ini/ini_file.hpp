@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace parsers {
+	namespace ini {
+
+		class ini_exception : public std::exception {
+			std::string error_;
+		public:
+			ini_exception(std::string error) : error_(error) {}
+			~ini_exception() throw() {}
+			const char* what() const throw() {
+				return error_.c_str();
+			}
+		};
+
+		// Case insensitive (ASCII) hashing and comparison, section and key names are not case sensitive
+		struct nocase_hash {
+			std::size_t operator()(const std::string &s) const;
+		};
+		struct nocase_equal {
+			bool operator()(const std::string &a, const std::string &b) const;
+		};
+
+		/**
+		 * An INI file (UTF-8) which is read in a single pass.
+		 *
+		 * Loading only indexes where each section starts and ends, the keys of a section are parsed the first
+		 * time the section is accessed so large files where only a few sections are used load quickly.
+		 * Comments preceding a section or key are kept and sections and keys are written back in the order
+		 * they were read (new ones are appended) so a file survives a load/save round trip.
+		 * The format (comments, file comment, case insensitive names, last duplicate key wins) is the same as
+		 * the one used by simpleini.
+		 */
+		class ini_file : boost::noncopyable {
+		public:
+			typedef std::list<std::string> string_list;
+
+		private:
+			struct range {
+				std::size_t begin;
+				std::size_t end;
+				range(std::size_t begin, std::size_t end) : begin(begin), end(end) {}
+			};
+			struct entry {
+				std::string key;
+				std::string value;
+				std::string comment;
+			};
+			typedef std::list<entry> entry_list;
+			typedef boost::unordered_map<std::string, entry_list::iterator, nocase_hash, nocase_equal> entry_index;
+			struct section {
+				std::string name;
+				std::string comment;
+				// Unparsed parts of the file belonging to this section (a section can be repeated)
+				std::vector<range> ranges;
+				bool parsed;
+				entry_list entries;
+				entry_index index;
+				section() : parsed(false) {}
+			};
+			typedef std::list<section> section_list;
+			typedef boost::unordered_map<std::string, section_list::iterator, nocase_hash, nocase_equal> section_index;
+
+			std::string data_;
+			std::string file_comment_;
+			section_list sections_;
+			section_index index_;
+
+		public:
+			ini_file() {}
+
+			// Replaces the current content with the content of the file (throws ini_exception)
+			void load_file(const std::string &file);
+			// Replaces the current content with the given text
+			void load_data(const std::string &data);
+			void save_file(const std::string &file);
+			std::string render();
+			void clear();
+
+			// Returns NULL if the key does not exist, the pointer is valid until the key is changed
+			const std::string* get_value(const std::string &section, const std::string &key);
+			bool has_key(const std::string &section, const std::string &key);
+			bool has_section(const std::string &section) const;
+			std::size_t get_section_size(const std::string &section);
+			// Sections and keys are returned in file order
+			void get_sections(string_list &list) const;
+			void get_keys(const std::string &section, string_list &list);
+
+			// The comment is only used when a new key is created, existing keys keep their comment and position
+			void set_value(const std::string &section, const std::string &key, const std::string &value, const std::string &comment = "");
+			// The comment is only used when a new section is created
+			void add_section(const std::string &section, const std::string &comment = "");
+			bool remove_key(const std::string &section, const std::string &key, bool remove_empty);
+			bool remove_section(const std::string &section);
+
+		private:
+			void index();
+			section& get_or_create(const std::string &name, const std::string &comment);
+			section* find(const std::string &name);
+			section* find_parsed(const std::string &name);
+			void parse(section &s);
+			void add_entry(section &s, const std::string &key, const std::string &value, const std::string &comment);
+		};
+	}
+}
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 namespace process {
 	class process_exception : public std::exception {
 		std::string error;
@@ -64,6 +67,9 @@ namespace process {
 		bool display;
 		bool ignore_perf;
 		bool fork;
+		// When not empty the command is executed directly (argv[0] is the program) instead of via the shell.
+		// Only used on platforms where commands are normally run through a shell.
+		std::vector<std::string> argv;
 	};
 	void kill_all();
 	int execute_process(process::exec_arguments args, std::string &output);
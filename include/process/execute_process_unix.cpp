@@ -18,79 +18,190 @@
  */
 
 #include <string>
+#include <set>
+#include <vector>
 #include <NSCAPI.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h> 
+#include <string.h>
 #include <errno.h>
 
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #include <process/execute_process.hpp>
+#include <str/xtos.hpp>
 #include <buffer.hpp>
 
 #define BUFFER_SIZE 4096
 
-bool early_timeout = false;
+extern char **environ;
+
 typedef hlp::buffer<char> buffer_type;
 
-//extern int errno;
+namespace {
+	boost::timed_mutex mutex_;
+	std::set<pid_t> pids_;
+
+	void register_proc(pid_t pid) {
+		boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(1));
+		if (!lock.owns_lock())
+			return;
+		pids_.insert(pid);
+	}
+	void remove_proc(pid_t pid) {
+		boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(1));
+		if (!lock.owns_lock())
+			return;
+		pids_.erase(pid);
+	}
+
+	long long remaining_ms(const boost::posix_time::ptime &deadline) {
+		long long ms = (deadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+		return ms < 0 ? 0 : ms;
+	}
 
-/* handle timeouts when executing commands via my_system() */
-void my_system_sighandler(int sig) {
-	//exit(NSCAPI::returnUNKNOWN);
-	printf("\n\n\nTIMEOUT TIMEOUT TIMEOUT\n\n\n");
+	void reap_detached(pid_t pid) {
+		int status;
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+	}
 }
 
 void process::kill_all() {
-	// TODO: Fixme
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock())
+		return;
+	BOOST_FOREACH(const pid_t &pid, pids_) {
+		kill(-pid, SIGKILL);
+	}
 }
 
-
 int process::execute_process(process::exec_arguments args, std::string &output) {
-	NSCAPI::nagiosReturn result;
-	int fd[2];
-	std::size_t bytes_read=0;
-	early_timeout=false;
-
-	if (pipe(fd) == -1) {
-    output = "Failed to create pipe";
-		result = NSCAPI::query_return_codes::returnUNKNOWN;
-  }
-	//fcntl(fd[0],F_SETFL,O_NONBLOCK);
-	//fcntl(fd[1],F_SETFL,O_NONBLOCK);
-
-
-	//time(&start_time);
-
-	//signal(SIGALRM, my_system_sighandler);
-	//alarm(args.timeout);
+	// Commands without shell features are spawned directly, everything else goes through /bin/sh like popen would.
+	bool use_shell = args.argv.empty();
+	std::vector<std::string> argv_data;
+	if (use_shell) {
+		argv_data.push_back("sh");
+		argv_data.push_back("-c");
+		argv_data.push_back(args.command);
+	} else {
+		argv_data = args.argv;
+	}
+	std::vector<char*> argv;
+	BOOST_FOREACH(std::string &a, argv_data) {
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(NULL);
 
-	FILE *fp = popen(args.command.c_str(), "r");
-	close(fd[1]);
-	if (fp == NULL) {
-		close(fd[0]);
-		output = "NRPE: Call to popen() failed";
-		return NSCAPI::query_return_codes::returnUNKNOWN;
+	int fd[2] = { -1, -1 };
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (args.fork) {
+		posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
 	} else {
-		buffer_type buffer(BUFFER_SIZE);
-		while ( (bytes_read=fread(buffer.get(),1,buffer.size()-1,fp)) >0 ) {
-			if (bytes_read > 0 && bytes_read < BUFFER_SIZE) {
-				buffer[bytes_read] = 0;
-				output += std::string(buffer.get());
-			}
+		if (pipe2(fd, O_CLOEXEC) == -1) {
+			posix_spawn_file_actions_destroy(&actions);
+			output = "Failed to create pipe: " + std::string(strerror(errno));
+			return NSCAPI::query_return_codes::returnUNKNOWN;
 		}
-
-		int status = pclose(fp);
-		if (status == -1 || !WIFEXITED(status))
-			result = NSCAPI::query_return_codes::returnUNKNOWN;
-		else
-			result=WEXITSTATUS(status);
+		posix_spawn_file_actions_adddup2(&actions, fd[1], 1);
+	}
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	// Own process group so a timeout can kill the entire pipeline
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attr, 0);
+
+	pid_t pid = 0;
+	int err;
+	if (use_shell)
+		err = posix_spawn(&pid, "/bin/sh", &actions, &attr, &argv[0], environ);
+	else
+		err = posix_spawnp(&pid, argv[0], &actions, &attr, &argv[0], environ);
+	if (err == ENOEXEC && !use_shell) {
+		// Scripts without a #! line: run them with /bin/sh like execvp does
+		std::string shell = "sh";
+		argv.insert(argv.begin(), &shell[0]);
+		err = posix_spawn(&pid, "/bin/sh", &actions, &attr, &argv[0], environ);
+	}
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	if (fd[1] != -1)
+		close(fd[1]);
+	if (err != 0) {
+		if (fd[0] != -1)
+			close(fd[0]);
+		output = "Failed to execute " + args.alias + ": " + std::string(strerror(err));
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	}
+	if (args.fork) {
+		boost::thread(boost::bind(&reap_detached, pid)).detach();
+		output = "Command started successfully";
+		return NSCAPI::query_return_codes::returnOK;
+	}
+	register_proc(pid);
+
+	boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(args.timeout);
+	bool timed_out = false;
+	buffer_type buffer(BUFFER_SIZE);
+	while (true) {
+		struct pollfd pfd;
+		pfd.fd = fd[0];
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, static_cast<int>(remaining_ms(deadline)));
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret == 0) {
+			timed_out = true;
+			break;
+		}
+		if (ret < 0)
+			break;
+		ssize_t bytes_read = read(fd[0], buffer.get(), buffer.size());
+		if (bytes_read < 0 && errno == EINTR)
+			continue;
+		if (bytes_read <= 0)
+			break;
+		output.append(buffer.get(), bytes_read);
 	}
 	close(fd[0]);
-	//alarm(0);
-	return result;
-}
 
+	int status = 0;
+	pid_t waited = 0;
+	unsigned int sleep_us = 100;
+	while (!timed_out) {
+		waited = waitpid(pid, &status, WNOHANG);
+		if (waited == -1 && errno == EINTR)
+			continue;
+		if (waited != 0)
+			break;
+		if (remaining_ms(deadline) == 0) {
+			timed_out = true;
+			break;
+		}
+		usleep(sleep_us);
+		if (sleep_us < 50000)
+			sleep_us *= 2;
+	}
+	if (timed_out) {
+		kill(-pid, SIGKILL);
+		reap_detached(pid);
+		remove_proc(pid);
+		output = "Command " + args.alias + " didn't terminate within the timeout period " + str::xtos(args.timeout) + "s";
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	}
+	remove_proc(pid);
+	if (waited == -1 || !WIFEXITED(status))
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	return WEXITSTATUS(status);
+}
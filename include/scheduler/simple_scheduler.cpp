@@ -251,6 +251,7 @@ namespace simple_scheduler {
 				}
 
 				boost::posix_time::ptime now_time = now();
+				queue_wait_.record(now_time - (*instance).time);
 				atomic_inc32(&metric_executed);
 				op_task_object item = get_task((*instance).schedule_id);
 				if (item) {
@@ -260,6 +261,7 @@ namespace simple_scheduler {
 							to_reschedule = handler_->handle_schedule(*item);
 						}
 						boost::posix_time::time_duration duration = now() - now_time;
+						run_time_.record(duration);
 
 						my_atomic_add(&metric_time, duration.total_milliseconds());
 						atomic_inc32(&metric_count);
@@ -33,6 +33,7 @@
 #include <boost/function.hpp>
 
 #include <has-threads.hpp>
+#include <metrics/latency_histogram.hpp>
 
 #include <parsers/cron/cron_parser.hpp>
 
@@ -168,6 +169,9 @@ namespace simple_scheduler {
 		schedule_queue_type queue_;
 		boost::mutex idle_thread_mutex_;
 		boost::condition_variable idle_thread_cond_;
+		// Time from when an item was due until a thread started running it
+		metrics::latency_histogram queue_wait_;
+		metrics::latency_histogram run_time_;
 	public:
 
 		scheduler() : schedule_id_(0), stop_requested_(false), running_(false), has_watchdog_(false), thread_count_(10), handler_(NULL), error_threshold_(5) {}
@@ -192,6 +196,8 @@ namespace simple_scheduler {
 		std::size_t get_metric_threads() const;
 		std::size_t get_metric_ql();
 		bool has_metrics() const;
+		const metrics::latency_histogram& get_queue_wait() const { return queue_wait_; }
+		const metrics::latency_histogram& get_run_time() const { return run_time_; }
 
 		int add_task(std::string tag, boost::posix_time::time_duration duration, double randomness);
 		int add_task(std::string tag, cron_parser::schedule schedule);
@@ -22,14 +22,12 @@
 #include <settings/settings_core.hpp>
 #include <settings/settings_interface_impl.hpp>
 
-#include <error/error.hpp>
-
 #include <str/xtos.hpp>
 #include <str/utils.hpp>
 
 #include <file_helpers.hpp>
 
-#include <simpleini/simpleini.h>
+#include <parsers/ini/ini_file.hpp>
 
 
 #include <boost/filesystem/path.hpp>
@@ -42,12 +40,12 @@
 namespace settings {
 	class INISettings : public settings::settings_interface_impl {
 	private:
-		CSimpleIni ini;
+		parsers::ini::ini_file ini;
 		bool is_loaded_;
 		std::string filename_;
 
 	public:
-		INISettings(settings::settings_core *core, std::string alias, std::string context) : settings::settings_interface_impl(core, alias, context), ini(false, false, false), is_loaded_(false) {
+		INISettings(settings::settings_core *core, std::string alias, std::string context) : settings::settings_interface_impl(core, alias, context), is_loaded_(false) {
 			load_data();
 		}
 		//////////////////////////////////////////////////////////////////////////
@@ -60,10 +58,10 @@ namespace settings {
 		/// @author mickem
 		virtual op_string get_real_string(settings_core::key_path_type key) {
 			load_data();
-			const wchar_t *val = ini.GetValue(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str(), NULL);
+			const std::string *val = ini.get_value(key.first, key.second);
 			if (val == NULL)
 				return op_string();
-			return op_string(utf8::cvt<std::string>(val));
+			return op_string(*val);
 		}
 		//////////////////////////////////////////////////////////////////////////
 		/// Check if a key exists
@@ -74,11 +72,11 @@ namespace settings {
 		///
 		/// @author mickem
 		virtual bool has_real_key(settings_core::key_path_type key) {
-			return ini.GetValue(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str()) != NULL;
+			return ini.has_key(key.first, key.second);
 		}
 
 		virtual bool has_real_path(std::string path) {
-			return ini.GetSectionSize(utf8::cvt<std::wstring>(path).c_str()) > 0;
+			return ini.get_section_size(path) > 0;
 		}
 
 		std::string render_comment(const settings_core::key_description &desc) {
@@ -103,6 +101,7 @@ namespace settings {
 
 		//////////////////////////////////////////////////////////////////////////
 		/// Write a value to the resulting context.
+		/// Existing keys are updated in place (keeping their comment), new keys are appended to the section.
 		///
 		/// @param key The key to write to
 		/// @param value The value to write
@@ -112,12 +111,14 @@ namespace settings {
 			if (!value.is_dirty())
 				return;
 			try {
+				if (ini.has_key(key.first, key.second)) {
+					ini.set_value(key.first, key.second, value.get_string());
+					return;
+				}
 				const settings_core::key_description desc = get_core()->get_registred_key(key.first, key.second);
-				std::string comment = render_comment(desc);
-				ini.Delete(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str());
-				ini.SetValue(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str(), utf8::cvt<std::wstring>(value.get_string()).c_str(), utf8::cvt<std::wstring>(comment).c_str());
+				ini.set_value(key.first, key.second, value.get_string(), render_comment(desc));
 			} catch (settings_exception e) {
-				ini.SetValue(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str(), utf8::cvt<std::wstring>(value.get_string()).c_str(), L"; Undocumented key");
+				ini.set_value(key.first, key.second, value.get_string(), "; Undocumented key");
 			} catch (...) {
 				get_logger()->error("settings", __FILE__, __LINE__, "Unknown failure when writing key: " + make_skey(key.first, key.second));
 			}
@@ -128,20 +129,20 @@ namespace settings {
 				const settings_core::path_description desc = get_core()->get_registred_path(path);
 				std::string comment = render_comment(desc);
 				if (!comment.empty()) {
-					ini.SetValue(utf8::cvt<std::wstring>(path).c_str(), NULL, NULL, utf8::cvt<std::wstring>(comment).c_str());
+					ini.add_section(path, comment);
 				}
 			} catch (settings_exception e) {
-				ini.SetValue(utf8::cvt<std::wstring>(path).c_str(), NULL, NULL, L"; Undocumented section");
+				ini.add_section(path, "; Undocumented section");
 			} catch (...) {
 				get_logger()->error("settings", __FILE__, __LINE__, "Unknown failure when writing section: " + path);
 			}
 		}
 
 		virtual void remove_real_value(settings_core::key_path_type key) {
-			ini.Delete(utf8::cvt<std::wstring>(key.first).c_str(), utf8::cvt<std::wstring>(key.second).c_str(), true);
+			ini.remove_key(key.first, key.second, true);
 		}
 		virtual void remove_real_path(std::string path) {
-			ini.Delete(utf8::cvt<std::wstring>(path).c_str(), NULL, true);
+			ini.remove_section(path);
 		}
 
 		//////////////////////////////////////////////////////////////////////////
@@ -154,12 +155,11 @@ namespace settings {
 		///
 		/// @author mickem
 		virtual void get_real_sections(std::string path, string_list &list) {
-			CSimpleIni::TNamesDepend lst;
+			string_list lst;
 			std::string::size_type path_len = path.length();
-			ini.GetAllSections(lst);
+			ini.get_sections(lst);
 			if (path.empty()) {
-				BOOST_FOREACH(const CSimpleIni::Entry &e, lst) {
-					std::string key = utf8::cvt<std::string>(e.pItem);
+				BOOST_FOREACH(std::string key, lst) {
 					if (key.length() > 1) {
 						std::string::size_type pos = key.find('/', 1);
 						if (pos != std::string::npos)
@@ -168,8 +168,7 @@ namespace settings {
 					list.push_back(key);
 				}
 			} else {
-				BOOST_FOREACH(const CSimpleIni::Entry &e, lst) {
-					std::string key = utf8::cvt<std::string>(e.pItem);
+				BOOST_FOREACH(std::string key, lst) {
 					if (key.length() > path_len + 1 && key.substr(0, path_len) == path) {
 						std::string::size_type pos = key.find('/', path_len + 1);
 						if (pos == std::string::npos && path_len > 1) {
@@ -204,11 +203,7 @@ namespace settings {
 		/// @author mickem
 		virtual void get_real_keys(std::string path, string_list &list) {
 			load_data();
-			CSimpleIni::TNamesDepend lst;
-			ini.GetAllKeys(utf8::cvt<std::wstring>(path).c_str(), lst);
-			BOOST_FOREACH(const CSimpleIni::Entry &e, lst) {
-				list.push_back(utf8::cvt<std::string>(e.pItem));
-			}
+			ini.get_keys(path, list);
 		}
 		//////////////////////////////////////////////////////////////////////////
 		/// Save the settings store
@@ -218,26 +213,26 @@ namespace settings {
 			settings_interface_impl::save();
 
 
-			SI_Error rc = ini.SaveFile(get_file_name().string().c_str());
-			if (rc < 0)
-				throw_SI_error(rc, "Failed to save file");
+			try {
+				ini.save_file(get_file_name().string());
+			} catch (const parsers::ini::ini_exception &e) {
+				throw settings_exception(__FILE__, __LINE__, "Failed to save file '" + get_context() + "': " + e.what());
+			}
 		}
 
 		settings::error_list validate() {
 			settings::error_list ret;
-			CSimpleIni::TNamesDepend sections;
-			ini.GetAllSections(sections);
-			BOOST_FOREACH(const CSimpleIni::Entry &ePath, sections) {
-				std::string path = utf8::cvt<std::string>(ePath.pItem);
+			string_list sections;
+			ini.get_sections(sections);
+			BOOST_FOREACH(const std::string &path, sections) {
 				try {
 					get_core()->get_registred_path(path);
 				} catch (const settings_exception &) {
 					ret.push_back(std::string("Invalid path: ") + path);
 				}
-				CSimpleIni::TNamesDepend keys;
-				ini.GetAllKeys(ePath.pItem, keys);
-				BOOST_FOREACH(const CSimpleIni::Entry &eKey, keys) {
-					std::string key = utf8::cvt<std::string>(eKey.pItem);
+				string_list keys;
+				ini.get_keys(path, keys);
+				BOOST_FOREACH(const std::string &key, keys) {
 					try {
 						get_core()->get_registred_key(path, key);
 					} catch (const settings_exception &) {
@@ -269,35 +264,24 @@ namespace settings {
 				is_loaded_ = true;
 				return;
 			}
-			std::string f = utf8::cvt<std::string>(get_file_name().string());
-			ini.SetUnicode();
 			get_logger()->debug("settings", __FILE__, __LINE__, "Loading: " + get_file_name().string());
-			SI_Error rc = ini.LoadFile(f.c_str());
-			if (rc < 0)
-				throw_SI_error(rc, "Failed to load file");
+			try {
+				ini.load_file(utf8::cvt<std::string>(get_file_name().string()));
+			} catch (const parsers::ini::ini_exception &e) {
+				throw settings_exception(__FILE__, __LINE__, "Failed to load file '" + get_context() + "': " + e.what());
+			}
 
 			get_core()->register_path(999, "/includes", "INCLUDED FILES", "Files to be included in the configuration", false, false);
-			CSimpleIni::TNamesDepend lst;
-			ini.GetAllKeys(L"/includes", lst);
-			for (CSimpleIni::TNamesDepend::const_iterator cit = lst.begin(); cit != lst.end(); ++cit) {
-				std::string alias = utf8::cvt<std::string>((*cit).pItem);
-				std::string child = utf8::cvt<std::string>(ini.GetValue(L"/includes", (*cit).pItem));
-				get_core()->register_key(999, "/includes", utf8::cvt<std::string>((*cit).pItem), "INCLUDED FILE", "Included configuration", "", true, false);
-				if (!child.empty())
-					add_child_unsafe(alias, child);
+			string_list lst;
+			ini.get_keys("/includes", lst);
+			BOOST_FOREACH(const std::string &alias, lst) {
+				const std::string *child = ini.get_value("/includes", alias);
+				get_core()->register_key(999, "/includes", alias, "INCLUDED FILE", "Included configuration", "", true, false);
+				if (child && !child->empty())
+					add_child_unsafe(alias, *child);
 			}
 			is_loaded_ = true;
 		}
-		void throw_SI_error(SI_Error err, std::string msg) {
-			std::string error_str = "unknown error";
-			if (err == SI_NOMEM)
-				error_str = "Out of memory";
-			if (err == SI_FAIL)
-				error_str = "General failure";
-			if (err == SI_FILE)
-				error_str = "I/O error: " + error::lookup::last_error();
-			throw settings_exception(__FILE__, __LINE__, msg + " '" + get_context() + "': " + error_str);
-		}
 		boost::filesystem::path get_file_name() {
 			if (filename_.empty()) {
 				filename_ = get_file_from_context();
@@ -21,6 +21,7 @@
 
 //#include <nsclient/logger/logger.hpp>
 #include <settings/settings_value.hpp>
+#include <settings/settings_snapshot.hpp>
 
 //#include <utf8.hpp>
 
@@ -204,5 +205,18 @@ namespace settings {
 		virtual std::list<boost::shared_ptr<settings_interface> > get_children() = 0;
 
 		virtual void house_keeping() = 0;
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Get the current snapshot of all values (can be empty if the settings have changed since the last one was built).
+		///
+		/// @return the snapshot or an empty pointer
+		///
+		/// @author mickem
+		virtual snapshot_ptr get_snapshot() = 0;
+		//////////////////////////////////////////////////////////////////////////
+		/// Build and publish a new snapshot of all values.
+		///
+		/// @author mickem
+		virtual void publish_snapshot() = 0;
 	};
 }
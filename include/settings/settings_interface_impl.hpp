@@ -48,6 +48,9 @@ namespace settings {
 		typedef std::list<instance_raw_ptr> parent_list_type;
 		parent_list_type children_;
 		boost::timed_mutex mutex_;
+		// Only accessed with boost::atomic_load/atomic_store, the generation is bumped (under the mutex) on every change
+		snapshot_ptr snapshot_;
+		unsigned long long snapshot_generation_;
 	public:
 		struct conainer {
 		private:
@@ -106,7 +109,7 @@ namespace settings {
 		path_cache_type settings_delete_path_cache_;
 		key_cache_type key_cache_;
 
-		settings_interface_impl(settings_core *core, std::string alias, std::string context) : core_(core), alias_(alias), context_(context), url_(net::parse(context_)) {}
+		settings_interface_impl(settings_core *core, std::string alias, std::string context) : core_(core), alias_(alias), context_(context), url_(net::parse(context_)), snapshot_generation_(0) {}
 
 		//////////////////////////////////////////////////////////////////////////
 		/// Empty all cached settings values and force a reload.
@@ -114,17 +117,68 @@ namespace settings {
 		///
 		/// @author mickem
 		void clear_cache() {
-			MUTEX_GUARD();
 			{
+				MUTEX_GUARD();
+				invalidate_snapshot_unsafe();
 				settings_cache_.clear();
 				settings_delete_cache_.clear();
 				path_cache_.clear();
 				settings_delete_path_cache_.clear();
 				key_cache_.clear();
 				children_.clear();
+				real_clear_cache();
+				get_core()->set_reload(false);
 			}
-			real_clear_cache();
-			get_core()->set_reload(false);
+			publish_snapshot();
+		}
+
+		virtual snapshot_ptr get_snapshot() {
+			return boost::atomic_load(&snapshot_);
+		}
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Build a new snapshot from the current values and publish it.
+		/// If the settings are changed while the snapshot is built it is discarded (and rebuilt by the next house keeping).
+		///
+		/// @author mickem
+		virtual void publish_snapshot() {
+			unsigned long long generation;
+			{
+				MUTEX_GUARD();
+				generation = snapshot_generation_;
+			}
+			settings_snapshot::builder builder;
+			build_snapshot(builder, "", 0);
+			snapshot_ptr snapshot = builder.build(generation);
+			MUTEX_GUARD();
+			if (generation != snapshot_generation_)
+				return;
+			boost::atomic_store(&snapshot_, snapshot);
+			get_logger()->debug("settings", __FILE__, __LINE__, "Published settings snapshot " + str::xtos(generation) + " for " + alias_ + ": " + str::xtos(snapshot->get_section_count()) + " sections, " + str::xtos(snapshot->get_key_count()) + " keys");
+		}
+
+		void build_snapshot(settings_snapshot::builder &builder, const std::string &path, int depth) {
+			if (depth > 32)
+				return;
+			if (!path.empty() && !builder.add_section(path))
+				return;
+			if (!path.empty()) {
+				BOOST_FOREACH(const std::string &key, get_keys(path)) {
+					StringHandler::op_type value = locked_getter<StringHandler>(path, key);
+					if (value)
+						builder.add(path, key, *value);
+				}
+			}
+			BOOST_FOREACH(const std::string &child, get_sections(path)) {
+				if (!child.empty())
+					build_snapshot(builder, join_path(path, child), depth + 1);
+			}
+		}
+
+		// Must be called (with the mutex held) before any value is changed
+		void invalidate_snapshot_unsafe() {
+			snapshot_generation_++;
+			boost::atomic_store(&snapshot_, snapshot_ptr());
 		}
 
 		//////////////////////////////////////////////////////////////////////////
@@ -175,6 +229,21 @@ namespace settings {
 
 		template<class T>
 		typename T::op_type getter(std::string path, std::string key) {
+			snapshot_ptr snapshot = get_snapshot();
+			if (snapshot) {
+				const settings_snapshot::section *s = snapshot->find_section(path);
+				if (s) {
+					const settings_snapshot::value *v = s->find(key);
+					if (v)
+						return T::get_snapshot_value(*v);
+					return typename T::op_type();
+				}
+			}
+			return locked_getter<T>(path, key);
+		}
+
+		template<class T>
+		typename T::op_type locked_getter(std::string path, std::string key) {
 			MUTEX_GUARD();
 			settings_core::key_path_type lookup(path, key);
 			cache_type::const_iterator cit = settings_cache_.find(lookup);
@@ -201,6 +270,7 @@ namespace settings {
 					return;
 			}
 
+			invalidate_snapshot_unsafe();
 			settings_core::key_path_type lookup(path, key);
 			typename T::op_type current = T::get_real(this, lookup);
 			if (!current) {
@@ -235,6 +305,9 @@ namespace settings {
 			static type get_value(const conainer &c) {
 				return c.get_string();
 			}
+			static op_type get_snapshot_value(const settings_snapshot::value &v) {
+				return v.string_value;
+			}
 			static op_type get_real(settings_interface_impl *ptr, settings_core::key_path_type &lookup) {
 				return ptr->get_real_string(lookup);
 			}
@@ -292,6 +365,7 @@ namespace settings {
 
 		virtual void remove_key(std::string path, std::string key) {
 			MUTEX_GUARD();
+			invalidate_snapshot_unsafe();
 			settings_core::key_path_type lookup(path, key);
 			cache_type::iterator it = settings_cache_.find(lookup);
 			if (it != settings_cache_.end()) {
@@ -302,6 +376,7 @@ namespace settings {
 		}
 		virtual void remove_path(std::string path) {
 			MUTEX_GUARD();
+			invalidate_snapshot_unsafe();
 			path_cache_type::iterator it = path_cache_.find(path);
 			if (it != path_cache_.end()) {
 				path_cache_.erase(it);
@@ -591,6 +666,7 @@ namespace settings {
 		/// @author mickem
 		virtual void load() {
 			MUTEX_GUARD();
+			invalidate_snapshot_unsafe();
 			settings_delete_cache_.clear();
 			settings_delete_path_cache_.clear();
 			path_cache_.clear();
@@ -700,6 +776,8 @@ namespace settings {
 			BOOST_FOREACH(parent_list_type::value_type i, children_) {
 				i->house_keeping();
 			}
+			if (!get_snapshot())
+				publish_snapshot();
 		}
 	};
 
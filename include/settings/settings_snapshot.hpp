@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace settings {
+
+	//////////////////////////////////////////////////////////////////////////
+	/// An immutable copy of all settings values taken after a load/reload.
+	///
+	/// Paths and keys are stored once in sorted vectors so a lookup is two binary searches without
+	/// any allocations.
+	/// Snapshots are never modified: a new one is built and swapped in (with boost::atomic_store) when
+	/// the settings change so readers can use it without taking the settings mutex.
+	///
+	/// This is a core side cache of the string values only: settings_interface::get_string still returns
+	/// a copy and modules (targets, client configuration) keep reading through the settings query.
+	///
+	/// @author mickem
+	class settings_snapshot : boost::noncopyable {
+	public:
+		struct value {
+			std::string string_value;
+
+			value() {}
+			explicit value(const std::string &v) : string_value(v) {}
+		};
+		struct entry {
+			std::string key;
+			settings_snapshot::value value;
+			entry(const std::string &key, const std::string &v) : key(key), value(v) {}
+		};
+		struct section {
+			std::string path;
+			std::vector<entry> keys;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Find a key in this section.
+			///
+			/// @param key the key to lookup
+			/// @return the value or NULL if the key does not exist
+			const settings_snapshot::value* find(const std::string &key) const {
+				std::vector<entry>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), key, key_less());
+				if (it == keys.end() || it->key != key)
+					return NULL;
+				return &it->value;
+			}
+		};
+
+		//////////////////////////////////////////////////////////////////////////
+		/// Collects values before they are frozen into a snapshot
+		class builder {
+			typedef std::map<std::string, std::map<std::string, std::string> > data_type;
+			data_type data_;
+		public:
+			// Returns false if the section has already been added
+			bool add_section(const std::string &path) {
+				return data_.insert(data_type::value_type(path, data_type::mapped_type())).second;
+			}
+			void add(const std::string &path, const std::string &key, const std::string &value) {
+				data_[path][key] = value;
+			}
+			boost::shared_ptr<const settings_snapshot> build(unsigned long long version) const {
+				boost::shared_ptr<settings_snapshot> ret(new settings_snapshot(version));
+				ret->sections_.reserve(data_.size());
+				for (data_type::const_iterator sit = data_.begin(); sit != data_.end(); ++sit) {
+					ret->sections_.push_back(section());
+					section &s = ret->sections_.back();
+					s.path = sit->first;
+					s.keys.reserve(sit->second.size());
+					for (data_type::mapped_type::const_iterator kit = sit->second.begin(); kit != sit->second.end(); ++kit) {
+						s.keys.push_back(entry(kit->first, kit->second));
+					}
+					ret->key_count_ += s.keys.size();
+				}
+				return ret;
+			}
+		};
+
+	private:
+		struct key_less {
+			bool operator()(const entry &e, const std::string &key) const {
+				return e.key < key;
+			}
+		};
+		struct path_less {
+			bool operator()(const section &s, const std::string &path) const {
+				return s.path < path;
+			}
+		};
+
+		std::vector<section> sections_;
+		unsigned long long version_;
+		std::size_t key_count_;
+
+		explicit settings_snapshot(unsigned long long version) : version_(version), key_count_(0) {}
+
+	public:
+		//////////////////////////////////////////////////////////////////////////
+		/// Find a section.
+		/// A section which is not found might still exist (it was added after the snapshot was built)
+		/// so callers should fall back to the settings store.
+		///
+		/// @param path the path to look up
+		/// @return the section or NULL if it is not part of the snapshot
+		const section* find_section(const std::string &path) const {
+			std::vector<section>::const_iterator it = std::lower_bound(sections_.begin(), sections_.end(), path, path_less());
+			if (it == sections_.end() || it->path != path)
+				return NULL;
+			return &*it;
+		}
+
+		unsigned long long get_version() const {
+			return version_;
+		}
+		std::size_t get_section_count() const {
+			return sections_.size();
+		}
+		std::size_t get_key_count() const {
+			return key_count_;
+		}
+	};
+	typedef boost::shared_ptr<const settings_snapshot> snapshot_ptr;
+}
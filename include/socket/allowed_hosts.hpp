@@ -19,10 +19,13 @@
 
 #pragma once
 
-//#include <str/xtos.hpp>
+#include <socket/prefix_trie.hpp>
 
 #include <boost/asio/ip/address.hpp>
-#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <list>
 #include <string>
@@ -56,60 +59,93 @@ namespace socket_helpers {
 		typedef host_record<addr_v4> host_record_v4;
 		typedef host_record<addr_v6> host_record_v6;
 
-		std::list<host_record_v4> entries_v4;
-		std::list<host_record_v6> entries_v6;
+		// The compiled list of allowed hosts, never modified once published
+		struct snapshot {
+			std::list<host_record_v4> entries_v4;
+			std::list<host_record_v6> entries_v6;
+			prefix_trie<4> trie_v4;
+			prefix_trie<16> trie_v6;
+			// If any of the sources are host names (which can be resolved again)
+			bool has_names;
+			snapshot() : has_names(false) {}
+			bool empty() const {
+				return trie_v4.empty() && trie_v6.empty();
+			}
+		};
+		typedef boost::shared_ptr<const snapshot> snapshot_type;
+
+		// Shared by all copies of the manager: the current snapshot (swapped atomically) and the
+		// thread resolving host names in the background.
+		struct acl_state : boost::noncopyable {
+			snapshot_type current;
+			boost::mutex mutex;
+			boost::shared_ptr<boost::thread> thread;
+			std::list<std::string> sources;
+			unsigned int interval;
+
+			acl_state() : interval(0) {}
+			~acl_state();
+			void publish(snapshot_type next);
+			snapshot_type get() const;
+			// Restart the background refresh (an interval of 0 disables it)
+			void schedule(const std::list<std::string> &sources, unsigned int interval);
+		private:
+			void stop();
+			void run();
+		};
+
 		std::list<std::string> sources;
 		bool cached;
+		// How often (in seconds) host names are resolved again when they are not cached
+		unsigned int refresh_interval;
 
-		allowed_hosts_manager() : cached(true) {}
-		allowed_hosts_manager(const allowed_hosts_manager &other) : entries_v4(other.entries_v4), entries_v6(other.entries_v6), sources(other.sources), cached(other.cached) {}
+		allowed_hosts_manager() : cached(true), refresh_interval(60), state_(new acl_state()) {}
+		allowed_hosts_manager(const allowed_hosts_manager &other) : sources(other.sources), cached(other.cached), refresh_interval(other.refresh_interval), state_(other.state_) {}
 		const allowed_hosts_manager& operator=(const allowed_hosts_manager &other) {
-			entries_v4 = other.entries_v4;
-			entries_v6 = other.entries_v6;
 			sources = other.sources;
 			cached = other.cached;
+			refresh_interval = other.refresh_interval;
+			state_ = other.state_;
 			return *this;
 		}
 
 		void set_source(std::string source);
-		addr_v4 lookup_mask_v4(std::string mask);
-		addr_v6 lookup_mask_v6(std::string mask);
+		// Resolve the sources and publish the new list. Unless cached host names are resolved again in the
+		// background (every refresh_interval seconds) so checking a connection never waits for DNS.
 		void refresh(std::list<std::string> &errors);
+		static snapshot_type compile(const std::list<std::string> &sources, snapshot_type previous, std::list<std::string> &errors);
 
-		template<class T>
-		inline bool match_host(const T &allowed, const T &mask, const T &remote) const {
-			for (std::size_t i = 0; i < allowed.size(); i++) {
-				if ((allowed[i] & mask[i]) != (remote[i] & mask[i]))
-					return false;
-			}
-			return true;
-		}
-		bool is_allowed(const boost::asio::ip::address &address, std::list<std::string> &errors) {
-			return (entries_v4.empty() && entries_v6.empty())
-				|| (address.is_v4() && is_allowed_v4(address.to_v4().to_bytes(), errors))
-				|| (address.is_v6() && is_allowed_v6(address.to_v6().to_bytes(), errors))
-				|| (address.is_v6() && address.to_v6().is_v4_compatible() && is_allowed_v4(address.to_v6().to_v4().to_bytes(), errors))
-				|| (address.is_v6() && address.to_v6().is_v4_mapped() && is_allowed_v4(address.to_v6().to_v4().to_bytes(), errors))
-				;
-		}
-		bool is_allowed_v4(const addr_v4 &remote, std::list<std::string> &errors) {
-			if (!cached)
-				refresh(errors);
-			BOOST_FOREACH(const host_record_v4 &r, entries_v4) {
-				if (match_host(r.addr, r.mask, remote))
-					return true;
+		bool is_allowed(const boost::asio::ip::address &address, std::list<std::string> &errors) const {
+			snapshot_type s = state_->get();
+			if (!s || s->empty())
+				return true;
+			if (address.is_v4())
+				return is_allowed_v4(*s, address.to_v4().to_bytes());
+			if (address.is_v6()) {
+				boost::asio::ip::address_v6 a6 = address.to_v6();
+				return is_allowed_v6(*s, a6.to_bytes())
+					|| ((a6.is_v4_compatible() || a6.is_v4_mapped()) && is_allowed_v4(*s, a6.to_v4().to_bytes()));
 			}
 			return false;
 		}
-		bool is_allowed_v6(const addr_v6 &remote, std::list<std::string> &errors) {
-			if (!cached)
-				refresh(errors);
-			BOOST_FOREACH(const host_record_v6 &r, entries_v6) {
-				if (match_host(r.addr, r.mask, remote))
-					return true;
-			}
-			return false;
+		bool is_allowed_v4(const addr_v4 &remote, std::list<std::string> &errors) const {
+			snapshot_type s = state_->get();
+			return s && is_allowed_v4(*s, remote);
+		}
+		bool is_allowed_v6(const addr_v6 &remote, std::list<std::string> &errors) const {
+			snapshot_type s = state_->get();
+			return s && is_allowed_v6(*s, remote);
 		}
 		std::string to_string();
+
+	private:
+		static bool is_allowed_v4(const snapshot &s, const addr_v4 &remote) {
+			return s.trie_v4.contains(&remote[0]);
+		}
+		static bool is_allowed_v6(const snapshot &s, const addr_v6 &remote) {
+			return s.trie_v6.contains(&remote[0]);
+		}
+
+		boost::shared_ptr<acl_state> state_;
 	};
 }
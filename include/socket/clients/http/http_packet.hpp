@@ -21,6 +21,9 @@
 
 #include <str/xtos.hpp>
 
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+
 #include <string>
 #include <map>
 
@@ -155,6 +158,14 @@ namespace http {
 			add_header("Accept", "*/*");
 			add_header("Connection", "close");
 		}
+		// Ask the server to keep the connection open (sent as HTTP/1.1)
+		void set_keep_alive() {
+			add_header("Connection", "keep-alive");
+		}
+		bool is_keep_alive() const {
+			header_type::const_iterator it = headers_.find("Connection");
+			return it != headers_.end() && it->second == "keep-alive";
+		}
 		void set_payload(std::string data) {
 			payload_ = data;
 		}
@@ -205,7 +216,8 @@ namespace http {
 
 		void build_request(std::ostream &os) const {
 			const char* crlf = "\r\n";
-			os << verb_ << " " << path_ << " HTTP/1.0" << crlf;
+			bool keep_alive = is_keep_alive();
+			os << verb_ << " " << path_ << (keep_alive ? " HTTP/1.1" : " HTTP/1.0") << crlf;
 			if (!server_.empty()) {
 				os << "Host: " << server_ << crlf;
 			}
@@ -215,8 +227,11 @@ namespace http {
 			os << crlf;
 			if (!payload_.empty())
 				os << payload_;
-			os << crlf;
-			os << crlf;
+			if (!keep_alive) {
+				// Anything after the body would be read as the start of the next request on a persistent connection
+				os << crlf;
+				os << crlf;
+			}
 		}
 		void add_post_payload(const post_map_type &payload_map) {
 			std::string data;
@@ -285,6 +300,15 @@ namespace http {
 			return status_code_ >= 200 && status_code_ < 300;
 		}
 
+		// Header value (name is case insensitive, value is trimmed)
+		std::string get_header(const std::string &key) const {
+			BOOST_FOREACH(const header_type::value_type &v, headers_) {
+				if (boost::algorithm::iequals(boost::algorithm::trim_copy(v.first), key))
+					return boost::algorithm::trim_copy(v.second);
+			}
+			return "";
+		}
+
 
 	};
 
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <vector>
+
+namespace socket_helpers {
+
+	/**
+	 * Set of address prefixes (N byte addresses) answering "is this address covered by any prefix".
+	 *
+	 * Multibit trie with an 8 bit stride: every node is a table indexed by one byte of the address and a
+	 * prefix which ends inside a byte is expanded into all the slots it covers. A lookup is at most N table
+	 * lookups regardless of the number of prefixes.
+	 * Not thread safe while inserting, once built it can be shared (read only) between threads.
+	 */
+	template<std::size_t N>
+	class prefix_trie {
+		struct node {
+			boost::uint32_t child[256];
+			boost::uint64_t covered[4];
+			node() {
+				std::memset(child, 0, sizeof(child));
+				std::memset(covered, 0, sizeof(covered));
+			}
+			bool is_covered(unsigned char b) const {
+				return (covered[b >> 6] >> (b & 63)) & 1;
+			}
+			void cover(unsigned char b) {
+				covered[b >> 6] |= boost::uint64_t(1) << (b & 63);
+			}
+		};
+		std::vector<node> nodes_;
+		std::size_t count_;
+
+	public:
+		prefix_trie() : nodes_(1), count_(0) {}
+
+		// Add the prefix of length bits of address (bits larger than the address means the whole address)
+		void insert(const unsigned char *address, std::size_t bits) {
+			if (bits > N * 8)
+				bits = N * 8;
+			count_++;
+			boost::uint32_t current = 0;
+			for (std::size_t depth = 0; depth < N; depth++) {
+				unsigned char b = address[depth];
+				if (bits <= (depth + 1) * 8) {
+					std::size_t remaining = bits - depth * 8;
+					unsigned int span = 1u << (8 - remaining);
+					unsigned int first = remaining == 0 ? 0 : (b & (0xff << (8 - remaining)) & 0xff);
+					for (unsigned int i = first; i < first + span; i++)
+						nodes_[current].cover(static_cast<unsigned char>(i));
+					return;
+				}
+				if (nodes_[current].is_covered(b))
+					return;
+				boost::uint32_t next = nodes_[current].child[b];
+				if (next == 0) {
+					next = static_cast<boost::uint32_t>(nodes_.size());
+					nodes_.push_back(node());
+					nodes_[current].child[b] = next;
+				}
+				current = next;
+			}
+		}
+
+		bool contains(const unsigned char *address) const {
+			boost::uint32_t current = 0;
+			for (std::size_t depth = 0; depth < N; depth++) {
+				const node &n = nodes_[current];
+				unsigned char b = address[depth];
+				if (n.is_covered(b))
+					return true;
+				current = n.child[b];
+				if (current == 0)
+					return false;
+			}
+			return false;
+		}
+
+		bool empty() const {
+			return count_ == 0;
+		}
+		std::size_t size() const {
+			return count_;
+		}
+		std::size_t node_count() const {
+			return nodes_.size();
+		}
+	};
+}
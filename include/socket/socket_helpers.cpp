@@ -19,6 +19,7 @@
 
 #include <boost/asio.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 #include <str/utils.hpp>
@@ -82,13 +83,16 @@ long socket_helpers::connection_info::get_ctx_opts() {
 
 std::string socket_helpers::allowed_hosts_manager::to_string() {
 	std::string ret;
-	BOOST_FOREACH(const host_record_v4 &r, entries_v4) {
+	snapshot_type current = state_->get();
+	if (!current)
+		return ret;
+	BOOST_FOREACH(const host_record_v4 &r, current->entries_v4) {
 		ip::address_v4 a(r.addr);
 		ip::address_v4 m(r.mask);
 		std::string s = a.to_string() + "(" + m.to_string() + ")";
 		str::format::append_list(ret, s);
 	}
-	BOOST_FOREACH(const host_record_v6 &r, entries_v6) {
+	BOOST_FOREACH(const host_record_v6 &r, current->entries_v6) {
 		ip::address_v6 a(r.addr);
 		ip::address_v6 m(r.mask);
 		std::string s = a.to_string() + "(" + m.to_string() + ")";
@@ -142,11 +146,49 @@ void socket_helpers::allowed_hosts_manager::set_source(std::string source) {
 	}
 }
 
-void socket_helpers::allowed_hosts_manager::refresh(std::list<std::string> &errors) {
+namespace {
+	template<class addr, std::size_t N>
+	void add_record(std::list<socket_helpers::allowed_hosts_manager::host_record<addr> > &entries, socket_helpers::prefix_trie<N> &trie, const std::string &record, const addr &address, const std::string &mask) {
+		std::string mask_s = mask;
+		std::size_t bits = extract_mask(mask_s, N * 8);
+		entries.push_back(socket_helpers::allowed_hosts_manager::host_record<addr>(record, address, calculate_mask<addr>(mask)));
+		trie.insert(&address[0], bits);
+	}
+
+	void add_address(socket_helpers::allowed_hosts_manager::snapshot &s, const std::string &record, const ip::address &a, const std::string &mask, std::list<std::string> &errors) {
+		if (a.is_v4())
+			add_record(s.entries_v4, s.trie_v4, record, a.to_v4().to_bytes(), mask);
+		else if (a.is_v6())
+			add_record(s.entries_v6, s.trie_v6, record, a.to_v6().to_bytes(), mask);
+		else
+			errors.push_back("Invalid address: " + record);
+	}
+
+	// Keep what a host name resolved to the last time (if resolving it fails now)
+	bool add_previous(socket_helpers::allowed_hosts_manager::snapshot &s, socket_helpers::allowed_hosts_manager::snapshot_type previous, const std::string &record, const std::string &mask) {
+		if (!previous)
+			return false;
+		bool found = false;
+		BOOST_FOREACH(const socket_helpers::allowed_hosts_manager::host_record_v4 &r, previous->entries_v4) {
+			if (r.host == record) {
+				add_record(s.entries_v4, s.trie_v4, record, r.addr, mask);
+				found = true;
+			}
+		}
+		BOOST_FOREACH(const socket_helpers::allowed_hosts_manager::host_record_v6 &r, previous->entries_v6) {
+			if (r.host == record) {
+				add_record(s.entries_v6, s.trie_v6, record, r.addr, mask);
+				found = true;
+			}
+		}
+		return found;
+	}
+}
+
+socket_helpers::allowed_hosts_manager::snapshot_type socket_helpers::allowed_hosts_manager::compile(const std::list<std::string> &sources, snapshot_type previous, std::list<std::string> &errors) {
+	boost::shared_ptr<snapshot> ret(new snapshot());
 	boost::asio::io_service io_service;
 	ip::tcp::resolver resolver(io_service);
-	entries_v4.clear();
-	entries_v6.clear();
 	BOOST_FOREACH(const std::string &record, sources) {
 		std::string::size_type pos = record.find('/');
 		std::string addr, mask;
@@ -161,34 +203,75 @@ void socket_helpers::allowed_hosts_manager::refresh(std::list<std::string> &erro
 			continue;
 
 		if (std::isdigit(addr[0])) {
-			ip::address a = ip::address::from_string(addr);
-			if (a.is_v4()) {
-				entries_v4.push_back(host_record_v4(record, a.to_v4().to_bytes(), calculate_mask<addr_v4>(mask)));
-			} else if (a.is_v6()) {
-				entries_v6.push_back(host_record_v6(record, a.to_v6().to_bytes(), calculate_mask<addr_v6>(mask)));
-			} else {
+			boost::system::error_code ec;
+			ip::address a = ip::address::from_string(addr, ec);
+			if (ec)
 				errors.push_back("Invalid address: " + record);
-			}
+			else
+				add_address(*ret, record, a, mask, errors);
 		} else {
+			ret->has_names = true;
 			try {
 				ip::tcp::resolver::query query(addr, "");
 				ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
 				ip::tcp::resolver::iterator end;
 				for (; endpoint_iterator != end; ++endpoint_iterator) {
-					ip::address a = endpoint_iterator->endpoint().address();
-					if (a.is_v4()) {
-						entries_v4.push_back(host_record_v4(record, a.to_v4().to_bytes(), calculate_mask<addr_v4>(mask)));
-					} else if (a.is_v6()) {
-						entries_v6.push_back(host_record_v6(record, a.to_v6().to_bytes(), calculate_mask<addr_v6>(mask)));
-					} else {
-						errors.push_back("Invalid address: " + record);
-					}
+					add_address(*ret, record, endpoint_iterator->endpoint().address(), mask, errors);
 				}
 			} catch (const std::exception &e) {
-				errors.push_back("Failed to parse host " + record + ": " + utf8::utf8_from_native(e.what()));
+				if (!add_previous(*ret, previous, record, mask))
+					errors.push_back("Failed to parse host " + record + ": " + utf8::utf8_from_native(e.what()));
 			}
 		}
 	}
+	return ret;
+}
+
+void socket_helpers::allowed_hosts_manager::refresh(std::list<std::string> &errors) {
+	snapshot_type next = compile(sources, state_->get(), errors);
+	state_->publish(next);
+	state_->schedule(sources, cached || !next->has_names ? 0 : refresh_interval);
+}
+
+socket_helpers::allowed_hosts_manager::acl_state::~acl_state() {
+	stop();
+}
+
+void socket_helpers::allowed_hosts_manager::acl_state::publish(snapshot_type next) {
+	boost::atomic_store(&current, next);
+}
+
+socket_helpers::allowed_hosts_manager::snapshot_type socket_helpers::allowed_hosts_manager::acl_state::get() const {
+	return boost::atomic_load(&current);
+}
+
+void socket_helpers::allowed_hosts_manager::acl_state::schedule(const std::list<std::string> &new_sources, unsigned int new_interval) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	stop();
+	sources = new_sources;
+	interval = new_interval;
+	if (interval > 0)
+		thread.reset(new boost::thread(boost::bind(&acl_state::run, this)));
+}
+
+void socket_helpers::allowed_hosts_manager::acl_state::stop() {
+	if (thread) {
+		thread->interrupt();
+		thread->join();
+		thread.reset();
+	}
+}
+
+void socket_helpers::allowed_hosts_manager::acl_state::run() {
+	try {
+		while (true) {
+			boost::this_thread::sleep(boost::posix_time::seconds(interval));
+			// Errors are reported when the list is first loaded, here we keep the last known addresses instead
+			std::list<std::string> errors;
+			publish(compile(sources, get(), errors));
+		}
+	} catch (const boost::thread_interrupted &) {
+	}
 }
 
 void socket_helpers::io::set_result(boost::optional<boost::system::error_code>* a, boost::system::error_code b) {
@@ -99,6 +99,9 @@ namespace socket_helpers {
 				("cache allowed hosts", nscapi::settings_helper::bool_key(&info_.allowed_hosts.cached, true),
 					"CACHE ALLOWED HOSTS", "If host names (DNS entries) should be cached, improves speed and security somewhat but won't allow you to have dynamic IPs for your Nagios server.")
 
+				("allowed hosts refresh", nscapi::settings_helper::uint_key(&info_.allowed_hosts.refresh_interval, 60),
+					"ALLOWED HOSTS REFRESH", "How often (in seconds) host names in allowed hosts are resolved again when they are not cached (this is done in the background).", true)
+
 				("timeout", nscapi::settings_helper::uint_key(&info_.timeout, 30),
 					"TIMEOUT", "Timeout when reading packets on incoming sockets. If the data has not arrived within this time we will bail out.")
 
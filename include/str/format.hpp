@@ -136,6 +136,19 @@ namespace str {
 		inline std::string format_date(std::time_t time, std::string format = "%Y-%m-%d %H:%M:%S") {
 			return format_date(boost::posix_time::from_time_t(time), format);
 		}
+		static const unsigned long long SECS_BETWEEN_EPOCHS = 11644473600ull;
+		static const unsigned long long SECS_TO_100NS = 10000000ull;
+		inline unsigned long long filetime_to_time(unsigned long long filetime) {
+			return (filetime - (SECS_BETWEEN_EPOCHS * SECS_TO_100NS)) / SECS_TO_100NS;
+		}
+		inline unsigned long long time_to_filetime(unsigned long long time, unsigned long long nsec = 0) {
+			return (time + SECS_BETWEEN_EPOCHS) * SECS_TO_100NS + nsec / 100;
+		}
+		inline std::string format_filetime(unsigned long long filetime, std::string format = "%Y-%m-%d %H:%M:%S") {
+			if (filetime == 0)
+				return "ZERO";
+			return format_date(static_cast<time_t>(filetime_to_time(filetime)), format);
+		}
 #define MK_FORMAT_FTD(min, key, val) \
 	if (mtm->tm_year > min) \
 	str::utils::replace(format, key, str::xtos(val));  \
@@ -158,12 +171,6 @@ namespace str {
 				return "";
 			return format_time_delta(&nt, format);
 		}
-		static const unsigned long long SECS_BETWEEN_EPOCHS = 11644473600ull;
-		static const unsigned long long SECS_TO_100NS = 10000000ull;
-		inline unsigned long long filetime_to_time(unsigned long long filetime) {
-			return (filetime - (SECS_BETWEEN_EPOCHS * SECS_TO_100NS)) / SECS_TO_100NS;
-		}
-
 		inline std::string format_filetime_delta(unsigned long long filetime, std::string format = "%Y-%m-%d %H:%M:%S") {
 			if (filetime == 0)
 				return "ZERO";
@@ -172,11 +179,6 @@ namespace str {
 			return format_time_delta(static_cast<time_t>(filetime), format);
 		}
 
-		inline std::string format_filetime(unsigned long long filetime, std::string format = "%Y-%m-%d %H:%M:%S") {
-			if (filetime == 0)
-				return "ZERO";
-			return format_date(static_cast<time_t>(filetime_to_time(filetime)), format);
-		}
 #endif
 
 		template<class T>
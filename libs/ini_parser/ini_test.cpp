@@ -0,0 +1,193 @@
+#include <string>
+#include <iostream>
+#include <sstream>
+
+#include <parsers/ini/ini_file.hpp>
+
+#include <utf8.hpp>
+#include <simpleini/simpleini.h>
+
+#include <gtest/gtest.h>
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#ifdef WIN32
+#define NL "\r\n"
+#else
+#define NL "\n"
+#endif
+
+std::string get(parsers::ini::ini_file &ini, const std::string &section, const std::string &key) {
+	const std::string *v = ini.get_value(section, key);
+	return v ? *v : "<missing>";
+}
+
+TEST(IniTest, simple_values) {
+	parsers::ini::ini_file ini;
+	ini.load_data("[/settings/default]\nallowed hosts = 127.0.0.1 \n  timeout=30\r\n[/modules]\nCheckSystem = enabled\n");
+	EXPECT_EQ("127.0.0.1", get(ini, "/settings/default", "allowed hosts"));
+	EXPECT_EQ("30", get(ini, "/settings/default", "timeout"));
+	EXPECT_EQ("enabled", get(ini, "/modules", "CheckSystem"));
+	EXPECT_EQ("<missing>", get(ini, "/modules", "CheckDisk"));
+	EXPECT_EQ("<missing>", get(ini, "/foo", "bar"));
+	EXPECT_EQ(2, ini.get_section_size("/settings/default"));
+}
+
+TEST(IniTest, case_insensitive_names) {
+	parsers::ini::ini_file ini;
+	ini.load_data("[/Modules]\ncheckSystem = enabled\n");
+	EXPECT_EQ("enabled", get(ini, "/modules", "CHECKSYSTEM"));
+	EXPECT_TRUE(ini.has_section("/MODULES"));
+}
+
+TEST(IniTest, duplicates) {
+	parsers::ini::ini_file ini;
+	ini.load_data("[a]\nk = 1\nk = 2\n[b]\nx = 1\n[a]\nj = 3\n");
+	EXPECT_EQ("2", get(ini, "a", "k"));
+	EXPECT_EQ("3", get(ini, "a", "j"));
+	parsers::ini::ini_file::string_list keys;
+	ini.get_keys("a", keys);
+	ASSERT_EQ(2, keys.size());
+	EXPECT_EQ("k", keys.front());
+	EXPECT_EQ("j", keys.back());
+}
+
+TEST(IniTest, invalid_lines) {
+	parsers::ini::ini_file ini;
+	ini.load_data("global = 1\n[a\n[b]\nfoo\n= bar\nk = v\n");
+	EXPECT_EQ("1", get(ini, "", "global"));
+	EXPECT_EQ("v", get(ini, "b", "k"));
+	EXPECT_EQ(1, ini.get_section_size("b"));
+}
+
+TEST(IniTest, round_trip) {
+	std::string data = "\xEF\xBB\xBF"
+		"; file comment" NL
+		"" NL
+		"" NL
+		"; section comment" NL
+		"[/modules]" NL
+		"" NL
+		"; key comment" NL
+		"; more" NL
+		"CheckSystem = enabled" NL
+		"CheckDisk = disabled" NL
+		"" NL
+		"" NL
+		"[/settings]" NL
+		"a = b" NL;
+	parsers::ini::ini_file ini;
+	ini.load_data(data);
+	EXPECT_EQ(data, ini.render());
+}
+
+TEST(IniTest, updates_keep_order_and_comments) {
+	parsers::ini::ini_file ini;
+	ini.load_data("[a]\n; first\nx = 1\ny = 2\n");
+	ini.set_value("a", "x", "3", "; ignored");
+	ini.set_value("a", "z", "4", "; new");
+	ini.add_section("b", "; section b");
+	ini.set_value("b", "k", "v");
+	EXPECT_EQ("\xEF\xBB\xBF" "[a]" NL NL "; first" NL "x = 3" NL "y = 2" NL NL "; new" NL "z = 4" NL NL NL "; section b" NL "[b]" NL "k = v" NL, ini.render());
+}
+
+TEST(IniTest, remove) {
+	parsers::ini::ini_file ini;
+	ini.load_data("[a]\nx = 1\n[b]\ny = 2\nz = 3\n");
+	EXPECT_TRUE(ini.remove_key("a", "x", true));
+	EXPECT_FALSE(ini.has_section("a"));
+	EXPECT_TRUE(ini.remove_key("b", "y", true));
+	EXPECT_TRUE(ini.has_section("b"));
+	EXPECT_FALSE(ini.remove_key("b", "y", true));
+	EXPECT_TRUE(ini.remove_section("b"));
+	EXPECT_EQ("\xEF\xBB\xBF", ini.render());
+}
+
+std::string make_large_config(int lines) {
+	std::stringstream ss;
+	ss << "# Generated configuration" << NL << NL;
+	int line = 2;
+	for (int s = 0; line < lines; s++) {
+		ss << NL << "; Section " << s << NL << "[/settings/external scripts/scripts/group" << s << "]" << NL;
+		line += 3;
+		for (int k = 0; k < 100 && line < lines; k++) {
+			if (k % 10 == 0) {
+				ss << "; A description of check_" << k << NL;
+				line++;
+			}
+			ss << "check_" << s << "_" << k << " = scripts\\check_" << k << ".bat $ARG1$ $ARG2$" << NL;
+			line++;
+		}
+	}
+	return ss.str();
+}
+
+TEST(IniTest, same_output_as_simpleini) {
+	const std::string data = make_large_config(2000) + "global = 1\n[a\n; dangling\n[/x]\n  ; indented\n\n; comment\nk=  v  \nfoo\nk = w\n";
+	CSimpleIniW si(false, false, false);
+	si.SetUnicode();
+	ASSERT_GE(si.LoadData(data.c_str(), data.size()), 0);
+	std::string expected;
+	ASSERT_GE(si.Save(expected, true), 0);
+
+	parsers::ini::ini_file ini;
+	ini.load_data(data);
+	EXPECT_EQ(expected, ini.render());
+}
+
+double elapsed_ms(const boost::posix_time::ptime &start) {
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+}
+
+// Run with --gtest_also_run_disabled_tests
+TEST(IniBenchmark, DISABLED_load_50k_lines) {
+	const std::string data = make_large_config(50000);
+	const int iterations = 10;
+
+	double si_load = 0, si_all = 0, ini_load = 0, ini_one = 0, ini_all = 0;
+	for (int i = 0; i < iterations; i++) {
+		{
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			CSimpleIniW ini(false, false, false);
+			ini.SetUnicode();
+			ASSERT_GE(ini.LoadData(data.c_str(), data.size()), 0);
+			si_load += elapsed_ms(start);
+			CSimpleIniW::TNamesDepend sections;
+			ini.GetAllSections(sections);
+			std::size_t count = 0;
+			BOOST_FOREACH(const CSimpleIniW::Entry &s, sections) {
+				CSimpleIniW::TNamesDepend keys;
+				ini.GetAllKeys(s.pItem, keys);
+				BOOST_FOREACH(const CSimpleIniW::Entry &k, keys) {
+					if (ini.GetValue(s.pItem, k.pItem, NULL))
+						count++;
+				}
+			}
+			si_all += elapsed_ms(start);
+			ASSERT_LT(40000u, count);
+		}
+		{
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			parsers::ini::ini_file ini;
+			ini.load_data(data);
+			ini_load += elapsed_ms(start);
+			ASSERT_TRUE(ini.get_value("/settings/external scripts/scripts/group7", "check_7_42") != NULL);
+			ini_one += elapsed_ms(start);
+			parsers::ini::ini_file::string_list sections;
+			ini.get_sections(sections);
+			std::size_t count = 0;
+			BOOST_FOREACH(const std::string &s, sections) {
+				parsers::ini::ini_file::string_list keys;
+				ini.get_keys(s, keys);
+				BOOST_FOREACH(const std::string &k, keys) {
+					if (ini.get_value(s, k))
+						count++;
+				}
+			}
+			ini_all += elapsed_ms(start);
+			ASSERT_LT(40000u, count);
+		}
+	}
+	std::cout << "simpleini: load " << si_load / iterations << "ms, load and read all " << si_all / iterations << "ms" << std::endl;
+	std::cout << "ini_file:  load " << ini_load / iterations << "ms, load and read one " << ini_one / iterations << "ms, load and read all " << ini_all / iterations << "ms" << std::endl;
+}
@@ -8,6 +8,10 @@
 
 #include <lua/lua_cpp.hpp>
 #include <lua/lua_core.hpp>
+#include <lua/lua_pool.hpp>
+#include <scripts/script_nscp.hpp>
+
+#include <boost/bind.hpp>
 
 void lua::lua_runtime::register_query(const std::string &command, const std::string &description) {
 	throw lua::lua_exception("The method or operation is not implemented(reg_query).");
@@ -18,7 +22,12 @@ void lua::lua_runtime::register_subscription(const std::string &channel, const s
 }
 
 void lua::lua_runtime::on_query(std::string command, script_information *information, lua::lua_traits::function_type function, bool simple, const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, const PB::Commands::QueryRequestMessage &request_message) {
-	lua_wrapper lua(prep_function(information, function));
+	if (!information->user_data.pool)
+		return nscapi::protobuf::functions::set_response_bad(*response, "Script not loaded: " + information->script);
+	lua::state_pool::lease state(*information->user_data.pool);
+	if (!state->primary && !state->find(simple ? scripts::nscp::tags::simple_query_tag : scripts::nscp::tags::query_tag, command, function))
+		return nscapi::protobuf::functions::set_response_bad(*response, "Command not registered: " + command);
+	lua_wrapper lua(prep_function(state->L, function));
 	int args = 2;
 	if (function.object_ref != 0)
 		args = 3;
@@ -62,7 +71,11 @@ void lua::lua_runtime::on_query(std::string command, script_information *informa
 }
 
 void lua::lua_runtime::exec_main(script_information *information, const std::vector<std::string> &opts, PB::Commands::ExecuteResponseMessage::Response *response) {
-	lua_wrapper lua(prep_function(information, "main"));
+	if (!information->user_data.pool)
+		return nscapi::protobuf::functions::set_response_bad(*response, "Script not loaded: " + information->script);
+	lua::state_pool::lease state(*information->user_data.pool);
+	lua_wrapper lua(state->L);
+	lua.getglobal("main");
 	lua.push_array(opts);
 	if (lua.pcall(1, 2, 0) != 0)
 		return nscapi::protobuf::functions::set_response_bad(*response, "Failed to handle command main: " + lua.pop_string());
@@ -79,7 +92,12 @@ void lua::lua_runtime::exec_main(script_information *information, const std::vec
 	nscapi::protobuf::functions::append_simple_exec_response_payload(response, "", ret, msg);
 }
 void lua::lua_runtime::on_exec(std::string command, script_information *information, lua::lua_traits::function_type function, bool simple, const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response, const PB::Commands::ExecuteRequestMessage &request_message) {
-	lua_wrapper lua(prep_function(information, function));
+	if (!information->user_data.pool)
+		return nscapi::protobuf::functions::set_response_bad(*response, "Script not loaded: " + information->script);
+	lua::state_pool::lease state(*information->user_data.pool);
+	if (!state->primary && !state->find(simple ? scripts::nscp::tags::simple_exec_tag : scripts::nscp::tags::exec_tag, command, function))
+		return nscapi::protobuf::functions::set_response_bad(*response, "Command not registered: " + command);
+	lua_wrapper lua(prep_function(state->L, function));
 	int args = 2;
 	if (function.object_ref != 0)
 		args = 3;
@@ -130,25 +148,46 @@ void lua::lua_runtime::create_user_data(scripts::script_information<lua_traits>
 }
 
 void lua::lua_runtime::load(scripts::script_information<lua_traits> *info) {
+	// Compile once (or load from the cache), every state in the pool then runs the same bytecode
+	lua::chunk c = lua::chunk::compile(info->user_data.L, info->script, cache_path);
+	lua::pooled_state *primary = new lua::pooled_state(info->user_data.L, true);
+	info->user_data.pool.reset(new lua::state_pool(primary, pool_size, boost::bind(&lua::lua_runtime::init_state, this, info, c, _1)));
+	init_state(info, c, *primary);
+}
+
+void lua::lua_runtime::init_state(script_information *info, const lua::chunk &c, lua::pooled_state &state) {
 	std::string base_path = info->user_data.base_path_;
-	lua::lua_wrapper lua_instance(info->user_data.L);
+	lua::lua_wrapper lua_instance(state.L);
 	lua_instance.set_userdata(lua::lua_traits::user_data_tag, info);
+	lua_instance.set_userdata(lua::pooled_state::user_data_tag, &state);
 	lua_instance.openlibs();
-	lua::lua_script::luaopen(info->user_data.L);
+	lua::lua_script::luaopen(state.L);
 	BOOST_FOREACH(lua::lua_runtime_plugin_type &plugin, plugins) {
 		plugin->load(lua_instance);
 	}
 	lua_instance.append_path(base_path + "/scripts/lua/lib/?.lua;" + base_path + "scripts/lua/?;");
-	if (lua_instance.loadfile(info->script) != 0)
+	if (c.load(state.L) != 0)
 		throw lua::lua_exception("Failed to load script: " + info->script + ": " + lua_instance.pop_string());
 	if (lua_instance.pcall(0, 0, 0) != 0)
 		throw lua::lua_exception("Failed to execute script: " + info->script + ": " + lua_instance.pop_string());
 }
+
 void lua::lua_runtime::unload(scripts::script_information<lua_traits> *info) {
-	lua::lua_wrapper lua_instance(info->user_data.L);
+	if (info->user_data.pool) {
+		BOOST_FOREACH(lua_State *L, info->user_data.pool->get_secondary_states()) {
+			unload_state(L);
+		}
+	}
+	unload_state(info->user_data.L);
+	info->user_data.pool.reset();
+}
+
+void lua::lua_runtime::unload_state(lua_State *L) {
+	lua::lua_wrapper lua_instance(L);
 	BOOST_FOREACH(lua::lua_runtime_plugin_type &plugin, plugins) {
 		plugin->unload(lua_instance);
 	}
 	lua_instance.gc(LUA_GCCOLLECT, 0);
 	lua_instance.remove_userdata(lua::lua_traits::user_data_tag);
-}
\ No newline at end of file
+	lua_instance.remove_userdata(lua::pooled_state::user_data_tag);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lua/lua_pool.hpp>
+
+extern "C" {
+#include <lua.h>
+#include "lauxlib.h"
+}
+
+#include <nscapi/nscapi_helper_singleton.hpp>
+#include <nscapi/macros.hpp>
+
+#include <str/xtos.hpp>
+#include <utf8.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+
+const std::string lua::pooled_state::user_data_tag = "nscp.userdata.state";
+
+namespace {
+	bool read_file(const std::string &file, std::string &data) {
+		std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+		if (!in.good())
+			return false;
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		return !in.bad();
+	}
+
+	// FNV-1a over the source and the things the bytecode format depends on
+	std::string content_hash(const std::string &source) {
+		unsigned long long hash = 14695981039346656037ULL;
+		std::string salt = std::string(LUA_RELEASE) + ":" + str::xtos(sizeof(void*)) + ":" + str::xtos(sizeof(lua_Number)) + ":";
+		BOOST_FOREACH(char c, salt + source) {
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ULL;
+		}
+		std::stringstream ss;
+		ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+		return ss.str();
+	}
+
+	int chunk_writer(lua_State *, const void *p, size_t size, void *ud) {
+		static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+		return 0;
+	}
+}
+
+lua::chunk lua::chunk::compile(lua_State *L, const std::string &script, const std::string &cache_path) {
+	chunk ret;
+	ret.name = "@" + script;
+	std::string source;
+	if (!read_file(script, source))
+		throw lua::lua_exception("Failed to read script: " + script);
+
+	boost::filesystem::path cache_file;
+	if (!cache_path.empty()) {
+		cache_file = boost::filesystem::path(cache_path) / (content_hash(source) + ".luac");
+		if (read_file(cache_file.string(), ret.bytecode)) {
+			// Make sure the cached file is usable (partial writes, other lua versions, ...)
+			if (ret.load(L) == 0) {
+				lua_pop(L, 1);
+				return ret;
+			}
+			lua_pop(L, 1);
+			ret.bytecode.clear();
+		}
+	}
+
+	if (luaL_loadbuffer(L, source.c_str(), source.size(), ret.name.c_str()) != 0) {
+		std::string error = lua_isstring(L, -1) ? lua_tostring(L, -1) : "unknown error";
+		lua_pop(L, 1);
+		throw lua::lua_exception("Failed to load script: " + script + ": " + error);
+	}
+#if LUA_VERSION_NUM >= 503
+	int dump_ret = lua_dump(L, &chunk_writer, &ret.bytecode, 0);
+#else
+	int dump_ret = lua_dump(L, &chunk_writer, &ret.bytecode);
+#endif
+	lua_pop(L, 1);
+	if (dump_ret != 0) {
+		// Not fatal: we can still load the source in every state
+		ret.bytecode = source;
+		return ret;
+	}
+
+	if (!cache_file.empty()) {
+		try {
+			boost::filesystem::create_directories(cache_file.parent_path());
+			std::string tmp = cache_file.string() + ".tmp";
+			{
+				std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+				out.write(ret.bytecode.c_str(), ret.bytecode.size());
+				if (!out.good())
+					throw lua::lua_exception("Failed to write " + tmp);
+			}
+			boost::filesystem::rename(tmp, cache_file);
+		} catch (const std::exception &e) {
+			NSC_DEBUG_MSG("Failed to cache compiled script " + script + ": " + utf8::utf8_from_native(e.what()));
+		}
+	}
+	return ret;
+}
+
+int lua::chunk::load(lua_State *L) const {
+	return luaL_loadbuffer(L, bytecode.c_str(), bytecode.size(), name.c_str());
+}
+
+bool lua::pooled_state::find(const std::string &type, const std::string &command, lua_traits::function &function) const {
+	function_map::const_iterator it = functions.find(make_key(type, command));
+	if (it == functions.end())
+		return false;
+	function = it->second;
+	return true;
+}
+
+lua::state_pool::state_pool(pooled_state *primary, unsigned int max_size, initializer_type initializer)
+	: max_size_(max_size == 0 ? 1 : max_size)
+	, initializer_(initializer)
+	, pending_(0) {
+	boost::shared_ptr<pooled_state> p(primary);
+	states_.push_back(p);
+	idle_.push_back(primary);
+}
+
+lua::pooled_state* lua::state_pool::acquire() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	while (idle_.empty()) {
+		if (states_.size() + pending_ < max_size_) {
+			// Grow the pool: the script is run outside the lock as it can take a while
+			pending_++;
+			lock.unlock();
+			boost::shared_ptr<pooled_state> state;
+			try {
+				state.reset(new pooled_state());
+				initializer_(*state);
+			} catch (const std::exception &e) {
+				NSC_LOG_ERROR("Failed to create additional lua state: " + utf8::utf8_from_native(e.what()));
+				state.reset();
+			}
+			lock.lock();
+			pending_--;
+			if (state) {
+				states_.push_back(state);
+				return state.get();
+			}
+			// Don't try again: use what we have
+			max_size_ = static_cast<unsigned int>(states_.size());
+			continue;
+		}
+		cond_.wait(lock);
+	}
+	pooled_state *state = idle_.front();
+	idle_.pop_front();
+	return state;
+}
+
+void lua::state_pool::release(pooled_state *state) {
+	lua_settop(state->L, 0);
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	idle_.push_front(state);
+	cond_.notify_one();
+}
+
+std::list<lua_State*> lua::state_pool::get_secondary_states() {
+	std::list<lua_State*> ret;
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	BOOST_FOREACH(const boost::shared_ptr<pooled_state> &s, states_) {
+		if (!s->primary)
+			ret.push_back(s->L);
+	}
+	return ret;
+}
+
+unsigned int lua::state_pool::size() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	return static_cast<unsigned int>(states_.size());
+}
@@ -15,6 +15,7 @@
 
 #include <lua/lua_cpp.hpp>
 #include <lua/lua_script.hpp>
+#include <lua/lua_pool.hpp>
 
 const std::string lua::lua_traits::user_data_tag = "nscp.userdata.info";
 
@@ -176,6 +177,15 @@ const Luna<lua::core_wrapper>::PropertyType lua::core_wrapper::Properties[] = {
 lua::registry_wrapper::registry_wrapper(lua_State *L, bool) : isExisting(false) {
 	lua::lua_wrapper instance(L);
 	info = instance.get_userdata<script_information*>(lua::lua_traits::user_data_tag);
+	state = instance.get_userdata<pooled_state*>(lua::pooled_state::user_data_tag);
+}
+
+void lua::registry_wrapper::register_command(const std::string type, const std::string &command, const std::string &description, const lua_traits::function &function) {
+	// Every state in the pool runs the script but only the primary one registers the command with the core
+	if (state)
+		state->functions[pooled_state::make_key(type, command)] = function;
+	if (!state || state->primary)
+		info->register_command(type, command, description, function);
 }
 
 boost::optional<int> read_registration(lua::lua_wrapper &lua_instance, std::string &command, lua::lua_traits::function &fun, std::string &description) {
@@ -210,7 +220,7 @@ int lua::registry_wrapper::register_function(lua_State *L) {
 
 	if (description.empty())
 		description = "Lua script: " + command;
-	info->register_command(scripts::nscp::tags::query_tag, command, description, fundata);
+	register_command(scripts::nscp::tags::query_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::register_simple_function(lua_State *L) {
@@ -224,7 +234,7 @@ int lua::registry_wrapper::register_simple_function(lua_State *L) {
 
 	if (description.empty())
 		description = "Lua script: " + command;
-	info->register_command(scripts::nscp::tags::simple_query_tag, command, description, fundata);
+	register_command(scripts::nscp::tags::simple_query_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::register_cmdline(lua_State *L) {
@@ -239,7 +249,7 @@ int lua::registry_wrapper::register_simple_cmdline(lua_State *L) {
 	boost::optional<int> error = read_registration(lua_instance, command, fundata, description);
 	if (error)
 		return *error;
-	info->register_command(scripts::nscp::tags::simple_exec_tag, command, description, fundata);
+	register_command(scripts::nscp::tags::simple_exec_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::subscription(lua_State *L) {
@@ -254,7 +264,7 @@ int lua::registry_wrapper::simple_subscription(lua_State *L) {
 	boost::optional<int> error = read_registration(lua_instance, command, fundata, description);
 	if (error)
 		return *error;
-	info->register_command("simple_submit", command, description, fundata);
+	register_command("simple_submit", command, description, fundata);
 	return lua_instance.size();
 }
 
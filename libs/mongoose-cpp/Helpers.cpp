@@ -1,6 +1,7 @@
 #include "Helpers.h"
 
 #include <char_buffer.hpp>
+#include <zip/miniz.hpp>
 
 #include "ext/mongoose.h"
 
@@ -21,4 +22,40 @@ namespace Mongoose
 		mg_base64_decode(src.get_t<unsigned char*>(), static_cast<int>(str.size()), dst.get());
 		return std::string(dst.get());
 	}
+
+	static void append_le32(std::string &out, mz_ulong value) {
+		for (int i = 0; i < 4; i++) {
+			out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+		}
+	}
+
+	// gzip (RFC 1952) i.e. a raw deflate stream with a minimal header and a crc/size trailer
+	bool Helpers::gzip(const std::string &data, std::string &out) {
+		static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+		std::size_t len = 0;
+		int flags = tdefl_create_comp_flags_from_zip_params(MZ_DEFAULT_LEVEL, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+		void *buf = tdefl_compress_mem_to_heap(data.c_str(), data.size(), &len, flags);
+		if (buf == NULL) {
+			return false;
+		}
+		out.reserve(sizeof(header) + len + 8);
+		out.assign(header, sizeof(header));
+		out.append(static_cast<const char*>(buf), len);
+		mz_free(buf);
+		append_le32(out, mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char*>(data.c_str()), data.size()));
+		append_le32(out, static_cast<mz_ulong>(data.size()));
+		return true;
+	}
+
+	// HTTP "deflate" is a zlib (RFC 1950) stream
+	bool Helpers::deflate(const std::string &data, std::string &out) {
+		mz_ulong len = mz_compressBound(static_cast<mz_ulong>(data.size()));
+		out.resize(len);
+		if (mz_compress2(reinterpret_cast<unsigned char*>(&out[0]), &len, reinterpret_cast<const unsigned char*>(data.c_str()), static_cast<mz_ulong>(data.size()), MZ_DEFAULT_LEVEL) != MZ_OK) {
+			out.clear();
+			return false;
+		}
+		out.resize(len);
+		return true;
+	}
 }
@@ -12,5 +12,7 @@ namespace Mongoose
 	struct NSCAPI_EXPORT Helpers {
 		static std::string encode_b64(std::string &str);
 		static std::string decode_b64(std::string &str);
+		static bool gzip(const std::string &data, std::string &out);
+		static bool deflate(const std::string &data, std::string &out);
 	};
 }
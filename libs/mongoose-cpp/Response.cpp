@@ -1,8 +1,12 @@
 #include "Response.h"
+#include "Helpers.h"
 
+#include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
 
+#include <cstdlib>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 
@@ -27,8 +31,92 @@ namespace Mongoose
     }
 
     string Response::getData()
+    {
+        return render(getBody());
+    }
+
+    string Response::getData(content_encoding encoding, std::size_t min_size)
     {
         string body = getBody();
+        if (body.size() < min_size || !is_compressible()) {
+            return render(body);
+        }
+        setHeader("Vary", "Accept-Encoding");
+        if (encoding == encoding_gzip && gzip_body) {
+            setHeader("Content-Encoding", "gzip");
+            headers.erase("Content-Length");
+            return render(*gzip_body);
+        }
+        string compressed;
+        if (encoding == encoding_gzip && Helpers::gzip(body, compressed) && compressed.size() < body.size()) {
+            setHeader("Content-Encoding", "gzip");
+        } else if (encoding == encoding_deflate && Helpers::deflate(body, compressed) && compressed.size() < body.size()) {
+            setHeader("Content-Encoding", "deflate");
+        } else {
+            return render(body);
+        }
+        headers.erase("Content-Length");
+        return render(compressed);
+    }
+
+    void Response::setGzipBody(boost::shared_ptr<const std::string> body)
+    {
+        gzip_body = body;
+    }
+
+    // Images, woff fonts (and anything already encoded) do not compress
+    bool Response::is_compressible()
+    {
+        if (hasHeader("Content-Encoding")) {
+            return false;
+        }
+        header_type::const_iterator cit = headers.find("Content-Type");
+        if (cit == headers.end() || cit->second == "image/svg+xml") {
+            return true;
+        }
+        return !boost::algorithm::starts_with(cit->second, "image/") && !boost::algorithm::starts_with(cit->second, "font/woff");
+    }
+
+    content_encoding Response::negotiate_encoding(const std::string &accept_encoding)
+    {
+        double gzip = -1.0, deflate = -1.0, any = -1.0;
+        std::vector<std::string> items;
+        boost::algorithm::split(items, accept_encoding, boost::algorithm::is_any_of(","));
+        BOOST_FOREACH(const std::string &item, items) {
+            std::string::size_type pos = item.find(';');
+            std::string name = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(item.substr(0, pos)));
+            double q = 1.0;
+            if (pos != std::string::npos) {
+                std::string param = boost::algorithm::trim_copy(item.substr(pos + 1));
+                if (boost::algorithm::starts_with(param, "q=")) {
+                    q = strtod(param.c_str() + 2, NULL);
+                }
+            }
+            if (name == "gzip" || name == "x-gzip") {
+                gzip = q;
+            } else if (name == "deflate") {
+                deflate = q;
+            } else if (name == "*") {
+                any = q;
+            }
+        }
+        if (gzip < 0) {
+            gzip = any;
+        }
+        if (deflate < 0) {
+            deflate = any;
+        }
+        if (gzip > 0 && gzip >= deflate) {
+            return encoding_gzip;
+        }
+        if (deflate > 0) {
+            return encoding_deflate;
+        }
+        return encoding_identity;
+    }
+
+    string Response::render(const std::string &body)
+    {
         ostringstream data;
 
         data << "HTTP/1.1 " << code << " " << reason << "\r\n";
@@ -5,10 +5,13 @@
 #pragma warning(disable:4251)
 #endif
 
+#include <boost/shared_ptr.hpp>
+
 #include <map>
 #include <string>
 
 #define HTTP_OK 200
+#define HTTP_NOT_MODIFIED 304
 #define HTTP_BAD_REQUEST 400
 #define HTTP_NOT_FOUND 404
 #define HTTP_FORBIDDEN 403
@@ -16,6 +19,7 @@
 #define HTTP_SERVICE_UNAVALIBLE 503
 
 #define REASON_OK "OK"
+#define REASON_NOT_MODIFIED "Not Modified"
 #define REASON_SERVER_ERROR "Error"
 #define REASON_NOT_FOUND "Not Found"
 #define REASON_BAD_REQUEST "Bad Request"
@@ -29,6 +33,12 @@
  */
 namespace Mongoose
 {
+	enum content_encoding {
+		encoding_identity,
+		encoding_gzip,
+		encoding_deflate
+	};
+
     class NSCAPI_EXPORT Response 
     {
         public:
@@ -61,6 +71,34 @@ namespace Mongoose
              */
             virtual std::string getData();
 
+            /**
+             * Get the data of the response with the body compressed using
+             * the given encoding (if it is worth compressing)
+             *
+             * @param encoding the encoding accepted by the client
+             * @param min_size smaller bodies are not compressed
+             *
+             * @return string the response data
+             */
+            std::string getData(content_encoding encoding, std::size_t min_size);
+
+            /**
+             * Sets a gzip compressed copy of the body which is sent (instead
+             * of compressing the body) to clients accepting gzip
+             *
+             * @param body the compressed body
+             */
+            void setGzipBody(boost::shared_ptr<const std::string> body);
+
+            /**
+             * Select the encoding to use from an Accept-Encoding header
+             *
+             * @param accept_encoding the header value
+             *
+             * @return content_encoding the preferred encoding (gzip over deflate)
+             */
+            static content_encoding negotiate_encoding(const std::string &accept_encoding);
+
             /**
              * Gets the response body
              *
@@ -97,9 +135,13 @@ namespace Mongoose
 				return headers;
 			}
         private:
+			bool is_compressible();
+			std::string render(const std::string &body);
+
 			int code;
 			std::string reason;
 			header_type headers;
 			header_type cookies;
+			boost::shared_ptr<const std::string> gzip_body;
 	};
 }
@@ -3,6 +3,7 @@
 #include "Request.h"
 #include "Response.h"
 #include "Controller.h"
+#include "WorkerPool.h"
 
 #include "dll_defines.hpp"
 
@@ -47,6 +48,32 @@ namespace Mongoose {
 		*/
 		virtual void setSsl(const char *certificate) = 0;
 
+		/**
+		* Setup persistent connections
+		*
+		* @param timeout seconds an idle connection is kept open (0 closes the connection after each response)
+		* @param max_requests the number of requests served on a connection before it is closed
+		*/
+		virtual void setKeepAlive(int timeout, int max_requests) = 0;
+
+		/**
+		* Setup response compression (gzip or deflate depending on what the client accepts)
+		*
+		* @param enable true to compress responses
+		* @param min_size responses with a smaller body are sent as is
+		*/
+		virtual void setCompression(bool enable, std::size_t min_size) = 0;
+
+		/**
+		* Time requests spend queued before a worker picks them up
+		*/
+		virtual const metrics::latency_histogram& get_queue_wait() const = 0;
+
+		/**
+		* Counters from the worker pool
+		*/
+		virtual worker_stats get_worker_stats() const = 0;
+
 		/**
 		 * Does the server handles url?
 		 */
@@ -6,36 +6,13 @@
 #include <boost/foreach.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <string>
 
 using namespace std;
 using namespace Mongoose;
 
-struct oubound_frame {
-	job_id id;
-	ServerImpl *server;
-	char *data;
-	std::size_t len;
-};
-
-struct udt {
-	ServerImpl *server;
-	unsigned long job_id;
-	unsigned long magic;
-
-	udt(ServerImpl *server)
-		: server(server)
-		, job_id(0)
-		, magic(123456789) 
-	{}
-	~udt() {
-		server = NULL;
-		job_id = 0;
-		magic = 0;
-	}
-};
-
 void sendStockResponse(struct mg_connection *connection, int code, std::string reason, std::string msg) {
 	StreamResponse response;
 	response.setCode(code, reason);
@@ -46,16 +23,13 @@ void sendStockResponse(struct mg_connection *connection, int code, std::string r
 }
 
 
-void on_wake_up(struct mg_connection *connection, int, void *ev_data) {
-	if (ev_data == NULL || connection->user_data == NULL) {
+// Called (from the poll thread) for each connection, the first call delivers all pending replies
+void on_wake_up(struct mg_connection *, int, void *ev_data) {
+	if (ev_data == NULL) {
 		return;
 	}
-	oubound_frame *frame = reinterpret_cast<oubound_frame*>(ev_data);
-	if (frame->server->execute_reply_async(frame->id, frame->data, frame->len)) {
-		char *tmp = frame->data;
-		frame->data = NULL;
-		delete[] tmp;
-	}
+	ServerImpl *server = *reinterpret_cast<ServerImpl**>(ev_data);
+	server->deliver_replies();
 }
 job_id job_index = 1;
 
@@ -72,36 +46,21 @@ boost::posix_time::ptime now() {
 	return boost::get_system_time();
 }
 
-void ServerImpl::request_thread_proc() {
+void ServerImpl::execute_job(request_job &job) {
+	// The connection waits for this reply (before reading more requests) so we have to send one no matter what
 	try {
-		job_queue_type::value_type instance;
-		while (!stopped) {
-			instance = job_queue_.pop();
-			if (!instance) {
-				boost::unique_lock<boost::mutex> lock(idle_thread_mutex_);
-				idle_thread_cond_.wait(lock);
-				continue;
-			}
-
-			try {
-				if (instance->is_late(now())) {
-					instance->toLate();
-				} else {
-					instance->run();
-				}
-			} catch (const boost::thread_interrupted &) {
-				if (stopped) {
-					return;
-				}
-				continue;
-			} catch (...) {
-				// Log error
-				continue;
-			}
+		if (job.is_late(now())) {
+			job.toLate();
+		} else {
+			job.run();
 		}
 	} catch (const boost::thread_interrupted &) {
-	} catch (const std::exception &) {
+		job.serverError("Server is shutting down");
+		throw;
+	} catch (const std::exception &e) {
+		job.serverError(std::string("Failed to process request: ") + e.what());
 	} catch (...) {
+		job.serverError("Failed to process request");
 	}
 }
 
@@ -111,6 +70,10 @@ namespace Mongoose
         : stopped(false)
 		, destroyed(true)
 		, port(port_)
+		, keep_alive_timeout_(15)
+		, max_keep_alive_requests_(100)
+		, compress_(true)
+		, compress_min_size_(512)
     {
 		memset(&mgr, 0, sizeof(struct mg_mgr));
 		mg_mgr_init(&mgr, NULL);
@@ -126,29 +89,137 @@ namespace Mongoose
 		controllers.clear();
     }
 
-	void ServerImpl::request_reply_async(job_id id, std::string data) {
-		oubound_frame frame;
-		frame.server = this;
-		frame.id = id;
-		frame.len = data.size();
-		frame.data = new char[frame.len + 10];
-		memcpy(frame.data, data.c_str(), frame.len);
-		mg_broadcast(&mgr, on_wake_up, (void*)&frame, sizeof(frame));
+	// Called by the workers: replies are batched so the poll thread is woken once for all replies queued since it last ran
+	void ServerImpl::request_reply_async(job_id id, std::string &data) {
+		bool wake = false;
+		{
+			boost::unique_lock<boost::mutex> lock(replies_mutex_);
+			wake = replies_.empty();
+			replies_.push_back(std::make_pair(id, std::string()));
+			replies_.back().second.swap(data);
+		}
+		if (wake) {
+			ServerImpl *self = this;
+			mg_broadcast(&mgr, on_wake_up, (void*)&self, sizeof(self));
+		}
 	}
 
-	bool ServerImpl::execute_reply_async(job_id id, const void *buf, std::size_t len) {
-		struct mg_connection *c;
-		if (buf == NULL) {
-			return false;
+	void ServerImpl::deliver_replies() {
+		reply_list replies;
+		{
+			boost::unique_lock<boost::mutex> lock(replies_mutex_);
+			if (replies_.empty()) {
+				return;
+			}
+			replies.swap(replies_);
 		}
-		for (c = mg_next(&mgr, NULL); c != NULL; c = mg_next(&mgr, c)) {
-			if (c->user_data != NULL && ((udt*)c->user_data)->job_id == id) {
-				mg_send(c, buf, static_cast<int>(len));
-				c->flags |= MG_F_SEND_AND_CLOSE;
-				return true;
+		boost::unordered_map<job_id, std::string*> pending;
+		BOOST_FOREACH(reply_list::value_type &r, replies) {
+			pending[r.first] = &r.second;
+		}
+		// Replies to connections which have since been closed are dropped
+		for (struct mg_connection *c = mg_next(&mgr, NULL); c != NULL && !pending.empty(); c = mg_next(&mgr, c)) {
+			if (c->listener == NULL || c->user_data == NULL) {
+				continue;
+			}
+			connection_data *data = (connection_data*)c->user_data;
+			boost::unordered_map<job_id, std::string*>::iterator it = pending.find(data->job);
+			if (data->job == 0 || it == pending.end()) {
+				continue;
 			}
+			mg_send(c, it->second->c_str(), static_cast<int>(it->second->size()));
+			pending.erase(it);
+			data->job = 0;
+			next_request(c, data);
+		}
+	}
+
+	// Called (from the poll thread) when the connection is done with a request
+	void ServerImpl::next_request(struct mg_connection *connection, connection_data *data) {
+		if (data->close_after) {
+			data->backlog.clear();
+			connection->flags |= MG_F_SEND_AND_CLOSE;
+			return;
+		}
+		if (!data->backlog.empty()) {
+			request_job job = data->backlog.front();
+			data->backlog.pop_front();
+			dispatch(connection, data, job);
+			return;
+		}
+		parse_pending(connection, data);
+	}
+
+	void ServerImpl::dispatch(struct mg_connection *connection, connection_data *data, request_job job) {
+		data->requests++;
+		if (!job.is_keep_alive() || keep_alive_timeout_ <= 0 || data->requests >= max_keep_alive_requests_) {
+			data->close_after = true;
+			job.set_keep_alive(false);
+		}
+		if (!job.has_controller()) {
+			// Answered right away, this might be called while mongoose is still parsing the request so
+			// the pending data is left for the next poll.
+			std::string reply = job.notFound();
+			mg_send(connection, reply.c_str(), static_cast<int>(reply.size()));
+			if (data->close_after) {
+				data->backlog.clear();
+				connection->flags |= MG_F_SEND_AND_CLOSE;
+			} else if (!data->backlog.empty()) {
+				next_request(connection, data);
+			}
+			return;
+		}
+		if (job_index < 100 || job_index > 1000000) {
+			job_index = 100;
+		} else {
+			job_index++;
+		}
+		job.set_id(job_index);
+		data->job = job_index;
+		if (!workers_.push(job)) {
+			data->job = 0;
+			sendStockResponse(connection, HTTP_SERVER_ERROR, REASON_SERVER_ERROR, "Failed to process request");
+		}
+	}
+
+	// Requests pipelined by the client (in the same packet as a previous request) are left in the receive buffer by
+	// mongoose until more data arrives, so we feed the data mongoose has not yet seen back to the parser.
+	void ServerImpl::parse_pending(struct mg_connection *connection, connection_data *data) {
+		if (data->job != 0 || !data->backlog.empty() || data->full || (connection->flags & (MG_F_SEND_AND_CLOSE | MG_F_CLOSE_IMMEDIATELY)) != 0) {
+			return;
+		}
+		if (connection->recv_mbuf.len > data->received && connection->proto_handler != NULL) {
+			int len = static_cast<int>(connection->recv_mbuf.len - data->received);
+			connection->proto_handler(connection, MG_EV_RECV, &len);
+		}
+	}
+
+	void ServerImpl::close_idle(struct mg_connection *connection, connection_data *data) {
+		if (data->job != 0 || !data->backlog.empty() || (connection->flags & MG_F_SEND_AND_CLOSE) != 0) {
+			return;
 		}
-		return false;
+		int timeout = keep_alive_timeout_ > 0 ? keep_alive_timeout_ : 30;
+		if (connection->send_mbuf.len == 0 && time(NULL) - connection->last_io_time > timeout) {
+			connection->flags |= MG_F_CLOSE_IMMEDIATELY;
+		}
+	}
+
+	void ServerImpl::setKeepAlive(int timeout, int max_requests) {
+		keep_alive_timeout_ = timeout;
+		max_keep_alive_requests_ = max_requests > 0 ? max_requests : 1;
+	}
+
+	void ServerImpl::setCompression(bool enable, std::size_t min_size) {
+		compress_ = enable;
+		compress_min_size_ = min_size;
+	}
+
+	const metrics::latency_histogram& ServerImpl::get_queue_wait() const {
+		return workers_.get_queue_wait();
+	}
+
+	worker_stats ServerImpl::get_worker_stats() const {
+		return workers_.get_stats();
 	}
 
 #if MG_ENABLE_SSL
@@ -169,10 +240,7 @@ namespace Mongoose
 		stopped = false;
 		mg_set_protocol_http_websocket(server_connection);
 
-		for (std::size_t i = 0; i < thread_count; i++) {
-			boost::function<void()> f = boost::bind(&ServerImpl::request_thread_proc, this);
-			threads_.createThread(f);
-		}
+		workers_.start(thread_count, boost::bind(&ServerImpl::execute_job, this, _1));
 		mg_start_thread(server_poll, this);
     }
 
@@ -182,6 +250,8 @@ namespace Mongoose
 			destroyed = false;
         while (!stopped) {
 			mg_mgr_poll(&mgr, 1000);
+			// Wake the workers for all requests received in this poll
+			workers_.flush();
         }
 
         destroyed = true;
@@ -190,8 +260,7 @@ namespace Mongoose
 
     void ServerImpl::stop()
     {
-		threads_.interruptThreads();
-		threads_.waitForThreads();
+		workers_.stop();
         stopped = true;
         while (!destroyed) {
 			boost::this_thread::sleep(boost::posix_time::milliseconds(100));
@@ -203,25 +272,31 @@ namespace Mongoose
     }
 
 	void ServerImpl::event_handler(struct mg_connection *connection, int ev, void *ev_data) {
-		if (connection->user_data != NULL) {
-			if (ev == MG_EV_CLOSE) {
-				udt *data = (udt*)connection->user_data;
-				connection->user_data = NULL;
-				if (data->magic == 123456789) {
-					delete data;
-				}
-			} else if (ev == MG_EV_HTTP_REQUEST) {
-				udt *data = new udt((ServerImpl*)connection->user_data);
-				connection->user_data = data;
-				if (job_index < 100 || job_index > 1000000) {
-					job_index = 100;
-				} else {
-					job_index++;
-				}
-				data->job_id = job_index;
-				struct http_message *message = (struct http_message *) ev_data;
-				data->server->onHttpRequest(connection, message, data->job_id);
-			}
+		if (connection->user_data == NULL || connection->listener == NULL) {
+			return;
+		}
+		if (ev == MG_EV_ACCEPT) {
+			// Accepted connections inherit the user data (server) from the listener
+			connection->user_data = new connection_data((ServerImpl*)connection->user_data);
+			return;
+		}
+		connection_data *data = (connection_data*)connection->user_data;
+		if (data->magic != 123456789) {
+			return;
+		}
+		if (ev == MG_EV_CLOSE) {
+			connection->user_data = NULL;
+			delete data;
+		} else if (ev == MG_EV_POLL) {
+			data->server->parse_pending(connection, data);
+			data->server->close_idle(connection, data);
+		} else if (ev == MG_EV_RECV) {
+			// Keep track of what mongoose has seen (it only counts data towards the current request)
+			data->received += *(int*)ev_data;
+		} else if (ev == MG_EV_HTTP_REQUEST) {
+			data->received = 0;
+			struct http_message *message = (struct http_message *) ev_data;
+			data->server->onHttpRequest(connection, message);
 		}
 	}
 
@@ -248,7 +323,31 @@ namespace Mongoose
 
 	}
 
-    void ServerImpl::onHttpRequest(struct mg_connection *connection, struct http_message *message, job_id job_id) {
+	bool is_keep_alive(struct http_message *message) {
+		struct mg_str *hdr = mg_get_http_header(message, "Connection");
+		if (hdr != NULL) {
+			if (mg_vcasecmp(hdr, "close") == 0) {
+				return false;
+			}
+			if (mg_vcasecmp(hdr, "keep-alive") == 0) {
+				return true;
+			}
+		}
+		return mg_vcmp(&message->proto, "HTTP/1.1") == 0;
+	}
+
+    void ServerImpl::onHttpRequest(struct mg_connection *connection, struct http_message *message) {
+		connection_data *data = (connection_data*)connection->user_data;
+		bool keep_alive = is_keep_alive(message);
+		if (!data->admit(keep_alive, keep_alive_timeout_ > 0 ? max_keep_alive_requests_ : 1)) {
+			// The connection is closed once the requests already accepted have been answered
+			return;
+		}
+		content_encoding encoding = encoding_identity;
+		struct mg_str *accept_encoding = mg_get_http_header(message, "Accept-Encoding");
+		if (compress_ && accept_encoding != NULL) {
+			encoding = Response::negotiate_encoding(std::string(accept_encoding->p, accept_encoding->len));
+		}
 
 		bool is_ssl = (connection->flags&MG_F_SSL) == MG_F_SSL;
 		std::string url = std::string(message->uri.p, message->uri.len);
@@ -261,21 +360,20 @@ namespace Mongoose
 			}
 		}
 
+		Controller *controller = NULL;
 		BOOST_FOREACH(Controller *ctrl, controllers) {
 			if (ctrl->handles(method, url)) {
-
-				std::string ip = std::string(inet_ntoa(connection->sa.sin.sin_addr));
-				Request request = build_request(ip, message, is_ssl, method);
-				request_job job(this, ctrl, request, now(), job_id);
-
-				if (!job_queue_.push(job)) {
-					sendStockResponse(connection, HTTP_SERVER_ERROR, REASON_SERVER_ERROR, "Failed to process request");
-				}
-				idle_thread_cond_.notify_one();
-				return;
+				controller = ctrl;
+				break;
 			}
 		}
-		sendStockResponse(connection, HTTP_NOT_FOUND, REASON_NOT_FOUND, "Document not found");
+		std::string ip = std::string(inet_ntoa(connection->sa.sin.sin_addr));
+		request_job job(this, controller, build_request(ip, message, is_ssl, method), now(), keep_alive, encoding);
+		if (data->job != 0 || !data->backlog.empty()) {
+			data->backlog.push_back(job);
+			return;
+		}
+		dispatch(connection, data, job);
     }
 
 
@@ -288,12 +386,12 @@ namespace Mongoose
 		if (server != NULL && controller != NULL) {
 			Response *resp = controller->handleRequest(request);
 			if (resp) {
-				server->request_reply_async(id, resp->getData());
+				reply(*resp);
 				delete resp;
 			} else {
 				StreamResponse response;
 				response.setCodeServerError("No response from command");
-				server->request_reply_async(id, response.getData());
+				reply(response);
 			}
 		}
 	}
@@ -302,7 +400,30 @@ namespace Mongoose
 		StreamResponse response;
 		response.setCode(HTTP_SERVICE_UNAVALIBLE, REASON_SERVICE_UNAVALIBLE);
 		response.append("Server is overloaded, please try later");
-		server->request_reply_async(id, response.getData());
+		reply(response);
+	}
+
+	void request_job::serverError(const std::string &message) {
+		StreamResponse response;
+		response.setCodeServerError(message);
+		reply(response);
+	}
+
+	// Response to a request no controller handles (sent directly from the poll thread)
+	std::string request_job::notFound() {
+		StreamResponse response;
+		response.setCodeNotFound("Document not found");
+		return render(response);
+	}
+
+	void request_job::reply(Response &response) {
+		std::string data = render(response);
+		server->request_reply_async(id, data);
+	}
+
+	std::string request_job::render(Response &response) {
+		response.setHeader("Connection", keep_alive ? "keep-alive" : "close");
+		return response.getData(encoding, server->get_compress_min_size());
 	}
 
 }
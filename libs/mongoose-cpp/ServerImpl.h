@@ -4,16 +4,16 @@
 #include "Request.h"
 #include "Response.h"
 #include "Controller.h"
+#include "WorkerPool.h"
 
 #include "ext/mongoose.h"
 
-#include <has-threads.hpp>
-#include <threads/queue.hpp>
-
 #include "dll_defines.hpp"
 
 #include <boost/thread.hpp>
 
+#include <deque>
+#include <string>
 #include <vector>
 
 /**
@@ -31,18 +31,99 @@ namespace Mongoose
 		Controller *controller;
 		Request request;
 		boost::posix_time::ptime time;
-		int id;
+		job_id id;
+		bool keep_alive;
+		content_encoding encoding;
 
 	public:
-		request_job(ServerImpl *server, Controller *controller, Request request, boost::posix_time::ptime time, int id)
+		request_job(ServerImpl *server, Controller *controller, Request request, boost::posix_time::ptime time, bool keep_alive, content_encoding encoding)
 			: server(server)
 			, controller(controller)
 			, request(request)
 			, time(time)
-			, id(id) {}
+			, id(0)
+			, keep_alive(keep_alive)
+			, encoding(encoding) {}
 		bool is_late(boost::posix_time::ptime now);
 		void run();
 		void toLate();
+		void serverError(const std::string &message);
+		std::string notFound();
+
+		void set_id(job_id id_) {
+			id = id_;
+		}
+		job_id get_id() const {
+			return id;
+		}
+		bool has_controller() const {
+			return controller != NULL;
+		}
+		bool is_keep_alive() const {
+			return keep_alive;
+		}
+		void set_keep_alive(bool keep_alive_) {
+			keep_alive = keep_alive_;
+		}
+	private:
+		void reply(Response &response);
+		std::string render(Response &response);
+	};
+
+	/**
+	 * State of an accepted connection (owned by the poll thread)
+	 *
+	 * Only one request per connection is processed at a time, requests pipelined
+	 * by the client are kept in the backlog so responses are sent in order.
+	 * Queued requests count towards the keep alive limit and the backlog is bounded,
+	 * once either is reached the connection is closed after the accepted requests.
+	 */
+	struct connection_data {
+		static const std::size_t max_backlog = 32;
+
+		ServerImpl *server;
+		job_id job;
+		bool close_after;
+		bool full;
+		int requests;
+		std::size_t received;
+		std::deque<request_job> backlog;
+		unsigned long magic;
+
+		connection_data(ServerImpl *server)
+			: server(server)
+			, job(0)
+			, close_after(false)
+			, full(false)
+			, requests(0)
+			, received(0)
+			, magic(123456789)
+		{}
+
+		/**
+		 * Decides if a new request on this connection is processed
+		 *
+		 * @param keep_alive the client wants the connection kept open, cleared when this is the last request accepted
+		 * @param max_requests the maximum number of requests (processed and queued) on a connection
+		 *
+		 * @return bool false if the request should be dropped
+		 */
+		bool admit(bool &keep_alive, int max_requests) {
+			if (full) {
+				return false;
+			}
+			bool queued = job != 0 || !backlog.empty();
+			if (!keep_alive || requests + static_cast<int>(backlog.size()) + 1 >= max_requests || (queued && backlog.size() + 1 >= max_backlog)) {
+				full = true;
+				keep_alive = false;
+			}
+			return true;
+		}
+		~connection_data() {
+			server = NULL;
+			job = 0;
+			magic = 0;
+		}
 	};
 
 
@@ -85,7 +166,7 @@ namespace Mongoose
 			 */
 			static void event_handler(struct mg_connection *connection, int ev, void *ev_data);
 
-			void onHttpRequest(struct mg_connection *connection, struct http_message *message, job_id job_id);
+			void onHttpRequest(struct mg_connection *connection, struct http_message *message);
 
 
             /**
@@ -106,6 +187,13 @@ namespace Mongoose
 #if MG_ENABLE_SSL
 			void setSsl(const char *certificate);
 #endif
+
+			void setKeepAlive(int timeout, int max_requests);
+			void setCompression(bool enable, std::size_t min_size);
+			std::size_t get_compress_min_size() const {
+				return compress_min_size_;
+			}
+
             /**
              * Polls the server
              */
@@ -116,10 +204,19 @@ namespace Mongoose
              */
             bool handles(std::string method, std::string url);
 
-			void request_reply_async(job_id id, std::string data);
-			bool execute_reply_async(job_id id, const void *buf, std::size_t len);
+			const metrics::latency_histogram& get_queue_wait() const;
+			worker_stats get_worker_stats() const;
+
+			void request_reply_async(job_id id, std::string &data);
+			void deliver_replies();
+
+			void execute_job(request_job &job);
+		private:
+			void dispatch(struct mg_connection *connection, connection_data *data, request_job job);
+			void next_request(struct mg_connection *connection, connection_data *data);
+			void parse_pending(struct mg_connection *connection, connection_data *data);
+			void close_idle(struct mg_connection *connection, connection_data *data);
 
-			void request_thread_proc();
 		protected:
 			std::string port;
 			struct mg_mgr mgr;
@@ -130,11 +227,17 @@ namespace Mongoose
 
             std::vector<Controller *> controllers;
 
-			has_threads threads_;
-			typedef nscp_thread::safe_queue<request_job, std::queue<request_job> > job_queue_type;
-			job_queue_type job_queue_;
-			boost::mutex idle_thread_mutex_;
-			boost::condition_variable idle_thread_cond_;
+			worker_pool<request_job> workers_;
+
+			// Responses from the workers waiting for the poll thread
+			typedef std::vector<std::pair<job_id, std::string> > reply_list;
+			boost::mutex replies_mutex_;
+			reply_list replies_;
+
+			int keep_alive_timeout_;
+			int max_keep_alive_requests_;
+			bool compress_;
+			std::size_t compress_min_size_;
 
 	};
 }
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <has-threads.hpp>
+#include <metrics/latency_histogram.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace Mongoose
+{
+	struct worker_stats {
+		unsigned long long executed;
+		unsigned long long stolen;
+		unsigned long long wakeups;
+		std::size_t queued;
+		std::size_t threads;
+	};
+
+	/**
+	 * Fixed size pool of worker threads
+	 *
+	 * Each worker has its own queue (and lock) and jobs are handed out round robin so the
+	 * producer and the workers rarely contend. Idle workers steal (the oldest half of the)
+	 * jobs queued on other workers so a slow job does not hold up the jobs behind it.
+	 *
+	 * push() and flush() must be called from a single thread (the poll thread): jobs pushed
+	 * are not announced until flush() which wakes as many sleeping workers as there are new
+	 * jobs (at most) in one go.
+	 */
+	template<class Job>
+	class worker_pool : boost::noncopyable {
+	public:
+		typedef boost::function<void(Job&)> handler_type;
+
+	private:
+		struct entry {
+			Job job;
+			boost::posix_time::ptime queued;
+			entry(const Job &job, boost::posix_time::ptime queued) : job(job), queued(queued) {}
+		};
+		struct worker {
+			boost::mutex mutex;
+			std::deque<entry> jobs;
+		};
+		typedef boost::shared_ptr<worker> worker_type;
+
+		std::vector<worker_type> workers_;
+		has_threads threads_;
+		handler_type handler_;
+		boost::atomic<bool> stopped_;
+
+		boost::atomic<std::size_t> queued_;
+		std::size_t pending_;
+		std::size_t next_;
+
+		boost::mutex idle_mutex_;
+		boost::condition_variable idle_cond_;
+		std::size_t sleeping_;
+
+		metrics::latency_histogram queue_wait_;
+		boost::atomic<unsigned long long> executed_;
+		boost::atomic<unsigned long long> stolen_;
+		boost::atomic<unsigned long long> wakeups_;
+
+	public:
+		worker_pool()
+			: stopped_(true)
+			, queued_(0)
+			, pending_(0)
+			, next_(0)
+			, sleeping_(0)
+			, executed_(0)
+			, stolen_(0)
+			, wakeups_(0)
+		{}
+		~worker_pool() {
+			stop();
+		}
+
+		void start(std::size_t count, handler_type handler) {
+			if (count == 0) {
+				count = 1;
+			}
+			handler_ = handler;
+			stopped_ = false;
+			workers_.clear();
+			for (std::size_t i = 0; i < count; i++) {
+				workers_.push_back(worker_type(new worker()));
+			}
+			for (std::size_t i = 0; i < count; i++) {
+				boost::function<void()> f = boost::bind(&worker_pool::thread_proc, this, i);
+				threads_.createThread(f);
+			}
+		}
+
+		void stop() {
+			if (stopped_.exchange(true)) {
+				return;
+			}
+			{
+				boost::unique_lock<boost::mutex> lock(idle_mutex_);
+				idle_cond_.notify_all();
+			}
+			threads_.interruptThreads();
+			threads_.waitForThreads();
+		}
+
+		bool push(const Job &job) {
+			if (stopped_ || workers_.empty()) {
+				return false;
+			}
+			worker &w = *workers_[next_];
+			next_ = (next_ + 1) % workers_.size();
+			{
+				boost::unique_lock<boost::mutex> lock(w.mutex);
+				w.jobs.push_back(entry(job, boost::posix_time::microsec_clock::universal_time()));
+			}
+			queued_++;
+			pending_++;
+			return true;
+		}
+
+		void flush() {
+			if (pending_ == 0) {
+				return;
+			}
+			std::size_t count = pending_;
+			pending_ = 0;
+			boost::unique_lock<boost::mutex> lock(idle_mutex_);
+			if (sleeping_ == 0) {
+				return;
+			}
+			if (count >= sleeping_) {
+				wakeups_ += sleeping_;
+				idle_cond_.notify_all();
+				return;
+			}
+			wakeups_ += count;
+			for (std::size_t i = 0; i < count; i++) {
+				idle_cond_.notify_one();
+			}
+		}
+
+		const metrics::latency_histogram& get_queue_wait() const {
+			return queue_wait_;
+		}
+
+		worker_stats get_stats() const {
+			worker_stats ret;
+			ret.executed = executed_;
+			ret.stolen = stolen_;
+			ret.wakeups = wakeups_;
+			ret.queued = queued_;
+			ret.threads = workers_.size();
+			return ret;
+		}
+
+	private:
+		void thread_proc(std::size_t index) {
+			try {
+				while (!stopped_) {
+					boost::optional<entry> instance = take(index);
+					if (!instance) {
+						boost::unique_lock<boost::mutex> lock(idle_mutex_);
+						if (stopped_ || queued_ > 0) {
+							continue;
+						}
+						sleeping_++;
+						// Timed so a worker never sleeps on queued jobs for long should a wakeup be missed
+						idle_cond_.timed_wait(lock, boost::posix_time::seconds(1));
+						sleeping_--;
+						continue;
+					}
+					queue_wait_.record(boost::posix_time::microsec_clock::universal_time() - instance->queued);
+					try {
+						handler_(instance->job);
+					} catch (const boost::thread_interrupted &) {
+						if (stopped_) {
+							return;
+						}
+					} catch (...) {
+						// The handler is expected to deal with (and reply to) its own errors
+					}
+					executed_++;
+				}
+			} catch (const boost::thread_interrupted &) {
+			} catch (...) {
+			}
+		}
+
+		boost::optional<entry> take(std::size_t index) {
+			{
+				worker &w = *workers_[index];
+				boost::unique_lock<boost::mutex> lock(w.mutex);
+				if (!w.jobs.empty()) {
+					boost::optional<entry> ret = w.jobs.front();
+					w.jobs.pop_front();
+					queued_--;
+					return ret;
+				}
+			}
+			if (queued_ == 0) {
+				return boost::optional<entry>();
+			}
+			return steal(index);
+		}
+
+		// Moves the oldest half of another workers jobs to our queue and returns the first one
+		boost::optional<entry> steal(std::size_t index) {
+			for (std::size_t i = 1; i < workers_.size(); i++) {
+				worker &victim = *workers_[(index + i) % workers_.size()];
+				std::deque<entry> stolen;
+				{
+					boost::unique_lock<boost::mutex> lock(victim.mutex, boost::try_to_lock);
+					if (!lock.owns_lock() || victim.jobs.empty()) {
+						continue;
+					}
+					std::size_t count = (victim.jobs.size() + 1) / 2;
+					stolen.insert(stolen.end(), victim.jobs.begin(), victim.jobs.begin() + count);
+					victim.jobs.erase(victim.jobs.begin(), victim.jobs.begin() + count);
+				}
+				stolen_ += stolen.size();
+				boost::optional<entry> ret = stolen.front();
+				stolen.pop_front();
+				queued_--;
+				if (!stolen.empty()) {
+					worker &w = *workers_[index];
+					boost::unique_lock<boost::mutex> lock(w.mutex);
+					w.jobs.insert(w.jobs.end(), stolen.begin(), stolen.end());
+				}
+				return ret;
+			}
+			return boost::optional<entry>();
+		}
+	};
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ServerImpl.h"
+#include "StreamResponse.h"
+#include "Helpers.h"
+
+#include <zip/miniz.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+using namespace Mongoose;
+
+TEST(mongoose, negotiate_encoding) {
+	EXPECT_EQ(encoding_identity, Response::negotiate_encoding(""));
+	EXPECT_EQ(encoding_identity, Response::negotiate_encoding("identity"));
+	EXPECT_EQ(encoding_gzip, Response::negotiate_encoding("gzip, deflate, br"));
+	EXPECT_EQ(encoding_gzip, Response::negotiate_encoding("deflate,GZIP"));
+	EXPECT_EQ(encoding_gzip, Response::negotiate_encoding("x-gzip"));
+	EXPECT_EQ(encoding_deflate, Response::negotiate_encoding("deflate"));
+	EXPECT_EQ(encoding_deflate, Response::negotiate_encoding("gzip;q=0, deflate"));
+	EXPECT_EQ(encoding_deflate, Response::negotiate_encoding("gzip;q=0.5, deflate;q=1.0"));
+	EXPECT_EQ(encoding_gzip, Response::negotiate_encoding("gzip; q=0.8, deflate; q=0.8"));
+	EXPECT_EQ(encoding_gzip, Response::negotiate_encoding("*"));
+	EXPECT_EQ(encoding_deflate, Response::negotiate_encoding("gzip;q=0, *"));
+	EXPECT_EQ(encoding_identity, Response::negotiate_encoding("*;q=0"));
+	EXPECT_EQ(encoding_identity, Response::negotiate_encoding("gzip;q=0, deflate;q=0"));
+}
+
+namespace {
+	std::string make_body() {
+		std::string body;
+		for (int i = 0; i < 200; i++) {
+			body += "{\"key\": \"value\", \"index\": " + boost::lexical_cast<std::string>(i) + "}\n";
+		}
+		return body;
+	}
+	unsigned long read_le32(const std::string &data, std::size_t pos) {
+		unsigned long value = 0;
+		for (int i = 3; i >= 0; i--) {
+			value = (value << 8) | static_cast<unsigned char>(data[pos + i]);
+		}
+		return value;
+	}
+}
+
+TEST(mongoose, deflate) {
+	std::string body = make_body(), compressed;
+	ASSERT_TRUE(Helpers::deflate(body, compressed));
+	EXPECT_LT(compressed.size(), body.size());
+	// zlib framing: CMF (deflate, 32k window) and a header checksum
+	ASSERT_GT(compressed.size(), 6u);
+	EXPECT_EQ(0x78, static_cast<unsigned char>(compressed[0]));
+	EXPECT_EQ(0, ((static_cast<unsigned char>(compressed[0]) << 8) | static_cast<unsigned char>(compressed[1])) % 31);
+
+	std::string out(body.size(), '\0');
+	mz_ulong len = static_cast<mz_ulong>(out.size());
+	ASSERT_EQ(MZ_OK, mz_uncompress(reinterpret_cast<unsigned char*>(&out[0]), &len, reinterpret_cast<const unsigned char*>(compressed.c_str()), static_cast<mz_ulong>(compressed.size())));
+	out.resize(len);
+	EXPECT_EQ(body, out);
+}
+
+TEST(mongoose, gzip) {
+	std::string body = make_body(), compressed;
+	ASSERT_TRUE(Helpers::gzip(body, compressed));
+	EXPECT_LT(compressed.size(), body.size());
+	ASSERT_GT(compressed.size(), 18u);
+	// RFC 1952 header: magic, deflate and no flags
+	EXPECT_EQ(0x1f, static_cast<unsigned char>(compressed[0]));
+	EXPECT_EQ(0x8b, static_cast<unsigned char>(compressed[1]));
+	EXPECT_EQ(8, compressed[2]);
+	EXPECT_EQ(0, compressed[3]);
+
+	// The payload is a raw deflate stream followed by the crc and size of the input
+	std::size_t len = 0;
+	void *buf = tinfl_decompress_mem_to_heap(compressed.c_str() + 10, compressed.size() - 18, &len, 0);
+	ASSERT_TRUE(buf != NULL);
+	std::string out(static_cast<const char*>(buf), len);
+	mz_free(buf);
+	EXPECT_EQ(body, out);
+	EXPECT_EQ(mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char*>(body.c_str()), body.size()), read_le32(compressed, compressed.size() - 8));
+	EXPECT_EQ(body.size(), read_le32(compressed, compressed.size() - 4));
+}
+
+TEST(mongoose, gzip_empty) {
+	std::string compressed;
+	ASSERT_TRUE(Helpers::gzip("", compressed));
+	EXPECT_EQ(0u, read_le32(compressed, compressed.size() - 4));
+}
+
+namespace {
+	request_job make_job() {
+		return request_job(NULL, NULL, Request("127.0.0.1", false, "GET", "/", "", Request::headers_type(), ""), boost::get_system_time(), true, encoding_identity);
+	}
+
+	// Answers every request with the requested url (and fails /throw)
+	class echo_controller : public Controller {
+	public:
+		Response *handleRequest(Request &request) {
+			if (request.getUrl() == "/throw")
+				throw std::runtime_error("failed");
+			StreamResponse *response = new StreamResponse();
+			response->setCodeOk();
+			response->append(request.getUrl());
+			return response;
+		}
+		bool handles(std::string, std::string) {
+			return true;
+		}
+	};
+
+	class test_server : public ServerImpl {
+	public:
+		test_server() : ServerImpl("127.0.0.1:0") {
+			registerController(new echo_controller());
+		}
+		unsigned short get_port() const {
+			return ntohs(server_connection->sa.sin.sin_port);
+		}
+	};
+
+	std::size_t count(const std::string &data, const std::string &what) {
+		std::size_t found = 0;
+		for (std::string::size_type pos = data.find(what); pos != std::string::npos; pos = data.find(what, pos + what.size())) {
+			found++;
+		}
+		return found;
+	}
+
+	// Sends the data in one go and reads until the last (/z) response (or the end of the stream) was seen
+	std::string exchange(unsigned short port, const std::string &data) {
+		boost::asio::io_service io_service;
+		boost::asio::ip::tcp::socket socket(io_service);
+		socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+		boost::asio::write(socket, boost::asio::buffer(data));
+		std::string result;
+		char buffer[4096];
+		boost::system::error_code error;
+		while (result.find("\r\n\r\n/z") == std::string::npos) {
+			std::size_t len = socket.read_some(boost::asio::buffer(buffer), error);
+			if (error) {
+				break;
+			}
+			result.append(buffer, len);
+		}
+		return result;
+	}
+
+	std::string get(const std::string &url) {
+		return "GET " + url + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	}
+}
+
+TEST(mongoose, admit_keep_alive_limit) {
+	connection_data data(NULL);
+	bool keep_alive = true;
+	EXPECT_TRUE(data.admit(keep_alive, 3));
+	EXPECT_TRUE(keep_alive);
+	data.requests++;
+	data.job = 1;
+	EXPECT_TRUE(data.admit(keep_alive, 3));
+	EXPECT_TRUE(keep_alive);
+	data.backlog.push_back(make_job());
+	// The third request (one processed, one queued) is the last one
+	EXPECT_TRUE(data.admit(keep_alive, 3));
+	EXPECT_FALSE(keep_alive);
+	data.backlog.push_back(make_job());
+	keep_alive = true;
+	EXPECT_FALSE(data.admit(keep_alive, 3));
+}
+
+TEST(mongoose, admit_close) {
+	connection_data data(NULL);
+	bool keep_alive = false;
+	EXPECT_TRUE(data.admit(keep_alive, 100));
+	keep_alive = true;
+	EXPECT_FALSE(data.admit(keep_alive, 100));
+}
+
+TEST(mongoose, admit_backlog_limit) {
+	const std::size_t max_backlog = connection_data::max_backlog;
+	connection_data data(NULL);
+	data.job = 1;
+	data.requests = 1;
+	bool keep_alive = true;
+	while (data.admit(keep_alive, 1000)) {
+		data.backlog.push_back(make_job());
+		ASSERT_LE(data.backlog.size(), max_backlog);
+	}
+	EXPECT_EQ(max_backlog, data.backlog.size());
+	EXPECT_FALSE(keep_alive);
+}
+
+TEST(mongoose, pipelining) {
+	test_server server;
+	server.start(2);
+	std::string result = exchange(server.get_port(), get("/a") + get("/b") + get("/c") + get("/z"));
+	ASSERT_EQ(4u, count(result, "HTTP/1.1 200"));
+	std::string::size_type a = result.find("\r\n\r\n/a"), b = result.find("\r\n\r\n/b"), c = result.find("\r\n\r\n/c"), z = result.find("\r\n\r\n/z");
+	ASSERT_NE(std::string::npos, a);
+	EXPECT_LT(a, b);
+	EXPECT_LT(b, c);
+	EXPECT_LT(c, z);
+	EXPECT_EQ(0u, count(result, "Connection: close"));
+	server.stop();
+}
+
+TEST(mongoose, pipelining_keep_alive_limit) {
+	test_server server;
+	server.setKeepAlive(15, 2);
+	server.start(2);
+	// Only the first two requests are answered then the connection is closed
+	std::string result = exchange(server.get_port(), get("/a") + get("/b") + get("/c") + get("/z"));
+	EXPECT_EQ(2u, count(result, "HTTP/1.1 200"));
+	EXPECT_EQ(1u, count(result, "Connection: close"));
+	EXPECT_EQ(std::string::npos, result.find("\r\n\r\n/c"));
+	server.stop();
+}
+
+TEST(mongoose, handler_exception) {
+	test_server server;
+	server.start(2);
+	// A failing handler is answered with an error and the connection carries on
+	std::string result = exchange(server.get_port(), get("/throw") + get("/z"));
+	EXPECT_EQ(1u, count(result, "HTTP/1.1 500"));
+	EXPECT_EQ(1u, count(result, "HTTP/1.1 200"));
+	EXPECT_NE(std::string::npos, result.find("\r\n\r\n/z"));
+	server.stop();
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "WorkerPool.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+using namespace Mongoose;
+
+namespace {
+	// Runs int jobs: job 0 blocks until released and negative jobs throw
+	struct job_runner {
+		boost::mutex mutex;
+		boost::condition_variable cond;
+		bool released;
+		int executed;
+		job_runner() : released(false), executed(0) {}
+
+		void run(int &job) {
+			if (job == 0) {
+				boost::unique_lock<boost::mutex> lock(mutex);
+				while (!released)
+					cond.wait(lock);
+			}
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				executed++;
+				cond.notify_all();
+			}
+			if (job < 0)
+				throw std::runtime_error("failed");
+		}
+		void release() {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			released = true;
+			cond.notify_all();
+		}
+		bool wait_for(int count) {
+			boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+			boost::unique_lock<boost::mutex> lock(mutex);
+			while (executed < count) {
+				if (!cond.timed_wait(lock, deadline))
+					return false;
+			}
+			return true;
+		}
+	};
+
+	worker_pool<int>::handler_type handler(job_runner &runner) {
+		return boost::bind(&job_runner::run, &runner, _1);
+	}
+
+	// The executed counter is updated after the handler returns
+	bool wait_for_executed(worker_pool<int> &pool, unsigned long long count) {
+		for (int i = 0; i < 1000 && pool.get_stats().executed < count; i++)
+			boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+		return pool.get_stats().executed == count;
+	}
+}
+
+TEST(worker_pool, executes_all) {
+	job_runner runner;
+	worker_pool<int> pool;
+	pool.start(4, handler(runner));
+	for (int i = 1; i <= 100; i++)
+		EXPECT_TRUE(pool.push(i));
+	pool.flush();
+	ASSERT_TRUE(runner.wait_for(100));
+	EXPECT_TRUE(wait_for_executed(pool, 100));
+	worker_stats stats = pool.get_stats();
+	EXPECT_EQ(4u, stats.threads);
+	EXPECT_EQ(0u, stats.queued);
+	EXPECT_EQ(100u, pool.get_queue_wait().get_count());
+	pool.stop();
+	EXPECT_FALSE(pool.push(1));
+}
+
+TEST(worker_pool, steals_from_blocked_worker) {
+	job_runner runner;
+	worker_pool<int> pool;
+	pool.start(2, handler(runner));
+	// Jobs are handed out round robin so half of them are queued behind the blocking job
+	for (int i = 0; i < 10; i++)
+		pool.push(i);
+	pool.flush();
+	ASSERT_TRUE(runner.wait_for(9));
+	worker_stats stats = pool.get_stats();
+	EXPECT_GT(stats.stolen, 0u);
+	EXPECT_EQ(0u, stats.queued);
+	runner.release();
+	ASSERT_TRUE(runner.wait_for(10));
+	EXPECT_TRUE(wait_for_executed(pool, 10));
+	pool.stop();
+}
+
+TEST(worker_pool, wakes_sleeping_workers) {
+	job_runner runner;
+	worker_pool<int> pool;
+	pool.start(2, handler(runner));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+	EXPECT_EQ(0u, pool.get_stats().wakeups);
+	// One job wakes one of the two sleeping workers
+	pool.push(1);
+	pool.flush();
+	ASSERT_TRUE(runner.wait_for(1));
+	EXPECT_EQ(1u, pool.get_stats().wakeups);
+	// Nothing pushed nothing to wake
+	pool.flush();
+	EXPECT_EQ(1u, pool.get_stats().wakeups);
+	pool.stop();
+}
+
+TEST(worker_pool, survives_failing_jobs) {
+	job_runner runner;
+	worker_pool<int> pool;
+	pool.start(1, handler(runner));
+	pool.push(-1);
+	pool.push(1);
+	pool.push(-2);
+	pool.push(2);
+	pool.flush();
+	ASSERT_TRUE(runner.wait_for(4));
+	EXPECT_TRUE(wait_for_executed(pool, 4));
+	pool.stop();
+}
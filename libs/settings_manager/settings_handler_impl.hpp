@@ -236,6 +236,10 @@ namespace settings {
 
 		void register_tpl(unsigned int plugin_id, std::string path, std::string title, std::string data) {
 			std::string key = path + "::" + title;
+			boost::unique_lock<boost::shared_mutex> writeLock(registry_mutex_, boost::get_system_time() + boost::posix_time::seconds(10));
+			if (!writeLock.owns_lock()) {
+				throw settings_exception(__FILE__, __LINE__, "Failed to lock registry mutex: " + key);
+			}
 			registered_tpls_[key] = tpl_description(plugin_id, path, title, data);
 		}
 
@@ -338,6 +342,7 @@ namespace settings {
 			instance_ = create_instance(alias, key);
 			if (!instance_)
 				throw settings_exception(__FILE__, __LINE__, "set_instance Failed to create instance for: " + key);
+			instance_->publish_snapshot();
 		}
 
 	private:
@@ -16,6 +16,8 @@
 #include <str/format.hpp>
 #include <utf8.hpp>
 
+#include <simpleini/simpleini.h>
+
 static settings_manager::NSCSettingsImpl* settings_impl = NULL;
 
 namespace settings_manager {
@@ -204,6 +204,7 @@ void CheckDisk::check_files(const PB::Commands::QueryRequestMessage::Request &re
 		("paths", po::value<std::string>(&files_string), "A comma separated list of paths to scan")
 		("pattern", po::value<std::string>(&context.pattern)->default_value("*.*"), "The pattern of files to search for (works like a filter but is faster and can be combined with a filter).")
 		("max-depth", po::value<int>(&context.max_depth), "Maximum depth to recurse")
+		("threads", po::value<int>(&context.threads), "Number of threads to use when scanning directories (only used on unix, default is one per core up to 8)")
 		("total", po::value(&total)->implicit_value("filter"), "Include the total of either (filter) all files matching the filter or (all) all files regardless of the filter")
 		;
 
@@ -224,6 +225,9 @@ void CheckDisk::check_files(const PB::Commands::QueryRequestMessage::Request &re
 	boost::shared_ptr<file_filter::filter_obj> total_obj;
 	if (!total.empty())
 		total_obj = file_filter::filter_obj::get_total(context.now);
+	context.fields = filter.context->get_required_fields();
+	if (total_obj)
+		context.fields |= file_filter::field_size;
 
 	BOOST_FOREACH(const std::string &path, file_list) {
 		file_finder::recursive_scan(filter, context, path, total_obj, total == "all");
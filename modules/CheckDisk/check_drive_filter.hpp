@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <parsers/filter/modern_filter.hpp>
+#include <parsers/where/filter_handler_impl.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <list>
+#include <string>
+#include <vector>
+
+// The drive filter (and check_drivesize) shared by all platforms, finding drives as well as reading
+// their type and size is implemented per platform (check_drive_win.cpp and check_drive_unix.cpp).
+
+// Same numbering as the windows DRIVE_XXX constants so filters are portable
+const int drive_type_unknown = 0;
+const int drive_type_no_root_dir = 1;
+const int drive_type_removable = 2;
+const int drive_type_fixed = 3;
+const int drive_type_remote = 4;
+const int drive_type_cdrom = 5;
+const int drive_type_ramdisk = 6;
+const int drive_type_system = 7;
+const int drive_type_total = 0x77;
+
+struct drive_container {
+	std::string id;
+	std::string letter;
+	std::string letter_only;
+	std::string name;
+	std::string fs_type;
+	bool is_mounted;
+	enum drive_flags {
+		df_none = 0,
+		df_removable = 0x1,
+		df_hotplug = 0x2,
+		df_mounted = 0x4,
+		df_readable = 0x8,
+		df_writable = 0x10,
+		df_erasable = 0x20
+	};
+
+	// The media type on windows and the drive type on unix
+	unsigned long long type;
+	drive_flags flags;
+
+	drive_container(std::string id, std::string letter, std::string name, std::string fs_type, bool is_mounted, unsigned long long type, drive_flags flags)
+		: id(id), letter(letter), name(name), fs_type(fs_type), is_mounted(is_mounted), type(type), flags(flags) {
+#ifdef WIN32
+		letter_only = letter.substr(0, 1);
+#endif
+	}
+
+	bool has_flag(drive_flags flag) const {
+		return (flags & flag) == flag;
+	}
+};
+
+inline drive_container::drive_flags operator|=(drive_container::drive_flags &a, const drive_container::drive_flags b) {
+	return a = static_cast<drive_container::drive_flags>(static_cast<int>(a) | static_cast<int>(b));
+}
+
+struct filter_obj {
+	drive_container drive;
+	long long drive_type;
+	long long user_free;
+	long long total_free;
+	long long drive_size;
+	long long inodes_total;
+	long long inodes_free;
+	bool has_size;
+	bool has_type;
+
+	filter_obj(const drive_container drive)
+		: drive(drive)
+		, drive_type(0)
+		, user_free(0)
+		, total_free(0)
+		, drive_size(0)
+		, inodes_total(0)
+		, inodes_free(0)
+		, has_size(false)
+		, has_type(false) {};
+
+	std::string get_drive(parsers::where::evaluation_context) const { return drive.letter; }
+	std::string get_letter(parsers::where::evaluation_context) const {
+		if (drive.letter.size() >= 2 && drive.letter[1] == ':')
+			return drive.letter.substr(0, 1);
+		return "";
+	}
+	std::string get_name(parsers::where::evaluation_context) const { return drive.name; }
+	std::string get_id(parsers::where::evaluation_context) const { return drive.id; }
+	std::string get_fs_type(parsers::where::evaluation_context) const { return drive.fs_type; }
+	std::string get_drive_or_id(parsers::where::evaluation_context) const { return drive.letter.empty() ? drive.id : drive.letter; }
+	std::string get_drive_or_name(parsers::where::evaluation_context) const { return drive.letter.empty() ? drive.name : drive.letter; }
+	std::string get_flags(parsers::where::evaluation_context) const;
+
+	long long get_user_free(parsers::where::evaluation_context context) { get_size(context); return user_free; }
+	long long get_total_free(parsers::where::evaluation_context context) { get_size(context); return total_free; }
+	long long get_drive_size(parsers::where::evaluation_context context) { get_size(context); return drive_size; }
+	long long get_total_used(parsers::where::evaluation_context context) { get_size(context); return drive_size - total_free; }
+	long long get_user_used(parsers::where::evaluation_context context) { get_size(context); return drive_size - user_free; }
+
+	long long get_user_free_pct(parsers::where::evaluation_context context) { get_size(context); return drive_size == 0 ? 0 : (user_free * 100 / drive_size); }
+	long long get_total_free_pct(parsers::where::evaluation_context context) { get_size(context); return drive_size == 0 ? 0 : (total_free * 100 / drive_size); }
+	long long get_user_used_pct(parsers::where::evaluation_context context) { return 100 - get_user_free_pct(context); }
+	long long get_total_used_pct(parsers::where::evaluation_context context) { return 100 - get_total_free_pct(context); }
+
+	long long get_inodes_total(parsers::where::evaluation_context context) { get_size(context); return inodes_total; }
+	long long get_inodes_free(parsers::where::evaluation_context context) { get_size(context); return inodes_free; }
+	long long get_inodes_used(parsers::where::evaluation_context context) { get_size(context); return inodes_total - inodes_free; }
+	long long get_inodes_used_pct(parsers::where::evaluation_context context) { get_size(context); return inodes_total == 0 ? 0 : ((inodes_total - inodes_free) * 100 / inodes_total); }
+
+	long long get_is_mounted(parsers::where::evaluation_context) const { return drive.is_mounted ? 1 : 0; }
+	long long get_removable(parsers::where::evaluation_context) const { return drive.has_flag(drive_container::df_removable); }
+	long long get_hotplug(parsers::where::evaluation_context) const { return drive.has_flag(drive_container::df_hotplug); }
+	long long get_readable(parsers::where::evaluation_context) const { return drive.has_flag(drive_container::df_readable); }
+	long long get_writable(parsers::where::evaluation_context) const { return drive.has_flag(drive_container::df_writable); }
+	long long get_erasable(parsers::where::evaluation_context) const { return drive.has_flag(drive_container::df_erasable); }
+
+	std::string get_user_free_human(parsers::where::evaluation_context context);
+	std::string get_total_free_human(parsers::where::evaluation_context context);
+	std::string get_drive_size_human(parsers::where::evaluation_context context);
+	std::string get_total_used_human(parsers::where::evaluation_context context);
+	std::string get_user_used_human(parsers::where::evaluation_context context);
+	std::string get_type_as_string(parsers::where::evaluation_context context);
+
+	void append(boost::shared_ptr<filter_obj> other);
+	void make_total();
+
+	// Implemented per platform
+	long long get_type(parsers::where::evaluation_context context);
+	long long get_media_type(parsers::where::evaluation_context context) const;
+	void get_size(parsers::where::evaluation_context context);
+};
+
+typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
+struct filter_obj_handler : public native_context {
+	filter_obj_handler();
+};
+
+typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter_type;
+
+// Implemented per platform: the drives matching the given drive options (paths, letters, * and so on)
+std::list<drive_container> find_drives(std::vector<std::string> drives);
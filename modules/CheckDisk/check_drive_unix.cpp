@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "check_drive_filter.hpp"
+
+#include <nsclient/nsclient_exception.hpp>
+
+#include <utf8.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <list>
+#include <map>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/statvfs.h>
+
+namespace mountinfo {
+	struct mount_entry {
+		std::string mount_point;
+		std::string source;
+		std::string fs_type;
+		std::string device;
+		std::string options;
+		unsigned int major;
+		unsigned int minor;
+		mount_entry() : major(0), minor(0) {}
+	};
+
+	// Fields in mountinfo escape space, tab, newline and backslash as \ooo
+	std::string unescape(const std::string &str) {
+		std::string ret;
+		ret.reserve(str.size());
+		for (std::string::size_type i = 0; i < str.size(); i++) {
+			if (str[i] == '\\' && i + 3 < str.size() && str[i + 1] >= '0' && str[i + 1] <= '3') {
+				ret += static_cast<char>(((str[i + 1] - '0') << 6) | ((str[i + 2] - '0') << 3) | (str[i + 3] - '0'));
+				i += 3;
+			} else {
+				ret += str[i];
+			}
+		}
+		return ret;
+	}
+
+	// 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+	bool parse_line(const std::string &line, mount_entry &entry) {
+		std::vector<std::string> fields;
+		boost::split(fields, line, boost::is_any_of(" "), boost::token_compress_on);
+		std::vector<std::string>::iterator sep = std::find(fields.begin(), fields.end(), "-");
+		if (fields.size() < 6 || std::distance(sep, fields.end()) < 3)
+			return false;
+		entry.device = fields[2];
+		if (sscanf(entry.device.c_str(), "%u:%u", &entry.major, &entry.minor) != 2)
+			return false;
+		entry.mount_point = unescape(fields[4]);
+		entry.options = fields[5];
+		entry.fs_type = *(sep + 1);
+		entry.source = unescape(*(sep + 2));
+		return true;
+	}
+
+	std::list<mount_entry> read(const std::string &file = "/proc/self/mountinfo") {
+		std::list<mount_entry> ret;
+		std::ifstream in(file.c_str());
+		if (!in.is_open())
+			throw nsclient::nsclient_exception("Failed to open " + file + ": " + utf8::utf8_from_native(strerror(errno)));
+		std::string line;
+		while (std::getline(in, line)) {
+			mount_entry entry;
+			if (parse_line(line, entry))
+				ret.push_back(entry);
+		}
+		return ret;
+	}
+
+	bool read_flag(const std::string &file) {
+		std::ifstream in(file.c_str());
+		char c = 0;
+		return in.is_open() && in.get(c) && c == '1';
+	}
+
+	bool is_removable(const mount_entry &entry) {
+		if (entry.major == 0)
+			return false;
+		std::string base = "/sys/dev/block/" + entry.device;
+		// Partitions do not have the removable flag, it lives on the parent disk.
+		return read_flag(base + "/removable") || read_flag(base + "/../removable");
+	}
+
+	int get_type(const mount_entry &entry) {
+		const std::string &fs = entry.fs_type;
+		if (fs == "nfs" || fs == "nfs4" || fs == "cifs" || fs == "smbfs" || fs == "smb3" || fs == "ncpfs" || fs == "afs" || fs == "9p"
+			|| fs == "ceph" || fs == "glusterfs" || fs == "fuse.sshfs" || fs == "fuse.glusterfs" || fs == "fuse.s3fs" || fs == "lustre")
+			return drive_type_remote;
+		if (fs == "tmpfs" || fs == "ramfs")
+			return drive_type_ramdisk;
+		if (fs == "iso9660" || fs == "udf")
+			return drive_type_cdrom;
+		if (fs == "overlay" || fs == "zfs" || fs == "btrfs" || boost::starts_with(entry.source, "/dev/"))
+			return is_removable(entry) ? drive_type_removable : drive_type_fixed;
+		return drive_type_system;
+	}
+
+	bool has_option(const mount_entry &entry, const std::string &option) {
+		std::vector<std::string> options;
+		boost::split(options, entry.options, boost::is_any_of(","));
+		return std::find(options.begin(), options.end(), option) != options.end();
+	}
+}
+
+long long filter_obj::get_type(parsers::where::evaluation_context) {
+	if (!has_type) {
+		drive_type = static_cast<long long>(drive.type);
+		has_type = true;
+	}
+	return drive_type;
+}
+
+long long filter_obj::get_media_type(parsers::where::evaluation_context) const {
+	return 0;
+}
+
+void filter_obj::get_size(parsers::where::evaluation_context context) {
+	if (has_size)
+		return;
+	has_size = true;
+	struct statvfs buf;
+	if (statvfs(drive.letter.c_str(), &buf) != 0) {
+		context->error("Failed to get size for " + drive.letter + ": " + utf8::utf8_from_native(strerror(errno)));
+		return;
+	}
+	unsigned long long frsize = buf.f_frsize != 0 ? buf.f_frsize : buf.f_bsize;
+	drive_size = static_cast<long long>(buf.f_blocks * frsize);
+	total_free = static_cast<long long>(buf.f_bfree * frsize);
+	user_free = static_cast<long long>(buf.f_bavail * frsize);
+	inodes_total = static_cast<long long>(buf.f_files);
+	inodes_free = static_cast<long long>(buf.f_ffree);
+}
+
+drive_container get_dc_from_mount(const mountinfo::mount_entry &entry, const std::string &path) {
+	drive_container::drive_flags flags = drive_container::df_mounted;
+	flags |= drive_container::df_readable;
+	if (!mountinfo::has_option(entry, "ro"))
+		flags |= drive_container::df_writable;
+	int type = mountinfo::get_type(entry);
+	if (type == drive_type_removable)
+		flags |= drive_container::df_removable;
+	return drive_container(entry.device, path, entry.source, entry.fs_type, true, type, flags);
+}
+
+// Later entries shadow earlier ones mounted on the same path
+void find_all_mounts(std::list<drive_container> &drives, std::vector<std::string> &found, const std::list<mountinfo::mount_entry> &mounts) {
+	std::map<std::string, mountinfo::mount_entry> unique;
+	BOOST_FOREACH(const mountinfo::mount_entry &m, mounts) {
+		unique[m.mount_point] = m;
+	}
+	BOOST_FOREACH(const mountinfo::mount_entry &m, mounts) {
+		std::map<std::string, mountinfo::mount_entry>::iterator it = unique.find(m.mount_point);
+		if (it == unique.end())
+			continue;
+		if (std::find(found.begin(), found.end(), m.mount_point) == found.end()) {
+			drives.push_back(get_dc_from_mount(it->second, m.mount_point));
+			found.push_back(m.mount_point);
+		}
+		unique.erase(it);
+	}
+}
+
+// A path is checked using the mount it resides on (longest matching mount point).
+drive_container get_dc_from_path(const std::string &path, const std::list<mountinfo::mount_entry> &mounts) {
+	const mountinfo::mount_entry *best = NULL;
+	BOOST_FOREACH(const mountinfo::mount_entry &m, mounts) {
+		const std::string &mp = m.mount_point;
+		bool match = path == mp || (boost::starts_with(path, mp) && (mp == "/" || path[mp.size()] == '/'));
+		if (match && (best == NULL || mp.size() >= best->mount_point.size()))
+			best = &m;
+	}
+	if (best == NULL)
+		return drive_container("", path, path, "", false, drive_type_unknown, drive_container::df_none);
+	return get_dc_from_mount(*best, path);
+}
+
+std::list<drive_container> find_drives(std::vector<std::string> drives) {
+	std::list<mountinfo::mount_entry> mounts = mountinfo::read();
+	std::list<drive_container> ret;
+	std::vector<std::string> found_drives;
+	BOOST_FOREACH(const std::string &d, drives) {
+		if (d == "all-volumes" || d == "volumes" || d == "all-drives" || d == "drives" || d == "all" || d == "*") {
+			find_all_mounts(ret, found_drives, mounts);
+		} else {
+			ret.push_back(get_dc_from_path(d, mounts));
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "check_drive_filter.hpp"
+
+#include <nsclient/nsclient_exception.hpp>
+
+#include <nscapi/nscapi_helper_singleton.hpp>
+#include <nscapi/macros.hpp>
+
+#include <char_buffer.hpp>
+#include <error/error.hpp>
+#include <utf8.hpp>
+
+#include <boost/foreach.hpp>
+
+#include <map>
+
+#include <Windows.h>
+#include <winioctl.h>
+
+namespace {
+	std::wstring get_volume_or_letter_w(const drive_container &drive) {
+		if (!drive.id.empty())
+			return utf8::cvt<std::wstring>(drive.id);
+		return utf8::cvt<std::wstring>(drive.letter);
+	}
+}
+
+long long filter_obj::get_type(parsers::where::evaluation_context context) {
+	if (has_type)
+		return drive_type;
+	drive_type = GetDriveType(get_volume_or_letter_w(drive).c_str());
+	has_type = true;
+	return drive_type;
+}
+
+long long filter_obj::get_media_type(parsers::where::evaluation_context context) const {
+	return drive.type;
+}
+
+void filter_obj::get_size(parsers::where::evaluation_context context) {
+	if (has_size)
+		return;
+
+	ULARGE_INTEGER freeBytesAvailableToCaller;
+	ULARGE_INTEGER totalNumberOfBytes;
+	ULARGE_INTEGER totalNumberOfFreeBytes;
+	std::wstring drv = get_volume_or_letter_w(drive);
+	if (drv.size() == 1)
+		drv = drv + L":\\";
+	if (!GetDiskFreeSpaceEx(drv.c_str(), &freeBytesAvailableToCaller, &totalNumberOfBytes, &totalNumberOfFreeBytes)) {
+		DWORD err = GetLastError();
+		has_size = true;
+		if (err == ERROR_NOT_READY) {
+			user_free = 0;
+			total_free = 0;
+			drive_size = 0;
+			return;
+		}
+		context->error("Failed to get size for " + utf8::cvt<std::string>(drv) + ": " + error::lookup::last_error(err));
+		return;
+	}
+	has_size = true;
+	user_free = freeBytesAvailableToCaller.QuadPart;
+	total_free = totalNumberOfFreeBytes.QuadPart;
+	drive_size = totalNumberOfBytes.QuadPart;
+}
+
+class volume_helper {
+	typedef HANDLE(WINAPI *typeFindFirstVolumeW)(__out_ecount(cchBufferLength) LPWSTR lpszVolumeName, __in DWORD cchBufferLength);
+	typedef BOOL(WINAPI *typeFindNextVolumeW)(__inout HANDLE hFindVolume, __out_ecount(cchBufferLength) LPWSTR lpszVolumeName, __in DWORD cchBufferLength);
+	typedef HANDLE(WINAPI *typeFindFirstVolumeMountPointW)(__in LPCWSTR lpszRootPathName, __out_ecount(cchBufferLength) LPWSTR lpszVolumeMountPoint, __in DWORD cchBufferLength);
+	typedef BOOL(WINAPI *typeFindNextVolumeMountPointW)(__inout HANDLE hFindVolume, __out_ecount(cchBufferLength) LPWSTR lpszVolumeName, __in DWORD cchBufferLength);
+	typedef BOOL(WINAPI *typeGetVolumeNameForVolumeMountPointW)(__in LPCWSTR lpszVolumeMountPoint, __out_ecount(cchBufferLength) LPWSTR lpszVolumeName, __in DWORD cchBufferLength);
+	typedef BOOL(WINAPI *typeGetVolumeInformationByHandleW)(_In_ HANDLE hFile, _Out_opt_ LPWSTR lpVolumeNameBuffer, _In_ DWORD nVolumeNameSize, _Out_opt_ LPDWORD lpVolumeSerialNumber,
+		_Out_opt_ LPDWORD  lpMaximumComponentLength, _Out_opt_ LPDWORD lpFileSystemFlags, _Out_opt_ LPWSTR lpFileSystemNameBuffer, _In_ DWORD nFileSystemNameSize);
+	typedef BOOL(WINAPI *typeGetVolumePathNamesForVolumeNameW)(_In_ LPCTSTR lpszVolumeName, _Out_ LPTSTR lpszVolumePathNames, _In_ DWORD cchBufferLength, _Out_ PDWORD lpcchReturnLength);
+
+	typeFindFirstVolumeW ptrFindFirstVolumeW;
+	typeFindNextVolumeW ptrFindNextVolumeW;
+	typeFindFirstVolumeMountPointW ptrFindFirstVolumeMountPointW;
+	typeFindNextVolumeMountPointW ptrFindNextVolumeMountPointW;
+	typeGetVolumeNameForVolumeMountPointW ptrGetVolumeNameForVolumeMountPointW;
+	typeGetVolumeInformationByHandleW ptrGetVolumeInformationByHandleW;
+	typeGetVolumePathNamesForVolumeNameW ptrGetVolumePathNamesForVolumeNameW;
+	HMODULE hLib;
+
+public:
+	typedef std::map<std::string, std::string> map_type;
+
+public:
+	volume_helper()
+		: ptrFindFirstVolumeW(NULL)
+		, ptrFindNextVolumeW(NULL)
+		, ptrFindFirstVolumeMountPointW(NULL)
+		, ptrFindNextVolumeMountPointW(NULL)
+		, ptrGetVolumeNameForVolumeMountPointW(NULL)
+		, ptrGetVolumeInformationByHandleW(NULL)
+		, ptrGetVolumePathNamesForVolumeNameW(NULL) {
+		hLib = ::LoadLibrary(L"KERNEL32");
+		if (hLib) {
+			ptrFindFirstVolumeW = (typeFindFirstVolumeW)::GetProcAddress(hLib, "FindFirstVolumeW");
+			ptrFindNextVolumeW = (typeFindNextVolumeW)::GetProcAddress(hLib, "FindNextVolumeW");
+			ptrFindFirstVolumeMountPointW = (typeFindFirstVolumeMountPointW)::GetProcAddress(hLib, "FindFirstVolumeMountPointW");
+			ptrFindNextVolumeMountPointW = (typeFindNextVolumeMountPointW)::GetProcAddress(hLib, "FindNextVolumeMountPointW");
+			ptrGetVolumeNameForVolumeMountPointW = (typeGetVolumeNameForVolumeMountPointW)::GetProcAddress(hLib, "GetVolumeNameForVolumeMountPointW");
+			ptrGetVolumeInformationByHandleW = (typeGetVolumeInformationByHandleW)::GetProcAddress(hLib, "GetVolumeInformationByHandleW");
+			ptrGetVolumePathNamesForVolumeNameW = (typeGetVolumePathNamesForVolumeNameW)::GetProcAddress(hLib, "GetVolumePathNamesForVolumeNameW");
+		}
+	}
+
+	~volume_helper() {}
+
+	HANDLE FindFirstVolume(std::wstring &volume) {
+		if (ptrFindFirstVolumeW == NULL)
+			return INVALID_HANDLE_VALUE;
+		hlp::tchar_buffer buffer(1024);
+		HANDLE h = ptrFindFirstVolumeW(buffer.get(), static_cast<DWORD>(buffer.size()));
+		if (h != INVALID_HANDLE_VALUE)
+			volume = buffer.get();
+		return h;
+	}
+	BOOL FindNextVolume(HANDLE hVolume, std::wstring &volume) {
+		if (ptrFindFirstVolumeW == NULL || hVolume == INVALID_HANDLE_VALUE)
+			return FALSE;
+		hlp::tchar_buffer buffer(1024);
+		BOOL r = ptrFindNextVolumeW(hVolume, buffer.get(), static_cast<DWORD>(buffer.size()));
+		if (r)
+			volume = buffer.get();
+		return r;
+	}
+
+	HANDLE FindFirstVolumeMountPoint(std::wstring &root, std::wstring &volume) {
+		if (ptrFindFirstVolumeMountPointW == NULL)
+			return INVALID_HANDLE_VALUE;
+		hlp::tchar_buffer buffer(1024);
+		HANDLE h = ptrFindFirstVolumeMountPointW(root.c_str(), buffer.get(), static_cast<DWORD>(buffer.size()));
+		if (h != INVALID_HANDLE_VALUE)
+			volume = buffer.get();
+		return h;
+	}
+	BOOL FindNextVolumeMountPoint(HANDLE hVolume, std::wstring &volume) {
+		if (ptrFindNextVolumeMountPointW == NULL || hVolume == INVALID_HANDLE_VALUE)
+			return FALSE;
+		hlp::tchar_buffer buffer(1024);
+		BOOL r = ptrFindNextVolumeMountPointW(hVolume, buffer.get(), static_cast<DWORD>(buffer.size()));
+		if (r)
+			volume = buffer.get();
+		return r;
+	}
+
+	void GetVolumeInformationByHandle(HANDLE hVolume, std::wstring &name, std::wstring &fs) {
+		if (ptrGetVolumeInformationByHandleW == NULL || hVolume == INVALID_HANDLE_VALUE)
+			return;
+		hlp::tchar_buffer volumeName(1024);
+		hlp::tchar_buffer fileSysName(1024);
+		DWORD maximumComponentLength, fileSystemFlags;
+
+		if (!ptrGetVolumeInformationByHandleW(hVolume, volumeName.get(), static_cast<DWORD>(volumeName.size()),
+			NULL, &maximumComponentLength, &fileSystemFlags, fileSysName.get(), static_cast<DWORD>(fileSysName.size()))) {
+			NSC_LOG_ERROR("Failed to get volume information: " + error::lookup::last_error());
+		} else {
+			name = volumeName.get();
+			fs = fileSysName.get();
+		}
+	}
+
+	bool getVolumeInformation(std::wstring volume, std::wstring &name, std::wstring &fs, unsigned long long &type, drive_container::drive_flags &flags) {
+		hlp::tchar_buffer volumeName(1024);
+		hlp::tchar_buffer fileSysName(1024);
+		DWORD maximumComponentLength, fileSystemFlags;
+		type = 0;
+		std::wstring vfile = volume;
+		if (vfile[vfile.size() - 1] == '\\')
+			vfile = vfile.substr(0, vfile.size() - 1);
+
+		HANDLE hDevice = CreateFile(vfile.c_str(), 0, 0, 0, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, 0);
+		if (hDevice != INVALID_HANDLE_VALUE) {
+
+			DWORD ReturnedSize;
+			STORAGE_HOTPLUG_INFO Info = { 0 };
+
+			if (DeviceIoControl(hDevice, IOCTL_STORAGE_GET_HOTPLUG_INFO, 0, 0, &Info, sizeof(Info), &ReturnedSize, NULL)) {
+				if (Info.MediaRemovable)
+					flags |= drive_container::df_removable;
+				if (Info.DeviceHotplug)
+					flags |= drive_container::df_hotplug;
+			}
+
+			hlp::buffer<TCHAR, GET_MEDIA_TYPES*> mediaType(2048);
+			DWORD err = 0;
+			while (DeviceIoControl(hDevice, IOCTL_STORAGE_GET_MEDIA_TYPES_EX, 0, 0, mediaType.get(), mediaType.size(), &ReturnedSize, NULL) == FALSE && (err = GetLastError()) == ERROR_INSUFFICIENT_BUFFER) {
+				mediaType.resize(mediaType.size() * 2);
+			}
+
+
+			if (err == 0 && mediaType.get()->MediaInfoCount > 0) {
+
+				DWORD Characteristics = 0;
+				// Supports: Disk, CD, DVD
+				type = mediaType.get()->DeviceType;
+				if (mediaType.get()->DeviceType == FILE_DEVICE_DISK || mediaType.get()->DeviceType == FILE_DEVICE_CD_ROM || mediaType.get()->DeviceType == FILE_DEVICE_DVD) {
+					if (Info.MediaRemovable) {
+						Characteristics = mediaType.get()->MediaInfo[0].DeviceSpecific.RemovableDiskInfo.MediaCharacteristics;
+					} else {
+						Characteristics = mediaType.get()->MediaInfo[0].DeviceSpecific.DiskInfo.MediaCharacteristics;
+					}
+
+					if (Characteristics & MEDIA_CURRENTLY_MOUNTED)
+						flags |= drive_container::df_mounted;
+					if (Characteristics & (MEDIA_READ_ONLY | MEDIA_READ_WRITE))
+						flags |= drive_container::df_readable;
+					if (((Characteristics & MEDIA_READ_WRITE) != 0 || (Characteristics & MEDIA_WRITE_ONCE) != 0) && (Characteristics & MEDIA_WRITE_PROTECTED) == 0 && (Characteristics & MEDIA_READ_ONLY) == 0)
+						flags |= drive_container::df_writable;
+					if (Characteristics & MEDIA_ERASEABLE)
+						flags |= drive_container::df_erasable;
+				}
+			}
+
+			CloseHandle(hDevice);
+		}
+
+
+
+
+		if (!GetVolumeInformation(volume.c_str(), volumeName.get(), volumeName.size(),
+			NULL, &maximumComponentLength, &fileSystemFlags, fileSysName.get(), static_cast<DWORD>(fileSysName.size()))) {
+			DWORD dwErr = GetLastError();
+			if (dwErr == ERROR_PATH_NOT_FOUND)
+				return false;
+			if (dwErr != ERROR_NOT_READY)
+				name = L"Failed to get volume information " + volume + L": " + utf8::cvt<std::wstring>(error::lookup::last_error());
+		} else {
+			name = volumeName.get();
+			fs = fileSysName.get();
+		}
+		return true;
+	}
+
+	std::list<std::wstring> GetVolumePathNamesForVolumeName(std::wstring volume) {
+		std::list<std::wstring> ret;
+		if (ptrGetVolumePathNamesForVolumeNameW == NULL)
+			return ret;
+		hlp::tchar_buffer buffer(1024);
+		DWORD returnLen = 0;
+		if (!ptrGetVolumePathNamesForVolumeNameW(volume.c_str(), buffer.get(), buffer.size(), &returnLen)) {
+			NSC_LOG_ERROR("Failed to get mountpoints: " + error::lookup::last_error());
+			return ret;
+		} else {
+			DWORD last = 0;
+			for (DWORD i = 0; i < returnLen; i++) {
+				if (buffer[i] == 0) {
+					std::wstring item = buffer.get(last);
+					if (!item.empty())
+						ret.push_back(item);
+					last = i + 1;
+				}
+			}
+			return ret;
+		}
+	}
+
+	bool GetVolumeNameForVolumeMountPoint(std::wstring volumeMountPoint, std::wstring &volumeName) {
+		hlp::tchar_buffer buffer(1024);
+		if (ptrGetVolumeNameForVolumeMountPointW(volumeMountPoint.c_str(), buffer.get(), static_cast<DWORD>(buffer.size()))) {
+			volumeName = buffer;
+			return true;
+		}
+		return false;
+	}
+	std::wstring GetVolumeNameForVolumeMountPoint(std::wstring volumeMountPoint) {
+		std::wstring volumeName;
+		GetVolumeNameForVolumeMountPoint(volumeMountPoint, volumeName);
+		return volumeName;
+	}
+
+	std::list<std::wstring> find_mount_points(std::wstring &root, std::wstring &name) {
+		std::list<std::wstring> ret;
+		std::wstring volume;
+		HANDLE hVol = FindFirstVolumeMountPoint(root, volume);
+		if (hVol == INVALID_HANDLE_VALUE) {
+			DWORD dwErr = GetLastError();
+			if (dwErr != ERROR_NO_MORE_FILES && dwErr != ERROR_ACCESS_DENIED)
+				NSC_LOG_ERROR_STD("Failed to enumerate volumes " + utf8::cvt<std::string>(name) + ": " + error::lookup::last_error(dwErr));
+			return ret;
+		}
+		BOOL bFlag = TRUE;
+		while (bFlag) {
+			ret.push_back(volume);
+			bFlag = FindNextVolumeMountPoint(hVol, volume);
+		}
+		CloseHandle(hVol);
+		return ret;
+	}
+
+	std::list<drive_container> get_volumes() {
+		std::list<drive_container> ret;
+		std::wstring volume;
+		HANDLE hVol = FindFirstVolume(volume);
+		if (hVol == INVALID_HANDLE_VALUE) {
+			NSC_LOG_ERROR_STD("Failed to enumerate volumes");
+			return ret;
+		}
+		BOOL bFlag = TRUE;
+		while (bFlag) {
+			std::wstring name, fs;
+			unsigned long long type;
+			drive_container::drive_flags flags = drive_container::df_none;
+			bool is_valid = getVolumeInformation(volume, name, fs, type, flags);
+
+			bool found_mp = false;
+			std::string title = utf8::cvt<std::string>(name);
+			BOOST_FOREACH(const std::wstring &s, GetVolumePathNamesForVolumeName(volume)) {
+				ret.push_back(drive_container(utf8::cvt<std::string>(volume), utf8::cvt<std::string>(s), title, utf8::cvt<std::string>(fs), true, type, flags));
+				found_mp = true;
+			}
+			if (!found_mp && is_valid)
+				ret.push_back(drive_container(utf8::cvt<std::string>(volume), "", title, utf8::cvt<std::string>(fs), false, type, flags));
+			bFlag = FindNextVolume(hVol, volume);
+		}
+		FindVolumeClose(hVol);
+		return ret;
+	}
+};
+
+void add_missing(std::list<drive_container> &drives, std::vector<std::string> &exclude_drives, const drive_container &drive) {
+	if (!drive.letter.empty()) {
+		if (std::find(exclude_drives.begin(), exclude_drives.end(), drive.letter) == exclude_drives.end()) {
+			drives.push_back(drive);
+			exclude_drives.push_back(drive.letter);
+		}
+	} else if (!drive.id.empty()) {
+		if (std::find(exclude_drives.begin(), exclude_drives.end(), drive.id) == exclude_drives.end()) {
+			drives.push_back(drive);
+			exclude_drives.push_back(drive.id);
+		}
+	} else {
+		drives.push_back(drive);
+	}
+}
+void find_all_volumes(std::list<drive_container> &drives, std::vector<std::string> &exclude_drives, volume_helper helper) {
+	BOOST_FOREACH(const drive_container &d, helper.get_volumes()) {
+		add_missing(drives, exclude_drives, d);
+	}
+}
+
+drive_container get_dc_from_string(std::wstring folder, volume_helper &helper) {
+	std::wstring volume = helper.GetVolumeNameForVolumeMountPoint(folder);
+	unsigned long long type = 0;
+	std::string title = "", fs = "";
+	drive_container::drive_flags flags = drive_container::df_none;
+	if (!volume.empty()) {
+		std::wstring wtitle, wfs;
+		helper.getVolumeInformation(volume, wtitle, wfs, type, flags);
+		title = utf8::cvt<std::string>(wtitle);
+		fs = utf8::cvt<std::string>(wfs);
+	}
+	return drive_container(utf8::cvt<std::string>(volume), utf8::cvt<std::string>(folder), title, fs, true, type, flags);
+}
+void find_all_drives(std::list<drive_container> &drives, std::vector<std::string> &exclude_drives, volume_helper &helper) {
+	DWORD bufSize = GetLogicalDriveStrings(0, NULL) + 5;
+	hlp::tchar_buffer buffer(bufSize);
+
+	if (GetLogicalDriveStrings(bufSize, buffer.get()) > 0) {
+		for (std::size_t i = 0; i < buffer.size();) {
+			std::wstring drv = buffer.get(i);
+			if (drv.empty())
+				break;
+			std::string drive = utf8::cvt<std::string>(drv);
+			if (std::find(exclude_drives.begin(), exclude_drives.end(), drive) == exclude_drives.end()) {
+				add_missing(drives, exclude_drives, get_dc_from_string(drv, helper));
+			}
+			i += drv.size()+1;
+		}
+	} else
+		throw nsclient::nsclient_exception("Failed to get volume list: " + error::lookup::last_error());
+}
+
+std::list<drive_container> find_drives(std::vector<std::string> drives) {
+	volume_helper helper;
+	std::list<drive_container> ret;
+	std::vector<std::string> found_drives;
+	BOOST_FOREACH(const std::string &d, drives) {
+		if (d == "all-volumes" || d == "volumes") {
+			find_all_volumes(ret, found_drives, helper);
+		} else if (d == "all-drives" || d == "drives") {
+			find_all_drives(ret, found_drives, helper);
+		} else if (d == "all" || d == "*") {
+			find_all_volumes(ret, found_drives, helper);
+			find_all_drives(ret, found_drives, helper);
+		} else {
+			std::wstring drive = utf8::cvt<std::wstring>(d);
+			if (d.length() == 1)
+				drive = drive + L":";
+			ret.push_back(get_dc_from_string(drive, helper));
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "file_content.hpp"
+
+#include <utf8.hpp>
+#include <str/format.hpp>
+
+#include <algorithm>
+#include <list>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NSCP_HAVE_SSE2
+#endif
+
+#ifdef USE_SSL
+#include <openssl/evp.h>
+#endif
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace file_content {
+
+	const std::size_t read_buffer_size = 256 * 1024;
+	const std::size_t max_cache_entries = 4096;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Line counting
+
+#ifdef NSCP_HAVE_SSE2
+	inline unsigned long long sum_bytes(__m128i acc) {
+		__m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+		return static_cast<unsigned long long>(_mm_cvtsi128_si32(sum)) + static_cast<unsigned long long>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+	}
+#endif
+
+	void line_counter::update(const char *data, std::size_t len) {
+		if (len == 0)
+			return;
+		if (last_cr && data[0] == '\n')
+			crlf++;
+		std::size_t i = 0;
+#ifdef NSCP_HAVE_SSE2
+		const __m128i v_lf = _mm_set1_epi8('\n');
+		const __m128i v_cr = _mm_set1_epi8('\r');
+		// Each lane counts matches as 0xff (-1) so subtracting adds one, lanes overflow after 255 rounds.
+		while (i + 17 <= len) {
+			__m128i acc_lf = _mm_setzero_si128();
+			__m128i acc_cr = _mm_setzero_si128();
+			__m128i acc_crlf = _mm_setzero_si128();
+			for (int rounds = 0; rounds < 255 && i + 17 <= len; rounds++, i += 16) {
+				__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				__m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+				__m128i is_cr = _mm_cmpeq_epi8(chunk, v_cr);
+				acc_lf = _mm_sub_epi8(acc_lf, _mm_cmpeq_epi8(chunk, v_lf));
+				acc_cr = _mm_sub_epi8(acc_cr, is_cr);
+				acc_crlf = _mm_sub_epi8(acc_crlf, _mm_and_si128(is_cr, _mm_cmpeq_epi8(next, v_lf)));
+			}
+			lf += sum_bytes(acc_lf);
+			cr += sum_bytes(acc_cr);
+			crlf += sum_bytes(acc_crlf);
+		}
+#endif
+		for (; i < len; i++) {
+			if (data[i] == '\n') {
+				lf++;
+			} else if (data[i] == '\r') {
+				cr++;
+				if (i + 1 < len && data[i + 1] == '\n')
+					crlf++;
+			}
+		}
+		last_cr = data[len - 1] == '\r';
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// XXH64
+
+	static const unsigned long long PRIME64_1 = 11400714785074694791ULL;
+	static const unsigned long long PRIME64_2 = 14029467366897019727ULL;
+	static const unsigned long long PRIME64_3 = 1609587929392839161ULL;
+	static const unsigned long long PRIME64_4 = 9650029242287828579ULL;
+	static const unsigned long long PRIME64_5 = 2870177450012600261ULL;
+
+	inline unsigned long long rotl64(unsigned long long x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+	inline unsigned long long read64(const unsigned char *p) {
+		unsigned long long v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	inline unsigned long long read32(const unsigned char *p) {
+		unsigned int v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	inline unsigned long long xxh_round(unsigned long long acc, unsigned long long input) {
+		acc += input * PRIME64_2;
+		acc = rotl64(acc, 31);
+		return acc * PRIME64_1;
+	}
+	inline unsigned long long xxh_merge(unsigned long long acc, unsigned long long val) {
+		acc ^= xxh_round(0, val);
+		return acc * PRIME64_1 + PRIME64_4;
+	}
+
+	xxhash64::xxhash64()
+		: v1(PRIME64_1 + PRIME64_2)
+		, v2(PRIME64_2)
+		, v3(0)
+		, v4(0 - PRIME64_1)
+		, total_len(0)
+		, mem_size(0) {}
+
+	void xxhash64::update(const char *data, std::size_t len) {
+		const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+		const unsigned char *end = p + len;
+		total_len += len;
+		if (mem_size + len < 32) {
+			memcpy(mem + mem_size, p, len);
+			mem_size += len;
+			return;
+		}
+		if (mem_size > 0) {
+			memcpy(mem + mem_size, p, 32 - mem_size);
+			p += 32 - mem_size;
+			v1 = xxh_round(v1, read64(mem));
+			v2 = xxh_round(v2, read64(mem + 8));
+			v3 = xxh_round(v3, read64(mem + 16));
+			v4 = xxh_round(v4, read64(mem + 24));
+			mem_size = 0;
+		}
+		for (; p + 32 <= end; p += 32) {
+			v1 = xxh_round(v1, read64(p));
+			v2 = xxh_round(v2, read64(p + 8));
+			v3 = xxh_round(v3, read64(p + 16));
+			v4 = xxh_round(v4, read64(p + 24));
+		}
+		if (p < end) {
+			memcpy(mem, p, end - p);
+			mem_size = end - p;
+		}
+	}
+
+	unsigned long long xxhash64::digest() const {
+		unsigned long long h;
+		if (total_len >= 32) {
+			h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+			h = xxh_merge(h, v1);
+			h = xxh_merge(h, v2);
+			h = xxh_merge(h, v3);
+			h = xxh_merge(h, v4);
+		} else {
+			h = v3 + PRIME64_5;
+		}
+		h += total_len;
+		const unsigned char *p = mem;
+		const unsigned char *end = mem + mem_size;
+		for (; p + 8 <= end; p += 8) {
+			h ^= xxh_round(0, read64(p));
+			h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+		}
+		if (p + 4 <= end) {
+			h ^= read32(p) * PRIME64_1;
+			h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+			p += 4;
+		}
+		for (; p < end; p++) {
+			h ^= (*p) * PRIME64_5;
+			h = rotl64(h, 11) * PRIME64_1;
+		}
+		h ^= h >> 33;
+		h *= PRIME64_2;
+		h ^= h >> 29;
+		h *= PRIME64_3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	std::string to_hex(const unsigned char *data, std::size_t len) {
+		static const char digits[] = "0123456789abcdef";
+		std::string ret;
+		ret.reserve(len * 2);
+		for (std::size_t i = 0; i < len; i++) {
+			ret += digits[data[i] >> 4];
+			ret += digits[data[i] & 0xf];
+		}
+		return ret;
+	}
+
+	std::string to_hex(unsigned long long value) {
+		unsigned char data[8];
+		for (int i = 7; i >= 0; i--) {
+			data[i] = static_cast<unsigned char>(value & 0xff);
+			value >>= 8;
+		}
+		return to_hex(data, sizeof(data));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// SHA-256
+
+	bool has_sha256_support() {
+#ifdef USE_SSL
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	class sha256_hasher {
+#ifdef USE_SSL
+		EVP_MD_CTX *ctx_;
+	public:
+		sha256_hasher() : ctx_(EVP_MD_CTX_create()) {
+			EVP_DigestInit_ex(ctx_, EVP_sha256(), NULL);
+		}
+		~sha256_hasher() {
+			EVP_MD_CTX_destroy(ctx_);
+		}
+		void update(const char *data, std::size_t len) {
+			EVP_DigestUpdate(ctx_, data, len);
+		}
+		std::string digest() {
+			unsigned char md[EVP_MAX_MD_SIZE];
+			unsigned int len = 0;
+			EVP_DigestFinal_ex(ctx_, md, &len);
+			return to_hex(md, len);
+		}
+#else
+	public:
+		sha256_hasher() {}
+		void update(const char *, std::size_t) {}
+		std::string digest() { return ""; }
+#endif
+	private:
+		sha256_hasher(const sha256_hasher&);
+		sha256_hasher& operator=(const sha256_hasher&);
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Substring search across buffer boundaries
+
+	void needle_search::update(const char *data, std::size_t len) {
+		if (found_ || len == 0)
+			return;
+		const std::size_t overlap = needle_.size() - 1;
+		// Matches straddling the previous buffer
+		if (!carry_.empty()) {
+			std::string seam = carry_ + std::string(data, std::min(len, overlap));
+			if (seam.find(needle_) != std::string::npos) {
+				found_ = true;
+				return;
+			}
+		}
+		if (searcher_(data, data + len).first != data + len) {
+			found_ = true;
+			return;
+		}
+		if (len >= overlap) {
+			carry_.assign(data + len - overlap, overlap);
+		} else {
+			carry_.append(data, len);
+			if (carry_.size() > overlap)
+				carry_.erase(0, carry_.size() - overlap);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Cache
+
+	bool get_stamp(const std::string &file, file_stamp &stamp) {
+#ifdef WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesEx(utf8::cvt<std::wstring>(file).c_str(), GetFileExInfoStandard, &data))
+			return false;
+		stamp.size = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) + data.nFileSizeLow;
+		stamp.mtime = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) + data.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat st;
+		if (stat(file.c_str(), &st) != 0)
+			return false;
+		stamp.size = st.st_size;
+		stamp.mtime = str::format::time_to_filetime(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+#endif
+		return true;
+	}
+
+	struct cache_entry {
+		file_stamp stamp;
+		result data;
+		std::list<std::string>::iterator lru;
+	};
+
+	class content_cache {
+		typedef std::map<std::string, cache_entry> map_type;
+		boost::mutex mutex_;
+		map_type entries_;
+		std::list<std::string> lru_;
+
+	public:
+		bool get(const std::string &file, const file_stamp &stamp, result &res) {
+			boost::mutex::scoped_lock lock(mutex_);
+			map_type::iterator it = entries_.find(file);
+			if (it == entries_.end())
+				return false;
+			if (!(it->second.stamp == stamp)) {
+				lru_.erase(it->second.lru);
+				entries_.erase(it);
+				return false;
+			}
+			lru_.splice(lru_.begin(), lru_, it->second.lru);
+			res = it->second.data;
+			return true;
+		}
+
+		void put(const std::string &file, const file_stamp &stamp, const result &res) {
+			boost::mutex::scoped_lock lock(mutex_);
+			map_type::iterator it = entries_.find(file);
+			if (it != entries_.end()) {
+				it->second.stamp = stamp;
+				it->second.data = res;
+				lru_.splice(lru_.begin(), lru_, it->second.lru);
+				return;
+			}
+			while (entries_.size() >= max_cache_entries && !lru_.empty()) {
+				entries_.erase(lru_.back());
+				lru_.pop_back();
+			}
+			lru_.push_front(file);
+			cache_entry &e = entries_[file];
+			e.stamp = stamp;
+			e.data = res;
+			e.lru = lru_.begin();
+		}
+	};
+
+	content_cache cache;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	bool scan(const std::string &file, const request &req, result &res, std::string &error) {
+		file_stamp stamp;
+		if (!get_stamp(file, stamp)) {
+			error = "Failed to open: " + file;
+			return false;
+		}
+		return scan(file, stamp, req, res, error);
+	}
+
+	bool scan(const std::string &file, const file_stamp &stamp, const request &req, result &res, std::string &error) {
+		cache.get(file, stamp, res);
+
+		bool want_lines = req.line_count && !res.has_line_count;
+		bool want_xxhash = req.xxhash && !res.has_xxhash;
+		bool want_sha256 = req.sha256 && !res.has_sha256 && has_sha256_support();
+		std::list<boost::shared_ptr<needle_search> > searches;
+		BOOST_FOREACH(const std::string &n, req.needles) {
+			if (res.needles.find(n) == res.needles.end())
+				searches.push_back(boost::shared_ptr<needle_search>(new needle_search(n)));
+		}
+		if (!want_lines && !want_xxhash && !want_sha256 && searches.empty())
+			return true;
+
+#ifdef WIN32
+		FILE *fp = _wfopen(utf8::cvt<std::wstring>(file).c_str(), L"rb");
+#else
+		FILE *fp = fopen(file.c_str(), "rb");
+#endif
+		if (fp == NULL) {
+			error = "Failed to open: " + file;
+			return false;
+		}
+		setvbuf(fp, NULL, _IONBF, 0);
+		std::vector<char> buffer(read_buffer_size);
+		line_counter lines;
+		xxhash64 xxh;
+		sha256_hasher sha;
+		std::size_t pending_needles = searches.size();
+		while (true) {
+			std::size_t len = fread(&buffer[0], 1, buffer.size(), fp);
+			if (len == 0)
+				break;
+			const char *data = &buffer[0];
+			if (want_lines)
+				lines.update(data, len);
+			if (want_xxhash)
+				xxh.update(data, len);
+			if (want_sha256)
+				sha.update(data, len);
+			if (pending_needles > 0) {
+				pending_needles = 0;
+				BOOST_FOREACH(boost::shared_ptr<needle_search> &s, searches) {
+					s->update(data, len);
+					if (!s->found())
+						pending_needles++;
+				}
+				// Stop early if we only look for strings and we found them all
+				if (pending_needles == 0 && !want_lines && !want_xxhash && !want_sha256)
+					break;
+			}
+		}
+		bool failed = ferror(fp) != 0;
+		fclose(fp);
+		if (failed) {
+			error = "Failed to read: " + file;
+			return false;
+		}
+
+		if (want_lines) {
+			res.has_line_count = true;
+			res.line_count = static_cast<unsigned long>(lines.get_count());
+		}
+		if (want_xxhash) {
+			res.has_xxhash = true;
+			res.xxhash = to_hex(xxh.digest());
+		}
+		if (want_sha256) {
+			res.has_sha256 = true;
+			res.sha256 = sha.digest();
+		}
+		BOOST_FOREACH(const boost::shared_ptr<needle_search> &s, searches) {
+			res.needles[s->get_needle()] = s->found();
+		}
+		cache.put(file, stamp, res);
+		return true;
+	}
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/algorithm/searching/boyer_moore_horspool.hpp>
+
+namespace file_content {
+
+	// Counts lines in a stream of buffers (\n, \r\n and lone \r all end a line).
+	struct line_counter {
+		unsigned long long lf;
+		unsigned long long cr;
+		unsigned long long crlf;
+		bool last_cr;
+		line_counter() : lf(0), cr(0), crlf(0), last_cr(false) {}
+		void update(const char *data, std::size_t len);
+		unsigned long long get_count() const { return lf + cr - crlf; }
+	};
+
+	// Streaming XXH64 (seed 0)
+	class xxhash64 {
+		unsigned long long v1, v2, v3, v4;
+		unsigned long long total_len;
+		unsigned char mem[32];
+		std::size_t mem_size;
+	public:
+		xxhash64();
+		void update(const char *data, std::size_t len);
+		unsigned long long digest() const;
+	};
+
+	// Substring search in a stream of buffers (finds matches straddling two buffers)
+	class needle_search {
+		typedef boost::algorithm::boyer_moore_horspool<std::string::const_iterator> searcher_type;
+		std::string needle_;
+		searcher_type searcher_;
+		std::string carry_;
+		bool found_;
+	public:
+		needle_search(const std::string &needle) : needle_(needle), searcher_(needle_.begin(), needle_.end()), found_(needle.empty()) {}
+
+		bool found() const { return found_; }
+		const std::string& get_needle() const { return needle_; }
+		void update(const char *data, std::size_t len);
+	};
+
+	struct request {
+		bool line_count;
+		bool xxhash;
+		bool sha256;
+		std::set<std::string> needles;
+		request() : line_count(false), xxhash(false), sha256(false) {}
+		bool empty() const { return !line_count && !xxhash && !sha256 && needles.empty(); }
+	};
+
+	struct result {
+		bool has_line_count;
+		unsigned long line_count;
+		bool has_xxhash;
+		std::string xxhash;
+		bool has_sha256;
+		std::string sha256;
+		std::map<std::string, bool> needles;
+		result() : has_line_count(false), line_count(0), has_xxhash(false), has_sha256(false) {}
+	};
+
+	// Size and last write time (FILETIME) identifying a version of a file
+	struct file_stamp {
+		unsigned long long size;
+		unsigned long long mtime;
+		file_stamp() : size(0), mtime(0) {}
+		file_stamp(unsigned long long size, unsigned long long mtime) : size(size), mtime(mtime) {}
+		bool operator==(const file_stamp &other) const { return size == other.size && mtime == other.mtime; }
+	};
+
+	bool has_sha256_support();
+
+	bool get_stamp(const std::string &file, file_stamp &stamp);
+
+	// Read the file once computing everything asked for in the request.
+	// Results are cached by path and only reused as long as size and modification time are unchanged.
+	bool scan(const std::string &file, const request &req, result &res, std::string &error);
+	// Same as above when the caller already has the stamp (from the directory scan)
+	bool scan(const std::string &file, const file_stamp &stamp, const request &req, result &res, std::string &error);
+}
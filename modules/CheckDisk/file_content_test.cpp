@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "file_content.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+	unsigned long long count_lines(const std::string &data, std::size_t chunk) {
+		file_content::line_counter counter;
+		for (std::size_t i = 0; i < data.size(); i += chunk)
+			counter.update(data.c_str() + i, std::min(chunk, data.size() - i));
+		return counter.get_count();
+	}
+
+	unsigned long long xxh64(const std::string &data, std::size_t chunk) {
+		file_content::xxhash64 hash;
+		for (std::size_t i = 0; i < data.size(); i += chunk)
+			hash.update(data.c_str() + i, std::min(chunk, data.size() - i));
+		return hash.digest();
+	}
+
+	bool search(const std::string &needle, const std::string &data, std::size_t chunk) {
+		file_content::needle_search s(needle);
+		for (std::size_t i = 0; i < data.size(); i += chunk)
+			s.update(data.c_str() + i, std::min(chunk, data.size() - i));
+		return s.found();
+	}
+
+	// Same rules as line_counter without any tricks
+	unsigned long long naive_count(const std::string &data) {
+		unsigned long long count = 0;
+		for (std::size_t i = 0; i < data.size(); i++) {
+			if (data[i] == '\n')
+				count++;
+			else if (data[i] == '\r' && (i + 1 >= data.size() || data[i + 1] != '\n'))
+				count++;
+		}
+		return count;
+	}
+}
+
+TEST(line_counter, line_endings) {
+	EXPECT_EQ(0u, count_lines("", 1));
+	EXPECT_EQ(3u, count_lines("a\nb\nc\n", 1024));
+	EXPECT_EQ(3u, count_lines("a\r\nb\r\nc\r\n", 1024));
+	EXPECT_EQ(3u, count_lines("a\rb\rc\r", 1024));
+	EXPECT_EQ(4u, count_lines("a\n\r\n\r\r\n", 1024));
+	EXPECT_EQ(2u, count_lines("\n\n", 1024));
+}
+
+TEST(line_counter, last_line_without_newline) {
+	// Like wc -l only terminated lines are counted
+	EXPECT_EQ(0u, count_lines("a", 1024));
+	EXPECT_EQ(1u, count_lines("a\nb", 1024));
+	EXPECT_EQ(1u, count_lines("a\r\nb", 1024));
+	EXPECT_EQ(2u, count_lines("a\r\nb\r", 1024));
+}
+
+TEST(line_counter, crlf_split_across_buffers) {
+	file_content::line_counter counter;
+	counter.update("a\r", 2);
+	counter.update("\nb\r", 3);
+	counter.update("\n", 1);
+	EXPECT_EQ(2u, counter.get_count());
+
+	// Every split position of a longer text gives the same result
+	std::string text;
+	for (int i = 0; i < 200; i++)
+		text += i % 3 == 0 ? "line\r\n" : i % 3 == 1 ? "x\n" : "y\r";
+	text += "tail";
+	unsigned long long expected = naive_count(text);
+	EXPECT_EQ(200u, expected);
+	for (std::size_t chunk = 1; chunk < 40; chunk++)
+		EXPECT_EQ(expected, count_lines(text, chunk)) << "chunk: " << chunk;
+	EXPECT_EQ(expected, count_lines(text, text.size()));
+}
+
+TEST(line_counter, long_buffers) {
+	// Long enough for the vectorized path to overflow its byte counters (255 rounds of 16 bytes)
+	std::string text;
+	for (int i = 0; i < 10000; i++)
+		text += (i % 7 == 0) ? "\r\n" : (i % 5 == 0) ? "\r" : (i % 2 == 0) ? "\n" : "abc";
+	EXPECT_EQ(naive_count(text), count_lines(text, text.size()));
+	EXPECT_EQ(naive_count(text), count_lines(text, 4097));
+}
+
+TEST(xxhash64, known_vectors) {
+	EXPECT_EQ(0xEF46DB3751D8E999ULL, xxh64("", 1));
+	EXPECT_EQ(0xD24EC4F1A98C6E5BULL, xxh64("a", 1));
+	EXPECT_EQ(0x44BC2CF5AD770999ULL, xxh64("abc", 3));
+	EXPECT_EQ(0xFBCEA83C8A378BF1ULL, xxh64("Nobody inspects the spammish repetition", 1024));
+	EXPECT_EQ(0x0B242D361FDA71BCULL, xxh64("The quick brown fox jumps over the lazy dog", 1024));
+}
+
+TEST(xxhash64, streaming) {
+	std::string text;
+	for (int i = 0; i < 1000; i++)
+		text += static_cast<char>(i * 7 + 3);
+	unsigned long long expected = xxh64(text, text.size());
+	for (std::size_t chunk = 1; chunk < 70; chunk++)
+		EXPECT_EQ(expected, xxh64(text, chunk)) << "chunk: " << chunk;
+	EXPECT_EQ(0xFBCEA83C8A378BF1ULL, xxh64("Nobody inspects the spammish repetition", 5));
+}
+
+TEST(needle_search, within_buffer) {
+	EXPECT_TRUE(search("needle", "a haystack with a needle in it", 1024));
+	EXPECT_FALSE(search("needle", "a haystack with a needl in it", 1024));
+	EXPECT_TRUE(search("", "anything", 1024));
+	EXPECT_TRUE(search("x", "x", 1024));
+}
+
+TEST(needle_search, across_buffers) {
+	std::string text = "0123456789 some text with a needle somewhere 0123456789";
+	for (std::size_t chunk = 1; chunk <= text.size(); chunk++) {
+		EXPECT_TRUE(search("needle", text, chunk)) << "chunk: " << chunk;
+		EXPECT_TRUE(search("a needle s", text, chunk)) << "chunk: " << chunk;
+		EXPECT_FALSE(search("needles", text, chunk)) << "chunk: " << chunk;
+	}
+	// The needle spans more than two (small) buffers
+	file_content::needle_search s("abcdef");
+	s.update("xxab", 4);
+	s.update("c", 1);
+	s.update("d", 1);
+	EXPECT_FALSE(s.found());
+	s.update("efxx", 4);
+	EXPECT_TRUE(s.found());
+}
+
+TEST(file_content, scan) {
+	boost::filesystem::path file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("nscp-content-%%%%-%%%%.txt");
+	{
+		// The needle straddles the read buffer boundary (256k)
+		std::string text(256 * 1024 - 3, 'x');
+		text += "needle\r\nabc\n";
+		std::ofstream out(file.string().c_str(), std::ios::out | std::ios::binary);
+		out << text;
+	}
+	file_content::request req;
+	req.line_count = true;
+	req.xxhash = true;
+	req.needles.insert("needle");
+	req.needles.insert("missing");
+	file_content::result res;
+	std::string error;
+	EXPECT_TRUE(file_content::scan(file.string(), req, res, error)) << error;
+	boost::filesystem::remove(file);
+
+	EXPECT_TRUE(res.has_line_count);
+	EXPECT_EQ(2u, res.line_count);
+	EXPECT_TRUE(res.has_xxhash);
+	EXPECT_EQ(16u, res.xxhash.size());
+	EXPECT_TRUE(res.needles["needle"]);
+	EXPECT_FALSE(res.needles["missing"]);
+}
@@ -29,6 +29,9 @@
 #ifndef FILE_ATTRIBUTE_DIRECTORY
 #define FILE_ATTRIBUTE_DIRECTORY 0x00000010
 #endif
+#ifndef FILE_ATTRIBUTE_DEVICE
+#define FILE_ATTRIBUTE_DEVICE 0x00000040
+#endif
 bool file_finder::is_directory(unsigned long dwAttr) {
 	if (dwAttr == INVALID_FILE_ATTRIBUTES) {
 		return false;
@@ -37,7 +40,13 @@ bool file_finder::is_directory(unsigned long dwAttr) {
 	}
 	return false;
 }
+bool file_finder::has_content(unsigned long dwAttr) {
+	if (dwAttr == INVALID_FILE_ATTRIBUTES)
+		return false;
+	return (dwAttr & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)) == 0;
+}
 
+#ifdef WIN32
 void file_finder::recursive_scan(file_filter::filter &filter, scanner_context &context, boost::filesystem::path dir, boost::shared_ptr<file_filter::filter_obj> total_obj, bool total_all, bool recursive, int current_level) {
 	if (!context.is_valid_level(current_level)) {
 		if (context.debug) context.report_debug("Level death exhausted: " + str::xtos(current_level));
@@ -98,6 +107,7 @@ void file_finder::recursive_scan(file_filter::filter &filter, scanner_context &c
 		FindClose(hFind);
 	}
 }
+#endif
 
 bool file_finder::scanner_context::is_valid_level(int current_level) {
 	return max_depth == -1 || current_level < max_depth;
@@ -28,12 +28,17 @@
 
 namespace file_finder {
 	bool is_directory(unsigned long dwAttr);
+	// False for directories and special files (fifos, sockets and devices) which must not be read
+	bool has_content(unsigned long dwAttr);
 
 	struct scanner_context {
 		bool debug;
 		std::string pattern;
 		DWORD now;
 		int max_depth;
+		unsigned int fields;
+		int threads;
+		scanner_context() : debug(false), now(0), max_depth(-1), fields(file_filter::field_none), threads(0) {}
 		bool is_valid_level(int current_level);
 		void report_error(const std::string str);
 		void report_debug(const std::string str);
@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "file_finder.hpp"
+#include <nscapi/macros.hpp>
+#include <nscapi/nscapi_helper_singleton.hpp>
+
+#include <utf8.hpp>
+#include <str/xtos.hpp>
+#include <str/format.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "filter.hpp"
+
+#ifndef FILE_ATTRIBUTE_DIRECTORY
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#endif
+#ifndef FILE_ATTRIBUTE_DEVICE
+#define FILE_ATTRIBUTE_DEVICE 0x00000040
+#endif
+
+#if defined(__linux__) && defined(SYS_getdents64)
+#define NSCP_HAVE_GETDENTS64
+#endif
+#if defined(__linux__) && defined(STATX_BASIC_STATS) && defined(AT_STATX_DONT_SYNC)
+#define NSCP_HAVE_STATX
+#endif
+
+namespace file_finder {
+	namespace unix_scanner {
+
+		const std::size_t dirent_buffer_size = 64 * 1024;
+		const std::size_t result_batch_size = 512;
+		const std::size_t max_pending_batches = 64;
+		const int max_default_threads = 8;
+
+		struct entry_stat {
+			bool is_dir;
+			// Not a directory, regular file or symbolic link
+			bool is_special;
+			unsigned long long size;
+			unsigned long long access;
+			unsigned long long creation;
+			unsigned long long write;
+			entry_stat() : is_dir(false), is_special(false), size(0), access(0), creation(0), write(0) {}
+
+			void set_type(unsigned int mode) {
+				is_dir = S_ISDIR(mode);
+				is_special = !is_dir && !S_ISREG(mode) && !S_ISLNK(mode);
+			}
+			DWORD get_attributes() const {
+				if (is_dir)
+					return FILE_ATTRIBUTE_DIRECTORY;
+				return is_special ? FILE_ATTRIBUTE_DEVICE : 0;
+			}
+		};
+
+		// Read the attributes needed by the filter relative to an open directory.
+		// Only the fields asked for are requested from the kernel (which for some file systems saves a lot of work).
+		bool stat_entry(int dir_fd, const char *name, unsigned int fields, entry_stat &result) {
+#ifdef NSCP_HAVE_STATX
+			static boost::atomic<bool> has_statx(true);
+			if (has_statx.load(boost::memory_order_relaxed)) {
+				unsigned int mask = STATX_TYPE;
+				if ((fields & file_filter::field_size) != 0)
+					mask |= STATX_SIZE;
+				if ((fields & file_filter::field_access) != 0)
+					mask |= STATX_ATIME;
+				if ((fields & file_filter::field_creation) != 0)
+					mask |= STATX_BTIME | STATX_CTIME;
+				if ((fields & file_filter::field_write) != 0)
+					mask |= STATX_MTIME;
+				struct statx stx;
+				if (statx(dir_fd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC, mask, &stx) == 0) {
+					result.set_type(stx.stx_mode);
+					result.size = stx.stx_size;
+					result.access = str::format::time_to_filetime(stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec);
+					result.write = str::format::time_to_filetime(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+					if ((stx.stx_mask & STATX_BTIME) != 0)
+						result.creation = str::format::time_to_filetime(stx.stx_btime.tv_sec, stx.stx_btime.tv_nsec);
+					else
+						result.creation = str::format::time_to_filetime(stx.stx_ctime.tv_sec, stx.stx_ctime.tv_nsec);
+					return true;
+				}
+				if (errno != ENOSYS)
+					return false;
+				has_statx = false;
+			}
+#endif
+			struct stat st;
+			if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+				return false;
+			result.set_type(st.st_mode);
+			result.size = st.st_size;
+			result.access = str::format::time_to_filetime(st.st_atim.tv_sec, st.st_atim.tv_nsec);
+			result.creation = str::format::time_to_filetime(st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+			result.write = str::format::time_to_filetime(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+			return true;
+		}
+
+		// Thin wrapper around getdents64 (falling back to readdir) using a buffer owned by the worker.
+		class directory_reader {
+			int fd_;
+#ifdef NSCP_HAVE_GETDENTS64
+			struct linux_dirent64 {
+				uint64_t d_ino;
+				int64_t d_off;
+				unsigned short d_reclen;
+				unsigned char d_type;
+				char d_name[1];
+			};
+			std::vector<char> &buffer_;
+			long length_;
+			long offset_;
+#else
+			DIR *dir_;
+#endif
+
+		public:
+			directory_reader(int fd, std::vector<char> &buffer)
+				: fd_(fd)
+#ifdef NSCP_HAVE_GETDENTS64
+				, buffer_(buffer)
+				, length_(0)
+				, offset_(0)
+#else
+				, dir_(fdopendir(fd))
+#endif
+			{}
+			~directory_reader() {
+#ifndef NSCP_HAVE_GETDENTS64
+				if (dir_ != NULL) {
+					closedir(dir_);
+					return;
+				}
+#endif
+				close(fd_);
+			}
+
+			bool next(const char *&name, unsigned char &type) {
+#ifdef NSCP_HAVE_GETDENTS64
+				if (offset_ >= length_) {
+					length_ = syscall(SYS_getdents64, fd_, &buffer_[0], buffer_.size());
+					offset_ = 0;
+					if (length_ <= 0)
+						return false;
+				}
+				const linux_dirent64 *d = reinterpret_cast<const linux_dirent64*>(&buffer_[offset_]);
+				offset_ += d->d_reclen;
+				name = d->d_name;
+				type = d->d_type;
+				return true;
+#else
+				if (dir_ == NULL)
+					return false;
+				struct dirent *d = readdir(dir_);
+				if (d == NULL)
+					return false;
+				name = d->d_name;
+				type = d->d_type;
+				return true;
+#endif
+			}
+		};
+
+		struct dir_task {
+			std::string path;
+			int level;
+			dir_task() : level(0) {}
+			dir_task(std::string path, int level) : path(path), level(level) {}
+		};
+
+		typedef boost::shared_ptr<file_filter::filter_obj> object_type;
+		typedef std::vector<object_type> batch_type;
+
+		// Parallel directory walker.
+		// Each worker owns a deque of directories: it pushes and pops at the back (depth first) and
+		// idle workers steal from the front of other workers queues.
+		// Workers only list and stat, all filter evaluation is done by the calling thread as the
+		// filter (and the scanner context) is not thread safe. Warnings and debug messages are
+		// collected per worker and reported by the calling thread once the workers are done.
+		class parallel_walker {
+			struct worker_queue {
+				boost::mutex mutex;
+				std::deque<dir_task> tasks;
+			};
+			struct worker_log {
+				std::vector<std::string> warnings;
+				std::vector<std::string> debug;
+			};
+
+			scanner_context &context_;
+			std::string pattern_;
+			bool match_all_;
+			bool need_stat_;
+			std::size_t thread_count_;
+			std::vector<boost::shared_ptr<worker_queue> > queues_;
+			std::vector<worker_log> logs_;
+
+			// Directories queued or being scanned, when this reaches 0 all work is done.
+			boost::atomic<long> pending_;
+			boost::atomic<long> available_;
+			boost::atomic<bool> aborted_;
+			boost::mutex idle_mutex_;
+			boost::condition_variable idle_cond_;
+			std::size_t idle_workers_;
+
+			boost::mutex result_mutex_;
+			boost::condition_variable result_cond_;
+			boost::condition_variable space_cond_;
+			std::deque<batch_type> results_;
+			std::size_t finished_workers_;
+
+		public:
+			parallel_walker(scanner_context &context)
+				: context_(context)
+				, pattern_(context.pattern)
+				, need_stat_((context.fields & ~file_filter::field_type) != 0)
+				, thread_count_(1)
+				, pending_(0)
+				, available_(0)
+				, aborted_(false)
+				, idle_workers_(0)
+				, finished_workers_(0) {
+				match_all_ = pattern_.empty() || pattern_ == "*" || pattern_ == "*.*";
+				int threads = context.threads;
+				if (threads <= 0) {
+					threads = static_cast<int>(boost::thread::hardware_concurrency());
+					if (threads > max_default_threads)
+						threads = max_default_threads;
+				}
+				if (threads > 0)
+					thread_count_ = threads;
+				for (std::size_t i = 0; i < thread_count_; i++)
+					queues_.push_back(boost::shared_ptr<worker_queue>(new worker_queue()));
+				logs_.resize(thread_count_);
+			}
+
+			template<class Tcallback>
+			void run(const std::string &root, int level, Tcallback &callback) {
+				push_task(0, dir_task(root, level));
+				boost::thread_group workers;
+				for (std::size_t i = 0; i < thread_count_; i++)
+					workers.create_thread(boost::bind(&parallel_walker::worker, this, i));
+
+				try {
+					while (true) {
+						batch_type batch;
+						{
+							boost::unique_lock<boost::mutex> lock(result_mutex_);
+							while (results_.empty() && finished_workers_ < thread_count_)
+								result_cond_.wait(lock);
+							if (results_.empty())
+								break;
+							batch.swap(results_.front());
+							results_.pop_front();
+						}
+						space_cond_.notify_one();
+						BOOST_FOREACH(const object_type &o, batch) {
+							callback(o);
+						}
+					}
+				} catch (...) {
+					abort();
+					workers.join_all();
+					throw;
+				}
+				workers.join_all();
+				report();
+			}
+
+		private:
+			void report() {
+				BOOST_FOREACH(const worker_log &log, logs_) {
+					BOOST_FOREACH(const std::string &msg, log.debug) {
+						context_.report_debug(msg);
+					}
+					BOOST_FOREACH(const std::string &msg, log.warnings) {
+						context_.report_warning(msg);
+					}
+				}
+			}
+
+			void abort() {
+				aborted_ = true;
+				{
+					boost::mutex::scoped_lock lock(idle_mutex_);
+					idle_cond_.notify_all();
+				}
+				boost::mutex::scoped_lock lock(result_mutex_);
+				results_.clear();
+				space_cond_.notify_all();
+			}
+
+			bool matches(const char *name) const {
+				return match_all_ || fnmatch(pattern_.c_str(), name, 0) == 0;
+			}
+
+			void push_task(std::size_t id, const dir_task &task) {
+				pending_++;
+				{
+					boost::mutex::scoped_lock lock(queues_[id]->mutex);
+					queues_[id]->tasks.push_back(task);
+				}
+				available_++;
+				boost::mutex::scoped_lock lock(idle_mutex_);
+				if (idle_workers_ > 0)
+					idle_cond_.notify_one();
+			}
+
+			bool pop_task(std::size_t id, dir_task &task) {
+				{
+					worker_queue &q = *queues_[id];
+					boost::mutex::scoped_lock lock(q.mutex);
+					if (!q.tasks.empty()) {
+						task = q.tasks.back();
+						q.tasks.pop_back();
+						available_--;
+						return true;
+					}
+				}
+				for (std::size_t i = 1; i < thread_count_; i++) {
+					worker_queue &q = *queues_[(id + i) % thread_count_];
+					boost::mutex::scoped_lock lock(q.mutex);
+					if (!q.tasks.empty()) {
+						task = q.tasks.front();
+						q.tasks.pop_front();
+						available_--;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			void flush(batch_type &batch) {
+				if (batch.empty())
+					return;
+				boost::unique_lock<boost::mutex> lock(result_mutex_);
+				while (results_.size() >= max_pending_batches && !aborted_)
+					space_cond_.wait(lock);
+				if (aborted_) {
+					batch.clear();
+					return;
+				}
+				results_.push_back(batch_type());
+				results_.back().swap(batch);
+				result_cond_.notify_one();
+			}
+
+			void worker(std::size_t id) {
+				std::vector<char> buffer(dirent_buffer_size);
+				batch_type batch;
+				batch.reserve(result_batch_size);
+				while (!aborted_) {
+					dir_task task;
+					if (pop_task(id, task)) {
+						scan_directory(id, task, buffer, batch);
+						if (--pending_ == 0) {
+							boost::mutex::scoped_lock lock(idle_mutex_);
+							idle_cond_.notify_all();
+						}
+						continue;
+					}
+					flush(batch);
+					boost::unique_lock<boost::mutex> lock(idle_mutex_);
+					if (pending_ == 0 || aborted_)
+						break;
+					if (available_ > 0)
+						continue;
+					idle_workers_++;
+					idle_cond_.wait(lock);
+					idle_workers_--;
+				}
+				flush(batch);
+				boost::mutex::scoped_lock lock(result_mutex_);
+				finished_workers_++;
+				result_cond_.notify_all();
+			}
+
+			void scan_directory(std::size_t id, const dir_task &task, std::vector<char> &buffer, batch_type &batch) {
+				if (!context_.is_valid_level(task.level)) {
+					if (context_.debug) logs_[id].debug.push_back("Level death exhausted: " + str::xtos(task.level));
+					return;
+				}
+				int fd = open(task.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				if (fd == -1) {
+					logs_[id].warnings.push_back("Failed to open " + task.path + ": " + utf8::utf8_from_native(strerror(errno)));
+					return;
+				}
+				bool recurse = context_.is_valid_level(task.level + 1);
+				boost::filesystem::path dir(task.path);
+				directory_reader reader(fd, buffer);
+				const char *name;
+				unsigned char type;
+				while (reader.next(name, type)) {
+					if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+						continue;
+					bool wanted = matches(name);
+					entry_stat info;
+					info.is_dir = type == DT_DIR;
+					info.is_special = type != DT_DIR && type != DT_REG && type != DT_LNK && type != DT_UNKNOWN;
+					if ((wanted && need_stat_) || type == DT_UNKNOWN) {
+						if (!stat_entry(fd, name, context_.fields, info)) {
+							if (errno != ENOENT)
+								logs_[id].warnings.push_back("Failed to stat " + task.path + "/" + name + ": " + utf8::utf8_from_native(strerror(errno)));
+							continue;
+						}
+					}
+					if (wanted) {
+						batch.push_back(object_type(new file_filter::filter_obj(dir, name, context_.now,
+							info.creation, info.access, info.write, info.size, info.get_attributes())));
+						if (batch.size() >= result_batch_size) {
+							flush(batch);
+							batch.reserve(result_batch_size);
+						}
+					}
+					if (info.is_dir && recurse)
+						push_task(id, dir_task((dir / name).string(), task.level + 1));
+				}
+			}
+		};
+
+		struct match_callback {
+			file_filter::filter &filter;
+			boost::shared_ptr<file_filter::filter_obj> total_obj;
+			bool total_all;
+			match_callback(file_filter::filter &filter, boost::shared_ptr<file_filter::filter_obj> total_obj, bool total_all)
+				: filter(filter), total_obj(total_obj), total_all(total_all) {}
+			void operator() (const object_type &info) {
+				modern_filter::match_result ret = filter.match(info);
+				if (total_obj && (ret.matched_filter || total_all))
+					total_obj->add(info);
+			}
+		};
+	}
+}
+
+void file_finder::recursive_scan(file_filter::filter &filter, scanner_context &context, boost::filesystem::path dir, boost::shared_ptr<file_filter::filter_obj> total_obj, bool total_all, bool recursive, int current_level) {
+	if (!context.is_valid_level(current_level)) {
+		if (context.debug) context.report_debug("Level death exhausted: " + str::xtos(current_level));
+		return;
+	}
+	std::string path = dir.string();
+	if (path.size() > 1 && path[path.size() - 1] == '/')
+		path = path.substr(0, path.size() - 1);
+	unix_scanner::match_callback callback(filter, total_obj, total_all);
+
+	unix_scanner::entry_stat info;
+	if (!unix_scanner::stat_entry(AT_FDCWD, path.c_str(), context.fields | file_filter::field_type, info)) {
+		if (recursive)
+			context.report_warning("Invalid file specified: " + path);
+		else
+			context.report_error("Invalid file specified: " + path);
+		return;
+	}
+	if (!info.is_dir) {
+		if (context.debug) context.report_debug("Found a file won't do recursive scan: " + path);
+		boost::filesystem::path file(path);
+		callback(unix_scanner::object_type(new file_filter::filter_obj(file.parent_path(), file.filename().string(), context.now,
+			info.creation, info.access, info.write, info.size, info.get_attributes())));
+		return;
+	}
+	unix_scanner::parallel_walker walker(context);
+	walker.run(path, current_level, callback);
+}
@@ -22,6 +22,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/assign.hpp>
+#include <boost/foreach.hpp>
 
 #include <parsers/where.hpp>
 
@@ -74,7 +75,19 @@ parsers::where::node_type fun_convert_type(boost::shared_ptr<file_filter::filter
 	return parsers::where::factory::create_int(-1);
 }
 
-file_filter::filter_obj_handler::filter_obj_handler() {
+parsers::where::node_type fun_contains(const value_type, evaluation_context context, const node_type subject) {
+	file_filter::native_context *n_context = reinterpret_cast<file_filter::native_context*>(context.get());
+	boost::shared_ptr<file_filter::filter_obj> object = n_context->get_object();
+	if (!object)
+		return factory::create_false();
+	BOOST_FOREACH(const node_type &n, subject->get_list_value(context)) {
+		if (!object->contains(context, n->get_string_value(context)))
+			return factory::create_false();
+	}
+	return factory::create_true();
+}
+
+file_filter::filter_obj_handler::filter_obj_handler() : required_fields_(field_none) {
 
 	const parsers::where::value_type type_custom_type = parsers::where::type_custom_int_2;
 
@@ -90,11 +103,13 @@ file_filter::filter_obj_handler::filter_obj_handler() {
 		("access_u", boost::bind(&filter_obj::get_access_su, _1), "Last access time (UTC)")
 		("creation_u", boost::bind(&filter_obj::get_creation_su, _1), "When file was created (UTC)")
 		("written_u", boost::bind(&filter_obj::get_written_su, _1), "When file was last written  to (UTC)")
+		("xxhash", &filter_obj::get_xxhash, "XXH64 checksum of the file content (hex)")
+		("sha256", &filter_obj::get_sha256, "SHA-256 checksum of the file content (hex)")
 		;
 
 	registry_.add_int()
 		("size", type_size, boost::bind(&filter_obj::get_size, _1), "File size").add_scaled_byte(std::string(""), " size")
-		("line_count", boost::bind(&filter_obj::get_line_count, _1), "Number of lines in the file (text files)")
+		("line_count", &filter_obj::get_line_count, "Number of lines in the file (text files)")
 		("access", type_date, boost::bind(&filter_obj::get_access, _1), "Last access time")
 		("creation", type_date, boost::bind(&filter_obj::get_creation, _1), "When file was created")
 		("written", type_date, boost::bind(&filter_obj::get_write, _1), "When file was last written to")
@@ -105,6 +120,10 @@ file_filter::filter_obj_handler::filter_obj_handler() {
 			"True if this is the total object").no_perf();
 	;
 
+	registry_.add_int_fun()
+		("contains", type_bool, &fun_contains, "Check if the file content contains all the given strings: contains('foo')")
+		;
+
 	registry_.add_converter()
 		(type_custom_type, &fun_convert_type)
 		;
@@ -118,6 +137,47 @@ file_filter::filter_obj_handler::filter_obj_handler() {
 		;
 }
 
+parsers::where::node_type file_filter::filter_obj_handler::create_variable(const std::string &name, bool human_readable) {
+	if (name == "size")
+		required_fields_ |= field_size;
+	else if (name == "type")
+		required_fields_ |= field_type;
+	else if (name == "access" || name == "access_l" || name == "access_u")
+		required_fields_ |= field_access;
+	else if (name == "creation" || name == "creation_l" || name == "creation_u")
+		required_fields_ |= field_creation;
+	else if (name == "written" || name == "write" || name == "written_l" || name == "written_u" || name == "age")
+		required_fields_ |= field_write;
+	else if (name == "line_count")
+		content_request_.line_count = true;
+	else if (name == "xxhash")
+		content_request_.xxhash = true;
+	else if (name == "sha256")
+		content_request_.sha256 = true;
+	// Reading content needs the type (to skip directories) as well as size and time (to validate the content cache)
+	if (name == "line_count" || name == "xxhash" || name == "sha256")
+		required_fields_ |= field_type | field_size | field_write;
+	return native_context::create_variable(name, human_readable);
+}
+
+parsers::where::node_type file_filter::filter_obj_handler::create_function(const std::string &name, parsers::where::node_type subject) {
+	if (name == "contains") {
+		needle_nodes_.push_back(subject);
+		required_fields_ |= field_type | field_size | field_write;
+	}
+	return native_context::create_function(name, subject);
+}
+
+file_content::request file_filter::filter_obj_handler::get_content_request(parsers::where::evaluation_context context) const {
+	file_content::request ret = content_request_;
+	BOOST_FOREACH(const node_type &subject, needle_nodes_) {
+		BOOST_FOREACH(const node_type &n, subject->get_list_value(context)) {
+			ret.needles.insert(n->get_string_value(context));
+		}
+	}
+	return ret;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 #ifdef WIN32
@@ -138,6 +198,7 @@ boost::shared_ptr<file_filter::filter_obj> file_filter::filter_obj::get_total(un
 std::string file_filter::filter_obj::get_version() {
 	if (cached_version)
 		return *cached_version;
+#ifdef WIN32
 	std::string fullpath = (path / filename).string();
 
 	DWORD dwDummy;
@@ -168,6 +229,9 @@ std::string file_filter::filter_obj::get_version() {
 		str::xtos(dwSecondLeft) + "." +
 		str::xtos(dwSecondRight) + "." +
 		str::xtos(dwRightMost));
+#else
+	cached_version.reset("");
+#endif
 	return *cached_version;
 }
 
@@ -179,29 +243,66 @@ std::string file_filter::filter_obj::get_type_su() {
 	return file_finder::is_directory(attributes) ? "dir" : "file";
 }
 
-unsigned long file_filter::filter_obj::get_line_count() {
-	if (cached_count)
-		return *cached_count;
+bool file_filter::filter_obj::scan_content(parsers::where::evaluation_context context, const file_content::request &req) {
+	std::string error;
+	bool ok;
+	if (ullLastWriteTime != 0)
+		ok = file_content::scan((path / filename).string(), file_content::file_stamp(ullSize, ullLastWriteTime), req, content, error);
+	else
+		ok = file_content::scan((path / filename).string(), req, content, error);
+	if (!ok)
+		context->error(error);
+	return ok;
+}
 
-	unsigned long count = 0;
-	std::string fullpath = (path / filename).string();
-	FILE * pFile = fopen(fullpath.c_str(), "r");;
-	if (pFile == NULL)
-		return 0;
-	int c;
-	do {
-		c = fgetc(pFile);
-		if (c == '\r') {
-			c = fgetc(pFile);
-			count++;
-		} else if (c == '\n') {
-			c = fgetc(pFile);
-			count++;
+const file_content::result& file_filter::filter_obj::get_content(parsers::where::evaluation_context context) {
+	// Everything the filter needs is read on the first access
+	if (is_total() || content_scanned)
+		return content;
+	content_scanned = true;
+	if (!file_finder::has_content(attributes))
+		return content;
+	filter_obj_handler *handler = dynamic_cast<filter_obj_handler*>(context.get());
+	if (handler == NULL)
+		return content;
+	file_content::request req = handler->get_content_request(context);
+	if (req.sha256 && !file_content::has_sha256_support()) {
+		context->error("sha256 is not supported (built without OpenSSL)");
+		req.sha256 = false;
+	}
+	scan_content(context, req);
+	return content;
+}
+
+long long file_filter::filter_obj::get_line_count(parsers::where::evaluation_context context) {
+	return get_content(context).line_count;
+}
+
+std::string file_filter::filter_obj::get_xxhash(parsers::where::evaluation_context context) {
+	return get_content(context).xxhash;
+}
+
+std::string file_filter::filter_obj::get_sha256(parsers::where::evaluation_context context) {
+	return get_content(context).sha256;
+}
+
+bool file_filter::filter_obj::contains(parsers::where::evaluation_context context, const std::string &needle) {
+	if (is_total() || !file_finder::has_content(attributes))
+		return false;
+	std::map<std::string, bool>::const_iterator cit = content.needles.find(needle);
+	if (cit == content.needles.end()) {
+		get_content(context);
+		cit = content.needles.find(needle);
+		if (cit == content.needles.end()) {
+			// Dynamic needle not known up front, scan for it on its own
+			file_content::request req;
+			req.needles.insert(needle);
+			if (!scan_content(context, req))
+				return false;
+			cit = content.needles.find(needle);
 		}
-	} while (c != EOF);
-	fclose(pFile);
-	cached_count.reset(count);
-	return *cached_count;
+	}
+	return cit != content.needles.end() && cit->second;
 }
 
 void file_filter::filter_obj::add(boost::shared_ptr<file_filter::filter_obj> info) {
@@ -31,10 +31,16 @@
 #include <str/format.hpp>
 #include <str/utils.hpp>
 
+#include "file_content.hpp"
+
 #ifdef WIN32
 #include <Windows.h>
+#else
+#include <time.h>
+#include <types.hpp>
 #endif
 
+#include <list>
 #include <map>
 #include <string>
 
@@ -62,8 +68,9 @@ namespace file_filter {
 			, ullLastAccessTime(0)
 			, ullLastWriteTime(0)
 			, ullSize(0)
-			, ullNow(0) {}
-		filter_obj(boost::filesystem::path path_, std::string filename_, __int64 now = 0, __int64 creationTime = 0, __int64 lastAccessTime = 0, __int64 lastWriteTime = 0, __int64 size = 0, DWORD attributes = 0)
+			, ullNow(0)
+			, content_scanned(false) {}
+		filter_obj(boost::filesystem::path path_, std::string filename_, long long now = 0, long long creationTime = 0, long long lastAccessTime = 0, long long lastWriteTime = 0, long long size = 0, DWORD attributes = 0)
 			: is_total_(false)
 			, path(path_)
 			, filename(filename_)
@@ -72,6 +79,7 @@ namespace file_filter {
 			, ullLastWriteTime(lastWriteTime)
 			, ullSize(size)
 			, ullNow(now)
+			, content_scanned(false)
 			, attributes(attributes) {}
 
 		filter_obj(const filter_obj& other)
@@ -83,7 +91,8 @@ namespace file_filter {
 			, filename(other.filename)
 			, path(other.path)
 			, cached_version(other.cached_version)
-			, cached_count(other.cached_count)
+			, content(other.content)
+			, content_scanned(other.content_scanned)
 			, attributes(other.attributes) {}
 
 		const filter_obj& operator=(const filter_obj&other) {
@@ -95,7 +104,8 @@ namespace file_filter {
 			filename = other.filename;
 			path = other.path;
 			cached_version = other.cached_version;
-			cached_count = other.cached_count;
+			content = other.content;
+			content_scanned = other.content_scanned;
 			attributes = other.attributes;
 		}
 
@@ -119,7 +129,8 @@ namespace file_filter {
 			long long now = parsers::where::constants::get_now();
 			return now - get_write();
 		}
-		__int64 to_local_time(const __int64  &t) {
+#ifdef WIN32
+		long long to_local_time(const long long  &t) {
 			FILETIME ft;
 			ft.dwHighDateTime = t >> 32;
 			ft.dwLowDateTime = t;
@@ -135,6 +146,15 @@ namespace file_filter {
 			SystemTimeToFileTime(&st2, &lft);
 			return lft;
 		}
+#else
+		long long to_local_time(const long long  &t) {
+			struct tm lt;
+			time_t tt = static_cast<time_t>(str::format::filetime_to_time(t));
+			if (localtime_r(&tt, &lt) == NULL)
+				return t;
+			return t + static_cast<long long>(lt.tm_gmtoff) * static_cast<long long>(str::format::SECS_TO_100NS);
+		}
+#endif
 
 		std::string get_creation_su() {
 			return str::format::format_filetime(ullCreationTime);
@@ -160,7 +180,12 @@ namespace file_filter {
 		unsigned long long get_size() { return ullSize; }
 		//		std::string render(std::string syntax, std::string datesyntax);
 		std::string get_version();
-		unsigned long get_line_count();
+		long long get_line_count(parsers::where::evaluation_context context);
+		std::string get_xxhash(parsers::where::evaluation_context context);
+		std::string get_sha256(parsers::where::evaluation_context context);
+		bool contains(parsers::where::evaluation_context context, const std::string &needle);
+		const file_content::result& get_content(parsers::where::evaluation_context context);
+		bool scan_content(parsers::where::evaluation_context context, const file_content::request &req);
 
 	public:
 		void add(boost::shared_ptr<file_filter::filter_obj> info);
@@ -168,21 +193,41 @@ namespace file_filter {
 		bool is_total() const { return is_total_; }
 
 		unsigned long long ullSize;
-		__int64 ullCreationTime;
-		__int64 ullLastAccessTime;
-		__int64 ullLastWriteTime;
-		__int64 ullNow;
+		long long ullCreationTime;
+		long long ullLastAccessTime;
+		long long ullLastWriteTime;
+		long long ullNow;
 		std::string filename;
 		bool is_total_;
 		boost::filesystem::path path;
 		boost::optional<std::string> cached_version;
-		boost::optional<unsigned long> cached_count;
+		file_content::result content;
+		bool content_scanned;
 		DWORD attributes;
 	};
 
+	// Attributes which require the file to be stat:ed (the rest comes from the directory listing)
+	enum file_fields {
+		field_none = 0x00,
+		field_type = 0x01,
+		field_size = 0x02,
+		field_access = 0x04,
+		field_creation = 0x08,
+		field_write = 0x10
+	};
+
 	typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
 	struct filter_obj_handler : public native_context {
 		filter_obj_handler();
+		virtual parsers::where::node_type create_variable(const std::string &name, bool human_readable);
+		virtual parsers::where::node_type create_function(const std::string &name, parsers::where::node_type subject);
+		unsigned int get_required_fields() const { return required_fields_; }
+		// Everything the filter will want from the file content so it can be read in a single pass
+		file_content::request get_content_request(parsers::where::evaluation_context context) const;
+	private:
+		unsigned int required_fields_;
+		file_content::request content_request_;
+		std::list<parsers::where::node_type> needle_nodes_;
 	};
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
 }
\ No newline at end of file
@@ -1,3 +1 @@
-IF(WIN32)
 SET (BUILD_MODULE 1)
-ENDIF(WIN32)
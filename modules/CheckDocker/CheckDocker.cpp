@@ -71,5 +71,5 @@ void CheckDocker::fetchMetrics(PB::Metrics::MetricsMessage::Response* response)
 
 
 void CheckDocker::check_docker(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
-	docker_checks::check(request, response);
+	docker_checks::check(request, response, cgroup_reader_);
 }
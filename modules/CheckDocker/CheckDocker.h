@@ -27,12 +27,15 @@
 
 #include <nscapi/plugin.hpp>
 
+#include "check_docker.hpp"
+
 #include <boost/thread/thread.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/filesystem.hpp>
 
 class CheckDocker : public nscapi::impl::simple_plugin {
+	docker_checks::cgroup_reader cgroup_reader_;
 public:
 
 	CheckDocker() {}
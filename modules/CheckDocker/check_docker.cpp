@@ -36,6 +36,8 @@
 namespace check_docker_filter {
 	struct filter_obj {
 		std::string id, image ,imageId, command, created, state, status, names, ip;
+		// Read from the cgroup of the container (only for running containers)
+		cgroup::cgroup_stats stats;
 
 		filter_obj(json_spirit::Value& v) {
 
@@ -91,6 +93,35 @@ namespace check_docker_filter {
 		std::string get_ip() const {
 			return ip;
 		}
+		long long get_memory() const {
+			return stats.current.memory_current;
+		}
+		long long get_memory_limit() const {
+			return stats.current.memory_max;
+		}
+		long long get_memory_pct() const {
+			if (stats.current.memory_max == 0)
+				return 0;
+			return static_cast<long long>(stats.current.memory_current * 100 / stats.current.memory_max);
+		}
+		long long get_oom_kill() const {
+			return stats.get_oom_kill();
+		}
+		double get_cpu() const {
+			return stats.get_cpu();
+		}
+		double get_throttled() const {
+			return stats.get_throttled();
+		}
+		double get_cpu_some() const {
+			return stats.get_some(&cgroup::sample::cpu);
+		}
+		double get_memory_some() const {
+			return stats.get_some(&cgroup::sample::memory);
+		}
+		double get_io_some() const {
+			return stats.get_some(&cgroup::sample::io);
+		}
 
 
 	};
@@ -115,6 +146,19 @@ namespace check_docker_filter {
 				("names", boost::bind(&filter_obj::get_names, _1), "Container image")
 				("ip", boost::bind(&filter_obj::get_ip, _1), "IP of container")
 				;
+			registry_.add_int()
+				("memory", boost::bind(&filter_obj::get_memory, _1), "Memory used by the container in bytes (read from the cgroup)").add_perf("B")
+				("memory_limit", boost::bind(&filter_obj::get_memory_limit, _1), "The memory limit of the container in bytes, 0 if there is no limit")
+				("memory_pct", boost::bind(&filter_obj::get_memory_pct, _1), "Memory used in percent of the limit (0 if there is no limit)").add_perf("%")
+				("oom_kill", boost::bind(&filter_obj::get_oom_kill, _1), "Processes killed by the OOM killer since the previous check")
+				;
+			registry_.add_float()
+				("cpu", boost::bind(&filter_obj::get_cpu, _1), "CPU usage in percent of one core since the previous check").add_perf("%")
+				("throttled", boost::bind(&filter_obj::get_throttled, _1), "Percent of the CPU quota periods which were throttled").add_perf("%")
+				("cpu_some", boost::bind(&filter_obj::get_cpu_some, _1), "Percent of time some tasks were stalled waiting for CPU (PSI)").add_perf("%")
+				("memory_some", boost::bind(&filter_obj::get_memory_some, _1), "Percent of time some tasks were stalled on memory (PSI)").add_perf("%")
+				("io_some", boost::bind(&filter_obj::get_io_some, _1), "Percent of time some tasks were stalled on IO (PSI)").add_perf("%")
+				;
 				
 		}
 	};
@@ -124,6 +168,36 @@ namespace check_docker_filter {
 namespace docker_checks {
 
 	namespace po = boost::program_options;
+
+	void cgroup_reader::begin() {
+#ifndef WIN32
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		scanner_.begin_pass();
+#endif
+	}
+
+	void cgroup_reader::end() {
+#ifndef WIN32
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		// Two passes so a check running at the same time as another does not drop its containers
+		scanner_.drop_unread(2);
+#endif
+	}
+
+	bool cgroup_reader::read(const std::string &id, cgroup::cgroup_stats &stats) {
+#ifndef WIN32
+		if (id.empty())
+			return false;
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (!scanner_.is_available())
+			return false;
+		// The systemd cgroup driver (the default) and the cgroupfs driver
+		return scanner_.read("system.slice/docker-" + id + ".scope", 0.0, stats)
+			|| scanner_.read("docker/" + id, 0.0, stats);
+#else
+		return false;
+#endif
+	}
 	/**
 	 * Check available memory and return various check results
 	 * Example: checkMem showAll maxWarn=50 maxCrit=75
@@ -135,17 +209,19 @@ namespace docker_checks {
 	 * @param &perf String to put performance data in
 	 * @return The status of the command
 	 */
-	void check(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
+	void check(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, cgroup_reader &reader) {
 		typedef check_docker_filter::filter filter_type;
 		modern_filter::data_container data;
 		modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
 		std::string host = "\\\\.\\pipe\\docker_engine";
+		bool local_stats = true;
 
 		filter_type filter;
 		filter_helper.add_options("container_state != 'running'", "container_state != 'running'", "", filter.get_filter_syntax(), "warning");
 		filter_helper.add_syntax("${status}: ${list}", "${names}=${container_state}", "${id}", "", "");
 		filter_helper.get_desc().add_options()
 			("host", po::value<std::string>(&host), "The host or socket of the docker deamon")
+			("local-stats", po::value<bool>(&local_stats), "Read memory, cpu and pressure of running containers from their cgroup (cgroup v2 only) instead of asking the docker daemon")
 			;
 
 		if (!filter_helper.parse_options())
@@ -169,11 +245,17 @@ namespace docker_checks {
 			json_spirit::Value root;
 			json_spirit::read_or_throw(ss.str(), root);
 			json_spirit::Array list = root.getArray();
+			if (local_stats)
+				reader.begin();
 			BOOST_FOREACH(json_spirit::Value & v, list) {
 				boost::shared_ptr<check_docker_filter::filter_obj> record(new check_docker_filter::filter_obj(v));
+				if (local_stats && record->state == "running")
+					reader.read(record->id, record->stats);
 				filter.match(record);
 
 			}
+			if (local_stats)
+				reader.end();
 
 		}
 		catch (const socket_helpers::socket_exception& e) {
@@ -21,7 +21,29 @@
 
 #include <nscapi/nscapi_protobuf_command.hpp>
 
+#include <cgroup/cgroup.hpp>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+
 namespace docker_checks {
 
-	void check(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	// Reads the resource usage of a container from its cgroup instead of asking the docker daemon for stats.
+	// Kept between checks as the rates are calculated against the previous sample.
+	class cgroup_reader : boost::noncopyable {
+#ifndef WIN32
+		cgroup::cgroup_scanner scanner_;
+#endif
+		boost::mutex mutex_;
+	public:
+		// Call begin before and end after reading the containers of a check, containers which were not read
+		// during the last two checks (they are stopped or removed) are forgotten
+		void begin();
+		bool read(const std::string &id, cgroup::cgroup_stats &stats);
+		void end();
+	};
+
+	void check(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, cgroup_reader &reader);
 }
\ No newline at end of file
@@ -346,30 +346,20 @@ void CheckExternalScripts::query_fallback(const PB::Commands::QueryRequestMessag
 }
 
 void CheckExternalScripts::handle_command(const commands::command_object &cd, const std::list<std::string> &args, PB::Commands::QueryResponseMessage::Response *response) {
-	std::string cmdline = cd.command;
-	std::string all, allesc;
+	std::vector<std::string> arg_list(args.begin(), args.end());
 	if (allowArgs_) {
-		int i = 1;
-		BOOST_FOREACH(const std::string &str, args) {
+		BOOST_FOREACH(const std::string &str, arg_list) {
 			if (!allowNasty_ && str.find_first_of(NASTY_METACHARS) != std::string::npos) {
 				nscapi::protobuf::functions::set_response_bad(*response, "Request contained illegal characters set /settings/external scripts/allow nasty characters=true!");
 				return;
 			}
-			str::utils::replace(cmdline, "$ARG" + str::xtos(i) + "$", str);
-			str::utils::replace(cmdline, "%ARG" + str::xtos(i) + "%", str);
-			str::format::append_list(all, str, " ");
-			str::format::append_list(allesc, "\"" + str + "\"", " ");
-			i++;
 		}
-		str::utils::replace(cmdline, "$ARGS$", all);
-		str::utils::replace(cmdline, "%ARGS%", all);
-		str::utils::replace(cmdline, "$ARGS\"$", allesc);
-		str::utils::replace(cmdline, "%ARGS\"%", allesc);
 	} else if (args.size() > 0) {
 		NSC_LOG_ERROR_STD("Arguments not allowed in CheckExternalScripts set /settings/external scripts/allow arguments=true");
 		nscapi::protobuf::functions::set_response_bad(*response, "Arguments not allowed see nsclient.log for details");
 		return;
 	}
+	std::string cmdline = cd.tpl.expand(arg_list, allowArgs_);
 
 	if (cmdline.find("$ARG") != std::string::npos) {
 		NSC_DEBUG_MSG_STD("Possible missing argument in: " + cmdline);
@@ -377,9 +367,6 @@ void CheckExternalScripts::handle_command(const commands::command_object &cd, co
 	if (cmdline.find("%ARG") != std::string::npos) {
 		NSC_DEBUG_MSG_STD("Possible missing argument in: " + cmdline);
 	}
-	NSC_TRACE_ENABLED() {
-		NSC_TRACE_MSG(cd.get_alias() + " command line: " + cmdline);
-	}
 
 	process::exec_arguments arg(root_, cmdline, timeout, cd.encoding, cd.session, cd.display, !cd.no_fork);
 	if (!cd.user.empty()) {
@@ -391,8 +378,16 @@ void CheckExternalScripts::handle_command(const commands::command_object &cd, co
 	arg.ignore_perf = cd.ignore_perf;
 	arg.session = cd.session;
 	arg.display = cd.display;
+#ifndef WIN32
+	// No shell features used: execute directly instead of via /bin/sh
+	if (!cd.tpl.needs_shell)
+		arg.argv = cd.tpl.expand_argv(arg_list, allowArgs_);
+#endif
+	NSC_TRACE_ENABLED() {
+		NSC_TRACE_MSG(cd.get_alias() + " command line: " + cmdline + (arg.argv.empty() ? "" : " (direct)"));
+	}
 	std::string output;
-	int result = process::execute_process(arg, output);
+	int result = pool_.execute(cd.get_alias(), cmdline, cd.max_concurrent, cd.coalesce, timeout, boost::bind(&process::execute_process, arg, _1), output);
 	NSC_TRACE_ENABLED() {
 		NSC_TRACE_MSG(cd.get_alias() + " return code: " + str::xtos(result));
 		NSC_TRACE_MSG(cd.get_alias() + " output: " + output);
@@ -21,6 +21,7 @@
 
 #include "commands.hpp"
 #include "alias.hpp"
+#include "execution_pool.hpp"
 
 #include <nscapi/nscapi_plugin_impl.hpp>
 
@@ -30,6 +31,7 @@ class CheckExternalScripts : public nscapi::impl::simple_plugin {
 private:
 	boost::shared_ptr<script_provider_interface> provider_;
 	alias::command_handler aliases_;
+	commands::execution_pool pool_;
 	unsigned int timeout;
 	std::string root_;
 	bool allowArgs_;
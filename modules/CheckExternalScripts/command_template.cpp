@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "command_template.hpp"
+
+#include <cstring>
+
+#include <boost/foreach.hpp>
+
+namespace commands {
+
+	namespace {
+		// Characters which require a real shell when found outside quotes
+		const char *shell_chars = "|&;<>()`\\*?[]{}~#$!\n";
+
+		bool is_space(char c) {
+			return c == ' ' || c == '\t';
+		}
+
+		// Try to read a placeholder starting at pos (which is a $ or %), returns the number of characters consumed or 0.
+		std::size_t read_placeholder(const std::string &cmd, std::size_t pos, command_template::part::kind_type &kind, std::size_t &index) {
+			const char delim = cmd[pos];
+			std::size_t p = pos + 1;
+			if (cmd.compare(p, 3, "ARG") != 0)
+				return 0;
+			p += 3;
+			if (cmd.compare(p, 3, std::string("S\"") + delim) == 0) {
+				kind = command_template::part::args_quoted;
+				return p + 3 - pos;
+			}
+			if (cmd.compare(p, 2, std::string("S") + delim) == 0) {
+				kind = command_template::part::args;
+				return p + 2 - pos;
+			}
+			std::size_t start = p;
+			while (p < cmd.size() && cmd[p] >= '0' && cmd[p] <= '9')
+				p++;
+			if (p == start || p >= cmd.size() || cmd[p] != delim)
+				return 0;
+			kind = command_template::part::arg;
+			index = 0;
+			for (std::size_t i = start; i < p; i++)
+				index = index * 10 + (cmd[i] - '0');
+			return p + 1 - pos;
+		}
+
+		void add_literal(command_template::parts_type &parts, const std::string &text, bool quoted) {
+			if (!parts.empty() && parts.back().kind == command_template::part::literal && parts.back().quoted == quoted)
+				parts.back().text += text;
+			else
+				parts.push_back(command_template::part(command_template::part::literal, text, 0, quoted));
+		}
+
+		bool resolve(const command_template::part &p, const std::vector<std::string> &args, bool allow_args, std::string &value) {
+			if (p.kind == command_template::part::literal || !allow_args)
+				return false;
+			if (p.kind == command_template::part::arg) {
+				if (p.index == 0 || p.index > args.size())
+					return false;
+				value = args[p.index - 1];
+				return true;
+			}
+			value.clear();
+			BOOST_FOREACH(const std::string &a, args) {
+				if (!value.empty())
+					value += " ";
+				if (p.kind == command_template::part::args_quoted)
+					value += "\"" + a + "\"";
+				else
+					value += a;
+			}
+			return true;
+		}
+
+		struct field_builder {
+			std::vector<std::string> &fields;
+			std::string current;
+			bool has_current;
+			field_builder(std::vector<std::string> &fields) : fields(fields), has_current(false) {}
+			void append(const std::string &s) {
+				current += s;
+				has_current = true;
+			}
+			void flush() {
+				if (has_current)
+					fields.push_back(current);
+				current.clear();
+				has_current = false;
+			}
+			// Unquoted substitution: split on white space the way the shell would
+			void append_split(const std::string &s) {
+				std::size_t i = 0;
+				while (i < s.size()) {
+					if (is_space(s[i])) {
+						flush();
+						while (i < s.size() && is_space(s[i]))
+							i++;
+						continue;
+					}
+					std::size_t start = i;
+					while (i < s.size() && !is_space(s[i]))
+						i++;
+					append(s.substr(start, i - start));
+				}
+			}
+		};
+	}
+
+	command_template command_template::parse(const std::string &command) {
+		command_template ret;
+		ret.needs_shell = false;
+
+		parts_type word;
+		bool in_word = false;
+		bool in_first_word = true;
+		char quote = 0;
+		for (std::size_t i = 0; i < command.size(); i++) {
+			const char c = command[i];
+			if (c == '$' || c == '%') {
+				part::kind_type kind;
+				std::size_t index = 0;
+				std::size_t len = read_placeholder(command, i, kind, index);
+				if (len > 0) {
+					std::string text = command.substr(i, len);
+					ret.line.push_back(part(kind, text, index));
+					word.push_back(part(kind, text, index, quote != 0));
+					ret.has_placeholders = true;
+					in_word = true;
+					i += len - 1;
+					continue;
+				}
+			}
+			add_literal(ret.line, std::string(1, c), false);
+
+			if (quote == '\'') {
+				if (c == '\'')
+					quote = 0;
+				else
+					add_literal(word, std::string(1, c), true);
+			} else if (quote == '"') {
+				if (c == '"')
+					quote = 0;
+				else if (c == '$' || c == '`' || c == '\\')
+					ret.needs_shell = true;
+				else
+					add_literal(word, std::string(1, c), true);
+			} else if (is_space(c)) {
+				if (in_word) {
+					ret.words.push_back(word);
+					word.clear();
+					in_word = false;
+					in_first_word = false;
+				}
+			} else if (c == '\'' || c == '"') {
+				quote = c;
+				in_word = true;
+				// Make sure an empty quoted string still produces a word
+				add_literal(word, "", true);
+			} else if (strchr(shell_chars, c) != NULL) {
+				ret.needs_shell = true;
+			} else {
+				if (c == '=' && in_first_word)
+					ret.needs_shell = true;
+				add_literal(word, std::string(1, c), false);
+				in_word = true;
+			}
+		}
+		if (quote != 0)
+			ret.needs_shell = true;
+		if (in_word)
+			ret.words.push_back(word);
+		if (ret.words.empty())
+			ret.needs_shell = true;
+		if (ret.needs_shell)
+			ret.words.clear();
+		return ret;
+	}
+
+	std::string command_template::expand(const std::vector<std::string> &args, bool allow_args) const {
+		std::string ret;
+		std::string value;
+		BOOST_FOREACH(const part &p, line) {
+			if (resolve(p, args, allow_args, value))
+				ret += value;
+			else
+				ret += p.text;
+		}
+		return ret;
+	}
+
+	std::vector<std::string> command_template::expand_argv(const std::vector<std::string> &args, bool allow_args) const {
+		std::vector<std::string> ret;
+		std::string value;
+		BOOST_FOREACH(const parts_type &w, words) {
+			field_builder builder(ret);
+			BOOST_FOREACH(const part &p, w) {
+				if (!resolve(p, args, allow_args, value)) {
+					builder.append(p.text);
+				} else if (p.quoted) {
+					builder.append(value);
+				} else if (p.kind == part::args_quoted) {
+					// Each argument becomes exactly one word
+					bool first = true;
+					BOOST_FOREACH(const std::string &a, args) {
+						if (!first)
+							builder.flush();
+						builder.append(a);
+						first = false;
+					}
+				} else {
+					builder.append_split(value);
+				}
+			}
+			builder.flush();
+		}
+		return ret;
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace commands {
+
+	// A command line parsed once into literal text and argument placeholders ($ARGn$, %ARGn%, $ARGS$, $ARGS"$ and the % variants).
+	// If the command uses no shell features it is also split into words so it can be executed directly without a shell.
+	struct command_template {
+		struct part {
+			enum kind_type { literal, arg, args, args_quoted };
+			kind_type kind;
+			std::string text;	// The literal text or the original placeholder
+			std::size_t index;	// 1 based argument index for arg
+			bool quoted;		// Inside quotes in the command line (no word splitting)
+			part(kind_type kind, const std::string &text, std::size_t index = 0, bool quoted = false) : kind(kind), text(text), index(index), quoted(quoted) {}
+		};
+		typedef std::vector<part> parts_type;
+
+		parts_type line;
+		std::vector<parts_type> words;
+		bool needs_shell;
+		bool has_placeholders;
+
+		command_template() : needs_shell(true), has_placeholders(false) {}
+
+		static command_template parse(const std::string &command);
+
+		// Render the full command line (for the shell or for logging)
+		std::string expand(const std::vector<std::string> &args, bool allow_args) const;
+		// Render the argument vector (only valid if needs_shell is false)
+		std::vector<std::string> expand_argv(const std::vector<std::string> &args, bool allow_args) const;
+	};
+}
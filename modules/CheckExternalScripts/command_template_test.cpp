@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "command_template.hpp"
+
+#include <boost/foreach.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+	std::vector<std::string> make_args(const char *a = NULL, const char *b = NULL, const char *c = NULL) {
+		std::vector<std::string> ret;
+		if (a) ret.push_back(a);
+		if (b) ret.push_back(b);
+		if (c) ret.push_back(c);
+		return ret;
+	}
+	std::vector<std::string> argv(const std::string &command, const std::vector<std::string> &args, bool allow_args = true) {
+		return commands::command_template::parse(command).expand_argv(args, allow_args);
+	}
+	bool needs_shell(const std::string &command) {
+		return commands::command_template::parse(command).needs_shell;
+	}
+}
+
+TEST(command_template, tokenize) {
+	std::vector<std::string> r = argv("/usr/lib/check_foo  -w 10\t-c 20", make_args());
+	ASSERT_EQ(5u, r.size());
+	EXPECT_EQ("/usr/lib/check_foo", r[0]);
+	EXPECT_EQ("-w", r[1]);
+	EXPECT_EQ("10", r[2]);
+	EXPECT_EQ("-c", r[3]);
+	EXPECT_EQ("20", r[4]);
+}
+
+TEST(command_template, tokenize_quotes) {
+	std::vector<std::string> r = argv("echo 'a b' \"c  d\" e'f g'h \"\"", make_args());
+	ASSERT_EQ(5u, r.size());
+	EXPECT_EQ("echo", r[0]);
+	EXPECT_EQ("a b", r[1]);
+	EXPECT_EQ("c  d", r[2]);
+	EXPECT_EQ("ef gh", r[3]);
+	EXPECT_EQ("", r[4]);
+}
+
+TEST(command_template, needs_shell) {
+	EXPECT_FALSE(needs_shell("check_foo -w 10"));
+	EXPECT_FALSE(needs_shell("check_foo '$HOME' \"a|b\""));
+	EXPECT_FALSE(needs_shell("check_foo $ARG1$ %ARGS%"));
+	EXPECT_FALSE(needs_shell("check_foo --opt=1"));
+	const char *shell[] = { "a | b", "a && b", "a; b", "a > out", "a < in", "(a)", "a `b`", "a \\x", "ls *.log", "ls ?",
+		"ls [ab]", "echo {a,b}", "ls ~", "a # comment", "echo $HOME", "! a", "a\nb", "echo \"$HOME\"", "echo \"unterminated",
+		"FOO=bar check_foo", "", "   " };
+	BOOST_FOREACH(const char *c, shell) {
+		EXPECT_TRUE(needs_shell(c)) << c;
+	}
+}
+
+TEST(command_template, needs_shell_has_no_words) {
+	commands::command_template t = commands::command_template::parse("a | b");
+	EXPECT_TRUE(t.words.empty());
+	EXPECT_EQ("a | b", t.expand(make_args(), true));
+}
+
+TEST(command_template, arg) {
+	std::vector<std::string> r = argv("check_foo -w $ARG1$ -c %ARG2% $ARG3$", make_args("1 0", "20"));
+	ASSERT_EQ(7u, r.size());
+	// Unquoted substitutions are word split like the shell would
+	EXPECT_EQ("1", r[2]);
+	EXPECT_EQ("0", r[3]);
+	EXPECT_EQ("20", r[5]);
+	// Missing arguments are left as is
+	EXPECT_EQ("$ARG3$", r[6]);
+}
+
+TEST(command_template, arg_quoted) {
+	std::vector<std::string> r = argv("check_foo \"$ARG1$\" 'x$ARG2$y'", make_args("a b", "c"));
+	ASSERT_EQ(3u, r.size());
+	EXPECT_EQ("a b", r[1]);
+	EXPECT_EQ("xcy", r[2]);
+}
+
+TEST(command_template, args) {
+	std::vector<std::string> r = argv("check_foo $ARGS$", make_args("a", "b c"));
+	ASSERT_EQ(4u, r.size());
+	EXPECT_EQ("a", r[1]);
+	EXPECT_EQ("b", r[2]);
+	EXPECT_EQ("c", r[3]);
+}
+
+TEST(command_template, args_quoted_one_word_per_argument) {
+	std::vector<std::string> r = argv("check_foo $ARGS\"$", make_args("a", "b c", ""));
+	ASSERT_EQ(4u, r.size());
+	EXPECT_EQ("a", r[1]);
+	EXPECT_EQ("b c", r[2]);
+	EXPECT_EQ("", r[3]);
+	r = argv("check_foo -x%ARGS\"%-y", make_args("1", "2"));
+	ASSERT_EQ(3u, r.size());
+	EXPECT_EQ("-x1", r[1]);
+	EXPECT_EQ("2-y", r[2]);
+}
+
+TEST(command_template, args_quoted_expand) {
+	commands::command_template t = commands::command_template::parse("check_foo $ARGS\"$");
+	EXPECT_EQ("check_foo \"a\" \"b c\"", t.expand(make_args("a", "b c"), true));
+}
+
+TEST(command_template, args_not_allowed) {
+	std::vector<std::string> r = argv("check_foo $ARG1$ $ARGS$", make_args("a"), false);
+	ASSERT_EQ(3u, r.size());
+	EXPECT_EQ("$ARG1$", r[1]);
+	EXPECT_EQ("$ARGS$", r[2]);
+}
+
+TEST(command_template, placeholders) {
+	EXPECT_FALSE(commands::command_template::parse("check_foo $ARG$ $ARGx$ %ARG1$").has_placeholders);
+	EXPECT_TRUE(commands::command_template::parse("check_foo $ARG10$").has_placeholders);
+}
@@ -23,6 +23,8 @@
 #include <nscapi/nscapi_settings_proxy.hpp>
 #include <nscapi/nscapi_settings_object.hpp>
 
+#include "command_template.hpp"
+
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/bind.hpp>
 
@@ -40,6 +42,8 @@ namespace commands {
 			, display(false)
 			, ignore_perf(false)
 			, no_fork(true)
+			, max_concurrent(0)
+			, coalesce(false)
 		{}
 
 		std::string encoding;
@@ -51,6 +55,9 @@ namespace commands {
 		bool display;
 		bool ignore_perf;
 		bool no_fork;
+		unsigned int max_concurrent;
+		bool coalesce;
+		command_template tpl;
 
 		std::string to_string() const {
 			std::stringstream ss;
@@ -111,6 +118,12 @@ namespace commands {
 					("capture output", nscapi::settings_helper::bool_key(&no_fork),
 						"CAPTURE OUTPUT", "This should be set to false if you want to run commands which never terminates (i.e. relinquish control from NSClient++). The effect of this is that the command output will not be captured. The main use is to protect from socket reuse issues", true)
 
+					("max concurrent", nscapi::settings_helper::uint_key(&max_concurrent, 0),
+						"MAX CONCURRENT", "The maximum number of instances of this command which can run at the same time, additional requests are queued until a slot is free (or the timeout expires). 0 means no limit.", true)
+
+					("coalesce", nscapi::settings_helper::bool_key(&coalesce, false),
+						"COALESCE", "Let identical requests (same arguments) which arrive while the command is already running share the result of that execution instead of starting a new one.", true)
+
 					;
 
 				settings.register_all();
@@ -120,6 +133,7 @@ namespace commands {
 
 		void set_command(std::string str) {
 			command = str;
+			tpl = command_template::parse(str);
 		}
 	};
 	typedef boost::shared_ptr<command_object> command_object_instance;
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "execution_pool.hpp"
+
+#include <NSCAPI.h>
+#include <str/xtos.hpp>
+
+#include <boost/thread/thread_time.hpp>
+
+namespace commands {
+
+	int execution_pool::execute(const std::string &command, const std::string &key, unsigned int max_concurrent, bool coalesce, unsigned int queue_timeout, runner_type runner, std::string &output) {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		command_state &state = commands_[command];
+
+		boost::shared_ptr<job> j;
+		if (coalesce) {
+			std::map<std::string, boost::shared_ptr<job> >::const_iterator cit = state.inflight.find(key);
+			if (cit != state.inflight.end()) {
+				// Someone is already running (or waiting to run) this exact command: share the result
+				j = cit->second;
+				while (!j->done)
+					cond_.wait(lock);
+				output = j->output;
+				return j->result;
+			}
+			j.reset(new job());
+			state.inflight[key] = j;
+		}
+
+		if (max_concurrent > 0) {
+			unsigned long long ticket = next_ticket_++;
+			state.queue.push_back(ticket);
+			boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(queue_timeout);
+			while (state.running >= max_concurrent || state.queue.front() != ticket) {
+				if (!cond_.timed_wait(lock, deadline)) {
+					state.queue.remove(ticket);
+					std::string msg = "Command " + command + " was queued for more than " + str::xtos(queue_timeout) + "s (" + str::xtos(max_concurrent) + " instances already running)";
+					complete(state, key, j, coalesce, NSCAPI::query_return_codes::returnUNKNOWN, msg);
+					output = msg;
+					return NSCAPI::query_return_codes::returnUNKNOWN;
+				}
+			}
+			state.queue.pop_front();
+			// Let the next in line re-check (there might be more than one free slot)
+			cond_.notify_all();
+		}
+		state.running++;
+		lock.unlock();
+
+		int result = NSCAPI::query_return_codes::returnUNKNOWN;
+		try {
+			result = runner(output);
+		} catch (const std::exception &e) {
+			output = "Failed to execute " + command + ": " + e.what();
+			result = NSCAPI::query_return_codes::returnUNKNOWN;
+		} catch (...) {
+			output = "Failed to execute " + command;
+			result = NSCAPI::query_return_codes::returnUNKNOWN;
+		}
+
+		lock.lock();
+		state.running--;
+		complete(state, key, j, coalesce, result, output);
+		return result;
+	}
+
+	void execution_pool::complete(command_state &state, const std::string &key, boost::shared_ptr<job> j, bool coalesce, int result, const std::string &output) {
+		if (coalesce && j) {
+			j->result = result;
+			j->output = output;
+			j->done = true;
+			state.inflight.erase(key);
+		}
+		cond_.notify_all();
+	}
+}
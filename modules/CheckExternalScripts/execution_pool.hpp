@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace commands {
+
+	// Limits the number of concurrent executions per command (excess requests wait in FIFO order)
+	// and optionally lets identical concurrent requests share the result of a single execution.
+	class execution_pool {
+	public:
+		typedef boost::function<int(std::string&)> runner_type;
+
+	private:
+		struct job {
+			bool done;
+			int result;
+			std::string output;
+			job() : done(false), result(0) {}
+		};
+		struct command_state {
+			unsigned int running;
+			std::list<unsigned long long> queue;
+			std::map<std::string, boost::shared_ptr<job> > inflight;
+			command_state() : running(0) {}
+		};
+
+		boost::mutex mutex_;
+		boost::condition_variable cond_;
+		std::map<std::string, command_state> commands_;
+		unsigned long long next_ticket_;
+
+	public:
+		execution_pool() : next_ticket_(0) {}
+
+		// Execute runner for the given command.
+		// key identifies the invocation (i.e. the expanded command line) and is used for coalescing.
+		// max_concurrent is the number of allowed concurrent executions (0 means no limit) and
+		// queue_timeout the number of seconds a request can wait for a free slot.
+		int execute(const std::string &command, const std::string &key, unsigned int max_concurrent, bool coalesce, unsigned int queue_timeout, runner_type runner, std::string &output);
+
+	private:
+		void complete(command_state &state, const std::string &key, boost::shared_ptr<job> j, bool coalesce, int result, const std::string &output);
+	};
+}
@@ -158,6 +158,7 @@ void CheckMKClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool CheckMKClient::unloadModule() {
+	client_.stop();
 	client_.clear();
 	scripts_.reset();
 	lua_runtime_.reset();
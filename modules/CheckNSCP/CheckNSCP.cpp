@@ -34,6 +34,7 @@
 
 #include <file_helpers.hpp>
 #include <str/format.hpp>
+#include <str/utils.hpp>
 #include <config.h>
 
 #include <boost/filesystem.hpp>
@@ -70,6 +71,48 @@ void CheckNSCP::handleLogMessage(const PB::Log::LogEntry::Entry &message) {
 	}
 }
 
+namespace {
+	long long get_gauge(const PB::Metrics::MetricsBundle &bundle, const std::string &key) {
+		BOOST_FOREACH(const PB::Metrics::Metric &m, bundle.value()) {
+			if (m.key() == key && m.has_gauge_value())
+				return static_cast<long long>(m.gauge_value().value());
+		}
+		return -1;
+	}
+}
+
+void CheckNSCP::submitMetrics(const PB::Metrics::MetricsMessage &response) {
+	BOOST_FOREACH(const PB::Metrics::MetricsMessage::Response &p, response.payload()) {
+		BOOST_FOREACH(const PB::Metrics::MetricsBundle &b, p.bundles()) {
+			if (b.key() != "startup")
+				continue;
+			std::string slowest;
+			long long slowest_ms = 0;
+			std::list<std::string> failed;
+			BOOST_FOREACH(const PB::Metrics::MetricsBundle &c, b.children()) {
+				if (c.key() != "modules")
+					continue;
+				BOOST_FOREACH(const PB::Metrics::MetricsBundle &m, c.children()) {
+					long long load_time = get_gauge(m, "load_time");
+					if (load_time > slowest_ms || slowest.empty()) {
+						slowest = m.key();
+						slowest_ms = load_time;
+					}
+					if (get_gauge(m, "loaded") == 0)
+						failed.push_back(m.key());
+				}
+			}
+			boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+			if (!lock.owns_lock())
+				return;
+			startup_ms_ = get_gauge(b, "time");
+			slowest_module_ = slowest;
+			slowest_ms_ = slowest_ms;
+			failed_modules_ = failed;
+		}
+	}
+}
+
 int get_crashes(boost::filesystem::path root, std::string &last_crash) {
 	if (!boost::filesystem::is_directory(root)) {
 		return 0;
@@ -250,5 +293,15 @@ void CheckNSCP::check_nscp(const PB::Commands::QueryRequestMessage::Request &req
 	std::stringstream uptime;
 	uptime << "uptime " << td;
 	str::format::append_list(message, uptime.str(), std::string(", "));
+
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (lock.owns_lock() && startup_ms_ >= 0) {
+		std::string startup = "startup " + str::xtos(startup_ms_) + "ms";
+		if (!slowest_module_.empty())
+			startup += " (slowest: " + slowest_module_ + " " + str::xtos(slowest_ms_) + "ms)";
+		str::format::append_list(message, startup, std::string(", "));
+		if (!failed_modules_.empty())
+			str::format::append_list(message, "failed to load: " + str::utils::joinEx(failed_modules_, ", "), std::string(", "));
+	}
 	response->add_lines()->set_message(message);
 }
\ No newline at end of file
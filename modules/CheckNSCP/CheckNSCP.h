@@ -23,6 +23,7 @@
 
 #include <nscapi/nscapi_protobuf_command.hpp>
 #include <nscapi/nscapi_protobuf_log.hpp>
+#include <nscapi/nscapi_protobuf_metrics.hpp>
 #include <nscapi/plugin.hpp>
 
 #include <boost/thread/thread.hpp>
@@ -39,9 +40,14 @@ private:
 	std::string last_error_;
 	unsigned int error_count_;
 	boost::posix_time::ptime start_;
+	// Module startup timings (from the core "startup" metrics)
+	long long startup_ms_;
+	std::string slowest_module_;
+	long long slowest_ms_;
+	std::list<std::string> failed_modules_;
 public:
 
-	CheckNSCP() : error_count_(0) {}
+	CheckNSCP() : error_count_(0), startup_ms_(-1), slowest_ms_(0) {}
 
 	// Module calls
 	bool loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode);
@@ -50,6 +56,7 @@ public:
 	void check_nscp(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
 	void check_nscp_version(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
 	void handleLogMessage(const PB::Log::LogEntry::Entry &message);
+	void submitMetrics(const PB::Metrics::MetricsMessage &response);
 
 	std::size_t get_errors(std::string &last_error);
 };
\ No newline at end of file
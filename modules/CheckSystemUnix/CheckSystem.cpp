@@ -30,6 +30,7 @@
 
 #include <boost/program_options.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
  
 #include <utils.h>
 #include <nscapi/nscapi_settings_helper.hpp>
@@ -53,14 +54,17 @@ namespace po = boost::program_options;
  */
 bool CheckSystem::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 
-	sh::settings_registry settings(get_settings_proxy());
+	sh::settings_registry settings(nscapi::settings_proxy::create(get_id(), get_core()));
 	settings.set_alias("system", alias, "unix");
 	std::string counter_path = settings.alias().get_settings_path("counters");
 
 //	collector.filters_path_ = settings.alias().get_settings_path("real-time/checks");
 
 	//filters::filter_config_handler::add_samples(get_settings_proxy(), collector.filters_path_);
-	
+
+	if (mode == NSCAPI::normalStart) {
+		collector_.start();
+	}
 	return true;
 }
 
@@ -71,30 +75,54 @@ bool CheckSystem::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool CheckSystem::unloadModule() {
+	collector_.stop();
 	return true;
 }
 
-void CheckSystem::check_cpu(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_cpu(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
+	typedef check_cpu_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+	std::vector<std::string> times;
 
-}
+	filter_type filter;
+	filter_helper.add_options("load > 80", "load > 90", "core = 'total'", filter.get_filter_syntax(), "ignored");
+	filter_helper.add_syntax("${status}: ${problem_list}", "${time}: ${load}%", "${core} ${time}", "", "%(status): CPU load is ok.");
+	filter_helper.get_desc().add_options()
+		("time", po::value<std::vector<std::string> >(&times), "The time to check")
+		;
+
+	if (!filter_helper.parse_options())
+		return;
 
+	if (times.empty()) {
+		times.push_back("5m");
+		times.push_back("1m");
+		times.push_back("5s");
+	}
 
+	if (!filter_helper.build_filter(filter))
+		return;
 
-bool get_uptime(double &uptime_secs, double &idle_secs) {
-	try {
-		std::locale mylocale("C");
-		std::ifstream uptime_file;
-		uptime_file.imbue(mylocale);
-		uptime_file.open(UPTIME_FILE);
-		uptime_file >> uptime_secs >> idle_secs;
-		uptime_file.close();
-	} catch (const std::exception &e) {
-		return false;
+	BOOST_FOREACH(const std::string &time, times) {
+		std::map<std::string, procfs::load_entry> vals;
+		try {
+			vals = collector_.get_cpu_load(str::format::decode_time<long>(time, 1));
+		} catch (const std::exception &e) {
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to get cpu load for " + time + ": " + e.what());
+		}
+		typedef std::map<std::string, procfs::load_entry>::value_type vt;
+		BOOST_FOREACH(const vt &v, vals) {
+			boost::shared_ptr<check_cpu_filter::filter_obj> record(new check_cpu_filter::filter_obj(time, v.first, v.second));
+			filter.match(record);
+		}
 	}
-    return true;
+	filter_helper.post_process(filter);
 }
 
-void CheckSystem::check_uptime(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+
+
+void CheckSystem::check_uptime(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
 	typedef check_uptime_filter::filter filter_type;
 	modern_filter::data_container data;
 	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
@@ -110,9 +138,13 @@ void CheckSystem::check_uptime(const Plugin::QueryRequestMessage::Request &reque
 	if (!filter_helper.build_filter(filter))
 		return;
 
-	double uptime_secs = 0, idle_secs = 0;
-	get_uptime(uptime_secs, idle_secs);
-	unsigned long long value = uptime_secs;
+	procfs::uptime_info info;
+	{
+		boost::unique_lock<boost::mutex> lock(procfs_mutex_);
+		if (!uptime_reader_.read(info))
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to read " UPTIME_FILE);
+	}
+	unsigned long long value = static_cast<unsigned long long>(info.uptime);
 
 	boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
 	boost::posix_time::ptime epoch(boost::gregorian::date(1970,1,1));
@@ -126,7 +158,7 @@ void CheckSystem::check_uptime(const Plugin::QueryRequestMessage::Request &reque
 	filter_helper.post_process(filter);
 }
 
-void CheckSystem::check_os_version(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_os_version(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
 
 	typedef os_version_filter::filter filter_type;
 	modern_filter::data_container data;
@@ -158,63 +190,124 @@ void CheckSystem::check_os_version(const Plugin::QueryRequestMessage::Request &r
 	filter_helper.post_process(filter);
 }
 
-void CheckSystem::check_service(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_service(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
 
 }
 
 
-void CheckSystem::check_pagefile(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_pagefile(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
+	typedef check_page_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+
+	filter_type filter;
+	filter_helper.add_options("used > 60%", "used > 80%", "", filter.get_filter_syntax(), "ignored");
+	filter_helper.add_syntax("${status}: ${list}", "${name} ${used} (${size})", "${name}", "", "");
+
+	if (!filter_helper.parse_options())
+		return;
+
+	if (!filter_helper.build_filter(filter))
+		return;
+
+	std::vector<procfs::swap_entry> swaps;
+	{
+		boost::unique_lock<boost::mutex> lock(procfs_mutex_);
+		if (!swaps_reader_.read(swaps))
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to read /proc/swaps");
+	}
 
+	unsigned long long total_size = 0, total_used = 0;
+	BOOST_FOREACH(const procfs::swap_entry &e, swaps) {
+		boost::shared_ptr<check_page_filter::filter_obj> record(new check_page_filter::filter_obj(e.name, e.size - std::min(e.used, e.size), e.size));
+		filter.match(record);
+		total_size += e.size;
+		total_used += std::min(e.used, e.size);
+	}
+	boost::shared_ptr<check_page_filter::filter_obj> record(new check_page_filter::filter_obj("total", total_size - total_used, total_size));
+	filter.match(record);
+
+	filter_helper.post_process(filter);
 }
 
-long long read_mem_line(std::stringstream &iss) {
-	std::string unit;
-	unsigned long long value;
-	iss >> value >> unit;
-	if (unit == "kB") {
-		value*=1024;
-	} else if (!unit.empty()) {
-		NSC_LOG_ERROR("Invalid memory unit: " + unit);
+// Samples the given cgroups (or all of them down to depth), returns false if one of the given cgroups could not be read
+bool sample_cgroups(cgroup::cgroup_scanner &scanner, const std::vector<std::string> &cgroups, std::size_t depth, double window, cgroup::stats_list &list, std::string &failed) {
+	if (cgroups.empty()) {
+		list = scanner.scan(depth, window);
+		return true;
+	}
+	BOOST_FOREACH(const std::string &name, cgroups) {
+		cgroup::cgroup_stats stats;
+		if (!scanner.read(name, window, stats)) {
+			failed = name;
+			return false;
+		}
+		list.push_back(stats);
 	}
-	return value;
+	return true;
 }
-std::list<check_mem_filter::filter_obj> get_memory() {
-	std::list<check_mem_filter::filter_obj> ret;
-	check_mem_filter::filter_obj physical("physical", 0, 0);
-	check_mem_filter::filter_obj swap("swap", 0, 0);
-	long long cached = 0;
-
-	try {
-		std::locale mylocale("C");
-		std::ifstream file;
-		file.imbue(mylocale);
-		file.open(MEMINFO_FILE);
-		std::string line;
-		while (std::getline(file, line)) {
-			std::stringstream iss(line);
-			std::string tag;
-			iss >> tag;
-			if (tag == "MemTotal:")
-				physical.total = read_mem_line(iss);
-			else if (tag == "MemFree:")
-				physical.free = read_mem_line(iss);
-			else if (tag == "Buffers:" || tag == "Cached:")
-				cached += read_mem_line(iss);
-			else if (tag == "SwapTotal:")
-				swap.total += read_mem_line(iss);
-			else if (tag == "SwapFree:")
-				swap.free += read_mem_line(iss);
+
+void CheckSystem::check_cgroup(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
+	typedef check_cgroup_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+	std::vector<std::string> cgroups;
+	std::size_t depth = 2;
+	std::string time;
+	bool delta_scan = false;
+
+	filter_type filter;
+	filter_helper.add_options("memory_pct > 80 or cpu_some > 20 or memory_some > 10", "memory_pct > 90 or oom_kill > 0 or memory_full > 10", "", filter.get_filter_syntax(), "unknown");
+	filter_helper.add_syntax("${status}: ${problem_list}", "${name}: cpu ${cpu}%, memory ${memory}", "${name}", "UNKNOWN: No cgroups found", "%(status): all cgroups are ok.");
+	filter_helper.get_desc().add_options()
+		("cgroup", po::value<std::vector<std::string> >(&cgroups), "The cgroup(s) to check (relative to /sys/fs/cgroup), if not given all cgroups (down to depth) are checked")
+		("depth", po::value<std::size_t>(&depth), "How many levels below the root to check when checking all cgroups")
+		("time", po::value<std::string>(&time), "Calculate rates over (at least) this time window (if there are samples that old) instead of since the previous check")
+		("delta", po::value<bool>(&delta_scan), "Calculate rates over one second.\nThis call will sample the cgroups and then sleep for 1 second and then sample again (otherwise rates are since the previous check).")
+		;
+
+	if (!filter_helper.parse_options())
+		return;
+
+	if (!filter_helper.build_filter(filter))
+		return;
+
+	double window = time.empty() ? 0.0 : static_cast<double>(str::format::decode_time<long>(time, 1));
+	cgroup::stats_list list;
+	{
+		boost::unique_lock<boost::mutex> lock(cgroup_mutex_);
+		if (!cgroup_scanner_.is_available())
+			return nscapi::protobuf::functions::set_response_bad(*response, "No cgroup v2 hierarchy mounted at /sys/fs/cgroup");
+		std::string failed;
+		if (delta_scan) {
+			// Rates are calculated from the sample history so others can sample while we sleep
+			sample_cgroups(cgroup_scanner_, cgroups, depth, window, list, failed);
+			lock.unlock();
+			boost::this_thread::sleep(boost::posix_time::seconds(1));
+			lock.lock();
+			list.clear();
 		}
-		ret.push_back(physical);
-		ret.push_back(check_mem_filter::filter_obj("cached", physical.get_used()-cached, physical.total));
-		ret.push_back(swap);
-	} catch (const std::exception &e) {
-		return ret;
+		if (!sample_cgroups(cgroup_scanner_, cgroups, depth, window, list, failed))
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to read cgroup: " + failed);
+	}
+
+	BOOST_FOREACH(const cgroup::cgroup_stats &stats, list) {
+		boost::shared_ptr<check_cgroup_filter::filter_obj> record(new check_cgroup_filter::filter_obj(stats));
+		filter.match(record);
 	}
-    return ret;
+	filter_helper.post_process(filter);
+}
+
+std::list<check_mem_filter::filter_obj> get_memory(const procfs::meminfo &info) {
+	std::list<check_mem_filter::filter_obj> ret;
+	check_mem_filter::filter_obj physical("physical", info.free, info.total);
+	ret.push_back(physical);
+	ret.push_back(check_mem_filter::filter_obj("cached", physical.get_used() - (info.buffers + info.cached), info.total));
+	ret.push_back(check_mem_filter::filter_obj("swap", info.swap_free, info.swap_total));
+	return ret;
 }
 
-void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_memory(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
 	typedef check_mem_filter::filter filter_type;
 	modern_filter::data_container data;
 	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
@@ -239,12 +332,13 @@ void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &reque
 	if (!filter_helper.build_filter(filter))
 		return;
 
-	std::list<check_mem_filter::filter_obj> mem_data;
-	try {
-		mem_data = get_memory();
-	} catch (const std::exception &e) {
-		return nscapi::protobuf::functions::set_response_bad(*response, e.what());
+	procfs::meminfo info;
+	{
+		boost::unique_lock<boost::mutex> lock(procfs_mutex_);
+		if (!meminfo_reader_.read(info))
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to read " MEMINFO_FILE);
 	}
+	std::list<check_mem_filter::filter_obj> mem_data = get_memory(info);
 
 	BOOST_FOREACH(const std::string &type, types) {
 		bool found = false;
@@ -265,6 +359,74 @@ void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &reque
 }
 
 
-void CheckSystem::check_process(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+void CheckSystem::check_process(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response) {
+	typedef check_proc_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+	std::vector<std::string> processes;
+	bool deep_scan = false;
+	bool delta_scan = false;
+
+	filter_type filter;
+	filter_helper.add_filter_option("state != 'zombie'");
+	filter_helper.add_warn_option("state not in ('started')");
+	filter_helper.add_crit_option("state = 'stopped'", "count = 0");
+
+	filter_helper.add_options(filter.get_filter_syntax(), "unknown");
+	filter_helper.add_syntax("${status}: ${problem_list}", "${exe}=${state}", "${exe}", "UNKNOWN: No processes found", "%(status): all processes are ok.");
+	filter_helper.get_desc().add_options()
+		("process", po::value<std::vector<std::string> >(&processes), "The process to check, set this to * to check all processes")
+		("scan-info", po::value<bool>(&deep_scan), "If peak memory usage should be fetched as well (slower)")
+		("delta", po::value<bool>(&delta_scan), "Calculate cpu usage over one second.\nThis call will scan the processes and then sleep for 1 second and then scan again (otherwise cpu is since the previous check).")
+		;
+
+	if (!filter_helper.parse_options())
+		return;
+
+	if (processes.empty()) {
+		processes.push_back("*");
+	}
+	if (!filter_helper.build_filter(filter))
+		return;
 
+	std::set<std::string> procs;
+	bool all = false;
+	BOOST_FOREACH(const std::string &process, processes) {
+		if (process == "*")
+			all = true;
+		else
+			procs.insert(process);
+	}
+
+	process_helper::process_list list;
+	if (delta_scan) {
+		// Not holding the lock while sleeping: cpu is calculated over the time since the previous scan so a scan
+		// made by someone else in between only shortens the interval.
+		boost::unique_lock<boost::mutex> lock(process_mutex_);
+		process_scanner_.scan(false);
+		lock.unlock();
+		boost::this_thread::sleep(boost::posix_time::seconds(1));
+	}
+	{
+		boost::unique_lock<boost::mutex> lock(process_mutex_);
+		list = process_scanner_.scan(deep_scan);
+	}
+
+	std::set<std::string> matched;
+	BOOST_FOREACH(const process_helper::process_info &info, list) {
+		bool wanted = procs.count(info.get_exe()) > 0;
+		if (all || wanted) {
+			boost::shared_ptr<process_helper::process_info> record(new process_helper::process_info(info));
+			filter.match(record);
+		}
+		if (wanted)
+			matched.insert(info.get_exe());
+	}
+	BOOST_FOREACH(const std::string &proc, procs) {
+		if (matched.count(proc) == 0) {
+			boost::shared_ptr<process_helper::process_info> record(new process_helper::process_info(process_helper::process_info::missing(proc)));
+			filter.match(record);
+		}
+	}
+	filter_helper.post_process(filter);
 }
@@ -19,14 +19,33 @@
 
 #pragma once
 
-#include <nscapi/nscapi_protobuf.hpp>
+#include <nscapi/nscapi_protobuf_command.hpp>
 #include <nscapi/nscapi_settings_proxy.hpp>
 #include <nscapi/nscapi_plugin_impl.hpp>
 #include <nscapi/nscapi_settings_object.hpp>
 
+#include <cgroup/cgroup.hpp>
+
 #include "filter_config_object.hpp"
+#include "process_scanner.hpp"
+#include "procfs.hpp"
+#include "realtime_thread.hpp"
+
+#include <boost/thread/mutex.hpp>
 
 class CheckSystem : public nscapi::impl::simple_plugin {
+	// Kept between checks so processes which were already seen are cheap to rescan
+	process_helper::process_scanner process_scanner_;
+	boost::mutex process_mutex_;
+	// The /proc files are kept open between checks
+	procfs::meminfo_reader meminfo_reader_;
+	procfs::uptime_reader uptime_reader_;
+	procfs::swaps_reader swaps_reader_;
+	boost::mutex procfs_mutex_;
+	// Keeps the cgroup files open and the recent samples (for rates) between checks
+	cgroup::cgroup_scanner cgroup_scanner_;
+	boost::mutex cgroup_mutex_;
+	pdh_thread collector_;
 public:
 	CheckSystem() {}
 	virtual ~CheckSystem() {}
@@ -34,13 +53,14 @@ public:
 	virtual bool loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode);
 	virtual bool unloadModule();
 
-	void check_service(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	void check_memory(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	//void check_pdh(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	void check_process(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	void check_cpu(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	void check_uptime(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
-	void check_pagefile(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
+	void check_service(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_memory(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	//void check_pdh(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_process(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_cpu(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_uptime(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_pagefile(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
+	void check_cgroup(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
 	void add_counter(boost::shared_ptr<nscapi::settings_proxy> proxy, std::string path, std::string key, std::string query);
-	void check_os_version(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
+	void check_os_version(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response);
 };
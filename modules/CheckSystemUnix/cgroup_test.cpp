@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cgroup/cgroup.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <str/xtos.hpp>
+
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+	cgroup::pressure pressure(const std::string &data) {
+		cgroup::pressure ret;
+		cgroup::parse_pressure(data.c_str(), data.size(), ret);
+		return ret;
+	}
+
+	cgroup::cgroup_stats make_stats(double elapsed) {
+		cgroup::cgroup_stats stats;
+		stats.has_previous = true;
+		stats.previous.time = 100.0;
+		stats.current.time = 100.0 + elapsed;
+		return stats;
+	}
+
+	class cgroup_scanner_test : public ::testing::Test {
+	protected:
+		boost::filesystem::path root;
+
+		void SetUp() {
+			root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("nscp-cgroup-%%%%-%%%%");
+			boost::filesystem::create_directories(root / "a");
+			write("cgroup.controllers", "cpu memory io\n");
+		}
+		void TearDown() {
+			boost::filesystem::remove_all(root);
+		}
+		void write(const std::string &file, const std::string &data) {
+			// Rewrite in place (the scanner keeps the descriptors open)
+			std::ofstream out((root / file).string().c_str(), std::ios::out | std::ios::trunc);
+			out << data;
+		}
+		void write_usage(unsigned long long usage, unsigned long long oom_kill) {
+			write("a/cpu.stat", "usage_usec " + str::xtos(usage) + "\nuser_usec 0\nsystem_usec 0\n");
+			write("a/memory.events", "low 0\nhigh 0\nmax 0\noom 0\noom_kill " + str::xtos(oom_kill) + "\n");
+		}
+	};
+}
+
+TEST(cgroup_parse, pressure) {
+	cgroup::pressure p = pressure(
+		"some avg10=1.50 avg60=0.25 avg300=12.00 total=123456\n"
+		"full avg10=0.10 avg60=0.02 avg300=0.00 total=789\n");
+	EXPECT_DOUBLE_EQ(1.5, p.some_avg10);
+	EXPECT_DOUBLE_EQ(0.25, p.some_avg60);
+	EXPECT_DOUBLE_EQ(12.0, p.some_avg300);
+	EXPECT_EQ(123456u, p.some_total);
+	EXPECT_NEAR(0.1, p.full_avg10, 1e-9);
+	EXPECT_NEAR(0.02, p.full_avg60, 1e-9);
+	EXPECT_DOUBLE_EQ(0.0, p.full_avg300);
+	EXPECT_EQ(789u, p.full_total);
+}
+
+TEST(cgroup_parse, pressure_some_only) {
+	// cpu.pressure on older kernels (and the root cgroup) only has the some line
+	cgroup::pressure p = pressure("some avg10=3.25 avg60=2.00 avg300=1.00 total=42");
+	EXPECT_DOUBLE_EQ(3.25, p.some_avg10);
+	EXPECT_DOUBLE_EQ(2.0, p.some_avg60);
+	EXPECT_DOUBLE_EQ(1.0, p.some_avg300);
+	EXPECT_EQ(42u, p.some_total);
+	EXPECT_DOUBLE_EQ(0.0, p.full_avg10);
+	EXPECT_EQ(0u, p.full_total);
+}
+
+TEST(cgroup_parse, pressure_unknown_fields) {
+	cgroup::pressure p = pressure("some avg10=1.00 extra=5 total=7\nbogus line\n\nfull total=9\n");
+	EXPECT_DOUBLE_EQ(1.0, p.some_avg10);
+	EXPECT_EQ(7u, p.some_total);
+	EXPECT_EQ(9u, p.full_total);
+}
+
+TEST(cgroup_parse, cpu_stat) {
+	std::string data =
+		"usage_usec 1234567890\n"
+		"user_usec 1000000\n"
+		"system_usec 234567890\n"
+		"core_sched.force_idle_usec 0\n"
+		"nr_periods 50\n"
+		"nr_throttled 5\n"
+		"throttled_usec 999\n"
+		"nr_bursts 0\n"
+		"burst_usec 0\n";
+	cgroup::sample s;
+	cgroup::parse_cpu_stat(data.c_str(), data.size(), s);
+	EXPECT_EQ(1234567890u, s.usage_usec);
+	EXPECT_EQ(1000000u, s.user_usec);
+	EXPECT_EQ(234567890u, s.system_usec);
+	EXPECT_EQ(50u, s.nr_periods);
+	EXPECT_EQ(5u, s.nr_throttled);
+	EXPECT_EQ(999u, s.throttled_usec);
+}
+
+TEST(cgroup_parse, cpu_stat_without_cpu_controller) {
+	// Only the usage fields exist when the cpu controller is not enabled
+	std::string data = "usage_usec 10\nuser_usec 6\nsystem_usec 4";
+	cgroup::sample s;
+	cgroup::parse_cpu_stat(data.c_str(), data.size(), s);
+	EXPECT_EQ(10u, s.usage_usec);
+	EXPECT_EQ(6u, s.user_usec);
+	EXPECT_EQ(4u, s.system_usec);
+	EXPECT_EQ(0u, s.nr_periods);
+	EXPECT_EQ(0u, s.throttled_usec);
+}
+
+TEST(cgroup_parse, memory_events) {
+	// oom must not be confused with oom_kill (or oom_group_kill)
+	std::string data = "low 1\nhigh 22\nmax 333\noom 4\noom_kill 5\noom_group_kill 6\n";
+	cgroup::sample s;
+	cgroup::parse_memory_events(data.c_str(), data.size(), s);
+	EXPECT_EQ(1u, s.events_low);
+	EXPECT_EQ(22u, s.events_high);
+	EXPECT_EQ(333u, s.events_max);
+	EXPECT_EQ(4u, s.events_oom);
+	EXPECT_EQ(5u, s.events_oom_kill);
+}
+
+TEST(cgroup_stats, rates) {
+	cgroup::cgroup_stats stats = make_stats(2.0);
+	stats.previous.usage_usec = 1000000;
+	stats.current.usage_usec = 2000000;
+	stats.previous.nr_periods = 100;
+	stats.current.nr_periods = 200;
+	stats.previous.nr_throttled = 10;
+	stats.current.nr_throttled = 35;
+	stats.previous.events_oom_kill = 1;
+	stats.current.events_oom_kill = 3;
+	stats.previous.cpu.some_total = 0;
+	stats.current.cpu.some_total = 500000;
+	// One second of cpu over two seconds is half a core
+	EXPECT_DOUBLE_EQ(50.0, stats.get_cpu());
+	EXPECT_DOUBLE_EQ(25.0, stats.get_throttled());
+	EXPECT_EQ(2u, stats.get_oom_kill());
+	EXPECT_DOUBLE_EQ(25.0, stats.get_some(&cgroup::sample::cpu));
+}
+
+TEST(cgroup_stats, counter_reset) {
+	// The cgroup was removed and created again: counters start over
+	cgroup::cgroup_stats stats = make_stats(1.0);
+	stats.previous.usage_usec = 5000000;
+	stats.current.usage_usec = 100;
+	stats.previous.events_oom_kill = 7;
+	stats.current.events_oom_kill = 1;
+	stats.previous.nr_periods = 100;
+	stats.current.nr_periods = 10;
+	EXPECT_DOUBLE_EQ(0.0, stats.get_cpu());
+	EXPECT_EQ(0u, stats.get_oom_kill());
+	EXPECT_DOUBLE_EQ(0.0, stats.get_throttled());
+}
+
+TEST(cgroup_stats, no_previous) {
+	cgroup::cgroup_stats stats;
+	stats.current.usage_usec = 5000000;
+	stats.current.cpu.some_avg10 = 12.5;
+	EXPECT_DOUBLE_EQ(0.0, stats.get_cpu());
+	EXPECT_EQ(0u, stats.get_oom_kill());
+	// Falls back to the kernel average
+	EXPECT_DOUBLE_EQ(12.5, stats.get_some(&cgroup::sample::cpu));
+}
+
+TEST_F(cgroup_scanner_test, ring_buffer) {
+	cgroup::cgroup_scanner scanner(root.string(), 4);
+	ASSERT_TRUE(scanner.is_available());
+	cgroup::cgroup_stats stats;
+
+	write_usage(1000, 0);
+	ASSERT_TRUE(scanner.read("a", 0.0, stats));
+	EXPECT_EQ("a", stats.name);
+	EXPECT_FALSE(stats.has_previous);
+	EXPECT_EQ(1000u, stats.current.usage_usec);
+
+	boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+	write_usage(6000, 2);
+	ASSERT_TRUE(scanner.read("/a/", 0.0, stats));
+	ASSERT_TRUE(stats.has_previous);
+	EXPECT_EQ(1000u, stats.previous.usage_usec);
+	EXPECT_EQ(6000u, stats.current.usage_usec);
+	ASSERT_GT(stats.get_elapsed(), 0.0);
+	EXPECT_DOUBLE_EQ(5000 / (stats.get_elapsed() * 10000.0), stats.get_cpu());
+	EXPECT_EQ(2u, stats.get_oom_kill());
+
+	// A window longer than the history uses the oldest sample
+	write_usage(9000, 2);
+	ASSERT_TRUE(scanner.read("a", 3600.0, stats));
+	EXPECT_EQ(1000u, stats.previous.usage_usec);
+	// Without a window it is the previous one
+	write_usage(10000, 2);
+	ASSERT_TRUE(scanner.read("a", 0.0, stats));
+	EXPECT_EQ(9000u, stats.previous.usage_usec);
+
+	// The history is bounded (4 samples) so the oldest ones are gone
+	write_usage(11000, 2);
+	ASSERT_TRUE(scanner.read("a", 3600.0, stats));
+	EXPECT_EQ(6000u, stats.previous.usage_usec);
+
+	// Counter reset
+	write_usage(10, 0);
+	ASSERT_TRUE(scanner.read("a", 0.0, stats));
+	EXPECT_EQ(11000u, stats.previous.usage_usec);
+	EXPECT_DOUBLE_EQ(0.0, stats.get_cpu());
+	EXPECT_EQ(0u, stats.get_oom_kill());
+}
+
+TEST_F(cgroup_scanner_test, missing_cgroup) {
+	cgroup::cgroup_scanner scanner(root.string());
+	cgroup::cgroup_stats stats;
+	EXPECT_FALSE(scanner.read("missing", 0.0, stats));
+	EXPECT_FALSE(scanner.read("../etc", 0.0, stats));
+	EXPECT_EQ(0u, scanner.get_cached_count());
+}
+
+TEST_F(cgroup_scanner_test, scan) {
+	write("cpu.stat", "usage_usec 1\n");
+	write_usage(2, 0);
+	cgroup::cgroup_scanner scanner(root.string());
+	cgroup::stats_list list = scanner.scan(1, 0.0);
+	ASSERT_EQ(2u, list.size());
+	EXPECT_EQ("/", list.front().name);
+	EXPECT_EQ(1u, list.front().current.usage_usec);
+	EXPECT_EQ("a", list.back().name);
+	EXPECT_EQ(2u, list.back().current.usage_usec);
+	EXPECT_EQ(1u, scanner.scan(0, 0.0).size());
+}
@@ -98,18 +98,18 @@ namespace check_mem_filter {
 
 	}
 }
-/*
+
 namespace check_page_filter {
 
 	parsers::where::node_type calculate_free(boost::shared_ptr<filter_obj> object, parsers::where::evaluation_context context, parsers::where::node_type subject) {
-		boost::tuple<long long, std::string> value = parsers::where::helpers::read_arguments(context, subject, "%");
-		long long number = value.get<0>();
-		std::string unit = value.get<1>();
+		parsers::where::helpers::read_arg_type value = parsers::where::helpers::read_arguments(context, subject, "%");
+		long long number = value.get<1>();
+		std::string unit = value.get<2>();
 
 		if (unit == "%") {
 			number = (object->get_total()*(number))/100;
 		} else {
-			number = format::decode_byte_units(number, unit);
+			number = str::format::decode_byte_units(number, unit);
 		}
 		return parsers::where::factory::create_int(number);
 	}
@@ -123,10 +123,10 @@ namespace check_page_filter {
 		static const parsers::where::value_type type_custom_free = parsers::where::type_custom_int_2;
 
 		registry_.add_string()
-			("name", boost::bind(&filter_obj::get_name, _1), "The name of the page file (location)")
+			("name", boost::bind(&filter_obj::get_name, _1), "The name of the swap area (device or file) or total")
 			;
 		registry_.add_int()
-			("size", boost::bind(&filter_obj::get_total, _1), "Total size of pagefile")
+			("size", boost::bind(&filter_obj::get_total, _1), "Total size of the swap area")
 			("free", type_custom_free, boost::bind(&filter_obj::get_free, _1), "Free memory in bytes (g,m,k,b) or percentages %")
 			.add_scaled_byte(boost::bind(&get_zero), boost::bind(&filter_obj::get_total, _1))
 			.add_percentage(boost::bind(&filter_obj::get_total, _1), "", " %")
@@ -149,7 +149,7 @@ namespace check_page_filter {
 	}
 }
 
-
+/*
 namespace check_svc_filter {
 
 	bool check_state_is_perfect(DWORD state, DWORD start_type) {
@@ -262,67 +262,72 @@ namespace check_uptime_filter {
 	}
 }
 
-/*
-
-
 namespace check_proc_filter {
-
-
-	parsers::where::node_type parse_state(boost::shared_ptr<filter_obj> object, parsers::where::evaluation_context context, parsers::where::node_type subject) {
-		return parsers::where::factory::create_int(filter_obj::parse_state(subject->get_string_value(context)));
-	}
-
 	filter_obj_handler::filter_obj_handler() {
-		static const parsers::where::value_type type_custom_state = parsers::where::type_custom_int_1;
-		static const parsers::where::value_type type_custom_start_type = parsers::where::type_custom_int_2;
-
- 		registry_.add_string()
+		registry_.add_string()
 			("filename", boost::bind(&filter_obj::get_filename, _1), "Name of process (with path)")
 			("exe", boost::bind(&filter_obj::get_exe, _1), "The name of the executable")
 			("command_line", boost::bind(&filter_obj::get_command_line, _1), "Command line of process (not always available)")
-			("legacy_state", boost::bind(&filter_obj::get_legacy_state_s, _1), "Get process status (for legacy use via check_nt only)")
- 			;
- 		registry_.add_int()
-			("pid", boost::bind(&filter_obj::get_pid, _1), "Process id")
-			("started", parsers::where::type_bool, boost::bind(&filter_obj::get_started, _1), "Process is started")
-			("hung", parsers::where::type_bool, boost::bind(&filter_obj::get_hung, _1), "Process is hung")
-			("stopped", parsers::where::type_bool, boost::bind(&filter_obj::get_stopped, _1), "Process is stopped")
+			("state", boost::bind(&filter_obj::get_state_s, _1), "The current state (started, suspended, zombie or stopped if it is not running)")
+			("raw_state", boost::bind(&filter_obj::get_raw_state, _1), "The state as reported by the kernel (R, S, D, Z, T, ...)")
 			;
 		registry_.add_int()
-			("handles", boost::bind(&filter_obj::get_handleCount, _1), "Number of handles").add_perf("", "", " handle count")
-			("gdi_handles", boost::bind(&filter_obj::get_gdiHandleCount, _1), "Number of handles").add_perf("", "", " GDI handle count")
-			("user_handles", boost::bind(&filter_obj::get_userHandleCount, _1), "Number of handles").add_perf("", "", " USER handle count")
-			("peak_virtual", parsers::where::type_size, boost::bind(&filter_obj::get_PeakVirtualSize, _1), "Peak virtual size in bytes").add_scaled_byte(std::string(""), " pv_size")
-			("virtual", parsers::where::type_size, boost::bind(&filter_obj::get_VirtualSize, _1), "Virtual size in bytes").add_scaled_byte(std::string(""), " v_size")
-			("page_fault", boost::bind(&filter_obj::get_PageFaultCount, _1), "Page fault count").add_perf("", "", " pf_count")
-			("peak_working_set", parsers::where::type_size, boost::bind(&filter_obj::get_PeakWorkingSetSize, _1), "Peak working set in bytes").add_scaled_byte(std::string(""), " pws_size")
-			("working_set", parsers::where::type_size, boost::bind(&filter_obj::get_WorkingSetSize, _1), "Working set in bytes").add_scaled_byte(std::string(""), " ws_size")
-// 			("qouta", parsers::where::type_size, boost::bind(&filter_obj::get_QuotaPeakPagedPoolUsage, _1), "TODO").add_scaled_byte(std::string(""), " v_size")
-// 			("virtual_size", parsers::where::type_size, boost::bind(&filter_obj::get_QuotaPagedPoolUsage, _1), "TODO").add_scaled_byte(std::string(""), " v_size")
-// 			("virtual_size", parsers::where::type_size, boost::bind(&filter_obj::get_QuotaPeakNonPagedPoolUsage, _1), "TODO").add_scaled_byte(std::string(""), " v_size")
-// 			("virtual_size", parsers::where::type_size, boost::bind(&filter_obj::get_QuotaNonPagedPoolUsage, _1), "TODO").add_scaled_byte(std::string(""), " v_size")
-			("peak_pagefile", parsers::where::type_size, boost::bind(&filter_obj::get_PagefileUsage, _1), "Page file usage in bytes").add_scaled_byte(std::string(""), " ppf_use")
-			("pagefile", parsers::where::type_size, boost::bind(&filter_obj::get_PeakPagefileUsage, _1), "Peak page file use in bytes").add_scaled_byte(std::string(""), " pf_use")
-
-			("creation", parsers::where::type_date, boost::bind(&filter_obj::get_creation_time, _1), "Creation time").add_perf("", "", " creation")
+			("pid", boost::bind(&filter_obj::get_pid, _1), "Process id")
+			("ppid", boost::bind(&filter_obj::get_ppid, _1), "Parent process id")
+			("uid", boost::bind(&filter_obj::get_uid, _1), "Real user id of the process owner")
+			("started", parsers::where::type_bool, boost::bind(&filter_obj::get_started, _1), "Process is started")
+			("stopped", parsers::where::type_bool, boost::bind(&filter_obj::get_stopped, _1), "Process is stopped (not running, suspended or a zombie)")
+			("zombie", parsers::where::type_bool, boost::bind(&filter_obj::get_zombie, _1), "Process is a zombie")
+			("threads", boost::bind(&filter_obj::get_threads, _1), "Number of threads").add_perf("", "", " threads")
+			("peak_virtual", parsers::where::type_size, boost::bind(&filter_obj::get_peak_virtual, _1), "Peak virtual size in bytes (requires scan-info)").add_scaled_byte(std::string(""), " pv_size")
+			("virtual", parsers::where::type_size, boost::bind(&filter_obj::get_virtual, _1), "Virtual size in bytes").add_scaled_byte(std::string(""), " v_size")
+			("page_fault", boost::bind(&filter_obj::get_page_faults, _1), "Page fault count").add_perf("", "", " pf_count")
+			("peak_working_set", parsers::where::type_size, boost::bind(&filter_obj::get_peak_working_set, _1), "Peak working set (resident) in bytes (requires scan-info)").add_scaled_byte(std::string(""), " pws_size")
+			("working_set", parsers::where::type_size, boost::bind(&filter_obj::get_working_set, _1), "Working set (resident) in bytes").add_scaled_byte(std::string(""), " ws_size")
+			("creation", parsers::where::type_date, boost::bind(&filter_obj::get_creation, _1), "Creation time").add_perf("", "", " creation")
 			("kernel", boost::bind(&filter_obj::get_kernel_time, _1), "Kernel time in seconds").add_perf("", "", " kernel")
 			("user", boost::bind(&filter_obj::get_user_time, _1), "User time in seconds").add_perf("", "", " user")
-
- 			("state", type_custom_state, boost::bind(&filter_obj::get_state_i, _1), "The current state (started, stopped hung)").add_perf("", ""," state")
- 			;
-
-		registry_.add_human_string()
-			("state", boost::bind(&filter_obj::get_state_s, _1), "The current state (started, stopped hung)")
+			("time", boost::bind(&filter_obj::get_total_time, _1), "User-kernel time in seconds").add_perf("", "", " total")
+			("cpu", boost::bind(&filter_obj::get_cpu, _1), "CPU usage in percent (of one core) since the previous scan").add_perf("%", "", " cpu")
 			;
+	}
+}
 
-		registry_.add_converter()
-			(type_custom_state, &parse_state)
+namespace check_cgroup_filter {
+	filter_obj_handler::filter_obj_handler() {
+		registry_.add_string()
+			("name", boost::bind(&filter_obj::get_name, _1), "The path of the cgroup (relative to the cgroup root)")
+			("id", boost::bind(&filter_obj::get_id, _1), "The last component of the name (for instance docker-<id>.scope)")
+			;
+		registry_.add_int()
+			("memory", boost::bind(&filter_obj::get_memory, _1), "Memory used by the cgroup (memory.current) in bytes").add_perf("B")
+			("memory_limit", boost::bind(&filter_obj::get_memory_limit, _1), "The memory limit (memory.max) in bytes, 0 if there is no limit")
+			("memory_pct", boost::bind(&filter_obj::get_memory_pct, _1), "Memory used in percent of the limit (0 if there is no limit)").add_perf("%")
+			("throttled_time", boost::bind(&filter_obj::get_throttled_time, _1), "Time (ms) the cgroup was throttled in the sample window").add_perf("ms")
+			("high_events", boost::bind(&filter_obj::get_high_events, _1), "Times the memory.high boundary was crossed in the sample window")
+			("max_events", boost::bind(&filter_obj::get_max_events, _1), "Times the memory limit was hit in the sample window")
+			("oom", boost::bind(&filter_obj::get_oom, _1), "Times the cgroup ran out of memory in the sample window")
+			("oom_kill", boost::bind(&filter_obj::get_oom_kill, _1), "Processes killed by the OOM killer in the sample window")
+			("oom_kill_total", boost::bind(&filter_obj::get_oom_kill_total, _1), "Processes killed by the OOM killer since the cgroup was created")
+			;
+		registry_.add_float()
+			("cpu", boost::bind(&filter_obj::get_cpu, _1), "CPU usage in percent of one core over the sample window").add_perf("%")
+			("cpu_user", boost::bind(&filter_obj::get_cpu_user, _1), "User mode CPU usage in percent of one core")
+			("cpu_system", boost::bind(&filter_obj::get_cpu_system, _1), "Kernel mode CPU usage in percent of one core")
+			("throttled", boost::bind(&filter_obj::get_throttled, _1), "Percent of the CPU quota periods which were throttled").add_perf("%")
+			("cpu_some", boost::bind(&filter_obj::get_cpu_some, _1), "Percent of time some tasks were stalled waiting for CPU (PSI)").add_perf("%")
+			("cpu_full", boost::bind(&filter_obj::get_cpu_full, _1), "Percent of time all tasks were stalled waiting for CPU (PSI)").add_perf("%")
+			("memory_some", boost::bind(&filter_obj::get_memory_some, _1), "Percent of time some tasks were stalled on memory (PSI)").add_perf("%")
+			("memory_full", boost::bind(&filter_obj::get_memory_full, _1), "Percent of time all tasks were stalled on memory (PSI)").add_perf("%")
+			("io_some", boost::bind(&filter_obj::get_io_some, _1), "Percent of time some tasks were stalled on IO (PSI)").add_perf("%")
+			("io_full", boost::bind(&filter_obj::get_io_full, _1), "Percent of time all tasks were stalled on IO (PSI)").add_perf("%")
+			;
+		registry_.add_human_string()
+			("memory", boost::bind(&filter_obj::get_memory_human, _1), "")
+			("memory_limit", boost::bind(&filter_obj::get_memory_limit_human, _1), "")
 			;
-
-
 	}
 }
-*/
 
 namespace os_version_filter {
 	filter_obj_handler::filter_obj_handler() {
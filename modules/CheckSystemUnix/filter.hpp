@@ -33,22 +33,28 @@
 
 #include <string>
 
+#include <cgroup/cgroup.hpp>
+
+#include "process_scanner.hpp"
+#include "procfs.hpp"
+
 namespace check_cpu_filter {
 
 	struct filter_obj {
 		std::string time;
 		std::string core;
+		procfs::load_entry value;
 
-		filter_obj(std::string time, std::string core) : time(time), core(core) {}
+		filter_obj(std::string time, std::string core, const procfs::load_entry &value) : time(time), core(core), value(value) {}
 
 		long long get_total() const {
-			return 0;
+			return static_cast<long long>(value.total);
 		}
 		long long get_idle() const {
-			return 0;
+			return static_cast<long long>(value.idle);
 		}
 		long long get_kernel() const {
-			return 0;
+			return static_cast<long long>(value.kernel);
 		}
 		std::string get_time() const {
 			return time;
@@ -113,7 +119,47 @@ namespace check_mem_filter {
 	};
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
 }
-/*
+
+namespace check_page_filter {
+
+	struct filter_obj {
+		std::string name;
+		unsigned long long free;
+		unsigned long long total;
+
+		filter_obj(std::string name, unsigned long long free, unsigned long long total) : name(name), free(free), total(total) {}
+
+		long long get_total() const {
+			return total;
+		}
+		long long get_used() const {
+			return total - free;
+		}
+		long long get_free() const {
+			return free;
+		}
+		std::string get_name() const {
+			return name;
+		}
+
+		std::string get_total_human() const {
+			return str::format::format_byte_units(get_total());
+		}
+		std::string get_used_human() const {
+			return str::format::format_byte_units(get_used());
+		}
+		std::string get_free_human() const {
+			return str::format::format_byte_units(get_free());
+		}
+	};
+
+	typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
+	struct filter_obj_handler : public native_context {
+		filter_obj_handler();
+	};
+	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
+}
+
 namespace check_proc_filter {
 	typedef process_helper::process_info filter_obj;
 
@@ -123,7 +169,98 @@ namespace check_proc_filter {
 	};
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
 }
-*/
+
+namespace check_cgroup_filter {
+
+	// Rates (cpu, throttling, stall time and events) are over the window between the two samples
+	struct filter_obj {
+		cgroup::cgroup_stats stats;
+
+		filter_obj(const cgroup::cgroup_stats &stats) : stats(stats) {}
+
+		std::string get_name() const {
+			return stats.name;
+		}
+		std::string get_id() const {
+			std::string::size_type pos = stats.name.find_last_of('/');
+			if (pos == std::string::npos || stats.name.size() == 1)
+				return stats.name;
+			return stats.name.substr(pos + 1);
+		}
+		long long get_memory() const {
+			return stats.current.memory_current;
+		}
+		long long get_memory_limit() const {
+			return stats.current.memory_max;
+		}
+		long long get_memory_pct() const {
+			if (stats.current.memory_max == 0)
+				return 0;
+			return static_cast<long long>(stats.current.memory_current * 100 / stats.current.memory_max);
+		}
+		double get_cpu() const {
+			return stats.get_cpu();
+		}
+		double get_cpu_user() const {
+			return stats.get_cpu_user();
+		}
+		double get_cpu_system() const {
+			return stats.get_cpu_system();
+		}
+		double get_throttled() const {
+			return stats.get_throttled();
+		}
+		long long get_throttled_time() const {
+			return static_cast<long long>(stats.get_throttled_usec() / 1000);
+		}
+		long long get_high_events() const {
+			return stats.get_high_events();
+		}
+		long long get_max_events() const {
+			return stats.get_max_events();
+		}
+		long long get_oom() const {
+			return stats.get_oom();
+		}
+		long long get_oom_kill() const {
+			return stats.get_oom_kill();
+		}
+		long long get_oom_kill_total() const {
+			return stats.current.events_oom_kill;
+		}
+		double get_cpu_some() const {
+			return stats.get_some(&cgroup::sample::cpu);
+		}
+		double get_cpu_full() const {
+			return stats.get_full(&cgroup::sample::cpu);
+		}
+		double get_memory_some() const {
+			return stats.get_some(&cgroup::sample::memory);
+		}
+		double get_memory_full() const {
+			return stats.get_full(&cgroup::sample::memory);
+		}
+		double get_io_some() const {
+			return stats.get_some(&cgroup::sample::io);
+		}
+		double get_io_full() const {
+			return stats.get_full(&cgroup::sample::io);
+		}
+		std::string get_memory_human() const {
+			return str::format::format_byte_units(get_memory());
+		}
+		std::string get_memory_limit_human() const {
+			return stats.current.memory_max == 0 ? "max" : str::format::format_byte_units(get_memory_limit());
+		}
+	};
+
+	typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
+	struct filter_obj_handler : public native_context {
+		filter_obj_handler();
+	};
+	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
+}
+
 namespace os_version_filter {
 
 	struct filter_obj {
@@ -63,7 +63,7 @@ namespace filters {
 
 	void filter_config_object::read(boost::shared_ptr<nscapi::settings_proxy> proxy, bool oneliner, bool is_sample) {
 		if (!get_value().empty())
-			filter.filter_string = get_value();
+			filter.set_filter_string(get_value().c_str());
 		bool is_default = parent::is_default();
 
 		nscapi::settings_helper::settings_registry settings(proxy);
@@ -104,7 +104,7 @@ namespace filters {
 				// Populate default values!
 				filter.syntax_top = "${list}";
 				filter.syntax_detail = "${core}>${load}%";
-				filter.filter_string = "core = 'total'";
+				filter.set_filter_string("core = 'total'");
 			}
 
 			root_path.add_key()
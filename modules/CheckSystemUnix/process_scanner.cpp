@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "process_scanner.hpp"
+
+#include <boost/make_shared.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+	const std::size_t buffer_size = 8192;
+	// Longer command lines are truncated
+	const std::size_t max_cmdline = 4096;
+
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\n';
+	}
+	inline void skip_space(const char *&p, const char *end) {
+		while (p < end && is_space(*p))
+			p++;
+	}
+	inline void skip_field(const char *&p, const char *end) {
+		skip_space(p, end);
+		while (p < end && !is_space(*p))
+			p++;
+	}
+	inline unsigned long long parse_ull(const char *&p, const char *end) {
+		skip_space(p, end);
+		unsigned long long ret = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			ret = ret * 10 + (*p++ - '0');
+		return ret;
+	}
+	inline long long parse_ll(const char *&p, const char *end) {
+		skip_space(p, end);
+		if (p < end && *p == '-') {
+			p++;
+			return -static_cast<long long>(parse_ull(p, end));
+		}
+		return static_cast<long long>(parse_ull(p, end));
+	}
+	inline bool starts_with(const char *p, const char *end, const char *key, std::size_t len) {
+		return static_cast<std::size_t>(end - p) >= len && memcmp(p, key, len) == 0;
+	}
+
+	// Writes "<pid>/<file>" into buf
+	void make_path(char *buf, std::size_t size, pid_t pid, const char *file) {
+		char digits[24];
+		int n = 0;
+		unsigned long v = static_cast<unsigned long>(pid);
+		do {
+			digits[n++] = static_cast<char>('0' + v % 10);
+			v /= 10;
+		} while (v > 0);
+		std::size_t pos = 0;
+		while (n > 0 && pos < size - 1)
+			buf[pos++] = digits[--n];
+		if (pos < size - 1)
+			buf[pos++] = '/';
+		while (*file && pos < size - 1)
+			buf[pos++] = *file++;
+		buf[pos] = 0;
+	}
+
+	bool parse_pid(const char *name, pid_t &pid) {
+		if (*name == 0)
+			return false;
+		long long v = 0;
+		for (; *name; name++) {
+			if (*name < '0' || *name > '9')
+				return false;
+			v = v * 10 + (*name - '0');
+		}
+		pid = static_cast<pid_t>(v);
+		return true;
+	}
+
+	double clock_seconds(clockid_t clock) {
+		struct timespec ts;
+		if (clock_gettime(clock, &ts) != 0)
+			return 0.0;
+		return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1000000000.0;
+	}
+#ifdef CLOCK_BOOTTIME
+	const clockid_t boot_clock = CLOCK_BOOTTIME;
+#else
+	const clockid_t boot_clock = CLOCK_MONOTONIC;
+#endif
+}
+
+namespace process_helper {
+
+	process_info::process_info()
+		: pid(0), ppid(0), state('-'), threads(0), virtual_size(0), working_set(0), peak_virtual_size(0), peak_working_set(0)
+		, page_faults(0), user_time(0), kernel_time(0), creation(0), cpu(0.0) {}
+
+	process_info process_info::missing(const std::string &exe) {
+		boost::shared_ptr<static_info> info = boost::make_shared<static_info>();
+		info->exe = exe;
+		process_info ret;
+		ret.info = info;
+		return ret;
+	}
+
+	std::string process_info::get_state_s() const {
+		if (get_started())
+			return "started";
+		if (get_zombie())
+			return "zombie";
+		if (state == 'T' || state == 't')
+			return "suspended";
+		return "stopped";
+	}
+	bool process_info::get_started() const {
+		return state != '-' && state != 'T' && state != 't' && !get_zombie();
+	}
+	bool process_info::get_stopped() const {
+		return !get_started();
+	}
+	bool process_info::get_zombie() const {
+		return state == 'Z' || state == 'X' || state == 'x';
+	}
+
+	process_scanner::process_scanner(std::size_t max_open_fds)
+		: proc_fd_(-1)
+		, proc_dir_(NULL)
+		, buffer_(buffer_size + 1)
+		, generation_(0)
+		, open_fds_(0)
+		, max_open_fds_(max_open_fds)
+		, ticks_per_second_(sysconf(_SC_CLK_TCK))
+		, page_size_(sysconf(_SC_PAGESIZE))
+		, boot_time_(0)
+		, last_scan_(0.0)
+		, elapsed_(0.0) {
+		if (ticks_per_second_ <= 0)
+			ticks_per_second_ = 100;
+		if (page_size_ <= 0)
+			page_size_ = 4096;
+		// Leave most descriptors for the rest of the process
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+			max_open_fds_ = std::min<std::size_t>(max_open_fds_, limit.rlim_cur / 4);
+		boot_time_ = static_cast<long long>(clock_seconds(CLOCK_REALTIME) - clock_seconds(boot_clock) + 0.5);
+	}
+
+	process_scanner::~process_scanner() {
+		for (entry_map::iterator it = entries_.begin(); it != entries_.end(); ++it)
+			close_entry(it->second);
+		if (proc_dir_)
+			closedir(proc_dir_);
+		if (proc_fd_ >= 0)
+			close(proc_fd_);
+	}
+
+	bool process_scanner::open_proc() {
+		if (proc_dir_)
+			return true;
+		proc_fd_ = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (proc_fd_ < 0)
+			return false;
+		// fdopendir takes ownership so give it a descriptor of its own
+		int dir_fd = dup(proc_fd_);
+		if (dir_fd >= 0)
+			proc_dir_ = fdopendir(dir_fd);
+		if (!proc_dir_) {
+			if (dir_fd >= 0)
+				close(dir_fd);
+			close(proc_fd_);
+			proc_fd_ = -1;
+			return false;
+		}
+		return true;
+	}
+
+	void process_scanner::close_entry(entry &e) {
+		if (e.stat_fd >= 0) {
+			close(e.stat_fd);
+			e.stat_fd = -1;
+			open_fds_--;
+		}
+	}
+
+	ssize_t process_scanner::read_file(pid_t pid, const char *file, int *keep_fd) {
+		char *buf = &buffer_[0];
+		if (keep_fd && *keep_fd >= 0) {
+			ssize_t n = pread(*keep_fd, buf, buffer_size, 0);
+			if (n > 0) {
+				buf[n] = 0;
+				return n;
+			}
+			// The process has exited (the pid might have been reused so try again)
+			close(*keep_fd);
+			*keep_fd = -1;
+			open_fds_--;
+		}
+		char path[64];
+		make_path(path, sizeof(path), pid, file);
+		int fd = openat(proc_fd_, path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+		ssize_t n = pread(fd, buf, buffer_size, 0);
+		if (keep_fd && n > 0 && open_fds_ < max_open_fds_) {
+			*keep_fd = fd;
+			open_fds_++;
+		} else {
+			close(fd);
+		}
+		if (n < 0)
+			return -1;
+		buf[n] = 0;
+		return n;
+	}
+
+	bool process_scanner::read_stat(pid_t pid, entry &e, process_info &info) {
+		ssize_t n = read_file(pid, "stat", &e.stat_fd);
+		if (n <= 0)
+			return false;
+		const char *begin = &buffer_[0];
+		const char *end = begin + n;
+		// The name can contain anything (including spaces and parentheses)
+		const char *name = static_cast<const char*>(memchr(begin, '(', n));
+		const char *name_end = static_cast<const char*>(memrchr(begin, ')', n));
+		if (!name || !name_end || name_end < name || name_end + 2 >= end)
+			return false;
+		const char *p = name_end + 2;
+		info.pid = pid;
+		info.state = *p++;
+		info.ppid = parse_ll(p, end);
+		for (int i = 0; i < 5; i++)
+			skip_field(p, end);		// pgrp session tty_nr tpgid flags
+		unsigned long long minflt = parse_ull(p, end);
+		skip_field(p, end);			// cminflt
+		unsigned long long majflt = parse_ull(p, end);
+		skip_field(p, end);			// cmajflt
+		unsigned long long utime = parse_ull(p, end);
+		unsigned long long stime = parse_ull(p, end);
+		for (int i = 0; i < 4; i++)
+			skip_field(p, end);		// cutime cstime priority nice
+		info.threads = parse_ll(p, end);
+		skip_field(p, end);			// itrealvalue
+		unsigned long long start = parse_ull(p, end);
+		info.virtual_size = static_cast<long long>(parse_ull(p, end));
+		info.working_set = parse_ll(p, end) * page_size_;
+
+		info.page_faults = static_cast<long long>(minflt + majflt);
+		info.user_time = static_cast<long long>(utime) / ticks_per_second_;
+		info.kernel_time = static_cast<long long>(stime) / ticks_per_second_;
+		info.creation = boot_time_ + static_cast<long long>(start) / ticks_per_second_;
+
+		if (!e.info || e.start_ticks != start) {
+			// New process (or a new process with a reused pid)
+			boost::shared_ptr<static_info> sinfo = boost::make_shared<static_info>();
+			sinfo->exe.assign(name + 1, name_end);
+			e.info.reset();
+			e.start_ticks = start;
+			e.cpu_ticks = utime + stime;
+			read_status(pid, info, sinfo.get());
+			read_cmdline(pid, *sinfo);
+			e.info = sinfo;
+		} else {
+			if (elapsed_ > 0.0 && utime + stime >= e.cpu_ticks)
+				info.cpu = static_cast<double>(utime + stime - e.cpu_ticks) * 100.0 / static_cast<double>(ticks_per_second_) / elapsed_;
+			e.cpu_ticks = utime + stime;
+		}
+		info.info = e.info;
+		return true;
+	}
+
+	bool process_scanner::read_status(pid_t pid, process_info &info, static_info *sinfo) {
+		ssize_t n = read_file(pid, "status", NULL);
+		if (n <= 0)
+			return false;
+		const char *p = &buffer_[0];
+		const char *end = p + n;
+		while (p < end) {
+			const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!eol)
+				eol = end;
+			if (sinfo && starts_with(p, eol, "Uid:", 4)) {
+				p += 4;
+				sinfo->uid = parse_ll(p, eol);
+			} else if (starts_with(p, eol, "VmPeak:", 7)) {
+				p += 7;
+				info.peak_virtual_size = parse_ll(p, eol) * 1024;
+			} else if (starts_with(p, eol, "VmHWM:", 6)) {
+				p += 6;
+				info.peak_working_set = parse_ll(p, eol) * 1024;
+			}
+			p = eol + 1;
+		}
+		return true;
+	}
+
+	void process_scanner::read_cmdline(pid_t pid, static_info &sinfo) {
+		char path[64];
+		make_path(path, sizeof(path), pid, "exe");
+		char link[4096];
+		ssize_t len = readlinkat(proc_fd_, path, link, sizeof(link) - 1);
+		if (len > 0)
+			sinfo.filename.assign(link, len);
+
+		ssize_t n = read_file(pid, "cmdline", NULL);
+		if (n <= 0)
+			return;		// Kernel threads and zombies
+		const char *begin = &buffer_[0];
+		if (static_cast<std::size_t>(n) > max_cmdline)
+			n = max_cmdline;
+		while (n > 0 && begin[n - 1] == 0)
+			n--;
+		std::size_t argv0 = strnlen(begin, n);
+		if (sinfo.filename.empty())
+			sinfo.filename.assign(begin, argv0);
+		// The kernel truncates the name to 15 characters, try to get the full name from the command line
+		if (sinfo.exe.size() >= 15) {
+			const char *base = static_cast<const char*>(memrchr(begin, '/', argv0));
+			base = base ? base + 1 : begin;
+			std::string full(base, begin + argv0 - base);
+			if (full.compare(0, sinfo.exe.size(), sinfo.exe) == 0)
+				sinfo.exe = full;
+		}
+		sinfo.command_line.assign(begin, n);
+		std::replace(sinfo.command_line.begin(), sinfo.command_line.end(), '\0', ' ');
+	}
+
+	process_list process_scanner::scan(bool deep) {
+		process_list ret;
+		if (!open_proc())
+			return ret;
+		generation_++;
+		double now = clock_seconds(CLOCK_MONOTONIC);
+		elapsed_ = last_scan_ > 0.0 ? now - last_scan_ : 0.0;
+		ret.reserve(entries_.size() + 64);
+		rewinddir(proc_dir_);
+		struct dirent *de;
+		while ((de = readdir(proc_dir_)) != NULL) {
+			pid_t pid;
+			if (!parse_pid(de->d_name, pid))
+				continue;
+			entry &e = entries_[pid];
+			process_info info;
+			bool known = e.info.get() != NULL;
+			if (!read_stat(pid, e, info)) {
+				close_entry(e);
+				entries_.erase(pid);
+				continue;
+			}
+			if (deep && known)
+				read_status(pid, info, NULL);
+			e.generation = generation_;
+			ret.push_back(info);
+		}
+		for (entry_map::iterator it = entries_.begin(); it != entries_.end();) {
+			if (it->second.generation != generation_) {
+				close_entry(it->second);
+				it = entries_.erase(it);
+			} else {
+				++it;
+			}
+		}
+		last_scan_ = now;
+		return ret;
+	}
+}
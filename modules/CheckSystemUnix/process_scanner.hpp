@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <dirent.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace process_helper {
+
+	// Things which do not change during the lifetime of a process (read once per pid and start time)
+	struct static_info {
+		std::string exe;
+		std::string filename;
+		std::string command_line;
+		long long uid;
+		static_info() : uid(-1) {}
+	};
+
+	struct process_info {
+		boost::shared_ptr<const static_info> info;
+		long long pid;
+		long long ppid;
+		char state;
+		long long threads;
+		long long virtual_size;
+		long long working_set;
+		long long peak_virtual_size;
+		long long peak_working_set;
+		long long page_faults;
+		long long user_time;
+		long long kernel_time;
+		long long creation;
+		// CPU usage (percent of one core) since the previous scan
+		double cpu;
+
+		process_info();
+		// A process we were asked to check for but which is not running
+		static process_info missing(const std::string &exe);
+
+		std::string get_exe() const { return info->exe; }
+		std::string get_filename() const { return info->filename; }
+		std::string get_command_line() const { return info->command_line; }
+		long long get_uid() const { return info->uid; }
+		long long get_pid() const { return pid; }
+		long long get_ppid() const { return ppid; }
+		long long get_threads() const { return threads; }
+		long long get_virtual() const { return virtual_size; }
+		long long get_working_set() const { return working_set; }
+		long long get_peak_virtual() const { return peak_virtual_size; }
+		long long get_peak_working_set() const { return peak_working_set; }
+		long long get_page_faults() const { return page_faults; }
+		long long get_user_time() const { return user_time; }
+		long long get_kernel_time() const { return kernel_time; }
+		long long get_total_time() const { return user_time + kernel_time; }
+		long long get_creation() const { return creation; }
+		long long get_cpu() const { return static_cast<long long>(cpu + 0.5); }
+		std::string get_raw_state() const { return std::string(1, state); }
+		std::string get_state_s() const;
+		bool get_started() const;
+		bool get_stopped() const;
+		bool get_zombie() const;
+	};
+	typedef std::vector<process_info> process_list;
+
+	/**
+	 * Incremental scanner for /proc.
+	 *
+	 * Only stat is read for processes seen in an earlier scan (same pid and start time), cmdline and the
+	 * static parts of status are read the first time a process is seen. Files are read with openat/pread
+	 * relative to the /proc descriptor into a reused buffer and the stat descriptors of known processes
+	 * are kept open (up to a limit) so a rescan is a single pread per process.
+	 * Not thread safe: callers have to serialize scans.
+	 */
+	class process_scanner : boost::noncopyable {
+		struct entry {
+			boost::shared_ptr<const static_info> info;
+			unsigned long long start_ticks;
+			unsigned long long cpu_ticks;
+			int stat_fd;
+			unsigned int generation;
+			entry() : start_ticks(0), cpu_ticks(0), stat_fd(-1), generation(0) {}
+		};
+		typedef boost::unordered_map<pid_t, entry> entry_map;
+
+		int proc_fd_;
+		DIR *proc_dir_;
+		entry_map entries_;
+		std::vector<char> buffer_;
+		unsigned int generation_;
+		std::size_t open_fds_;
+		std::size_t max_open_fds_;
+		long long ticks_per_second_;
+		long long page_size_;
+		long long boot_time_;
+		double last_scan_;
+		double elapsed_;
+
+	public:
+		process_scanner(std::size_t max_open_fds = 1024);
+		~process_scanner();
+
+		// Scan all processes, deep also reads the peak memory usage (from status) which is slower
+		process_list scan(bool deep);
+		std::size_t get_cached_count() const { return entries_.size(); }
+
+	private:
+		bool open_proc();
+		bool read_stat(pid_t pid, entry &e, process_info &info);
+		bool read_status(pid_t pid, process_info &info, static_info *sinfo);
+		void read_cmdline(pid_t pid, static_info &sinfo);
+		ssize_t read_file(pid_t pid, const char *file, int *keep_fd);
+		void close_entry(entry &e);
+	};
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "procfs.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\t';
+	}
+	inline void skip_space(const char *&p, const char *end) {
+		while (p < end && is_space(*p))
+			p++;
+	}
+	inline unsigned long long parse_ull(const char *&p, const char *end) {
+		skip_space(p, end);
+		unsigned long long ret = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			ret = ret * 10 + (*p++ - '0');
+		return ret;
+	}
+	inline double parse_double(const char *&p, const char *end) {
+		double ret = static_cast<double>(parse_ull(p, end));
+		if (p < end && *p == '.') {
+			p++;
+			double scale = 0.1;
+			while (p < end && *p >= '0' && *p <= '9') {
+				ret += (*p++ - '0') * scale;
+				scale /= 10.0;
+			}
+		}
+		return ret;
+	}
+	inline void skip_field(const char *&p, const char *end) {
+		skip_space(p, end);
+		while (p < end && !is_space(*p))
+			p++;
+	}
+	inline const char* line_end(const char *p, const char *end) {
+		const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		return eol ? eol : end;
+	}
+	inline unsigned long long diff(unsigned long long previous, unsigned long long current) {
+		return current > previous ? current - previous : 0;
+	}
+
+	// Perfect hash over the /proc/meminfo keys we care about (other keys may land in a used slot so the key is always compared)
+	const std::size_t meminfo_slots = 16;
+	inline std::size_t meminfo_hash(const char *key, std::size_t len) {
+		const unsigned char *k = reinterpret_cast<const unsigned char*>(key);
+		return (len * 14 + k[0] + k[len - 1] * 4 + k[len / 2]) & (meminfo_slots - 1);
+	}
+
+	struct meminfo_key {
+		const char *key;
+		std::size_t len;
+		unsigned long long procfs::meminfo::*field;
+	};
+	const meminfo_key meminfo_keys[] = {
+		{ "MemTotal", 8, &procfs::meminfo::total },
+		{ "MemFree", 7, &procfs::meminfo::free },
+		{ "MemAvailable", 12, &procfs::meminfo::available },
+		{ "Buffers", 7, &procfs::meminfo::buffers },
+		{ "Cached", 6, &procfs::meminfo::cached },
+		{ "SwapCached", 10, &procfs::meminfo::swap_cached },
+		{ "SwapTotal", 9, &procfs::meminfo::swap_total },
+		{ "SwapFree", 8, &procfs::meminfo::swap_free },
+		{ "CommitLimit", 11, &procfs::meminfo::commit_limit },
+		{ "Committed_AS", 12, &procfs::meminfo::committed },
+		{ "SReclaimable", 12, &procfs::meminfo::reclaimable },
+		{ "Shmem", 5, &procfs::meminfo::shmem }
+	};
+
+	struct meminfo_table {
+		const meminfo_key *slots[meminfo_slots];
+		meminfo_table() {
+			for (std::size_t i = 0; i < meminfo_slots; i++)
+				slots[i] = NULL;
+			for (std::size_t i = 0; i < sizeof(meminfo_keys) / sizeof(meminfo_keys[0]); i++)
+				slots[meminfo_hash(meminfo_keys[i].key, meminfo_keys[i].len)] = &meminfo_keys[i];
+		}
+		const meminfo_key* find(const char *key, std::size_t len) const {
+			if (len == 0)
+				return NULL;
+			const meminfo_key *k = slots[meminfo_hash(key, len)];
+			if (k && k->len == len && memcmp(k->key, key, len) == 0)
+				return k;
+			return NULL;
+		}
+	};
+	const meminfo_table meminfo_lookup;
+}
+
+namespace procfs {
+
+	proc_file::proc_file(const std::string &path, std::size_t size) : path_(path), fd_(-1), buffer_(size + 1) {}
+
+	proc_file::~proc_file() {
+		close();
+	}
+
+	bool proc_file::open() {
+		if (fd_ < 0)
+			fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+		return fd_ >= 0;
+	}
+
+	void proc_file::close() {
+		if (fd_ >= 0)
+			::close(fd_);
+		fd_ = -1;
+	}
+
+	ssize_t proc_file::read() {
+		for (int attempt = 0; attempt < 2; attempt++) {
+			if (!open())
+				return -1;
+			ssize_t n = pread(fd_, &buffer_[0], buffer_.size() - 1, 0);
+			if (n >= 0) {
+				buffer_[n] = 0;
+				return n;
+			}
+			if (errno == EINTR)
+				continue;
+			close();
+		}
+		return -1;
+	}
+
+	bool meminfo_reader::read(meminfo &info) {
+		ssize_t n = file_.read();
+		if (n <= 0)
+			return false;
+		const char *p = file_.data();
+		const char *end = p + n;
+		while (p < end) {
+			const char *eol = line_end(p, end);
+			const char *colon = static_cast<const char*>(memchr(p, ':', eol - p));
+			if (colon) {
+				const meminfo_key *k = meminfo_lookup.find(p, colon - p);
+				if (k) {
+					const char *v = colon + 1;
+					unsigned long long value = parse_ull(v, eol);
+					skip_space(v, eol);
+					if (eol - v >= 2 && v[0] == 'k' && v[1] == 'B')
+						value *= 1024;
+					info.*(k->field) = value;
+				}
+			}
+			p = eol + 1;
+		}
+		return true;
+	}
+
+	stat_reader::stat_reader() : file_("/proc/stat", 4096 + 160 * static_cast<std::size_t>(sysconf(_SC_NPROCESSORS_CONF) > 0 ? sysconf(_SC_NPROCESSORS_CONF) : 64)) {}
+
+	bool stat_reader::read(cpu_stat &stat) {
+		ssize_t n = file_.read();
+		if (n <= 0)
+			return false;
+		const char *p = file_.data();
+		const char *end = p + n;
+		std::size_t count = 0;
+		while (p + 3 < end && p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+			const char *eol = line_end(p, end);
+			if (eol == end)
+				break;		// Truncated line
+			p += 3;
+			cpu_times *t = &stat.total;
+			if (*p >= '0' && *p <= '9') {
+				std::size_t core = static_cast<std::size_t>(parse_ull(p, eol));
+				if (core >= stat.cores.size())
+					stat.cores.resize(core + 1);
+				t = &stat.cores[core];
+				if (core + 1 > count)
+					count = core + 1;
+			}
+			t->user = parse_ull(p, eol);
+			t->nice = parse_ull(p, eol);
+			t->system = parse_ull(p, eol);
+			t->idle = parse_ull(p, eol);
+			t->iowait = parse_ull(p, eol);
+			t->irq = parse_ull(p, eol);
+			t->softirq = parse_ull(p, eol);
+			t->steal = parse_ull(p, eol);
+			p = eol + 1;
+		}
+		if (count < stat.cores.size())
+			stat.cores.resize(count);
+		return true;
+	}
+
+	bool uptime_reader::read(uptime_info &info) {
+		ssize_t n = file_.read();
+		if (n <= 0)
+			return false;
+		const char *p = file_.data();
+		const char *end = p + n;
+		info.uptime = parse_double(p, end);
+		info.idle = parse_double(p, end);
+		return true;
+	}
+
+	bool swaps_reader::read(std::vector<swap_entry> &entries) {
+		ssize_t n = file_.read();
+		if (n < 0)
+			return false;
+		const char *p = file_.data();
+		const char *end = p + n;
+		// Skip the header
+		p = line_end(p, end) + 1;
+		std::size_t count = 0;
+		while (p < end) {
+			const char *eol = line_end(p, end);
+			const char *name = p;
+			skip_field(p, eol);
+			if (p > name) {
+				if (count >= entries.size())
+					entries.resize(count + 1);
+				swap_entry &e = entries[count++];
+				e.name.assign(name, p);
+				skip_field(p, eol);		// type
+				e.size = parse_ull(p, eol) * 1024;
+				e.used = parse_ull(p, eol) * 1024;
+			}
+			p = eol + 1;
+		}
+		entries.resize(count);
+		return true;
+	}
+
+	load_entry load_entry::calculate(const cpu_times &previous, const cpu_times &current) {
+		load_entry ret;
+		unsigned long long total = diff(previous.get_total(), current.get_total());
+		if (total == 0)
+			return ret;
+		unsigned long long idle = diff(previous.get_idle(), current.get_idle());
+		unsigned long long kernel = diff(previous.get_kernel(), current.get_kernel());
+		if (idle > total)
+			idle = total;
+		ret.idle = static_cast<double>(idle) * 100.0 / static_cast<double>(total);
+		ret.total = 100.0 - ret.idle;
+		ret.kernel = static_cast<double>(kernel) * 100.0 / static_cast<double>(total);
+		return ret;
+	}
+
+	cpu_load cpu_load::calculate(const cpu_stat &previous, const cpu_stat &current) {
+		cpu_load ret;
+		ret.total = load_entry::calculate(previous.total, current.total);
+		std::size_t count = std::min(previous.cores.size(), current.cores.size());
+		ret.core.resize(count);
+		for (std::size_t i = 0; i < count; i++)
+			ret.core[i] = load_entry::calculate(previous.cores[i], current.cores[i]);
+		return ret;
+	}
+}
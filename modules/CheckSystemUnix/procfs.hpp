@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * Readers for the /proc files polled by the checks and the collector.
+ *
+ * Each reader keeps its file open and re-reads it with pread into a buffer allocated up front, the
+ * content is parsed in place into plain structs so steady state reads do not allocate.
+ * Readers are not thread safe.
+ */
+namespace procfs {
+
+	class proc_file : boost::noncopyable {
+		std::string path_;
+		int fd_;
+		std::vector<char> buffer_;
+	public:
+		proc_file(const std::string &path, std::size_t size);
+		~proc_file();
+		// Re-reads the file, returns the number of bytes (the data is NUL terminated) or -1
+		ssize_t read();
+		const char* data() const { return &buffer_[0]; }
+	private:
+		bool open();
+		void close();
+	};
+
+	// All values are in bytes
+	struct meminfo {
+		unsigned long long total;
+		unsigned long long free;
+		unsigned long long available;
+		unsigned long long buffers;
+		unsigned long long cached;
+		unsigned long long swap_cached;
+		unsigned long long swap_total;
+		unsigned long long swap_free;
+		unsigned long long commit_limit;
+		unsigned long long committed;
+		unsigned long long reclaimable;
+		unsigned long long shmem;
+		meminfo() : total(0), free(0), available(0), buffers(0), cached(0), swap_cached(0), swap_total(0), swap_free(0)
+			, commit_limit(0), committed(0), reclaimable(0), shmem(0) {}
+	};
+
+	class meminfo_reader : boost::noncopyable {
+		proc_file file_;
+	public:
+		meminfo_reader() : file_("/proc/meminfo", 8192) {}
+		bool read(meminfo &info);
+	};
+
+	// Ticks spent in each mode
+	struct cpu_times {
+		unsigned long long user;
+		unsigned long long nice;
+		unsigned long long system;
+		unsigned long long idle;
+		unsigned long long iowait;
+		unsigned long long irq;
+		unsigned long long softirq;
+		unsigned long long steal;
+		cpu_times() : user(0), nice(0), system(0), idle(0), iowait(0), irq(0), softirq(0), steal(0) {}
+
+		unsigned long long get_total() const {
+			return user + nice + system + idle + iowait + irq + softirq + steal;
+		}
+		unsigned long long get_idle() const {
+			return idle + iowait;
+		}
+		unsigned long long get_kernel() const {
+			return system + irq + softirq;
+		}
+	};
+
+	struct cpu_stat {
+		cpu_times total;
+		std::vector<cpu_times> cores;
+	};
+
+	// Only the cpu lines of /proc/stat are parsed
+	class stat_reader : boost::noncopyable {
+		proc_file file_;
+	public:
+		stat_reader();
+		bool read(cpu_stat &stat);
+	};
+
+	struct uptime_info {
+		double uptime;
+		double idle;
+		uptime_info() : uptime(0.0), idle(0.0) {}
+	};
+
+	class uptime_reader : boost::noncopyable {
+		proc_file file_;
+	public:
+		uptime_reader() : file_("/proc/uptime", 128) {}
+		bool read(uptime_info &info);
+	};
+
+	struct swap_entry {
+		std::string name;
+		unsigned long long size;
+		unsigned long long used;
+		swap_entry() : size(0), used(0) {}
+	};
+
+	class swaps_reader : boost::noncopyable {
+		proc_file file_;
+	public:
+		swaps_reader() : file_("/proc/swaps", 8192) {}
+		// entries is resized to the number of swap areas (the strings are reused)
+		bool read(std::vector<swap_entry> &entries);
+	};
+
+	// The load (in percent) over an interval
+	struct load_entry {
+		double idle;
+		double total;
+		double kernel;
+		load_entry() : idle(0.0), total(0.0), kernel(0.0) {}
+		void add(const load_entry &other) {
+			idle += other.idle;
+			total += other.total;
+			kernel += other.kernel;
+		}
+		void normalize(double value) {
+			idle /= value;
+			total /= value;
+			kernel /= value;
+		}
+		static load_entry calculate(const cpu_times &previous, const cpu_times &current);
+	};
+
+	struct cpu_load {
+		std::vector<load_entry> core;
+		load_entry total;
+		void add(const cpu_load &other) {
+			total.add(other.total);
+			if (core.size() < other.core.size())
+				core.resize(other.core.size());
+			for (std::size_t i = 0; i < other.core.size(); ++i)
+				core[i].add(other.core[i]);
+		}
+		void normalize(double value) {
+			total.normalize(value);
+			BOOST_FOREACH(load_entry &c, core) {
+				c.normalize(value);
+			}
+		}
+		static cpu_load calculate(const cpu_stat &previous, const cpu_stat &current);
+	};
+}
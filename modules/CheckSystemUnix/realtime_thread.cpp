@@ -22,6 +22,7 @@
 #include <nscapi/nscapi_helper_singleton.hpp>
 #include <nscapi/macros.hpp>
 #include <parsers/filter/realtime_helper.hpp>
+#include <str/xtos.hpp>
 #include "realtime_data.hpp"
 
 
@@ -40,20 +41,59 @@
 *
 */
 void pdh_thread::thread_proc() {
-
+	procfs::cpu_stat samples[2];
+	int current = 0;
+	bool has_previous = false;
+	try {
+		while (true) {
+			if (stat_reader_.read(samples[current])) {
+				if (has_previous) {
+					procfs::cpu_load load = procfs::cpu_load::calculate(samples[1 - current], samples[current]);
+					boost::unique_lock<boost::shared_mutex> writeLock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+					if (writeLock.owns_lock())
+						cpu.push(load);
+					else
+						NSC_LOG_ERROR("Failed to get Mutex for: cpu");
+				}
+				has_previous = true;
+				current = 1 - current;
+			} else {
+				NSC_LOG_ERROR("Failed to read /proc/stat");
+			}
+			boost::this_thread::sleep(boost::posix_time::seconds(1));
+		}
+	} catch (const boost::thread_interrupted &) {
+	}
 }
 
-
+std::map<std::string, procfs::load_entry> pdh_thread::get_cpu_load(long seconds) {
+	std::map<std::string, procfs::load_entry> ret;
+	procfs::cpu_load load;
+	{
+		boost::shared_lock<boost::shared_mutex> readLock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+		if (!readLock.owns_lock()) {
+			NSC_LOG_ERROR("Failed to get Mutex for: cpu");
+			return ret;
+		}
+		load = cpu.get_average(seconds);
+	}
+	ret["total"] = load.total;
+	int i = 0;
+	BOOST_FOREACH(const procfs::load_entry &l, load.core)
+		ret["core " + str::xtos(i++)] = l;
+	return ret;
+}
 
 bool pdh_thread::start() {
-//	stop_event_ = CreateEvent(NULL, TRUE, FALSE, _T("EventLogShutdown"));
 	thread_ = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&pdh_thread::thread_proc, this)));
 	return true;
 }
 bool pdh_thread::stop() {
-//	SetEvent(stop_event_);
-	if (thread_)
+	if (thread_) {
+		thread_->interrupt();
 		thread_->join();
+		thread_.reset();
+	}
 	return true;
 }
 void pdh_thread::add_realtime_filter(boost::shared_ptr<nscapi::settings_proxy> proxy, std::string key, std::string query) {
@@ -23,8 +23,13 @@
 #include <boost/unordered_map.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/foreach.hpp>
+
+#include <map>
+#include <string>
 
 #include "filter_config_object.hpp"
+#include "procfs.hpp"
 
 #include <nscapi/nscapi_settings_proxy.hpp>
 
@@ -119,16 +124,11 @@ public:
 
 class pdh_thread {
 private:
-//	typedef boost::unordered_map<std::string,PDH::pdh_instance> lookup_type;
-
 	boost::shared_ptr<boost::thread> thread_;
 	boost::shared_mutex mutex_;
-//	HANDLE stop_event_;
 
-//	std::list<PDH::pdh_object> configs_;
-//	std::list<PDH::pdh_instance> counters_;
-//	rrd_buffer<windows::system_info::cpu_load> cpu;
-//	lookup_type lookups_;
+	procfs::stat_reader stat_reader_;
+	rrd_buffer<procfs::cpu_load> cpu;
 public:
 
 	std::string subsystem;
@@ -137,13 +137,9 @@ public:
 
 public:
 
-//	void add_counter(const PDH::pdh_object &counter);
-/*
-	std::map<std::string,double> get_value(std::string counter);
-	std::map<std::string,double> get_average(std::string counter, long seconds);
-	std::map<std::string,long long> get_int_value(std::string counter);
-	std::map<std::string,windows::system_info::load_entry> get_cpu_load(long seconds);
-*/
+	// Average load for the last seconds (total and per core)
+	std::map<std::string, procfs::load_entry> get_cpu_load(long seconds);
+
 	bool start();
 	bool stop();
 
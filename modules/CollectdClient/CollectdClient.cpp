@@ -153,6 +153,7 @@ void CollectdClient::add_target(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool CollectdClient::unloadModule() {
+	client_.stop();
 	client_.clear();
 	return true;
 }
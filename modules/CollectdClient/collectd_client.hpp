@@ -29,51 +29,64 @@
 
 namespace collectd_client {
 
-	class udp_sender {
+	// Sends datagrams to a collectd server (or multicast group), the sockets are opened once and reused for all datagrams
+	class udp_sender : public boost::noncopyable {
 	public:
-		udp_sender(boost::asio::io_service& io_service, boost::asio::ip::udp::endpoint source_endpoint,
-			const boost::asio::ip::address& multicast_address, unsigned short multicast_port)
-			: endpoint_(multicast_address, multicast_port)
-			, socket_(io_service, source_endpoint)
-			//, timer_(io_service)
-		{}
-
-		udp_sender(boost::asio::io_service& io_service,
-			const boost::asio::ip::address& multicast_address, unsigned short multicast_port)
-			: endpoint_(multicast_address, multicast_port)
-			, socket_(io_service, endpoint_.protocol())
-			//, timer_(io_service)
-		{}
-
-		void send_data(const std::string &data) {
-			payload = data;
-			socket_.async_send_to(
-				boost::asio::buffer(payload), endpoint_,
-				boost::bind(&udp_sender::handle_send_to, this,
-					boost::asio::placeholders::error));
+		typedef boost::shared_ptr<boost::asio::ip::udp::socket> socket_type;
+
+		udp_sender(boost::asio::io_service& io_service, const boost::asio::ip::address& target_address, unsigned short port)
+			: endpoint_(target_address, port)
+			, errors_(0) {
+			bool is_multicast = false;
+			if (target_address.is_v4()) {
+				is_multicast = target_address.to_v4().is_multicast();
+			}
+#if BOOST_VERSION >= 105300
+			else if (target_address.is_v6()) {
+				is_multicast = target_address.to_v6().is_multicast();
+			}
+#endif
+			if (is_multicast) {
+				// Send the datagrams out on all local interfaces
+				boost::asio::ip::udp::resolver resolver(io_service);
+				boost::asio::ip::udp::resolver::query query(boost::asio::ip::host_name(), "");
+				boost::asio::ip::udp::resolver::iterator endpoint_iterator = resolver.resolve(query);
+				boost::asio::ip::udp::resolver::iterator end;
+				while (endpoint_iterator != end) {
+					if (target_address.is_v4() && endpoint_iterator->endpoint().address().is_v4())
+						sockets_.push_back(socket_type(new boost::asio::ip::udp::socket(io_service, endpoint_iterator->endpoint())));
+					endpoint_iterator++;
+				}
+			} else {
+				sockets_.push_back(socket_type(new boost::asio::ip::udp::socket(io_service, endpoint_.protocol())));
+			}
 		}
 
-		void handle_send_to(const boost::system::error_code& error) {}
-
-		// 	void handle_timeout(const boost::system::error_code& error) {
-		// 		if (!error) {
-		// 			socket_.async_send_to(
-		// 				boost::asio::buffer(message_), endpoint_,
-		// 				boost::bind(&udp_sender::handle_send_to, this,
-		// 					boost::asio::placeholders::error));
-		// 		}
-		// 	}
+		void send(const char *data, std::size_t length) {
+			BOOST_FOREACH(const socket_type &s, sockets_) {
+				boost::system::error_code error;
+				s->send_to(boost::asio::buffer(data, length), endpoint_, 0, error);
+				if (error && errors_++ == 0)
+					NSC_LOG_ERROR("Failed to send packet to " + endpoint_.address().to_string() + ": " + error.message());
+			}
+		}
+		std::size_t get_errors() const {
+			return errors_;
+		}
 
 	private:
 		boost::asio::ip::udp::endpoint endpoint_;
-		boost::asio::ip::udp::socket socket_;
-		//boost::asio::deadline_timer timer_;
-		std::string payload;
+		std::list<socket_type> sockets_;
+		std::size_t errors_;
 	};
 
 
 	struct connection_data : public socket_helpers::connection_info {
 		std::string sender_hostname;
+		std::size_t packet_size;
+		std::string security_level;
+		std::string username;
+		std::string password;
 
 		connection_data() {}
 
@@ -85,6 +98,10 @@ namespace collectd_client {
 			ssl.enabled = false;
 			timeout = arguments.get_int_data("timeout", 30);
 			retry = arguments.get_int_data("retries", 3);
+			packet_size = arguments.get_int_data("packet size", collectd::encoder::max_packet_size);
+			security_level = arguments.get_string_data("security level");
+			username = arguments.get_string_data("username");
+			password = arguments.get_string_data("password");
 			sender_hostname = sender.address.host;
 			if (sender.has_data("host"))
 				sender_hostname = sender.get_string_data("host");
@@ -94,6 +111,9 @@ namespace collectd_client {
 			std::stringstream ss;
 			ss << "host: " << get_endpoint_string();
 			ss << ", sender_hostname: " << sender_hostname;
+			ss << ", packet size: " << packet_size;
+			if (!security_level.empty())
+				ss << ", security level: " << security_level;
 			return ss.str();
 		}
 	};
@@ -127,16 +147,7 @@ namespace collectd_client {
 		bool submit(client::destination_container sender, client::destination_container target, const PB::Commands::SubmitRequestMessage &request_message, PB::Commands::SubmitResponseMessage &response_message) {
 			const PB::Common::Header& request_header = request_message.header();
 			nscapi::protobuf::functions::make_return_header(response_message.mutable_header(), request_header);
-			connection_data con(target, sender);
-
-			std::list<collectd::packet> list;
-			for (int i = 0; i < request_message.payload_size(); ++i) {
-				collectd::packet packet;
-				//packet.add_string(0, "Hello WOrld");
-				list.push_back(packet);
-			}
-
-			send(con, list);
+			// Check results have no collectd representation: only metrics are sent
 			return true;
 		}
 
@@ -156,6 +167,8 @@ namespace collectd_client {
 			BOOST_FOREACH(const PB::Metrics::Metric &v, b.value()) {
 				if (v.has_gauge_value()) {
 					builder.set_metric(mypath + "." + v.key(), str::xtos(v.gauge_value().value()));
+				} else if (v.has_counter_value()) {
+					builder.set_metric(mypath + "." + v.key(), str::xtos(v.counter_value().value()));
 				} else if (v.has_string_value()) {
 					builder.set_metric(mypath + "." + v.key(), v.string_value().value());
 				} else {
@@ -227,64 +240,24 @@ namespace collectd_client {
 			builder.add_metric("cpu-total/cpu-idle", "derive:system.cpu.total.idle");
 
 			//NSC_DEBUG_MSG("--->" + builder.to_string());
-			collectd::collectd_builder::packet_list packets;
-
-			builder.render(packets);
 			connection_data con(target, sender);
-			send(con, packets);
+			send(con, builder);
 			return true;
 		}
 
 
-		void send(const connection_data target, const collectd::collectd_builder::packet_list &packets) {
-			NSC_TRACE_ENABLED() {
-				NSC_TRACE_MSG("Sending " + str::xtos(packets.size()) + " packets to: " + target.to_string());
-			}
-			BOOST_FOREACH(const collectd::packet &p, packets) {
-				try {
-					boost::asio::io_service io_service;
-					std::list<boost::shared_ptr<udp_sender>> senders;
-
-					boost::asio::ip::address target_address = boost::asio::ip::address::from_string(target.get_address());
-
-					boost::asio::ip::udp::resolver resolver(io_service);
-					boost::asio::ip::udp::resolver::query query(boost::asio::ip::host_name(), "");
-					boost::asio::ip::udp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-					boost::asio::ip::udp::resolver::iterator end;
-					bool is_multicast = false;
-					if (target_address.is_v4()) {
-						is_multicast = target_address.to_v4().is_multicast();
-					}
-#if BOOST_VERSION >= 105300
-					else if (target_address.is_v6()) {
-						is_multicast = target_address.to_v6().is_multicast();
-					}
-#endif
-
-					if (is_multicast) {
-						while (endpoint_iterator != end) {
-							std::string ss = endpoint_iterator->endpoint().address().to_string();
-							if (target_address.is_v4() && endpoint_iterator->endpoint().address().is_v4()) {
-								boost::shared_ptr<udp_sender> s = boost::make_shared<udp_sender>(io_service, endpoint_iterator->endpoint(), target_address, target.get_int_port());
-								senders.push_back(s);
-								s->send_data(p.get_buffer());
-								io_service.run();
-							}
-							endpoint_iterator++;
-						}
-					} else {
-						boost::shared_ptr<udp_sender> s = boost::make_shared<udp_sender>(io_service, target_address, target.get_int_port());
-						senders.push_back(s);
-						s->send_data(p.get_buffer());
-						io_service.run();
-
-					}
-
-					senders.clear();
-
-				} catch (std::exception& e) {
-					NSC_LOG_ERROR_STD(utf8::utf8_from_native(e.what()));
+		void send(const connection_data &target, collectd::collectd_builder &builder) {
+			try {
+				boost::asio::io_service io_service;
+				boost::asio::ip::address target_address = boost::asio::ip::address::from_string(target.get_address());
+				udp_sender sender(io_service, target_address, target.get_int_port());
+				collectd::encoder encoder(target.packet_size, collectd::encoder::parse_security_level(target.security_level), target.username, target.password);
+				std::size_t packets = builder.render(encoder, boost::bind(&udp_sender::send, &sender, _1, _2));
+				NSC_TRACE_ENABLED() {
+					NSC_TRACE_MSG("Sent " + str::xtos(builder.rendererd_metrics.size()) + " metrics in " + str::xtos(packets) + " packets to: " + target.to_string());
 				}
+			} catch (std::exception& e) {
+				NSC_LOG_ERROR_STD(utf8::utf8_from_native(e.what()));
 			}
 		}
 	};
@@ -57,6 +57,24 @@ namespace collectd_handler {
 
 			//add_ssl_keys(root_path);
 
+			if (oneliner)
+				return;
+
+			root_path.add_key()
+
+				("packet size", sh::int_fun_key(boost::bind(&parent::set_property_int, this, "packet size", _1), collectd::encoder::max_packet_size),
+					"PACKET SIZE", "Maximum size of a datagram, as many metrics as fit are packed into each datagram (the default fits an ethernet MTU).", true)
+
+				("security level", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "security level", _1), "none"),
+					"SECURITY LEVEL", "Sign or encrypt the packets (none, sign or encrypt), requires the username and password to be set and matching the collectd server.", true)
+
+				("username", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "username", _1)),
+					"USERNAME", "Username used to sign or encrypt packets.", true)
+
+				("password", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "password", _1)),
+					"PASSWORD", "Password used to sign or encrypt packets.", true)
+				;
+
 			settings.register_all();
 			settings.notify();
 		}
@@ -84,6 +102,15 @@ namespace collectd_handler {
 				("password", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, &data, "password", _1)),
 					"Password")
 
+				("username", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, &data, "username", _1)),
+					"Username used to sign or encrypt packets")
+
+				("security-level", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, &data, "security level", _1)),
+					"Sign or encrypt packets: none, sign or encrypt")
+
+				("packet-size", po::value<unsigned int>()->notifier(boost::bind(&client::destination_container::set_int_data, &data, "packet size", _1)),
+					"Maximum size of each datagram")
+
 				("time-offset", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, &data, "time offset", _1)),
 					"")
 				;
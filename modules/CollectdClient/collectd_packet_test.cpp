@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <collectd/collectd_packet.hpp>
+
+#include <boost/foreach.hpp>
+
+#include <string>
+#include <vector>
+
+#ifdef USE_SSL
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#endif
+
+#include <gtest/gtest.h>
+
+namespace {
+	struct part {
+		unsigned int type;
+		std::string data;
+	};
+	typedef std::vector<part> part_list;
+
+	unsigned long long get_be(const std::string &data, std::size_t pos, std::size_t size) {
+		unsigned long long ret = 0;
+		for (std::size_t i = 0; i < size; i++)
+			ret = (ret << 8) | static_cast<unsigned char>(data[pos + i]);
+		return ret;
+	}
+
+	part_list parse_parts(const std::string &packet) {
+		part_list ret;
+		std::size_t pos = 0;
+		while (pos + 4 <= packet.size()) {
+			part p;
+			p.type = static_cast<unsigned int>(get_be(packet, pos, 2));
+			std::size_t length = static_cast<std::size_t>(get_be(packet, pos + 2, 2));
+			if (length < 4 || pos + length > packet.size())
+				throw collectd::collectd_exception("Invalid part length");
+			p.data = packet.substr(pos + 4, length - 4);
+			ret.push_back(p);
+			pos += length;
+		}
+		if (pos != packet.size())
+			throw collectd::collectd_exception("Trailing data");
+		return ret;
+	}
+
+	std::vector<unsigned int> part_types(const part_list &parts) {
+		std::vector<unsigned int> ret;
+		BOOST_FOREACH(const part &p, parts) {
+			ret.push_back(p.type);
+		}
+		return ret;
+	}
+
+	struct decoded {
+		std::string host;
+		long long time_hr;
+		long long interval_hr;
+		std::string plugin;
+		std::string plugin_instance;
+		std::string type;
+		std::string type_instance;
+		std::vector<double> gauges;
+		std::vector<long long> derives;
+		decoded() : time_hr(0), interval_hr(0) {}
+	};
+
+	std::string get_string(const part &p) {
+		if (p.data.empty() || p.data[p.data.size() - 1] != '\0')
+			throw collectd::collectd_exception("String part is not null terminated");
+		return p.data.substr(0, p.data.size() - 1);
+	}
+
+	// Decodes a packet the way the collectd network plugin does: identifiers are kept as state between the value parts
+	std::vector<decoded> decode(const part_list &parts) {
+		std::vector<decoded> ret;
+		decoded state;
+		BOOST_FOREACH(const part &p, parts) {
+			switch (p.type) {
+			case collectd::encoder::part_host: state.host = get_string(p); break;
+			case collectd::encoder::part_time_hr: state.time_hr = static_cast<long long>(get_be(p.data, 0, 8)); break;
+			case collectd::encoder::part_interval_hr: state.interval_hr = static_cast<long long>(get_be(p.data, 0, 8)); break;
+			case collectd::encoder::part_plugin: state.plugin = get_string(p); break;
+			case collectd::encoder::part_plugin_instance: state.plugin_instance = get_string(p); break;
+			case collectd::encoder::part_type: state.type = get_string(p); break;
+			case collectd::encoder::part_type_instance: state.type_instance = get_string(p); break;
+			case collectd::encoder::part_values: {
+				decoded d = state;
+				std::size_t count = static_cast<std::size_t>(get_be(p.data, 0, 2));
+				EXPECT_EQ(2 + count * 9, p.data.size());
+				for (std::size_t i = 0; i < count; i++) {
+					std::size_t pos = 2 + count + i * 8;
+					if (p.data[2 + i] == collectd::encoder::value_gauge) {
+						double v;
+						memcpy(&v, &p.data[pos], sizeof(double));
+						d.gauges.push_back(swap_bytes::ltoh<double>(v));
+					} else {
+						d.derives.push_back(static_cast<long long>(get_be(p.data, pos, 8)));
+					}
+				}
+				ret.push_back(d);
+				break;
+			}
+			default:
+				throw collectd::collectd_exception("Unexpected part: " + str::xtos(p.type));
+			}
+		}
+		return ret;
+	}
+
+	std::string finish(collectd::encoder &enc) {
+		std::size_t length = 0;
+		const char *data = enc.finish(length);
+		return std::string(data, length);
+	}
+
+	struct collect {
+		std::vector<std::string> &packets;
+		collect(std::vector<std::string> &packets) : packets(packets) {}
+		void operator()(const char *data, std::size_t length) {
+			packets.push_back(std::string(data, length));
+		}
+	};
+
+	collectd::value_list make_value(const std::string &plugin, const std::string &type, double gauge) {
+		collectd::value_list vl(1000, 10);
+		vl.set_plugin(plugin);
+		vl.set_type(type);
+		vl.gauges.push_back(gauge);
+		return vl;
+	}
+}
+
+TEST(collectd_encoder, decode_multiple_metrics) {
+	collectd::encoder enc;
+	collectd::value_list cpu(1234567, 10 << 30);
+	cpu.set_plugin("cpu", std::string("0"));
+	cpu.set_type("percent", std::string("idle"));
+	cpu.gauges.push_back(12.5);
+	collectd::value_list load(1234567, 10 << 30);
+	load.set_plugin("load");
+	load.set_type("load");
+	load.gauges.push_back(0.5);
+	load.gauges.push_back(1.0);
+	load.gauges.push_back(-1.5);
+	collectd::value_list net(1234999, 10 << 30);
+	net.set_plugin("interface", std::string("eth0"));
+	net.set_type("if_octets");
+	net.derives.push_back(1);
+	net.derives.push_back(1LL << 40);
+	ASSERT_TRUE(enc.add("host1", cpu));
+	ASSERT_TRUE(enc.add("host1", load));
+	ASSERT_TRUE(enc.add("host1", net));
+	EXPECT_EQ(3u, enc.count());
+
+	std::string packet = finish(enc);
+	EXPECT_EQ(enc.size(), packet.size());
+	std::vector<decoded> d = decode(parse_parts(packet));
+	ASSERT_EQ(3u, d.size());
+
+	EXPECT_EQ("host1", d[0].host);
+	EXPECT_EQ(1234567, d[0].time_hr);
+	EXPECT_EQ(10 << 30, d[0].interval_hr);
+	EXPECT_EQ("cpu", d[0].plugin);
+	EXPECT_EQ("0", d[0].plugin_instance);
+	EXPECT_EQ("percent", d[0].type);
+	EXPECT_EQ("idle", d[0].type_instance);
+	ASSERT_EQ(1u, d[0].gauges.size());
+	EXPECT_DOUBLE_EQ(12.5, d[0].gauges[0]);
+
+	EXPECT_EQ("host1", d[1].host);
+	EXPECT_EQ("load", d[1].plugin);
+	EXPECT_EQ("", d[1].plugin_instance);
+	EXPECT_EQ("load", d[1].type);
+	EXPECT_EQ("", d[1].type_instance);
+	ASSERT_EQ(3u, d[1].gauges.size());
+	EXPECT_DOUBLE_EQ(0.5, d[1].gauges[0]);
+	EXPECT_DOUBLE_EQ(1.0, d[1].gauges[1]);
+	EXPECT_DOUBLE_EQ(-1.5, d[1].gauges[2]);
+	EXPECT_TRUE(d[1].derives.empty());
+
+	EXPECT_EQ(1234999, d[2].time_hr);
+	EXPECT_EQ("interface", d[2].plugin);
+	EXPECT_EQ("eth0", d[2].plugin_instance);
+	EXPECT_EQ("if_octets", d[2].type);
+	EXPECT_TRUE(d[2].gauges.empty());
+	ASSERT_EQ(2u, d[2].derives.size());
+	EXPECT_EQ(1, d[2].derives[0]);
+	EXPECT_EQ(1LL << 40, d[2].derives[1]);
+}
+
+TEST(collectd_encoder, elide_unchanged_parts) {
+	collectd::encoder enc;
+	collectd::value_list a = make_value("disk", "bytes", 1);
+	a.set_plugin("disk", std::string("sda"));
+	a.set_type("bytes", std::string("read"));
+	collectd::value_list b = a;
+	b.type_instance = std::string("write");
+	collectd::value_list c = b;
+	c.plugin_instance = boost::none;
+	c.type_instance = boost::none;
+	collectd::value_list d = c;
+	d.time_hr = 2000;
+	ASSERT_TRUE(enc.add("host", a));
+	ASSERT_TRUE(enc.add("host", b));
+	ASSERT_TRUE(enc.add("host", c));
+	ASSERT_TRUE(enc.add("host", d));
+	ASSERT_TRUE(enc.add("other", d));
+
+	std::vector<unsigned int> expected;
+	// a: everything
+	expected.push_back(collectd::encoder::part_host);
+	expected.push_back(collectd::encoder::part_time_hr);
+	expected.push_back(collectd::encoder::part_interval_hr);
+	expected.push_back(collectd::encoder::part_plugin);
+	expected.push_back(collectd::encoder::part_plugin_instance);
+	expected.push_back(collectd::encoder::part_type);
+	expected.push_back(collectd::encoder::part_type_instance);
+	expected.push_back(collectd::encoder::part_values);
+	// b: only the type instance changed
+	expected.push_back(collectd::encoder::part_type_instance);
+	expected.push_back(collectd::encoder::part_values);
+	// c: the instances are cleared (which has to be sent)
+	expected.push_back(collectd::encoder::part_plugin_instance);
+	expected.push_back(collectd::encoder::part_type_instance);
+	expected.push_back(collectd::encoder::part_values);
+	// d: only the time changed
+	expected.push_back(collectd::encoder::part_time_hr);
+	expected.push_back(collectd::encoder::part_values);
+	// d for another host
+	expected.push_back(collectd::encoder::part_host);
+	expected.push_back(collectd::encoder::part_values);
+
+	part_list parts = parse_parts(finish(enc));
+	EXPECT_EQ(expected, part_types(parts));
+	std::vector<decoded> values = decode(parts);
+	ASSERT_EQ(5u, values.size());
+	EXPECT_EQ("write", values[1].type_instance);
+	EXPECT_EQ("sda", values[1].plugin_instance);
+	EXPECT_EQ("", values[2].plugin_instance);
+	EXPECT_EQ("", values[2].type_instance);
+	EXPECT_EQ(2000, values[3].time_hr);
+	EXPECT_EQ("other", values[4].host);
+	EXPECT_EQ(2000, values[4].time_hr);
+}
+
+TEST(collectd_encoder, new_packet_at_size_limit) {
+	collectd::encoder enc(256);
+	std::size_t added = 0;
+	while (enc.add("host", make_value("plugin", "type_" + str::xtos(added), static_cast<double>(added))))
+		added++;
+	ASSERT_GT(added, 1u);
+	EXPECT_EQ(added, enc.count());
+	EXPECT_LE(enc.size(), 256u);
+	// The rejected value list did not change the packet
+	std::string packet = finish(enc);
+	EXPECT_EQ(added, decode(parse_parts(packet)).size());
+
+	// A new packet starts from scratch (all identifiers are sent again)
+	enc.reset();
+	EXPECT_TRUE(enc.empty());
+	ASSERT_TRUE(enc.add("host", make_value("plugin", "type_" + str::xtos(added), static_cast<double>(added))));
+	part_list parts = parse_parts(finish(enc));
+	ASSERT_EQ(6u, parts.size());
+	EXPECT_EQ(collectd::encoder::part_host, parts[0].type);
+	std::vector<decoded> d = decode(parts);
+	ASSERT_EQ(1u, d.size());
+	EXPECT_EQ("host", d[0].host);
+	EXPECT_EQ("type_" + str::xtos(added), d[0].type);
+}
+
+TEST(collectd_encoder, value_list_too_large) {
+	collectd::encoder enc(256);
+	collectd::value_list vl = make_value("plugin", "type", 1);
+	for (int i = 0; i < 30; i++)
+		vl.gauges.push_back(i);
+	EXPECT_THROW(enc.add("host", vl), collectd::collectd_exception);
+}
+
+TEST(collectd_encoder, builder_splits_packets) {
+	collectd::collectd_builder builder;
+	builder.set_host("host");
+	builder.set_time(1000, 10);
+	for (int i = 0; i < 100; i++) {
+		collectd::value_list vl = make_value("plugin", "type_" + str::xtos(i), i);
+		builder.rendererd_metrics.push_back(vl);
+	}
+	collectd::encoder enc(256);
+	std::vector<std::string> packets;
+	std::size_t count = builder.render(enc, collect(packets));
+	EXPECT_EQ(packets.size(), count);
+	ASSERT_GT(count, 1u);
+	std::size_t total = 0;
+	BOOST_FOREACH(const std::string &p, packets) {
+		EXPECT_LE(p.size(), 256u);
+		total += decode(parse_parts(p)).size();
+	}
+	EXPECT_EQ(100u, total);
+}
+
+#ifdef USE_SSL
+TEST(collectd_encoder, sign) {
+	const std::string username = "user";
+	const std::string password = "secret";
+	collectd::encoder enc(collectd::encoder::max_packet_size, collectd::encoder::security_sign, username, password);
+	ASSERT_TRUE(enc.add("host", make_value("cpu", "percent", 1.5)));
+	std::string packet = finish(enc);
+
+	ASSERT_GT(packet.size(), 4u + SHA256_DIGEST_LENGTH + username.size());
+	EXPECT_EQ(collectd::encoder::part_signature, get_be(packet, 0, 2));
+	std::size_t length = static_cast<std::size_t>(get_be(packet, 2, 2));
+	EXPECT_EQ(4u + SHA256_DIGEST_LENGTH + username.size(), length);
+	EXPECT_EQ(username, packet.substr(4 + SHA256_DIGEST_LENGTH, username.size()));
+
+	// The HMAC covers the username and the payload
+	std::string covered = packet.substr(4 + SHA256_DIGEST_LENGTH);
+	unsigned char hmac[SHA256_DIGEST_LENGTH];
+	unsigned int hmac_len = SHA256_DIGEST_LENGTH;
+	ASSERT_TRUE(HMAC(EVP_sha256(), password.c_str(), static_cast<int>(password.size()), reinterpret_cast<const unsigned char*>(covered.c_str()), covered.size(), hmac, &hmac_len) != NULL);
+	EXPECT_EQ(std::string(reinterpret_cast<const char*>(hmac), SHA256_DIGEST_LENGTH), packet.substr(4, SHA256_DIGEST_LENGTH));
+
+	std::vector<decoded> d = decode(parse_parts(packet.substr(length)));
+	ASSERT_EQ(1u, d.size());
+	EXPECT_EQ("cpu", d[0].plugin);
+}
+
+TEST(collectd_encoder, encrypt) {
+	const std::string username = "user";
+	const std::string password = "secret";
+	const std::string iv = "0123456789abcdef";
+	collectd::encoder enc(collectd::encoder::max_packet_size, collectd::encoder::security_encrypt, username, password);
+	enc.set_iv(iv);
+	ASSERT_TRUE(enc.add("host", make_value("cpu", "percent", 1.5)));
+	ASSERT_TRUE(enc.add("host", make_value("cpu", "user", 2.5)));
+	std::string packet = finish(enc);
+
+	EXPECT_EQ(collectd::encoder::part_encryption, get_be(packet, 0, 2));
+	// The encryption part is the entire packet
+	EXPECT_EQ(packet.size(), get_be(packet, 2, 2));
+	ASSERT_EQ(username.size(), get_be(packet, 4, 2));
+	EXPECT_EQ(username, packet.substr(6, username.size()));
+	std::size_t pos = 6 + username.size();
+	EXPECT_EQ(iv, packet.substr(pos, 16));
+	pos += 16;
+
+	// AES-256-OFB keyed with sha256(password)
+	unsigned char key[SHA256_DIGEST_LENGTH];
+	SHA256(reinterpret_cast<const unsigned char*>(password.c_str()), password.size(), key);
+	std::string encrypted = packet.substr(pos);
+	std::string plain(encrypted.size(), '\0');
+	int out_len = 0;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	ASSERT_TRUE(ctx != NULL);
+	EXPECT_EQ(1, EVP_DecryptInit_ex(ctx, EVP_aes_256_ofb(), NULL, key, reinterpret_cast<const unsigned char*>(iv.c_str())));
+	EXPECT_EQ(1, EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plain[0]), &out_len, reinterpret_cast<const unsigned char*>(encrypted.c_str()), static_cast<int>(encrypted.size())));
+	EVP_CIPHER_CTX_free(ctx);
+	ASSERT_EQ(encrypted.size(), static_cast<std::size_t>(out_len));
+
+	// sha1 of the payload followed by the payload
+	std::string payload = plain.substr(SHA_DIGEST_LENGTH);
+	unsigned char hash[SHA_DIGEST_LENGTH];
+	SHA1(reinterpret_cast<const unsigned char*>(payload.c_str()), payload.size(), hash);
+	EXPECT_EQ(std::string(reinterpret_cast<const char*>(hash), SHA_DIGEST_LENGTH), plain.substr(0, SHA_DIGEST_LENGTH));
+
+	std::vector<decoded> d = decode(parse_parts(payload));
+	ASSERT_EQ(2u, d.size());
+	EXPECT_EQ("percent", d[0].type);
+	EXPECT_EQ("user", d[1].type);
+	EXPECT_DOUBLE_EQ(2.5, d[1].gauges[0]);
+}
+#endif
@@ -296,6 +296,8 @@ void build_metrics(json_spirit::Object &metrics, const std::string trail, const
 			: trail + "_" + boost::replace_all_copy(v.key(), ".", "_");
 		if (v.has_gauge_value())
 			node.insert(json_spirit::Object::value_type(key, v.gauge_value().value()));
+		else if (v.has_counter_value())
+			node.insert(json_spirit::Object::value_type(key, v.counter_value().value()));
 		else if (v.has_string_value())
 			node.insert(json_spirit::Object::value_type(key, v.string_value().value()));
 	}
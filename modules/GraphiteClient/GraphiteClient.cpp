@@ -168,6 +168,7 @@ void GraphiteClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool GraphiteClient::unloadModule() {
+	client_.stop();
 	client_.clear();
 	return true;
 }
@@ -150,6 +150,9 @@ namespace graphite_client {
 				if (v.has_gauge_value()) {
 					d.value = str::xtos(v.gauge_value().value());
 					list.push_back(d);
+				} else if (v.has_counter_value()) {
+					d.value = str::xtos(v.counter_value().value());
+					list.push_back(d);
 				}
 			}
 		}
@@ -52,6 +52,14 @@ bool LUAScript::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode) {
 				"SCRIPT DEFENTION", "For more configuration options add a dedicated section")
 			;
 
+		settings.alias().add_key_to_settings()
+			("state pool size", sh::uint_key(&lua_runtime_->pool_size, 1),
+				"STATE POOL SIZE", "Maximum number of Lua states per script. Additional states are created on demand (running the script once for each state) so commands from the same script can run concurrently.")
+
+			("bytecode cache", sh::path_key(&lua_runtime_->cache_path, "${cache-folder}/lua"),
+				"BYTECODE CACHE", "Folder where compiled scripts are cached (keyed by a hash of the script). Set to empty to always compile the scripts.")
+			;
+
 		settings.register_all();
 		settings.notify();
 
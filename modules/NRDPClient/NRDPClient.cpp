@@ -19,7 +19,6 @@
 
 #include "NRDPClient.h"
 
-#include "nrdp_client.hpp"
 #include "nrdp_handler.hpp"
 
 #include <nscapi/nscapi_settings_helper.hpp>
@@ -35,7 +34,9 @@
  * Default c-tor
  * @return
  */
-NRDPClient::NRDPClient() : client_("nrdp", boost::make_shared<nrdp_client::nrdp_client_handler>(), boost::make_shared<nrdp_handler::options_reader_impl>()) {}
+NRDPClient::NRDPClient()
+	: handler_(boost::make_shared<nrdp_client::nrdp_client_handler>())
+	, client_("nrdp", handler_, boost::make_shared<nrdp_handler::options_reader_impl>()) {}
 
 /**
  * Default d-tor
@@ -171,6 +172,8 @@ void NRDPClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool NRDPClient::unloadModule() {
+	client_.stop();
+	handler_->stop();
 	client_.clear();
 	return true;
 }
@@ -25,6 +25,8 @@
 
 #include <client/command_line_parser.hpp>
 
+#include "nrdp_client.hpp"
+
 namespace po = boost::program_options;
 namespace sh = nscapi::settings_helper;
 
@@ -34,6 +36,7 @@ private:
 	std::string channel_;
 	std::string hostname_;
 
+	boost::shared_ptr<nrdp_client::nrdp_client_handler> handler_;
 	client::configuration client_;
 
 public:
@@ -1,5 +1 @@
-IF(TINYXML2_FOUND)
-	SET (BUILD_MODULE 1)
-ELSE(TINYXML2_FOUND)
-	SET (BUILD_MODULE 0)
-ENDIF(TINYXML2_FOUND)
+SET (BUILD_MODULE 1)
@@ -22,11 +22,84 @@
 #include <str/xtos.hpp>
 #include <utf8.hpp>
 
-#include <tinyxml2.h>
-
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/foreach.hpp>
 
 namespace nrdp {
+
+	void xml_writer::escape(std::string &out, const std::string &text) {
+		std::string::size_type last = 0;
+		for (std::string::size_type i = 0; i < text.size(); i++) {
+			const char *replacement = NULL;
+			switch (text[i]) {
+			case '&': replacement = "&amp;"; break;
+			case '<': replacement = "&lt;"; break;
+			case '>': replacement = "&gt;"; break;
+			case '"': replacement = "&quot;"; break;
+			case '\'': replacement = "&apos;"; break;
+			default:
+				continue;
+			}
+			out.append(text, last, i - last);
+			out.append(replacement);
+			last = i + 1;
+		}
+		out.append(text, last, std::string::npos);
+	}
+
+	void xml_writer::begin() {
+		if (open_)
+			return;
+		buffer_.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<checkresults>\n");
+		open_ = true;
+	}
+
+	void xml_writer::add_element(const char *name, const std::string &text) {
+		buffer_.append("<").append(name).append(">");
+		escape(buffer_, text);
+		buffer_.append("</").append(name).append(">\n");
+	}
+
+	void xml_writer::add_host(const std::string &host, NSCAPI::nagiosReturn result, const std::string &message) {
+		begin();
+		buffer_.append("<checkresult type=\"host\">\n");
+		add_element("hostname", host);
+		add_element("state", str::xtos(result));
+		add_element("output", message);
+		buffer_.append("</checkresult>\n");
+		count_++;
+	}
+
+	void xml_writer::add_service(const std::string &host, const std::string &service, NSCAPI::nagiosReturn result, const std::string &message) {
+		begin();
+		buffer_.append("<checkresult type=\"service\">\n");
+		add_element("hostname", host);
+		add_element("servicename", service);
+		add_element("state", str::xtos(result));
+		add_element("output", message);
+		buffer_.append("</checkresult>\n");
+		count_++;
+	}
+
+	const std::string& xml_writer::finish() {
+		begin();
+		buffer_.append("</checkresults>\n");
+		open_ = false;
+		return buffer_;
+	}
+
+	void xml_writer::clear() {
+		buffer_.clear();
+		count_ = 0;
+		open_ = false;
+	}
+
+	void xml_writer::swap(xml_writer &other) {
+		buffer_.swap(other.buffer_);
+		std::swap(count_, other.count_);
+		std::swap(open_, other.open_);
+	}
+
 	void data::add_host(std::string host, NSCAPI::nagiosReturn result, std::string message) {
 		item_type item;
 		item.type = type_host;
@@ -53,54 +126,71 @@ namespace nrdp {
 		items.push_back(item);
 	}
 
-	void render_item(tinyxml2::XMLDocument &doc, tinyxml2::XMLNode* parent, const nrdp::data::item_type &item) {
-		tinyxml2::XMLNode* node = parent->InsertEndChild(doc.NewElement("checkresult"));
-		tinyxml2::XMLNode* child;
-		if (item.type == nrdp::data::type_service)
-			node->ToElement()->SetAttribute("type", "service");
-		else if (item.type == nrdp::data::type_host)
-			node->ToElement()->SetAttribute("type", "host");
-		child = node->InsertEndChild(doc.NewElement("hostname"));
-		child->InsertEndChild(doc.NewText(item.host.c_str()));
-		if (item.type == nrdp::data::type_service) {
-			child = node->InsertEndChild(doc.NewElement("servicename"));
-			child->InsertEndChild(doc.NewText(item.service.c_str()));
+	std::string data::render_request() const {
+		xml_writer writer;
+		BOOST_FOREACH(const item_type &item, items) {
+			if (item.type == type_host)
+				writer.add_host(item.host, item.result, item.message);
+			else if (item.type == type_service)
+				writer.add_service(item.host, item.service, item.result, item.message);
 		}
-		child = node->InsertEndChild(doc.NewElement("state"));
-		child->InsertEndChild(doc.NewText(str::xtos(item.result).c_str()));
-		child = node->InsertEndChild(doc.NewElement("output"));
-		child->InsertEndChild(doc.NewText(item.message.c_str()));
+		return writer.finish();
 	}
 
-	std::string data::render_request() const {
-		tinyxml2::XMLDocument doc;
-		doc.InsertEndChild(doc.NewDeclaration());
-		tinyxml2::XMLNode* element = doc.InsertEndChild(doc.NewElement("checkresults"));
-		BOOST_FOREACH(const item_type &item, items) {
-			render_item(doc, element, item);
+	namespace {
+		std::string unescape(const std::string &text) {
+			std::string ret;
+			ret.reserve(text.size());
+			for (std::string::size_type i = 0; i < text.size(); i++) {
+				if (text[i] == '&') {
+					std::string::size_type end = text.find(';', i);
+					if (end != std::string::npos) {
+						std::string entity = text.substr(i + 1, end - i - 1);
+						char c = 0;
+						if (entity == "amp") c = '&';
+						else if (entity == "lt") c = '<';
+						else if (entity == "gt") c = '>';
+						else if (entity == "quot") c = '"';
+						else if (entity == "apos") c = '\'';
+						if (c != 0) {
+							ret += c;
+							i = end;
+							continue;
+						}
+					}
+				}
+				ret += text[i];
+			}
+			return ret;
+		}
+
+		// Finds the text of <name>...</name> between begin and end
+		bool find_element(const std::string &str, std::string::size_type begin, std::string::size_type end, const std::string &name, std::string &text) {
+			std::string::size_type start = str.find("<" + name, begin);
+			if (start == std::string::npos || start >= end)
+				return false;
+			start = str.find('>', start);
+			if (start == std::string::npos || start >= end)
+				return false;
+			std::string::size_type stop = str.find("</" + name, start);
+			if (stop == std::string::npos || stop > end)
+				return false;
+			text = unescape(str.substr(start + 1, stop - start - 1));
+			return true;
 		}
-		tinyxml2::XMLPrinter printer;
-		doc.Print(&printer);
-		return printer.CStr();
 	}
 
 	boost::tuple<int, std::string> data::parse_response(const std::string &str) {
-		tinyxml2::XMLDocument doc;
-		doc.Parse(str.c_str(), str.length());
-		tinyxml2::XMLNode* node = doc.FirstChildElement("result");
-		if (node == NULL) {
+		std::string::size_type begin = str.find("<result");
+		std::string::size_type end = str.find("</result>");
+		if (begin == std::string::npos || end == std::string::npos || end < begin) {
 			return boost::make_tuple(-1, "Invalid response from server");
 		}
-		tinyxml2::XMLNode* nStatus = node->FirstChildElement("status");
-		tinyxml2::XMLNode* nError = node->FirstChildElement("message");
-		if (nStatus == NULL || nError == NULL) {
+		std::string status, error;
+		if (!find_element(str, begin, end, "status", status) || !find_element(str, begin, end, "message", error)) {
 			return boost::make_tuple(-1, "Invalid response from server");
 		}
-		tinyxml2::XMLNode* tnStatus = nStatus->FirstChild();
-		tinyxml2::XMLNode* tnError = nError->FirstChild();
-
-		std::string status = tnStatus->Value();
-		std::string error = tnError->Value();
+		boost::algorithm::trim(status);
 		return boost::make_tuple(str::stox<int>(status, -1), error);
 	}
-}
\ No newline at end of file
+}
@@ -28,6 +28,37 @@
 #include <NSCAPI.h>
 
 namespace nrdp {
+
+	// Writes a checkresults document straight into a buffer (which keeps its capacity between documents)
+	class xml_writer : boost::noncopyable {
+		std::string buffer_;
+		std::size_t count_;
+		bool open_;
+
+	public:
+		xml_writer() : count_(0), open_(false) {}
+
+		void add_host(const std::string &host, NSCAPI::nagiosReturn result, const std::string &message);
+		void add_service(const std::string &host, const std::string &service, NSCAPI::nagiosReturn result, const std::string &message);
+		// Closes the document and returns it (valid until the next call to clear)
+		const std::string& finish();
+		void clear();
+		void swap(xml_writer &other);
+
+		std::size_t count() const {
+			return count_;
+		}
+		bool empty() const {
+			return count_ == 0;
+		}
+
+		static void escape(std::string &out, const std::string &text);
+
+	private:
+		void begin();
+		void add_element(const char *name, const std::string &text);
+	};
+
 	struct data : boost::noncopyable {
 		enum item_type_type {
 			type_service,
@@ -48,4 +79,4 @@ namespace nrdp {
 		std::string render_request() const;
 		static boost::tuple<int, std::string> parse_response(const std::string &str);
 	};
-}
\ No newline at end of file
+}
@@ -27,11 +27,22 @@
 #include "nrdp.hpp"
 #include <http/client.hpp>
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+
 namespace nrdp_client {
 	struct connection_data : public socket_helpers::connection_info {
 		std::string token;
 		std::string protocol;
 		std::string path;
+		int batch_interval;
+		int batch_size;
 
 		std::string sender_hostname;
 
@@ -50,11 +61,20 @@ namespace nrdp_client {
 			timeout = arguments.get_int_data("timeout", 30);
 			token = arguments.get_string_data("token");
 			retry = arguments.get_int_data("retry", 3);
+			batch_interval = arguments.get_int_data("batch interval", 0);
+			batch_size = arguments.get_int_data("batch size", 1000);
+			if (batch_size <= 0)
+				batch_size = 1000;
 
 			if (sender.has_data("host"))
 				sender_hostname = sender.get_string_data("host");
 		}
 
+		// Identifies the server (and credentials) so connections and batches can be shared
+		std::string get_key() const {
+			return protocol + "://" + get_endpoint_string() + ":" + port_ + path + "#" + token;
+		}
+
 		std::string to_string() const {
 			std::stringstream ss;
 			ss << "protocol: " << protocol;
@@ -64,11 +84,52 @@ namespace nrdp_client {
 			ss << ", timeout: " << timeout;
 			ss << ", token: " << token;
 			ss << ", sender: " << sender_hostname;
+			ss << ", batch interval: " << batch_interval;
 			return ss.str();
 		}
 	};
 
-	struct nrdp_client_handler : public client::handler_interface {
+	// A persistent connection to a server (used by one request at a time)
+	struct connection : boost::noncopyable {
+		boost::mutex mutex;
+		boost::shared_ptr<http::simple_client> client;
+		std::string protocol;
+	};
+	typedef boost::shared_ptr<connection> connection_type;
+
+	// Collects results for one server and posts them all at once every batch interval (or when the batch is full)
+	// The configuration is refreshed by every submission. A batcher retires (its thread ends) once batching is
+	// turned off for the target or it has been idle for a while, and is replaced when it is needed again.
+	struct batcher : boost::noncopyable {
+		connection_data con;
+		boost::mutex mutex;
+		boost::condition_variable cond;
+		nrdp::xml_writer pending;
+		bool stop;
+		bool retired;
+		boost::shared_ptr<boost::thread> thread;
+
+		batcher(const connection_data &con) : con(con), stop(false), retired(false) {}
+
+		// Called with the mutex held, returns true if the thread needs to be woken up
+		bool update(const connection_data &next) {
+			bool changed = next.batch_interval != con.batch_interval || next.batch_size != con.batch_size;
+			con = next;
+			return changed;
+		}
+	};
+	typedef boost::shared_ptr<batcher> batcher_type;
+
+	class nrdp_client_handler : public client::handler_interface, boost::noncopyable {
+		boost::mutex mutex_;
+		std::map<std::string, connection_type> connections_;
+		std::map<std::string, batcher_type> batchers_;
+
+	public:
+		~nrdp_client_handler() {
+			stop();
+		}
+
 		bool query(client::destination_container sender, client::destination_container target, const PB::Commands::QueryRequestMessage &request_message, PB::Commands::QueryResponseMessage &response_message) {
 			return false;
 		}
@@ -82,8 +143,68 @@ namespace nrdp_client {
 				NSC_TRACE_MSG("Target configuration: " + target.to_string());
 			}
 
-			nrdp::data nrdp_data;
+			if (con.batch_interval > 0) {
+				while (true) {
+					batcher_type b = get_batcher(con);
+					bool notify = false;
+					{
+						boost::unique_lock<boost::mutex> lock(b->mutex);
+						if (b->retired)
+							continue;
+						notify = b->update(con);
+						if (b->pending.count() >= static_cast<std::size_t>(con.batch_size) * 10) {
+							nscapi::protobuf::functions::set_response_bad(*response_message.add_payload(), "Too many queued results for: " + con.get_endpoint_string());
+							return true;
+						}
+						add_results(b->pending, sender, request_message);
+						notify = notify || b->pending.count() >= static_cast<std::size_t>(con.batch_size);
+					}
+					if (notify)
+						b->cond.notify_all();
+					nscapi::protobuf::functions::set_response_good(*response_message.add_payload(), "Queued for submission");
+					return true;
+				}
+			}
+			// Batching may just have been turned off: let a running batch flush and retire
+			update_batcher(con);
+
+			nrdp::xml_writer writer;
+			add_results(writer, sender, request_message);
+			send(response_message.add_payload(), con, writer.finish());
+			return true;
+		}
+
+		bool exec(client::destination_container sender, client::destination_container target, const PB::Commands::ExecuteRequestMessage &request_message, PB::Commands::ExecuteResponseMessage &response_message) {
+			return false;
+		}
+
+		bool metrics(client::destination_container sender, client::destination_container target, const PB::Metrics::MetricsMessage &request_message) {
+			return false;
+		}
+
+		// Posts whatever is queued and stops all batches (and closes all connections)
+		void stop() {
+			std::map<std::string, batcher_type> batchers;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				batchers.swap(batchers_);
+			}
+			typedef std::map<std::string, batcher_type>::value_type batcher_entry;
+			BOOST_FOREACH(const batcher_entry &e, batchers) {
+				{
+					boost::unique_lock<boost::mutex> lock(e.second->mutex);
+					e.second->stop = true;
+				}
+				e.second->cond.notify_all();
+				if (e.second->thread)
+					e.second->thread->join();
+			}
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			connections_.clear();
+		}
 
+	private:
+		static void add_results(nrdp::xml_writer &writer, const client::destination_container &sender, const PB::Commands::SubmitRequestMessage &request_message) {
 			BOOST_FOREACH(const ::PB::Commands::QueryResponseMessage_Response &p, request_message.payload()) {
 				std::string msg = nscapi::protobuf::functions::query_data_to_nagios_string(p, nscapi::protobuf::functions::no_truncation);
 				std::string alias = p.alias();
@@ -91,39 +212,124 @@ namespace nrdp_client {
 					alias = p.command();
 				int result = nscapi::protobuf::functions::gbp_to_nagios_status(p.result());
 				if (alias == "host_check")
-					nrdp_data.add_host(sender.get_host(), result, msg);
+					writer.add_host(sender.get_host(), result, msg);
 				else
-					nrdp_data.add_service(sender.get_host(), alias, result, msg);
+					writer.add_service(sender.get_host(), alias, result, msg);
 			}
-			send(response_message.add_payload(), con, nrdp_data);
-			return true;
 		}
 
-		bool exec(client::destination_container sender, client::destination_container target, const PB::Commands::ExecuteRequestMessage &request_message, PB::Commands::ExecuteResponseMessage &response_message) {
-			return false;
+		batcher_type get_batcher(const connection_data &con) {
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			std::string key = con.get_key();
+			std::map<std::string, batcher_type>::iterator it = batchers_.find(key);
+			if (it != batchers_.end()) {
+				batcher_type b = it->second;
+				{
+					boost::unique_lock<boost::mutex> batch_lock(b->mutex);
+					if (!b->retired)
+						return b;
+				}
+				// Retiring is the last thing the thread does so this does not block
+				if (b->thread)
+					b->thread->join();
+			}
+			batcher_type b(new batcher(con));
+			b->thread.reset(new boost::thread(boost::bind(&nrdp_client_handler::batch_thread, this, b)));
+			batchers_[key] = b;
+			return b;
 		}
 
-		bool metrics(client::destination_container sender, client::destination_container target, const PB::Metrics::MetricsMessage &request_message) {
-			return false;
+		void update_batcher(const connection_data &con) {
+			batcher_type b;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				std::map<std::string, batcher_type>::iterator it = batchers_.find(con.get_key());
+				if (it == batchers_.end())
+					return;
+				b = it->second;
+			}
+			bool notify = false;
+			{
+				boost::unique_lock<boost::mutex> lock(b->mutex);
+				if (!b->retired)
+					notify = b->update(con);
+			}
+			if (notify)
+				b->cond.notify_all();
 		}
 
-		void send(PB::Commands::SubmitResponseMessage::Response *payload, connection_data con, const nrdp::data &nrdp_data) {
+		void batch_thread(batcher_type b) {
+			// Number of empty intervals after which an unused batcher retires
+			const int max_idle = 10;
+			// Kept between batches so the buffer is reused
+			nrdp::xml_writer sending;
+			int idle = 0;
+			boost::unique_lock<boost::mutex> lock(b->mutex);
+			while (true) {
+				boost::posix_time::ptime started = boost::posix_time::microsec_clock::universal_time();
+				// The configuration can change while we wait so the deadline is recalculated on every wakeup
+				while (!b->stop && b->con.batch_interval > 0 && b->pending.count() < static_cast<std::size_t>(b->con.batch_size)) {
+					if (!b->cond.timed_wait(lock, started + boost::posix_time::seconds(b->con.batch_interval)))
+						break;
+				}
+				if (b->pending.empty()) {
+					if (b->stop || b->con.batch_interval <= 0 || ++idle >= max_idle) {
+						b->retired = true;
+						return;
+					}
+					continue;
+				}
+				idle = 0;
+				sending.clear();
+				sending.swap(b->pending);
+				connection_data con = b->con;
+				lock.unlock();
+
+				PB::Commands::SubmitResponseMessage::Response result;
+				send(&result, con, sending.finish());
+				if (result.result().code() != PB::Common::Result_StatusCodeType_STATUS_OK) {
+					NSC_LOG_ERROR("Failed to submit " + str::xtos(sending.count()) + " results to " + con.get_endpoint_string() + ": " + result.result().message());
+				} else {
+					NSC_DEBUG_MSG("Submitted " + str::xtos(sending.count()) + " results to " + con.get_endpoint_string());
+				}
+
+				lock.lock();
+			}
+		}
+
+		connection_type get_connection(const connection_data &con) {
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			connection_type &c = connections_[con.get_key()];
+			if (!c)
+				c.reset(new connection());
+			return c;
+		}
+
+		void send(PB::Commands::SubmitResponseMessage::Response *payload, const connection_data &con, const std::string &xml) {
 			try {
 				NSC_TRACE_ENABLED() {
-					NSC_TRACE_MSG("Connecting tuo: " + con.to_string());
+					NSC_TRACE_MSG("Connecting to: " + con.to_string());
 				}
-				http::simple_client c(con.protocol);
 				http::packet request("POST", con.get_address(), con.path);
 				http::packet::post_map_type post;
 				post["token"] = con.token;
-				post["XMLDATA"] = nrdp_data.render_request();
+				post["XMLDATA"] = xml;
 				post["cmd"] = "submitcheck";
 				request.add_post_payload(post);
 				NSC_TRACE_ENABLED() {
-					NSC_TRACE_MSG("Sending: " + nrdp_data.render_request());
+					NSC_TRACE_MSG("Sending: " + xml);
 				}
 				std::ostringstream os;
-				http::response response = c.execute(os, con.get_address(), con.get_port(), request);
+				http::response response;
+				{
+					connection_type c = get_connection(con);
+					boost::unique_lock<boost::mutex> lock(c->mutex);
+					if (!c->client || c->protocol != con.protocol) {
+						c->client.reset(new http::simple_client(con.protocol));
+						c->protocol = con.protocol;
+					}
+					response = c->client->execute_keep_alive(os, con.get_address(), con.get_port(), request);
+				}
 				response.payload_ = os.str();
 				NSC_TRACE_ENABLED() {
 					NSC_TRACE_MSG("Recieved: " + response.payload_);
@@ -143,4 +349,4 @@ namespace nrdp_client {
 			}
 		}
 	};
-}
\ No newline at end of file
+}
@@ -64,6 +64,12 @@ namespace nrdp_handler {
 				("token", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "token", _1)),
 					"SECURITY TOKEN", "The security token")
 
+				("batch interval", sh::int_fun_key(boost::bind(&parent::set_property_int, this, "batch interval", _1), 0),
+					"BATCH INTERVAL", "Number of seconds to collect results before they are posted together (as one request over a persistent connection). 0 posts every submission directly.")
+
+				("batch size", sh::int_fun_key(boost::bind(&parent::set_property_int, this, "batch size", _1), 1000),
+					"BATCH SIZE", "Post the batch right away when it has this many results (regardless of the batch interval).")
+
 				;
 
 			settings.register_all();
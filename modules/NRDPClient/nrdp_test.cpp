@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "nrdp.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+	std::string escape(const std::string &text) {
+		std::string ret;
+		nrdp::xml_writer::escape(ret, text);
+		return ret;
+	}
+	int status(const boost::tuple<int, std::string> &r) {
+		return r.get<0>();
+	}
+	std::string message(const boost::tuple<int, std::string> &r) {
+		return r.get<1>();
+	}
+}
+
+TEST(nrdp, escape) {
+	EXPECT_EQ("", escape(""));
+	EXPECT_EQ("hello world", escape("hello world"));
+	EXPECT_EQ("&amp;&lt;&gt;&quot;&apos;", escape("&<>\"'"));
+	EXPECT_EQ("a &lt; b &amp;&amp; c &gt; d", escape("a < b && c > d"));
+	EXPECT_EQ("&amp;amp;", escape("&amp;"));
+}
+
+TEST(nrdp, escape_appends) {
+	std::string out = "x=";
+	nrdp::xml_writer::escape(out, "<1>");
+	EXPECT_EQ("x=&lt;1&gt;", out);
+}
+
+TEST(nrdp, writer) {
+	nrdp::xml_writer writer;
+	EXPECT_TRUE(writer.empty());
+	writer.add_service("host", "cpu & load", 2, "CRITICAL: <90%>");
+	EXPECT_EQ(1, writer.count());
+	std::string xml = writer.finish();
+	EXPECT_NE(std::string::npos, xml.find("<servicename>cpu &amp; load</servicename>"));
+	EXPECT_NE(std::string::npos, xml.find("<output>CRITICAL: &lt;90%&gt;</output>"));
+	EXPECT_NE(std::string::npos, xml.find("<state>2</state>"));
+	EXPECT_EQ(xml.size() - 16, xml.find("</checkresults>\n"));
+
+	writer.clear();
+	EXPECT_TRUE(writer.empty());
+	writer.add_host("host", 0, "OK");
+	EXPECT_EQ(std::string::npos, writer.finish().find("servicename"));
+}
+
+TEST(nrdp, parse_response_ok) {
+	boost::tuple<int, std::string> r = nrdp::data::parse_response("<?xml version=\"1.0\"?>\n<result>\n  <status> 0 </status>\n  <message>OK</message>\n  <meta><output>1 checks processed.</output></meta>\n</result>\n");
+	EXPECT_EQ(0, status(r));
+	EXPECT_EQ("OK", message(r));
+}
+
+TEST(nrdp, parse_response_error) {
+	boost::tuple<int, std::string> r = nrdp::data::parse_response("<result><status>-1</status><message>BAD TOKEN &amp; &lt;more&gt;</message></result>");
+	EXPECT_EQ(-1, status(r));
+	EXPECT_EQ("BAD TOKEN & <more>", message(r));
+}
+
+TEST(nrdp, parse_response_invalid) {
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("")));
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("<html>502 Bad Gateway</html>")));
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("<result><status>0</status></result>")));
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("</result><result><status>0</status><message>OK</message>")));
+	// Elements outside the result element are not used
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("<result></result><status>0</status><message>OK</message>")));
+	EXPECT_EQ(-1, status(nrdp::data::parse_response("<result><status>zero</status><message>OK</message></result>")));
+}
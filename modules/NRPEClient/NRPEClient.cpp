@@ -124,6 +124,7 @@ void NRPEClient::add_command(std::string name, std::string args) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool NRPEClient::unloadModule() {
+	client_.stop();
 	return true;
 }
 
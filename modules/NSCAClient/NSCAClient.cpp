@@ -172,6 +172,7 @@ void NSCAClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool NSCAClient::unloadModule() {
+	client_.stop();
 	client_.clear();
 	return true;
 }
@@ -121,6 +121,7 @@ void NSCPClient::add_command(std::string name, std::string args) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool NSCPClient::unloadModule() {
+	client_.stop();
 	return true;
 }
 
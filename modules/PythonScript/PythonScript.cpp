@@ -35,6 +35,8 @@
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <str/xtos.hpp>
+
 
 namespace sh = nscapi::settings_helper;
 namespace po = boost::program_options;
@@ -44,6 +46,7 @@ bool PythonScript::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode)
 	alias_ = alias;
 
 	if (mode == NSCAPI::reloadStart) {
+		stop_workers();
 		nscapi::core_helper ch(get_core(), get_id());
 		BOOST_FOREACH(const std::string &s, script_wrapper::functions::get()->get_commands()) {
 			ch.unregister_command(s);
@@ -68,6 +71,15 @@ bool PythonScript::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode)
 				"SCRIPT", "For more configuration options add a dedicated section")
 			;
 
+		settings.alias().add_key_to_settings()
+			("worker processes", sh::uint_key(&worker_count_, 0),
+				"WORKER PROCESSES", "Number of pre-forked worker processes used to run queries (0 runs all queries inside the agent). "
+				"Workers are forked after all scripts are loaded so modules are only imported once, calls scripts make into the agent are proxied back over a socket. Not supported on Windows.")
+
+			("worker timeout", sh::uint_key(&worker_timeout_, 60),
+				"WORKER TIMEOUT", "Number of seconds a query can run in a worker process before the worker is killed and replaced.")
+			;
+
 		settings.alias().add_templates()
 			("scripts", "plus", "Add a simple script",
 				"Add binding for a simple script",
@@ -89,6 +101,8 @@ bool PythonScript::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode)
 		python_script::init();
 
 		settings.notify();
+
+		start_workers();
 	} catch (...) {
 		NSC_LOG_ERROR_STD("Exception caught: <UNKNOWN EXCEPTION>");
 		return false;
@@ -105,6 +119,7 @@ void PythonScript::loadScript(std::string alias, std::string file) {
 }
 
 bool PythonScript::unloadModule() {
+	stop_workers();
 	if (provider_) {
 		provider_->clear();
 	}
@@ -213,7 +228,73 @@ void PythonScript::execute_script(const PB::Commands::ExecuteRequestMessage::Req
 }
 
 
+void PythonScript::start_workers() {
+	if (worker_count_ == 0)
+		return;
+#ifndef WIN32
+	workers_.reset(new python_worker::worker_pool(get_core(), boost::bind(&PythonScript::handle_worker_query, this, _1, _2, _3), worker_timeout_));
+	bool ok = false;
+	{
+		script_wrapper::thread_locker locker;
+		ok = workers_->start(worker_count_);
+	}
+	if (!ok) {
+		NSC_LOG_ERROR("Failed to start python workers, queries will be handled in-process");
+		stop_workers();
+	} else {
+		NSC_DEBUG_MSG("Started " + str::xtos(worker_count_) + " python workers");
+	}
+#else
+	NSC_LOG_ERROR("Worker processes are not supported on this platform, queries will be handled in-process");
+#endif
+}
+
+void PythonScript::stop_workers() {
+#ifndef WIN32
+	if (workers_) {
+		workers_->stop();
+		workers_.reset();
+	}
+#endif
+}
+
+void PythonScript::handle_worker_query(int index, const std::string &request, std::string &response) {
+	PB::Commands::QueryRequestMessage request_message;
+	PB::Commands::QueryResponseMessage::Response local_response;
+	if (!request_message.ParseFromString(request) || index < 0 || index >= request_message.payload_size()) {
+		nscapi::protobuf::functions::set_response_bad(local_response, "Invalid request");
+	} else {
+		local_response.set_command(request_message.payload(index).command());
+		query_local(request_message.payload(index), &local_response, request_message);
+	}
+	response = local_response.SerializeAsString();
+}
+
 void PythonScript::query_fallback(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, const PB::Commands::QueryRequestMessage &request_message) {
+#ifndef WIN32
+	boost::shared_ptr<python_worker::worker_pool> workers = workers_;
+	if (workers && workers->is_running()) {
+		int index = 0;
+		for (int i = 0; i < request_message.payload_size(); i++) {
+			if (&request_message.payload(i) == &request) {
+				index = i;
+				break;
+			}
+		}
+		std::string buffer, error;
+		if (!workers->execute(index, request_message.SerializeAsString(), buffer, error))
+			return nscapi::protobuf::functions::set_response_bad(*response, error);
+		PB::Commands::QueryResponseMessage::Response worker_response;
+		if (!worker_response.ParseFromString(buffer))
+			return nscapi::protobuf::functions::set_response_bad(*response, "Invalid response from worker: " + request.command());
+		response->CopyFrom(worker_response);
+		return;
+	}
+#endif
+	query_local(request, response, request_message);
+}
+
+void PythonScript::query_local(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, const PB::Commands::QueryRequestMessage &request_message) {
 	boost::shared_ptr<script_wrapper::function_wrapper> inst = script_wrapper::function_wrapper::create(get_id());
 	if (inst->has_function(request.command())) {
 		std::string buffer;
@@ -18,6 +18,9 @@
  */
 
 #include "script_interface.hpp"
+#ifndef WIN32
+#include "python_worker.hpp"
+#endif
 
 #include <nscapi/nscapi_protobuf_command.hpp>
 #include <nscapi/nscapi_protobuf_metrics.hpp>
@@ -35,9 +38,14 @@ private:
 	std::string alias_;
 
 	boost::shared_ptr<script_provider_interface> provider_;
+	unsigned int worker_count_;
+	unsigned int worker_timeout_;
+#ifndef WIN32
+	boost::shared_ptr<python_worker::worker_pool> workers_;
+#endif
 
 public:
-	PythonScript() {}
+	PythonScript() : worker_count_(0), worker_timeout_(60) {}
 	virtual ~PythonScript() {}
 	// Module calls
 	bool loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode);
@@ -53,6 +61,10 @@ public:
 	void execute_script(const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response);
 
 private:
+	void query_local(const PB::Commands::QueryRequestMessage::Request &request, PB::Commands::QueryResponseMessage::Response *response, const PB::Commands::QueryRequestMessage &request_message);
+	void handle_worker_query(int index, const std::string &request, std::string &response);
+	void start_workers();
+	void stop_workers();
 	void loadScript(std::string alias, std::string script);
 	//boost::optional<boost::filesystem::path> find_file(std::string file);
 };
@@ -0,0 +1,651 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "python_worker.hpp"
+#include "script_wrapper.hpp"
+
+#include <nscapi/nscapi_helper_singleton.hpp>
+#include <nscapi/macros.hpp>
+
+#include <str/xtos.hpp>
+#include <utf8.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread_time.hpp>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+namespace python_worker {
+
+	const std::size_t header_size = 1 + 4 + 4 + 4;
+	const unsigned int max_frame_size = 64 * 1024 * 1024;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Framing
+
+	namespace {
+		// fork() bracketed by the python fork hooks so the child does not inherit locked interpreter locks.
+		// The caller has to hold the GIL (which the child ends up holding).
+		pid_t fork_python() {
+#if PY_VERSION_HEX >= 0x03070000
+			PyOS_BeforeFork();
+			pid_t pid = fork();
+			if (pid == 0)
+				PyOS_AfterFork_Child();
+			else
+				PyOS_AfterFork_Parent();
+			return pid;
+#else
+			pid_t pid = fork();
+			if (pid == 0)
+				PyOS_AfterFork();
+			return pid;
+#endif
+		}
+
+		// Passes a descriptor over a unix socket
+		bool send_fd(int socket, int fd) {
+			char data = 0;
+			struct iovec iov;
+			iov.iov_base = &data;
+			iov.iov_len = 1;
+			char control[CMSG_SPACE(sizeof(int))];
+			memset(control, 0, sizeof(control));
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+			while (true) {
+				ssize_t n = sendmsg(socket, &msg, MSG_NOSIGNAL);
+				if (n < 0 && errno == EINTR)
+					continue;
+				return n == 1;
+			}
+		}
+
+		// Returns -1 when the socket is closed (or broken)
+		int receive_fd(int socket) {
+			char data = 0;
+			struct iovec iov;
+			iov.iov_base = &data;
+			iov.iov_len = 1;
+			char control[CMSG_SPACE(sizeof(int))];
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			while (true) {
+				ssize_t n = recvmsg(socket, &msg, 0);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n != 1)
+					return -1;
+				break;
+			}
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+			if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				return -1;
+			int fd;
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+			return fd;
+		}
+
+		bool write_all(int fd, const char *data, std::size_t len) {
+			while (len > 0) {
+				ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				data += n;
+				len -= n;
+			}
+			return true;
+		}
+
+		bool read_all(int fd, char *data, std::size_t len, const boost::posix_time::ptime *deadline) {
+			while (len > 0) {
+				if (deadline) {
+					long long ms = (*deadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+					if (ms < 0)
+						ms = 0;
+					struct pollfd pfd;
+					pfd.fd = fd;
+					pfd.events = POLLIN;
+					pfd.revents = 0;
+					int ret = poll(&pfd, 1, static_cast<int>(ms));
+					if (ret < 0 && errno == EINTR)
+						continue;
+					if (ret <= 0)
+						return false;
+				}
+				ssize_t n = ::read(fd, data, len);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				data += n;
+				len -= n;
+			}
+			return true;
+		}
+
+		void put_u32(std::string &buf, unsigned int v) {
+			buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+		}
+		unsigned int get_u32(const char *p) {
+			unsigned int v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+	}
+
+	bool write_frame(int fd, const frame &f) {
+		std::string buf;
+		buf.reserve(4 + header_size + f.target.size() + f.payload.size());
+		put_u32(buf, static_cast<unsigned int>(header_size + f.target.size() + f.payload.size()));
+		buf.push_back(static_cast<char>(f.type));
+		put_u32(buf, static_cast<unsigned int>(f.code));
+		put_u32(buf, static_cast<unsigned int>(f.aux));
+		put_u32(buf, static_cast<unsigned int>(f.target.size()));
+		buf += f.target;
+		buf += f.payload;
+		return write_all(fd, buf.data(), buf.size());
+	}
+
+	bool read_frame(int fd, frame &f, int timeout_ms) {
+		boost::posix_time::ptime deadline;
+		const boost::posix_time::ptime *pdeadline = NULL;
+		if (timeout_ms >= 0) {
+			deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeout_ms);
+			pdeadline = &deadline;
+		}
+		char size_buf[4];
+		if (!read_all(fd, size_buf, sizeof(size_buf), pdeadline))
+			return false;
+		unsigned int size = get_u32(size_buf);
+		if (size < header_size || size > max_frame_size)
+			return false;
+		std::string buf(size, '\0');
+		if (!read_all(fd, &buf[0], size, pdeadline))
+			return false;
+		f.type = static_cast<unsigned char>(buf[0]);
+		f.code = static_cast<int>(get_u32(&buf[1]));
+		f.aux = static_cast<int>(get_u32(&buf[5]));
+		unsigned int target_size = get_u32(&buf[9]);
+		if (target_size > size - header_size)
+			return false;
+		f.target = buf.substr(header_size, target_size);
+		f.payload = buf.substr(header_size + target_size);
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Worker side: the core API is replaced with stubs forwarding everything to the parent
+
+	namespace child {
+		int fd = -1;
+		NSCAPI::log_level::level loglevel = NSCAPI::log_level::info;
+
+		bool call(unsigned char type, const std::string &target, const std::string &payload, int &code, std::string &result) {
+			if (!write_frame(fd, frame(type, 0, target, payload)))
+				return false;
+			frame f;
+			if (!read_frame(fd, f) || f.type != frame::reply)
+				return false;
+			code = f.code;
+			result = f.payload;
+			return true;
+		}
+
+		int buffer_call(unsigned char type, const char *target, const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			int code = NSCAPI::api_return_codes::hasFailed;
+			std::string result;
+			*response = NULL;
+			*response_len = 0;
+			if (!call(type, target ? target : "", std::string(request, request_len), code, result))
+				return NSCAPI::api_return_codes::hasFailed;
+			*response = new char[result.size() + 1];
+			memcpy(*response, result.data(), result.size());
+			(*response)[result.size()] = 0;
+			*response_len = static_cast<unsigned int>(result.size());
+			return code;
+		}
+
+		NSCAPI::nagiosReturn inject(const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_query, NULL, request, request_len, response, response_len);
+		}
+		NSCAPI::nagiosReturn exec_command(const char* target, const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_exec, target, request, request_len, response, response_len);
+		}
+		NSCAPI::errorReturn notify(const char* channel, const char* request, unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_submit, channel, request, request_len, response, response_len);
+		}
+		NSCAPI::errorReturn settings_query(const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_settings, NULL, request, request_len, response, response_len);
+		}
+		NSCAPI::errorReturn registry_query(const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_registry, NULL, request, request_len, response, response_len);
+		}
+		NSCAPI::errorReturn storage_query(const char *request, const unsigned int request_len, char **response, unsigned int *response_len) {
+			return buffer_call(frame::core_storage, NULL, request, request_len, response, response_len);
+		}
+		NSCAPI::errorReturn expand_path(const char *key, char *buffer, unsigned int len) {
+			int code = NSCAPI::api_return_codes::hasFailed;
+			std::string result;
+			if (!call(frame::core_expand_path, "", key, code, result) || len == 0)
+				return NSCAPI::api_return_codes::hasFailed;
+			std::size_t n = std::min<std::size_t>(result.size(), len - 1);
+			memcpy(buffer, result.data(), n);
+			buffer[n] = 0;
+			return code;
+		}
+		NSCAPI::errorReturn emit_event(const char *request, int request_len) {
+			int code = NSCAPI::api_return_codes::hasFailed;
+			std::string result;
+			call(frame::core_emit_event, "", std::string(request, request_len), code, result);
+			return code;
+		}
+		NSCAPI::errorReturn reload(const char *module) {
+			int code = NSCAPI::api_return_codes::hasFailed;
+			std::string result;
+			call(frame::core_reload, module, "", code, result);
+			return code;
+		}
+		void destroy_buffer(char **buffer) {
+			delete[] * buffer;
+			*buffer = NULL;
+		}
+		NSCAPI::log_level::level get_loglevel() {
+			return loglevel;
+		}
+		void simple_message(const char*, int level, const char *file, int line, const char *message) {
+			frame f(frame::core_log, level, file, message);
+			f.aux = line;
+			write_frame(fd, f);
+		}
+		void message(const char *data, unsigned int len) {
+			frame f(frame::core_log, -1, "", std::string(data, len));
+			write_frame(fd, f);
+		}
+
+		nscapi::core_api::FUNPTR loader(const char *name) {
+			std::string n = name;
+			if (n == "NSAPIInject")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&inject);
+			if (n == "NSAPIExecCommand")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&exec_command);
+			if (n == "NSAPINotify")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&notify);
+			if (n == "NSAPISettingsQuery")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&settings_query);
+			if (n == "NSAPIRegistryQuery")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&registry_query);
+			if (n == "NSAPIStorageQuery")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&storage_query);
+			if (n == "NSAPIExpandPath")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&expand_path);
+			if (n == "NSCAPIEmitEvent")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&emit_event);
+			if (n == "NSAPIReload")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&reload);
+			if (n == "NSAPIDestroyBuffer")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&destroy_buffer);
+			if (n == "NSAPIGetLoglevel")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&get_loglevel);
+			if (n == "NSAPISimpleMessage")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&simple_message);
+			if (n == "NSAPIMessage")
+				return reinterpret_cast<nscapi::core_api::FUNPTR>(&message);
+			return NULL;
+		}
+
+		// Close everything inherited from the parent (listening sockets, other workers, log files...)
+		void close_inherited_fds(int keep) {
+			std::vector<int> fds;
+			DIR *dir = opendir("/proc/self/fd");
+			if (dir != NULL) {
+				int dir_fd = dirfd(dir);
+				struct dirent *e;
+				while ((e = readdir(dir)) != NULL) {
+					int f = atoi(e->d_name);
+					if (f > 2 && f != keep && f != dir_fd)
+						fds.push_back(f);
+				}
+				closedir(dir);
+			} else {
+				long max = sysconf(_SC_OPEN_MAX);
+				for (int f = 3; f < max; f++) {
+					if (f != keep)
+						fds.push_back(f);
+				}
+			}
+			BOOST_FOREACH(int f, fds) {
+				close(f);
+			}
+		}
+
+		void run(int socket, nscapi::core_wrapper *core, query_handler handler) {
+#ifdef __linux__
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+			close_inherited_fds(socket);
+			fd = socket;
+			core->load_endpoints(&loader);
+			// We hold the GIL (see fork_python), release it so handlers can lock as usual
+			if (script_wrapper::thread_support::enabled)
+				PyEval_SaveThread();
+
+			frame f;
+			while (read_frame(fd, f)) {
+				if (f.type != frame::query)
+					continue;
+				std::string response;
+				try {
+					handler(f.code, f.payload, response);
+				} catch (...) {
+					response.clear();
+				}
+				if (!write_frame(fd, frame(frame::answer, 0, "", response)))
+					break;
+			}
+			_exit(0);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Spawner: a single threaded copy of the process which forks the workers
+
+	namespace spawner {
+		// For every socket received fork a worker serving it and reply with its pid (or -1).
+		// Exits when the agent closes the control socket (which includes the agent dying).
+		void run(int control, nscapi::core_wrapper *core, query_handler handler) {
+			child::close_inherited_fds(control);
+			// Workers are reaped automatically
+			signal(SIGCHLD, SIG_IGN);
+			while (true) {
+				int socket = receive_fd(control);
+				if (socket < 0)
+					_exit(0);
+				pid_t pid = fork_python();
+				if (pid == 0) {
+					child::run(socket, core, handler);
+				}
+				close(socket);
+				int reply = pid < 0 ? -1 : static_cast<int>(pid);
+				if (!write_all(control, reinterpret_cast<const char*>(&reply), sizeof(reply)))
+					_exit(0);
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Parent side
+
+	bool worker_pool::start(unsigned int count) {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		child::loglevel = core_->get_loglevel();
+		if (!start_spawner())
+			return false;
+		for (unsigned int i = 0; i < count; i++) {
+			worker w;
+			if (!spawn(w))
+				return false;
+			workers_.push_back(w);
+		}
+		return true;
+	}
+
+	// Forks the spawner (the only fork made from the agent which has lots of threads running)
+	bool worker_pool::start_spawner() {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+			NSC_LOG_ERROR("Failed to create socket pair for python worker spawner: " + std::string(strerror(errno)));
+			return false;
+		}
+		pid_t pid = fork_python();
+		if (pid < 0) {
+			close(sv[0]);
+			close(sv[1]);
+			NSC_LOG_ERROR("Failed to fork python worker spawner: " + std::string(strerror(errno)));
+			return false;
+		}
+		if (pid == 0) {
+			close(sv[0]);
+			spawner::run(sv[1], core_, handler_);
+		}
+		close(sv[1]);
+		spawner_pid_ = pid;
+		spawner_fd_ = sv[0];
+		return true;
+	}
+
+	void worker_pool::stop_spawner() {
+		boost::unique_lock<boost::mutex> lock(spawn_mutex_);
+		if (spawner_fd_ != -1)
+			close(spawner_fd_);
+		if (spawner_pid_ > 0) {
+			kill(spawner_pid_, SIGKILL);
+			int status;
+			while (waitpid(spawner_pid_, &status, 0) == -1 && errno == EINTR) {}
+		}
+		spawner_fd_ = -1;
+		spawner_pid_ = -1;
+	}
+
+	bool worker_pool::spawn(worker &w) {
+		boost::unique_lock<boost::mutex> lock(spawn_mutex_);
+		if (spawner_fd_ == -1)
+			return false;
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+			NSC_LOG_ERROR("Failed to create socket pair for python worker: " + std::string(strerror(errno)));
+			return false;
+		}
+		bool sent = send_fd(spawner_fd_, sv[1]);
+		close(sv[1]);
+		int pid = -1;
+		boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(5);
+		if (!sent || !read_all(spawner_fd_, reinterpret_cast<char*>(&pid), sizeof(pid), &deadline) || pid <= 0) {
+			close(sv[0]);
+			NSC_LOG_ERROR("Failed to start python worker");
+			return false;
+		}
+		w.pid = pid;
+		w.fd = sv[0];
+		w.busy = false;
+		NSC_DEBUG_MSG("Started python worker: " + str::xtos(pid));
+		return true;
+	}
+
+	void worker_pool::kill_worker(worker &w) {
+		if (w.fd != -1)
+			close(w.fd);
+		// Workers are children of (and reaped by) the spawner
+		if (w.pid > 0)
+			kill(w.pid, SIGKILL);
+		w.fd = -1;
+		w.pid = -1;
+	}
+
+	void worker_pool::stop() {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		BOOST_FOREACH(worker &w, workers_) {
+			kill_worker(w);
+		}
+		workers_.clear();
+		cond_.notify_all();
+		lock.unlock();
+		stop_spawner();
+	}
+
+	bool worker_pool::is_running() {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		return !workers_.empty();
+	}
+
+	bool worker_pool::handle_core_call(int fd, const frame &f) {
+		if (f.type == frame::core_log) {
+			if (f.code == -1)
+				core_->log(f.payload);
+			else
+				core_->log(f.code, f.target, f.aux, f.payload);
+			return true;
+		}
+		char *buffer = NULL;
+		unsigned int buffer_len = 0;
+		int code = NSCAPI::api_return_codes::hasFailed;
+		std::string result;
+		try {
+			switch (f.type) {
+			case frame::core_query:
+				code = core_->query(f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_exec:
+				code = core_->exec_command(f.target.c_str(), f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_submit:
+				code = core_->submit_message(f.target.c_str(), f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_settings:
+				code = core_->settings_query(f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_registry:
+				code = core_->registry_query(f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_storage:
+				code = core_->storage_query(f.payload.c_str(), static_cast<unsigned int>(f.payload.size()), &buffer, &buffer_len);
+				break;
+			case frame::core_expand_path:
+				result = core_->expand_path(f.payload);
+				code = NSCAPI::api_return_codes::isSuccess;
+				break;
+			case frame::core_emit_event:
+				code = core_->emit_event(f.payload.c_str(), static_cast<unsigned int>(f.payload.size()));
+				break;
+			case frame::core_reload:
+				code = core_->reload(f.target) ? NSCAPI::api_return_codes::isSuccess : NSCAPI::api_return_codes::hasFailed;
+				break;
+			default:
+				NSC_LOG_ERROR("Unexpected message from python worker: " + str::xtos(static_cast<int>(f.type)));
+				return false;
+			}
+		} catch (const std::exception &e) {
+			NSC_LOG_ERROR_EXR("python worker core call", e);
+		}
+		if (buffer != NULL) {
+			result.assign(buffer, buffer_len);
+			core_->DestroyBuffer(&buffer);
+		}
+		return write_frame(fd, frame(frame::reply, code, "", result));
+	}
+
+	bool worker_pool::execute(int index, const std::string &request, std::string &response, std::string &error) {
+		boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(timeout_);
+		std::size_t slot = 0;
+		int fd = -1;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			boost::system_time wait_until = boost::get_system_time() + boost::posix_time::seconds(timeout_);
+			while (true) {
+				if (workers_.empty()) {
+					error = "No python workers running";
+					return false;
+				}
+				bool found = false;
+				for (slot = 0; slot < workers_.size(); slot++) {
+					if (!workers_[slot].busy) {
+						found = true;
+						break;
+					}
+				}
+				if (found)
+					break;
+				if (!cond_.timed_wait(lock, wait_until)) {
+					error = "Timeout waiting for a free python worker";
+					return false;
+				}
+			}
+			workers_[slot].busy = true;
+			fd = workers_[slot].fd;
+		}
+
+		bool ok = write_frame(fd, frame(frame::query, index, "", request));
+		while (ok) {
+			long long ms = (deadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+			frame f;
+			if (ms <= 0 || !read_frame(fd, f, static_cast<int>(ms))) {
+				ok = false;
+				break;
+			}
+			if (f.type == frame::answer) {
+				response = f.payload;
+				break;
+			}
+			if (!handle_core_call(fd, f))
+				ok = false;
+		}
+
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (slot < workers_.size() && workers_[slot].fd == fd) {
+			if (!ok) {
+				// Worker is stuck or dead: replace it
+				error = "Python worker " + str::xtos(workers_[slot].pid) + " failed or timed out";
+				kill_worker(workers_[slot]);
+				lock.unlock();
+				worker w;
+				bool spawned = spawn(w);
+				lock.lock();
+				if (slot < workers_.size() && workers_[slot].fd == -1) {
+					if (spawned)
+						workers_[slot] = w;
+					else
+						workers_.erase(workers_.begin() + slot);
+				} else if (spawned) {
+					kill_worker(w);
+				}
+			} else {
+				workers_[slot].busy = false;
+			}
+		}
+		cond_.notify_all();
+		return ok;
+	}
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <nscapi/nscapi_core_wrapper.hpp>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace python_worker {
+
+	// A message on the wire: [u32 size][u8 type][i32 code][i32 aux][u32 target size][target][payload]
+	struct frame {
+		enum frame_type {
+			query = 'Q',		// parent -> worker: code = payload index, payload = QueryRequestMessage
+			answer = 'A',		// worker -> parent: payload = QueryResponseMessage::Response
+			core_query = 'q',	// worker -> parent: calls into the core
+			core_exec = 'x',
+			core_submit = 's',
+			core_settings = 'c',
+			core_registry = 'r',
+			core_storage = 't',
+			core_expand_path = 'p',
+			core_emit_event = 'e',
+			core_reload = 'd',
+			core_log = 'l',		// worker -> parent: code = level, aux = line, target = file (no reply)
+			reply = 'R'			// parent -> worker: result of a core call
+		};
+		unsigned char type;
+		int code;
+		int aux;
+		std::string target;
+		std::string payload;
+		frame() : type(0), code(0), aux(0) {}
+		frame(unsigned char type, int code, const std::string &target, const std::string &payload) : type(type), code(code), aux(0), target(target), payload(payload) {}
+	};
+
+	bool write_frame(int fd, const frame &f);
+	// timeout_ms < 0 waits forever
+	bool read_frame(int fd, frame &f, int timeout_ms = -1);
+
+	// Handles a query inside a worker: (payload index, serialized request message, serialized response)
+	typedef boost::function<void(int, const std::string&, std::string&)> query_handler;
+
+	// A pool of pre-forked copies of the process where all scripts are already loaded.
+	// Queries are sent to an idle worker and calls the scripts make into the core are proxied back to this process.
+	// The agent is forked only once (when the pool starts) into a single threaded spawner which forks the workers
+	// (including replacements) so workers never start as a copy of a process with other threads holding locks.
+	class worker_pool : public boost::noncopyable {
+		struct worker {
+			pid_t pid;
+			int fd;
+			bool busy;
+			worker() : pid(-1), fd(-1), busy(false) {}
+		};
+		nscapi::core_wrapper *core_;
+		query_handler handler_;
+		unsigned int timeout_;
+		boost::mutex mutex_;
+		boost::condition_variable cond_;
+		std::vector<worker> workers_;
+		boost::mutex spawn_mutex_;
+		pid_t spawner_pid_;
+		int spawner_fd_;
+
+	public:
+		worker_pool(nscapi::core_wrapper *core, query_handler handler, unsigned int timeout) : core_(core), handler_(handler), timeout_(timeout), spawner_pid_(-1), spawner_fd_(-1) {}
+		~worker_pool() { stop(); }
+
+		// Must be called with the GIL held
+		bool start(unsigned int count);
+		void stop();
+		bool is_running();
+
+		// Returns false if no worker could handle the request (the error is in error)
+		bool execute(int index, const std::string &request, std::string &response, std::string &error);
+
+	private:
+		bool start_spawner();
+		void stop_spawner();
+		bool spawn(worker &w);
+		void kill_worker(worker &w);
+		bool handle_core_call(int fd, const frame &f);
+	};
+}
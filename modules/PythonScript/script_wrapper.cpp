@@ -611,6 +611,8 @@ void build_metrics(py::dict &metrics, const PB::Metrics::MetricsBundle &b, const
 			metrics[p + "." + v.key()] = v.string_value().value();
 		else if (v.has_gauge_value())
 			metrics[p + "." + v.key()] = str::xtos(v.gauge_value().value());
+		else if (v.has_counter_value())
+			metrics[p + "." + v.key()] = str::xtos(v.counter_value().value());
 	}
 }
 
@@ -114,6 +114,7 @@ void SMTPClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool SMTPClient::unloadModule() {
+	client_.stop();
 	client_.clear();
 	return true;
 }
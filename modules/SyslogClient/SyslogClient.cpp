@@ -36,7 +36,9 @@
  * Default c-tor
  * @return
  */
-SyslogClient::SyslogClient() : client_("syslog", boost::make_shared<syslog_client::syslog_client_handler>(), boost::make_shared<syslog_handler::options_reader_impl>()) {}
+SyslogClient::SyslogClient()
+	: handler_(boost::make_shared<syslog_client::syslog_client_handler>())
+	, client_("syslog", handler_, boost::make_shared<syslog_handler::options_reader_impl>()) {}
 
 /**
  * Default d-tor
@@ -166,6 +168,8 @@ void SyslogClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool SyslogClient::unloadModule() {
+	client_.stop();
+	handler_->stop();
 	client_.clear();
 	return true;
 }
@@ -182,4 +186,10 @@ bool SyslogClient::commandLineExec(const int target_mode, const PB::Commands::Ex
 
 void SyslogClient::handleNotification(const std::string &, const PB::Commands::SubmitRequestMessage &request_message, PB::Commands::SubmitResponseMessage *response_message) {
 	client_.do_submit(request_message, *response_message);
-}
\ No newline at end of file
+}
+
+void SyslogClient::fetchMetrics(PB::Metrics::MetricsMessage::Response *response) {
+	PB::Metrics::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("syslog");
+	handler_->add_metrics(bundle);
+}
@@ -25,6 +25,8 @@
 
 #include <client/command_line_parser.hpp>
 
+#include "syslog_client.hpp"
+
 namespace po = boost::program_options;
 namespace sh = nscapi::settings_helper;
 
@@ -34,6 +36,7 @@ private:
 	std::string channel_;
 	std::string hostname_;
 
+	boost::shared_ptr<syslog_client::syslog_client_handler> handler_;
 	client::configuration client_;
 
 public:
@@ -46,6 +49,7 @@ public:
 	void query_fallback(const PB::Commands::QueryRequestMessage &request_message, PB::Commands::QueryResponseMessage &response_message);
 	bool commandLineExec(const int target_mode, const PB::Commands::ExecuteRequestMessage &request, PB::Commands::ExecuteResponseMessage &response);
 	void handleNotification(const std::string &channel, const PB::Commands::SubmitRequestMessage &request_message, PB::Commands::SubmitResponseMessage *response_message);
+	void fetchMetrics(PB::Metrics::MetricsMessage::Response *response);
 
 private:
 	void add_command(std::string key, std::string args);
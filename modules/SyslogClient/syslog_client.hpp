@@ -27,9 +27,13 @@
 #include <str/format.hpp>
 
 #include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "syslog_sender.hpp"
 
 namespace syslog_client {
-	struct connection_data : public socket_helpers::connection_info {
+	struct connection_data : public transport_info {
 		std::string severity;
 		std::string facility;
 		std::string tag_syntax;
@@ -61,6 +65,19 @@ namespace syslog_client {
 			port_ = arguments.address.get_port_string("514");
 			timeout = arguments.get_int_data("timeout", 30);
 			retry = arguments.get_int_data("retry", 3);
+			protocol = parse_protocol(arguments.get_string_data("protocol", "udp"));
+			spool_size = arguments.get_int_data("spool size", 10000);
+			batch_size = arguments.get_int_data("batch size", 256);
+			if (protocol == protocol_tls) {
+				ssl.enabled = true;
+				ssl.certificate = arguments.get_string_data("certificate");
+				ssl.certificate_key = arguments.get_string_data("certificate key");
+				ssl.certificate_key_format = arguments.get_string_data("certificate format");
+				ssl.ca_path = arguments.get_string_data("ca");
+				ssl.allowed_ciphers = arguments.get_string_data("allowed ciphers");
+				ssl.dh_key = arguments.get_string_data("dh");
+				ssl.verify_mode = arguments.get_string_data("verify mode");
+			}
 			severity = arguments.data["severity"];
 			facility = arguments.data["facility"];
 			tag_syntax = arguments.data["tag template"];
@@ -107,7 +124,7 @@ namespace syslog_client {
 
 		std::string to_string() const {
 			std::stringstream ss;
-			ss << "host: " << get_endpoint_string();
+			ss << "host: " << get_key();
 			ss << ", severity: " << severity;
 			ss << ", facility: " << facility;
 			ss << ", tag_syntax: " << tag_syntax;
@@ -121,41 +138,62 @@ namespace syslog_client {
 		std::string value;
 	};
 
-	struct syslog_client_handler : public client::handler_interface {
+	struct syslog_client_handler : public client::handler_interface, public boost::noncopyable {
+	private:
+		boost::mutex mutex_;
+		std::map<std::string, sender_type> senders_;
+
+	public:
+		~syslog_client_handler() {
+			stop();
+		}
+
 		bool query(client::destination_container sender, client::destination_container target, const PB::Commands::QueryRequestMessage &request_message, PB::Commands::QueryResponseMessage &response_message) {
 			return false;
 		}
 
 		bool submit(client::destination_container sender, client::destination_container target, const PB::Commands::SubmitRequestMessage &request_message, PB::Commands::SubmitResponseMessage &response_message) {
 			const PB::Common::Header& request_header = request_message.header();
-			connection_data con(sender, target);
-
 			nscapi::protobuf::functions::make_return_header(response_message.mutable_header(), request_header);
+			PB::Commands::SubmitResponseMessage::Response *payload = response_message.add_payload();
 
-			std::list<std::string> messages;
+			try {
+				connection_data con(target, sender);
+				sender_type s = get_sender(con);
 
-			BOOST_FOREACH(const ::PB::Commands::QueryResponseMessage_Response &p, request_message.payload()) {
 				boost::posix_time::ptime now = boost::posix_time::second_clock::local_time();
 				std::string date = str::format::format_date(now, "%b %e %H:%M:%S");
-				std::string tag = con.tag_syntax;
-				std::string message = con.message_syntax;
-				std::string nagios_msg = nscapi::protobuf::functions::query_data_to_nagios_string(p, nscapi::protobuf::functions::no_truncation);
-				str::utils::replace(message, "%message%", nagios_msg);
-				str::utils::replace(tag, "%message%", nagios_msg);
-
-				std::string severity = con.severity;
-				if (p.result() == PB::Common::ResultCode::OK)
-					severity = con.ok_severity;
-				if (p.result() == PB::Common::ResultCode::WARNING)
-					severity = con.warn_severity;
-				if (p.result() == PB::Common::ResultCode::CRITICAL)
-					severity = con.crit_severity;
-				if (p.result() == PB::Common::ResultCode::UNKNOWN)
-					severity = con.unknown_severity;
-
-				messages.push_back(con.parse_priority(severity, con.facility) + date + " " + tag + " " + message);
+				std::size_t count = 0, dropped = 0;
+				BOOST_FOREACH(const ::PB::Commands::QueryResponseMessage_Response &p, request_message.payload()) {
+					std::string tag = con.tag_syntax;
+					std::string message = con.message_syntax;
+					std::string nagios_msg = nscapi::protobuf::functions::query_data_to_nagios_string(p, nscapi::protobuf::functions::no_truncation);
+					str::utils::replace(message, "%message%", nagios_msg);
+					str::utils::replace(tag, "%message%", nagios_msg);
+
+					std::string severity = con.severity;
+					if (p.result() == PB::Common::ResultCode::OK)
+						severity = con.ok_severity;
+					if (p.result() == PB::Common::ResultCode::WARNING)
+						severity = con.warn_severity;
+					if (p.result() == PB::Common::ResultCode::CRITICAL)
+						severity = con.crit_severity;
+					if (p.result() == PB::Common::ResultCode::UNKNOWN)
+						severity = con.unknown_severity;
+
+					count++;
+					if (!s->enqueue(con.parse_priority(severity, con.facility) + date + " " + tag + " " + message))
+						dropped++;
+				}
+				if (dropped > 0)
+					nscapi::protobuf::functions::set_response_bad(*payload, "Dropped " + str::xtos(dropped) + " of " + str::xtos(count) + " messages: queue for " + con.get_key() + " is full");
+				else
+					nscapi::protobuf::functions::set_response_good(*payload, "Queued " + str::xtos(count) + " messages");
+			} catch (const std::exception &e) {
+				nscapi::protobuf::functions::set_response_bad(*payload, "Error: " + utf8::utf8_from_native(e.what()));
+			} catch (...) {
+				nscapi::protobuf::functions::set_response_bad(*payload, "Unknown error -- REPORT THIS!");
 			}
-			send(response_message.add_payload(), con, messages);
 			return true;
 		}
 
@@ -167,31 +205,40 @@ namespace syslog_client {
 			return false;
 		}
 
+		// Sends what is queued and stops all senders
+		void stop() {
+			std::map<std::string, sender_type> senders;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				senders.swap(senders_);
+			}
+			typedef std::map<std::string, sender_type>::value_type sender_entry;
+			BOOST_FOREACH(const sender_entry &e, senders) {
+				e.second->stop();
+			}
+		}
 
-		void send(PB::Commands::SubmitResponseMessage::Response *payload, connection_data con, const std::list<std::string> &messages) {
-			try {
-				NSC_DEBUG_MSG_STD("Connection details: " + con.to_string());
-
-				boost::asio::io_service io_service;
-				boost::asio::ip::udp::resolver resolver(io_service);
-				boost::asio::ip::udp::resolver::query query(boost::asio::ip::udp::v4(), con.address, con.get_port());
-				boost::asio::ip::udp::endpoint receiver_endpoint = *resolver.resolve(query);
-
-				boost::asio::ip::udp::socket socket(io_service);
-				socket.open(boost::asio::ip::udp::v4());
-
-				BOOST_FOREACH(const std::string msg, messages) {
-					NSC_DEBUG_MSG_STD("Sending data: " + msg);
-					socket.send_to(boost::asio::buffer(msg), receiver_endpoint);
-				}
-				nscapi::protobuf::functions::set_response_good(*payload, "Data presumably sent successfully");
-			} catch (const std::runtime_error &e) {
-				nscapi::protobuf::functions::set_response_bad(*payload, "Socket error: " + utf8::utf8_from_native(e.what()));
-			} catch (const std::exception &e) {
-				nscapi::protobuf::functions::set_response_bad(*payload, "Error: " + utf8::utf8_from_native(e.what()));
-			} catch (...) {
-				nscapi::protobuf::functions::set_response_bad(*payload, "Unknown error -- REPORT THIS!");
+		void add_metrics(PB::Metrics::MetricsBundle *bundle) {
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			typedef std::map<std::string, sender_type>::value_type sender_entry;
+			BOOST_FOREACH(const sender_entry &e, senders_) {
+				PB::Metrics::MetricsBundle *b = bundle->add_children();
+				b->set_key(e.first);
+				e.second->add_metrics(b);
 			}
 		}
+
+	private:
+		sender_type get_sender(const connection_data &con) {
+			std::string key = con.get_key();
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			std::map<std::string, sender_type>::const_iterator it = senders_.find(key);
+			if (it != senders_.end())
+				return it->second;
+			NSC_DEBUG_MSG_STD("Connection details: " + con.to_string());
+			sender_type s(new sender(con));
+			senders_[key] = s;
+			return s;
+		}
 	};
-}
\ No newline at end of file
+}
@@ -46,6 +46,9 @@ namespace syslog_handler {
 			set_property_string("warning severity", "warning");
 			set_property_string("critical severity", "critical");
 			set_property_string("unknown severity", "emergency");
+			set_property_string("protocol", "udp");
+			set_property_int("spool size", 10000);
+			set_property_int("batch size", 256);
 		}
 		syslog_target_object(const nscapi::settings_objects::object_instance other, std::string alias, std::string path) : parent(other, alias, path) {}
 
@@ -83,7 +86,18 @@ namespace syslog_handler {
 
 				("unknown severity", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "unknown severity", _1), "emergency"),
 					"TODO", "")
+
+				("protocol", sh::string_fun_key(boost::bind(&parent::set_property_string, this, "protocol", _1), "udp"),
+					"PROTOCOL", "Transport to use: udp, tcp or tls (tcp and tls use a persistent connection with octet counting framing as in RFC 5425).")
+
+				("spool size", sh::int_fun_key(boost::bind(&parent::set_property_int, this, "spool size", _1), 10000),
+					"SPOOL SIZE", "Number of messages kept while the server is unreachable, when full the oldest messages are dropped.", true)
+
+				("batch size", sh::int_fun_key(boost::bind(&parent::set_property_int, this, "batch size", _1), 256),
+					"BATCH SIZE", "Maximum number of messages written to the server in one go.", true)
 				;
+
+			add_ssl_keys(root_path);
 		}
 	};
 
@@ -123,6 +137,15 @@ namespace syslog_handler {
 				("message template", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, data, "message template", _1)),
 					"Message template (TODO)")
 
+				("protocol", po::value<std::string>()->notifier(boost::bind(&client::destination_container::set_string_data, &data, "protocol", _1)),
+					"Transport to use: udp, tcp or tls")
+
+				("spool-size", po::value<unsigned int>()->notifier(boost::bind(&client::destination_container::set_int_data, &data, "spool size", _1)),
+					"Number of messages kept while the server is unreachable")
+
+				("batch-size", po::value<unsigned int>()->notifier(boost::bind(&client::destination_container::set_int_data, &data, "batch size", _1)),
+					"Maximum number of messages written in one go")
+
 				;
 		}
 	};
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "syslog_sender.hpp"
+
+#include <nscapi/nscapi_helper_singleton.hpp>
+#include <nscapi/macros.hpp>
+
+#include <metrics/latency_histogram.hpp>
+#include <str/xtos.hpp>
+#include <utf8.hpp>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace {
+	const int max_backoff = 60;
+
+	void set_result(boost::optional<boost::system::error_code> *result, const boost::system::error_code &ec) {
+		result->reset(ec);
+	}
+	template<class iterator_type>
+	void set_resolved(boost::optional<boost::system::error_code> *result, iterator_type *out, const boost::system::error_code &ec, iterator_type it) {
+		*out = it;
+		result->reset(ec);
+	}
+	template<class stream_type>
+	void close_stream(stream_type *stream) {
+		boost::system::error_code ignored;
+		stream->lowest_layer().close(ignored);
+	}
+	template<class resolver_type>
+	void cancel_resolve(resolver_type *resolver) {
+		resolver->cancel();
+	}
+}
+
+syslog_client::transport_info::protocol_type syslog_client::transport_info::parse_protocol(const std::string &protocol) {
+	std::string p = boost::algorithm::to_lower_copy(protocol);
+	if (p.empty() || p == "udp")
+		return protocol_udp;
+	if (p == "tcp")
+		return protocol_tcp;
+	if (p == "tls" || p == "ssl") {
+#ifndef USE_SSL
+		throw socket_helpers::socket_exception("TLS is not available (compiled without USE_SSL)");
+#endif
+		return protocol_tls;
+	}
+	throw socket_helpers::socket_exception("Invalid protocol: " + protocol + " (should be udp, tcp or tls)");
+}
+
+std::string syslog_client::transport_info::get_protocol_string() const {
+	if (protocol == protocol_tcp)
+		return "tcp";
+	if (protocol == protocol_tls)
+		return "tls";
+	return "udp";
+}
+
+syslog_client::sender::sender(const transport_info &info)
+	: info_(info)
+	, head_(NULL)
+	, queued_(0)
+	, sent_(0)
+	, dropped_(0)
+	, bytes_(0)
+	, errors_(0)
+	, connects_(0)
+	, spooled_(0)
+	, stop_(false)
+	, connected_(false)
+	, backoff_(0)
+	, retry_at_(boost::get_system_time()) {
+	if (info_.spool_size == 0)
+		info_.spool_size = 1;
+	if (info_.batch_size == 0)
+		info_.batch_size = 1;
+	thread_.reset(new boost::thread(boost::bind(&sender::thread_proc, this)));
+}
+
+syslog_client::sender::~sender() {
+	stop();
+	node *n = head_.exchange(NULL);
+	while (n != NULL) {
+		node *next = n->next;
+		delete n;
+		n = next;
+	}
+}
+
+bool syslog_client::sender::enqueue(const std::string &message) {
+	if (queued_.fetch_add(1) >= info_.spool_size) {
+		queued_--;
+		dropped_++;
+		return false;
+	}
+	node *n = new node(message);
+	node *old = head_.load();
+	do {
+		n->next = old;
+	} while (!head_.compare_exchange_weak(old, n));
+	if (old == NULL) {
+		// The sender might be waiting for the list to become non empty
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		cond_.notify_one();
+	}
+	return true;
+}
+
+void syslog_client::sender::stop() {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		stop_ = true;
+		cond_.notify_all();
+	}
+	if (thread_) {
+		thread_->join();
+		thread_.reset();
+	}
+}
+
+void syslog_client::sender::thread_proc() {
+	while (true) {
+		bool stopping = false;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			while (!stop_ && !has_queued()) {
+				if (spool_.empty())
+					cond_.wait(lock);
+				else if (!cond_.timed_wait(lock, retry_at_))
+					break;
+			}
+			stopping = stop_;
+		}
+		take_queued();
+		// When stopping make one last attempt even if we are backing off
+		if (!spool_.empty() && (stopping || boost::get_system_time() >= retry_at_))
+			flush();
+		if (stopping)
+			break;
+	}
+	disconnect();
+	dropped_ += spool_.size();
+	spool_.clear();
+	spooled_ = 0;
+}
+
+void syslog_client::sender::take_queued() {
+	node *n = head_.exchange(NULL);
+	// The list is newest first
+	node *first = NULL;
+	while (n != NULL) {
+		node *next = n->next;
+		n->next = first;
+		first = n;
+		n = next;
+	}
+	std::size_t count = 0;
+	while (first != NULL) {
+		spool_.push_back(std::string());
+		spool_.back().swap(first->message);
+		node *next = first->next;
+		delete first;
+		first = next;
+		count++;
+	}
+	queued_ -= count;
+	while (spool_.size() > info_.spool_size) {
+		spool_.pop_front();
+		dropped_++;
+	}
+	spooled_ = spool_.size();
+}
+
+void syslog_client::sender::flush() {
+	if (!connected_ && !connect()) {
+		errors_++;
+	} else {
+		while (!spool_.empty()) {
+			std::size_t count = std::min(spool_.size(), info_.batch_size);
+			if (!write_batch(count)) {
+				errors_++;
+				disconnect();
+				break;
+			}
+			for (std::size_t i = 0; i < count; i++) {
+				bytes_ += spool_.front().size();
+				spool_.pop_front();
+			}
+			sent_ += count;
+		}
+		spooled_ = spool_.size();
+		if (spool_.empty()) {
+			if (backoff_ > 0)
+				NSC_DEBUG_MSG("Reconnected to " + info_.get_key());
+			backoff_ = 0;
+			return;
+		}
+	}
+	if (backoff_ == 0)
+		NSC_LOG_ERROR("Failed to send to " + info_.get_key() + ", spooling messages and retrying");
+	backoff_ = backoff_ == 0 ? 1 : std::min(backoff_ * 2, max_backoff);
+	retry_at_ = boost::get_system_time() + boost::posix_time::seconds(backoff_);
+}
+
+// Runs the io service until the pending operation has completed. If the timeout passes first the operation is
+// cancelled (closing the socket aborts it) and the result is a timed_out error.
+bool syslog_client::sender::wait(result_type &result, boost::function<void()> cancel) {
+	result_type timer_result;
+	bool timed_out = false;
+	boost::asio::deadline_timer timer(io_service_);
+	timer.expires_from_now(boost::posix_time::seconds(info_.timeout > 0 ? info_.timeout : 30));
+	timer.async_wait(boost::bind(&set_result, &timer_result, _1));
+	io_service_.reset();
+	while (!result && io_service_.run_one()) {
+		if (timer_result && !timed_out && !result) {
+			timed_out = true;
+			cancel();
+		}
+	}
+	timer.cancel();
+	// Let the cancelled handlers run so nothing refers to the stack of this call
+	io_service_.run();
+	if (timed_out)
+		result = boost::asio::error::timed_out;
+	return result && !*result;
+}
+
+template<class protocol_type>
+typename protocol_type::resolver::iterator syslog_client::sender::resolve() {
+	typedef typename protocol_type::resolver resolver_type;
+	resolver_type resolver(io_service_);
+	typename resolver_type::query query(info_.get_address(), info_.get_port());
+	typename resolver_type::iterator endpoints;
+	result_type result;
+	resolver.async_resolve(query, boost::bind(&set_resolved<typename resolver_type::iterator>, &result, &endpoints, _1, _2));
+	if (!wait(result, boost::bind(&cancel_resolve<resolver_type>, &resolver)))
+		throw boost::system::system_error(*result);
+	return endpoints;
+}
+
+bool syslog_client::sender::connect() {
+	try {
+		if (info_.protocol == transport_info::protocol_udp) {
+			udp_endpoint_ = *resolve<boost::asio::ip::udp>();
+			udp_socket_.reset(new boost::asio::ip::udp::socket(io_service_));
+			udp_socket_->open(udp_endpoint_.protocol());
+		} else {
+			boost::asio::ip::tcp::resolver::iterator endpoints = resolve<boost::asio::ip::tcp>();
+			result_type result;
+#ifdef USE_SSL
+			if (info_.protocol == transport_info::protocol_tls) {
+#if BOOST_VERSION >= 106800
+				ssl_context_.reset(new boost::asio::ssl::context(boost::asio::ssl::context::sslv23));
+#else
+				ssl_context_.reset(new boost::asio::ssl::context(io_service_, boost::asio::ssl::context::sslv23));
+#endif
+				std::list<std::string> errors;
+				info_.ssl.configure_ssl_context(*ssl_context_, errors);
+				BOOST_FOREACH(const std::string &e, errors) {
+					NSC_LOG_ERROR(e);
+				}
+				typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_stream;
+				ssl_socket_.reset(new ssl_stream(io_service_, *ssl_context_));
+				boost::asio::async_connect(ssl_socket_->lowest_layer(), endpoints, boost::bind(&set_result, &result, _1));
+				if (!wait(result, boost::bind(&close_stream<ssl_stream>, ssl_socket_.get())))
+					throw boost::system::system_error(*result);
+				result.reset();
+				ssl_socket_->async_handshake(boost::asio::ssl::stream_base::client, boost::bind(&set_result, &result, _1));
+				if (!wait(result, boost::bind(&close_stream<ssl_stream>, ssl_socket_.get())))
+					throw boost::system::system_error(*result);
+			} else
+#endif
+			{
+				tcp_socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
+				boost::asio::async_connect(*tcp_socket_, endpoints, boost::bind(&set_result, &result, _1));
+				if (!wait(result, boost::bind(&close_stream<boost::asio::ip::tcp::socket>, tcp_socket_.get())))
+					throw boost::system::system_error(*result);
+			}
+		}
+	} catch (const std::exception &e) {
+		if (backoff_ == 0)
+			NSC_LOG_ERROR("Failed to connect to " + info_.get_key() + ": " + utf8::utf8_from_native(e.what()));
+		disconnect();
+		return false;
+	}
+	connected_ = true;
+	connects_++;
+	return true;
+}
+
+void syslog_client::sender::disconnect() {
+	boost::system::error_code ignored;
+	if (udp_socket_)
+		udp_socket_->close(ignored);
+	if (tcp_socket_)
+		tcp_socket_->close(ignored);
+	udp_socket_.reset();
+	tcp_socket_.reset();
+#ifdef USE_SSL
+	if (ssl_socket_)
+		ssl_socket_->lowest_layer().close(ignored);
+	ssl_socket_.reset();
+	ssl_context_.reset();
+#endif
+	connected_ = false;
+}
+
+bool syslog_client::sender::write_batch(std::size_t count) {
+	if (udp_socket_) {
+		// One message per datagram (RFC 5426)
+		for (std::size_t i = 0; i < count; i++) {
+			boost::system::error_code error;
+			udp_socket_->send_to(boost::asio::buffer(spool_[i]), udp_endpoint_, 0, error);
+			if (error) {
+				NSC_DEBUG_MSG("Failed to send to " + info_.get_key() + ": " + utf8::utf8_from_native(error.message()));
+				return false;
+			}
+		}
+		return true;
+	}
+#ifdef USE_SSL
+	if (ssl_socket_)
+		return write_frames(*ssl_socket_, count);
+#endif
+	if (tcp_socket_)
+		return write_frames(*tcp_socket_, count);
+	return false;
+}
+
+template<class stream_type>
+bool syslog_client::sender::write_frames(stream_type &stream, std::size_t count) {
+	// Octet counting: "<length> <message>" where the length prefixes are kept in one buffer
+	frames_.clear();
+	for (std::size_t i = 0; i < count; i++) {
+		frames_ += str::xtos(spool_[i].size());
+		frames_ += ' ';
+	}
+	buffers_.clear();
+	std::size_t pos = 0;
+	for (std::size_t i = 0; i < count; i++) {
+		std::size_t end = frames_.find(' ', pos) + 1;
+		buffers_.push_back(boost::asio::buffer(frames_.data() + pos, end - pos));
+		buffers_.push_back(boost::asio::buffer(spool_[i]));
+		pos = end;
+	}
+	result_type result;
+	boost::asio::async_write(stream, buffers_, boost::bind(&set_result, &result, _1));
+	if (!wait(result, boost::bind(&close_stream<stream_type>, &stream))) {
+		NSC_DEBUG_MSG("Failed to send to " + info_.get_key() + ": " + utf8::utf8_from_native(result->message()));
+		return false;
+	}
+	return true;
+}
+
+void syslog_client::sender::add_metrics(PB::Metrics::MetricsBundle *bundle) const {
+	metrics::add_gauge(bundle, "queued", queued_.load());
+	metrics::add_gauge(bundle, "spooled", spooled_.load());
+	metrics::add_counter(bundle, "sent", sent_.load());
+	metrics::add_counter(bundle, "bytes", bytes_.load());
+	metrics::add_counter(bundle, "dropped", dropped_.load());
+	metrics::add_counter(bundle, "errors", errors_.load());
+	metrics::add_counter(bundle, "connects", connects_.load());
+}
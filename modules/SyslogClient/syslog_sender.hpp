@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <socket/socket_helpers.hpp>
+
+#include <nscapi/nscapi_protobuf_metrics.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#ifdef USE_SSL
+#include <boost/asio/ssl.hpp>
+#endif
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace syslog_client {
+
+	struct transport_info : public socket_helpers::connection_info {
+		enum protocol_type {
+			protocol_udp,
+			protocol_tcp,
+			protocol_tls
+		};
+		protocol_type protocol;
+		// Messages kept while the server is unreachable (the oldest are dropped)
+		std::size_t spool_size;
+		// Messages written in one go (one datagram per message for UDP, one writev for TCP/TLS)
+		std::size_t batch_size;
+
+		transport_info() : protocol(protocol_udp), spool_size(10000), batch_size(256) {}
+
+		static protocol_type parse_protocol(const std::string &protocol);
+		std::string get_protocol_string() const;
+		// Identifies the server so targets sending to the same server share a sender
+		std::string get_key() const {
+			return get_protocol_string() + "://" + get_endpoint_string();
+		}
+	};
+
+	/**
+	 * Ships syslog messages to one server from a background thread.
+	 *
+	 * Callers push messages onto a lock free list (they only take a lock to wake the sender when the list was
+	 * empty) and the sender takes everything queued at once. UDP sends one datagram per message, TCP and TLS
+	 * use a persistent stream with octet counting framing (RFC 5425/6587) and write each batch with a single
+	 * gathered write. When the server is unreachable messages are spooled (bounded) and the sender reconnects
+	 * with a backoff. Resolving, connecting, the TLS handshake and writes are asynchronous operations which are
+	 * aborted after the configured timeout so a dead server can not block the sender (or stopping it).
+	 */
+	class sender : boost::noncopyable {
+		struct node {
+			std::string message;
+			node *next;
+			node(const std::string &message) : message(message), next(NULL) {}
+		};
+
+		transport_info info_;
+
+		boost::atomic<node*> head_;
+		boost::atomic<std::size_t> queued_;
+
+		boost::atomic<unsigned long long> sent_;
+		boost::atomic<unsigned long long> dropped_;
+		boost::atomic<unsigned long long> bytes_;
+		boost::atomic<unsigned long long> errors_;
+		boost::atomic<unsigned long long> connects_;
+		boost::atomic<std::size_t> spooled_;
+
+		boost::mutex mutex_;
+		boost::condition_variable cond_;
+		bool stop_;
+		boost::shared_ptr<boost::thread> thread_;
+
+		// Only used from the sender thread
+		std::deque<std::string> spool_;
+		boost::asio::io_service io_service_;
+		boost::shared_ptr<boost::asio::ip::udp::socket> udp_socket_;
+		boost::asio::ip::udp::endpoint udp_endpoint_;
+		boost::shared_ptr<boost::asio::ip::tcp::socket> tcp_socket_;
+#ifdef USE_SSL
+		boost::shared_ptr<boost::asio::ssl::context> ssl_context_;
+		boost::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket> > ssl_socket_;
+#endif
+		bool connected_;
+		int backoff_;
+		boost::posix_time::ptime retry_at_;
+		std::string frames_;
+		std::vector<boost::asio::const_buffer> buffers_;
+
+	public:
+		sender(const transport_info &info);
+		~sender();
+
+		// Never blocks, returns false if the message was dropped (too many messages queued)
+		bool enqueue(const std::string &message);
+		// Makes a last attempt (bounded by the timeout) to send what is queued and stops the sender thread
+		void stop();
+		void add_metrics(PB::Metrics::MetricsBundle *bundle) const;
+		const transport_info& get_info() const {
+			return info_;
+		}
+
+	private:
+		void thread_proc();
+		bool has_queued() const {
+			return head_.load() != NULL;
+		}
+		void take_queued();
+		void flush();
+		bool connect();
+		void disconnect();
+		typedef boost::optional<boost::system::error_code> result_type;
+		bool wait(result_type &result, boost::function<void()> cancel);
+		template<class protocol_type>
+		typename protocol_type::resolver::iterator resolve();
+		bool write_batch(std::size_t count);
+		template<class stream_type>
+		bool write_frames(stream_type &stream, std::size_t count);
+	};
+	typedef boost::shared_ptr<sender> sender_type;
+}
@@ -50,6 +50,7 @@
 #include <str/format.hpp>
 
 #include <socket/socket_helpers.hpp>
+#include <metrics/latency_histogram.hpp>
 
 #include <json_spirit.h>
 
@@ -85,8 +86,14 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	std::string certificate;
 	std::string admin_password;
 	int threads;
+	std::size_t log_size;
+	unsigned int token_ttl, credential_ttl;
+	std::size_t max_tokens;
+	int keep_alive_timeout, keep_alive_requests;
+	bool compress;
 
 	role_map roles;
+	role_map cached_queries;
 
 	std::string role_path = settings.alias().get_settings_path("roles");
 	std::string user_path = settings.alias().get_settings_path("users");
@@ -103,13 +110,37 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 		("roles", sh::string_map_path(&roles)
 		, "Web server roles", "A list of roles and with coma separated list of access rights.")
 
+		("cached queries", sh::string_map_path(&cached_queries)
+		, "Cached queries", "Queries whose results (when executed through the REST API) are cached and shared between clients. The key is the query (or * for all queries) and the value the number of seconds a result is used. Concurrent identical requests for a cached query only execute it once.")
+
 		;
 	settings.alias().add_key_to_settings()
 		("port", sh::string_key(&port, "8443"),
 		"Server port", "Port to use for WEB server.")
 
 		("threads", sh::int_key(&threads, 10),
-		"Server threads", "The number of threads in the sever response pool.")
+		"Server threads", "The number of threads in the sever response pool (a quarter of them can be used by clients waiting for new log entries).")
+
+		("log size", sh::size_key(&log_size, 5000),
+		"Log size", "The number of log messages to keep for the web UI and REST API (older messages are dropped).")
+
+		("token ttl", sh::uint_key(&token_ttl, 3600),
+		"Token TTL", "Number of seconds a token can be left unused before it expires (0 means never).", true)
+
+		("max tokens", sh::size_key(&max_tokens, 10000),
+		"Max tokens", "The maximum number of tokens to keep, the least recently used are revoked first.", true)
+
+		("credential cache ttl", sh::uint_key(&credential_ttl, 30),
+		"Credential cache TTL", "Number of seconds a verified password (or basic authentication header) is remembered so it does not have to be checked again on every request (0 to disable).", true)
+
+		("keep alive timeout", sh::int_key(&keep_alive_timeout, 15),
+		"Keep alive timeout", "Number of seconds an idle (keep-alive) connection is kept open waiting for the next request (0 closes the connection after each response).", true)
+
+		("keep alive requests", sh::int_key(&keep_alive_requests, 100),
+		"Keep alive requests", "The maximum number of requests served over a single connection.", true)
+
+		("compress responses", sh::bool_key(&compress, true),
+		"Compress responses", "Compress responses (gzip or deflate) for clients which accept it.", true)
 		;
 	settings.alias().add_key_to_settings()
 		("certificate", sh::string_key(&certificate, "${certificate-path}/certificate.pem"),
@@ -133,6 +164,15 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	settings.register_all();
 	settings.notify();
 	certificate = get_core()->expand_path(certificate);
+	log_handler->set_capacity(log_size);
+	session->get_log_data()->set_capacity(log_size);
+	// Long polling for log entries can use at most a quarter of the server threads
+	session->get_log_data()->set_max_waiters(std::max(threads / 4, 1));
+	session->set_token_limits(token_ttl, max_tokens, credential_ttl);
+	session->get_query_cache().clear();
+	BOOST_FOREACH(const role_map::value_type &v, cached_queries) {
+		session->get_query_cache().set_max_age(v.first, str::stox<unsigned int>(v.second, 0));
+	}
 
 	users_.add_samples(nscapi::settings_proxy::create(get_id(), get_core()));
 
@@ -165,6 +205,8 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 		session->add_user("admin", "full", admin_password);
 
 		server.reset(Mongoose::Server::make_server(port));
+		server->setKeepAlive(keep_alive_timeout, keep_alive_requests);
+		server->setCompression(compress, 512);
 		if (!boost::filesystem::is_regular_file(certificate)) {
 			NSC_LOG_ERROR("Certificate not found (disabling SSL): " + certificate);
 		} else {
@@ -629,6 +671,35 @@ bool WEBServer::password(const PB::Commands::ExecuteRequestMessage::Request &req
 	return true;
 }
 
+// Metric names can only contain [a-zA-Z0-9_:] (command, module and channel names often contain other things)
+std::string openmetrics_name(const std::string &name) {
+	std::string ret = name;
+	BOOST_FOREACH(char &c, ret) {
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':'))
+			c = '_';
+	}
+	return ret;
+}
+
+void build_histogram(json_spirit::Object &node, json_spirit::Object &metrics_list, std::list<std::string> &openmetrics, const std::string trail, const std::string opentrail, const PB::Metrics::Metric &v) {
+	const PB::Metrics::Histogram &h = v.histogram_value();
+	json_spirit::Object histogram;
+	histogram.insert(json_spirit::Object::value_type("count", static_cast<boost::uint64_t>(h.sample_count())));
+	histogram.insert(json_spirit::Object::value_type("sum", h.sample_sum()));
+	node.insert(json_spirit::Object::value_type(v.key(), histogram));
+	metrics_list.insert(json_spirit::Object::value_type(trail + "." + v.key() + ".count", static_cast<boost::uint64_t>(h.sample_count())));
+	metrics_list.insert(json_spirit::Object::value_type(trail + "." + v.key() + ".sum", h.sample_sum()));
+
+	std::string name = openmetrics_name(opentrail + "_" + v.key());
+	openmetrics.push_back("# TYPE " + name + " histogram");
+	BOOST_FOREACH(const PB::Metrics::Bucket &bucket, h.bucket()) {
+		openmetrics.push_back(name + "_bucket{le=\"" + str::xtos(bucket.upper_bound()) + "\"} " + str::xtos(bucket.cumulative_count()));
+	}
+	openmetrics.push_back(name + "_bucket{le=\"+Inf\"} " + str::xtos(static_cast<boost::uint64_t>(h.sample_count())));
+	openmetrics.push_back(name + "_sum " + str::xtos(h.sample_sum()));
+	openmetrics.push_back(name + "_count " + str::xtos(static_cast<boost::uint64_t>(h.sample_count())));
+}
+
 void build_metrics(json_spirit::Object &metrics, json_spirit::Object &metrics_list, std::list<std::string> &openmetrics, const std::string trail, const std::string opentrail, const PB::Metrics::MetricsBundle & b) {
 	json_spirit::Object node;
 	BOOST_FOREACH(const PB::Metrics::MetricsBundle &b2, b.children()) {
@@ -638,14 +709,39 @@ void build_metrics(json_spirit::Object &metrics, json_spirit::Object &metrics_li
 		if (v.has_gauge_value()) {
 			node.insert(json_spirit::Object::value_type(v.key(), v.gauge_value().value()));
 			metrics_list.insert(json_spirit::Object::value_type(trail + "." + v.key(), v.gauge_value().value()));
-			openmetrics.push_back(opentrail + "_" + v.key() + " " + str::xtos(v.gauge_value().value()));
+			openmetrics.push_back(openmetrics_name(opentrail + "_" + v.key()) + " " + str::xtos(v.gauge_value().value()));
+		} else if (v.has_counter_value()) {
+			node.insert(json_spirit::Object::value_type(v.key(), v.counter_value().value()));
+			metrics_list.insert(json_spirit::Object::value_type(trail + "." + v.key(), v.counter_value().value()));
+			std::string name = openmetrics_name(opentrail + "_" + v.key());
+			openmetrics.push_back("# TYPE " + name + " counter");
+			openmetrics.push_back(name + "_total " + str::xtos(v.counter_value().value()));
 		} else if (v.has_string_value()) {
 			node.insert(json_spirit::Object::value_type(v.key(), v.string_value().value()));
 			metrics_list.insert(json_spirit::Object::value_type(trail + "." + v.key(), v.string_value().value()));
+		} else if (v.has_histogram_value()) {
+			build_histogram(node, metrics_list, openmetrics, trail, opentrail, v);
 		}
 	}
 	metrics.insert(json_spirit::Object::value_type(b.key(), node));
 }
+void WEBServer::fetchMetrics(PB::Metrics::MetricsMessage::Response *response) {
+	PB::Metrics::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("web");
+	session->get_query_cache().fetch_metrics(bundle->add_children());
+	if (server) {
+		Mongoose::worker_stats stats = server->get_worker_stats();
+		PB::Metrics::MetricsBundle *workers = bundle->add_children();
+		workers->set_key("workers");
+		metrics::add_gauge(workers, "threads", stats.threads);
+		metrics::add_gauge(workers, "queued", stats.queued);
+		metrics::add_counter(workers, "executed", stats.executed);
+		metrics::add_counter(workers, "stolen", stats.stolen);
+		metrics::add_counter(workers, "wakeups", stats.wakeups);
+		metrics::add_latency(workers, "queue_wait", server->get_queue_wait());
+	}
+}
+
 void WEBServer::submitMetrics(const PB::Metrics::MetricsMessage &response) {
 	json_spirit::Object metrics, metrics_list;
 	std::list<std::string> openmetrics;
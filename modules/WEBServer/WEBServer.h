@@ -50,6 +50,7 @@ public:
 	void handleLogMessage(const PB::Log::LogEntry::Entry &message);
 	bool commandLineExec(const int target_mode, const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response, const PB::Commands::ExecuteRequestMessage &request_message);
 	void submitMetrics(const PB::Metrics::MetricsMessage &response);
+	void fetchMetrics(PB::Metrics::MetricsMessage::Response *response);
 	bool install_server(const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response);
 	bool cli_add_user(const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response);
 	bool cli_add_role(const PB::Commands::ExecuteRequestMessage::Request &request, PB::Commands::ExecuteResponseMessage::Response *response);
@@ -2,26 +2,62 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <set>
+
 void error_handler::add_message(bool is_error, const log_entry &message) {
 	{
 		boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 		if (!lock.owns_lock())
 			return;
+		if (log_entries.full()) {
+			// The oldest entry is always first in the index of its level
+			sequence_index &index = levels_[log_entries.front().type];
+			if (!index.empty())
+				index.pop_front();
+		}
 		log_entries.push_back(message);
+		log_entry &entry = log_entries.back();
+		entry.sequence = next_sequence_++;
+		levels_[entry.type].push_back(entry.sequence);
 		if (is_error) {
 			error_count_++;
 			last_error_ = message.message;
 		}
 	}
+	added_.notify_all();
 }
 void error_handler::reset() {
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!lock.owns_lock())
 		return;
+	// The sequence is not reset so cursors held by clients remain valid
 	log_entries.clear();
+	levels_.clear();
 	last_error_ = "";
 	error_count_ = 0;
 }
+void error_handler::set_capacity(std::size_t capacity) {
+	if (capacity == 0)
+		capacity = 1;
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock() || capacity == log_entries.capacity())
+		return;
+	boost::circular_buffer<log_entry> entries(capacity);
+	std::size_t skip = log_entries.size() > capacity ? log_entries.size() - capacity : 0;
+	entries.insert(entries.end(), log_entries.begin() + skip, log_entries.end());
+	log_entries.swap(entries);
+	levels_.clear();
+	BOOST_FOREACH(const log_entry &e, log_entries) {
+		levels_[e.type].push_back(e.sequence);
+	}
+}
+void error_handler::set_max_waiters(std::size_t count) {
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock())
+		return;
+	max_waiters_ = count;
+}
 error_handler::status error_handler::get_status() {
 	status ret;
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
@@ -31,6 +67,61 @@ error_handler::status error_handler::get_status() {
 	ret.last_error = last_error_;
 	return ret;
 }
+
+error_handler::index_list error_handler::get_indexes(const std::list<std::string> &levels) const {
+	index_list ret;
+	std::set<std::string> unique(levels.begin(), levels.end());
+	BOOST_FOREACH(const std::string &level, unique) {
+		std::map<std::string, sequence_index>::const_iterator it = levels_.find(level);
+		if (it != levels_.end())
+			ret.push_back(&it->second);
+	}
+	return ret;
+}
+unsigned long long error_handler::first_sequence() const {
+	return log_entries.empty() ? next_sequence_ : log_entries.front().sequence;
+}
+const error_handler::log_entry& error_handler::get_entry(unsigned long long sequence) const {
+	return log_entries[static_cast<std::size_t>(sequence - first_sequence())];
+}
+std::size_t error_handler::count_before(const index_list &indexes, unsigned long long sequence) const {
+	std::size_t ret = 0;
+	BOOST_FOREACH(const sequence_index *index, indexes) {
+		ret += std::lower_bound(index->begin(), index->end(), sequence) - index->begin();
+	}
+	return ret;
+}
+// The sequence of the entry at position (among the entries in the indexes), position has to be less than the number of entries
+unsigned long long error_handler::find_position(const index_list &indexes, std::size_t position) const {
+	unsigned long long low = first_sequence(), high = next_sequence_;
+	while (low < high) {
+		unsigned long long mid = low + (high - low) / 2;
+		if (count_before(indexes, mid + 1) <= position)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+// Merges the indexes starting at sequence
+void error_handler::copy_from(const index_list &indexes, unsigned long long sequence, std::size_t max, log_list &result) const {
+	std::vector<sequence_index::const_iterator> pos, end;
+	BOOST_FOREACH(const sequence_index *index, indexes) {
+		pos.push_back(std::lower_bound(index->begin(), index->end(), sequence));
+		end.push_back(index->end());
+	}
+	for (std::size_t count = 0; count < max; count++) {
+		std::size_t best = pos.size();
+		for (std::size_t i = 0; i < pos.size(); i++) {
+			if (pos[i] != end[i] && (best == pos.size() || *pos[i] < *pos[best]))
+				best = i;
+		}
+		if (best == pos.size())
+			break;
+		result.push_back(get_entry(*pos[best]++));
+	}
+}
+
 error_handler::log_list error_handler::get_messages(std::list<std::string> levels, std::size_t &position, std::size_t &ipp, std::size_t &count) {
 	log_list ret;
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
@@ -44,28 +135,74 @@ error_handler::log_list error_handler::get_messages(std::list<std::string> level
 		if ((position + ipp) >= count) {
 			ipp = count - position;
 		}
-		log_list::iterator cit = log_entries.begin() + position;
-		log_list::iterator end = log_entries.begin() + position + ipp;
+		ret.insert(ret.end(), log_entries.begin() + position, log_entries.begin() + position + ipp);
+	} else {
+		index_list indexes = get_indexes(levels);
+		count = 0;
+		BOOST_FOREACH(const sequence_index *index, indexes) {
+			count += index->size();
+		}
+		if (position >= count) {
+			return ret;
+		}
+		if ((position + ipp) >= count) {
+			ipp = count - position;
+		}
+		copy_from(indexes, find_position(indexes, position), ipp, ret);
+	}
+	return ret;
+}
 
-		for (; cit != end; ++cit) {
-			ret.push_back(*cit);
+error_handler::log_list error_handler::get_since(std::list<std::string> levels, unsigned long long &sequence, std::size_t max, unsigned int timeout_ms) {
+	log_list ret;
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_ms);
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock() || max == 0)
+		return ret;
+	while (true) {
+		unsigned long long start = std::max(sequence + 1, first_sequence());
+		if (levels.empty()) {
+			for (unsigned long long s = start; s < next_sequence_ && ret.size() < max; s++)
+				ret.push_back(get_entry(s));
+		} else {
+			copy_from(get_indexes(levels), start, max, ret);
 		}
-	} else {
-		int i = 0;
-		BOOST_FOREACH(const log_entry &e, log_entries) {
-			if (std::find(levels.begin(), levels.end(), e.type) == levels.end()) {
-				continue;
-			}
-			i++;
-			if (i < position) {
-				continue;
-			}
-			if (i <= position + ipp) {
-				ret.push_back(e);
-			}
+		if (!ret.empty()) {
+			sequence = ret.back().sequence;
+			break;
 		}
-		count = i;
+		// Nothing (matching) so far so the cursor can skip ahead (this also resets cursors from a previous run)
+		sequence = next_sequence_ - 1;
+		// Waiting holds a server thread so only a few requests are allowed to do so
+		if (timeout_ms == 0 || waiters_ >= max_waiters_)
+			break;
+		waiters_++;
+		bool added = added_.timed_wait(lock, deadline);
+		waiters_--;
+		if (!added)
+			break;
 	}
 	return ret;
 }
 
+error_handler::log_list error_handler::get_tail(std::list<std::string> levels, std::size_t count, unsigned long long &sequence) {
+	log_list ret;
+	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock())
+		return ret;
+	sequence = next_sequence_ - 1;
+	if (levels.empty()) {
+		std::size_t skip = log_entries.size() > count ? log_entries.size() - count : 0;
+		ret.insert(ret.end(), log_entries.begin() + skip, log_entries.end());
+		return ret;
+	}
+	index_list indexes = get_indexes(levels);
+	std::size_t total = 0;
+	BOOST_FOREACH(const sequence_index *index, indexes) {
+		total += index->size();
+	}
+	if (total == 0)
+		return ret;
+	copy_from(indexes, find_position(indexes, total > count ? total - count : 0), count, ret);
+	return ret;
+}
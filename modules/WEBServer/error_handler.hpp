@@ -2,20 +2,45 @@
 
 #include "error_handler_interface.hpp"
 
+#include <boost/circular_buffer.hpp>
 #include <boost/thread.hpp>
 
+#include <deque>
+#include <map>
 #include <string>
 #include <vector>
 
+// Keeps the last capacity log entries in a ring buffer.
+// Every entry gets a sequence number and every level has an index (the sequence numbers of the entries
+// with that level) so filtered pages are found with a binary search instead of a scan.
 struct error_handler : error_handler_interface {
-	error_handler() : error_count_(0) {}
+	error_handler(std::size_t capacity = 5000) : log_entries(capacity == 0 ? 1 : capacity), next_sequence_(1), error_count_(0), waiters_(0), max_waiters_(1) {}
 	void add_message(bool is_error, const log_entry &message);
 	void reset();
 	status get_status();
 	log_list get_messages(std::list<std::string> levels, std::size_t &position, std::size_t &ipp, std::size_t &count);
+	log_list get_since(std::list<std::string> levels, unsigned long long &sequence, std::size_t max, unsigned int timeout_ms);
+	log_list get_tail(std::list<std::string> levels, std::size_t count, unsigned long long &sequence);
+	void set_capacity(std::size_t capacity);
+	void set_max_waiters(std::size_t count);
 private:
+	typedef std::deque<unsigned long long> sequence_index;
+	typedef std::vector<const sequence_index*> index_list;
+
+	index_list get_indexes(const std::list<std::string> &levels) const;
+	unsigned long long first_sequence() const;
+	const log_entry& get_entry(unsigned long long sequence) const;
+	std::size_t count_before(const index_list &indexes, unsigned long long sequence) const;
+	unsigned long long find_position(const index_list &indexes, std::size_t position) const;
+	void copy_from(const index_list &indexes, unsigned long long sequence, std::size_t max, log_list &result) const;
+
 	boost::timed_mutex mutex_;
-	log_list log_entries;
+	boost::condition_variable_any added_;
+	boost::circular_buffer<log_entry> log_entries;
+	std::map<std::string, sequence_index> levels_;
+	unsigned long long next_sequence_;
 	std::string last_error_;
 	unsigned int error_count_;
-};
\ No newline at end of file
+	std::size_t waiters_;
+	std::size_t max_waiters_;
+};
@@ -7,6 +7,9 @@
 struct error_handler_interface {
  
 	struct log_entry {
+		log_entry() : sequence(0), line(0) {}
+		// Assigned when the entry is added (starts at 1 and is never reused)
+		unsigned long long sequence;
 		int line;
 		std::string type;
 		std::string file;
@@ -25,6 +28,16 @@ struct error_handler_interface {
 	virtual void add_message(bool is_error, const log_entry &message) = 0;
 	virtual void reset() = 0;
 	virtual log_list get_messages(std::list<std::string> levels, std::size_t &position, std::size_t &ipp, std::size_t &count) = 0;
+	// Entries after sequence (oldest first, at most max), if there are none wait up to timeout_ms for new entries
+	// (unless max waiters are already waiting in which case it returns at once).
+	// sequence is moved to the last entry returned (or to the newest entry if nothing matched).
+	virtual log_list get_since(std::list<std::string> levels, unsigned long long &sequence, std::size_t max, unsigned int timeout_ms) = 0;
+	// The newest count entries (oldest first), sequence is set to the newest entry
+	virtual log_list get_tail(std::list<std::string> levels, std::size_t count, unsigned long long &sequence) = 0;
+	// The number of entries to keep (the oldest entries are dropped)
+	virtual void set_capacity(std::size_t capacity) = 0;
+	// The number of callers which can wait in get_since at the same time
+	virtual void set_max_waiters(std::size_t count) = 0;
 	virtual status get_status() = 0;
 
-};
\ No newline at end of file
+};
@@ -3,51 +3,128 @@
 #include <str/utils.hpp>
 
 #include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
 
-void grant_store::add_role(std::string &role, std::string &grant) {
+void grant_store::add_role(const std::string &role, const std::string &grant) {
+	boost::unique_lock<boost::shared_mutex> lock(mutex_);
 	BOOST_FOREACH(const std::string &g, str::utils::split<std::list<std::string> >(grant, ",")) {
 		roles[role].rules.push_back(g);
 	}
+	compile();
 }
 
-void grant_store::add_user(std::string &user, std::string &role) {
+void grant_store::add_user(const std::string &user, const std::string &role) {
+	boost::unique_lock<boost::shared_mutex> lock(mutex_);
 	users[user] = role;
+	compile();
 }
 
-void grant_store::remove_role(std::string &role) {
+void grant_store::remove_role(const std::string &role) {
+	boost::unique_lock<boost::shared_mutex> lock(mutex_);
 	roles.erase(role);
+	compile();
 }
 
-void grant_store::remove_user(std::string &uid) {
+void grant_store::remove_user(const std::string &uid) {
+	boost::unique_lock<boost::shared_mutex> lock(mutex_);
 	users.erase(uid);
+	compile();
 }
 
 void grant_store::clear() {
+	boost::unique_lock<boost::shared_mutex> lock(mutex_);
 	roles.clear();
 	users.clear();
+	compile();
 }
 
-bool grant_store::validate(const std::string &uid, std::string &check) {
-	std::list<std::string> need = str::utils::split_lst(check, ".");
-	grants g = fetch_role(uid);
-	BOOST_FOREACH(const std::string &rule, g.rules) {
-		std::list<std::string> tokens = str::utils::split_lst(rule, ".");
-		if (validate_grants(tokens, need)) {
+bool grant_store::validate(const std::string &uid, const std::string &check) {
+	boost::shared_lock<boost::shared_mutex> lock(mutex_);
+	boost::unordered_map<std::string, std::size_t>::const_iterator user = user_roles_.find(uid);
+	if (user == user_roles_.end()) {
+		return false;
+	}
+	const compiled_role &role = compiled_roles_[user->second];
+	boost::unordered_map<std::string, std::size_t>::const_iterator grant = grant_ids_.find(check);
+	if (grant != grant_ids_.end()) {
+		return role.granted.test(grant->second);
+	}
+	grant_list need = str::utils::split_lst(check, ".");
+	BOOST_FOREACH(const grant_list &rule, role.rules) {
+		if (validate_grants(rule, need)) {
 			return true;
 		}
 	}
 	return false;
 }
 
-grants grant_store::fetch_role(const std::string &uid) {
-	std::string role = users[uid];
-	if (role.empty()) {
-		return grants();
+namespace {
+	// Grants checked by the controllers (grants built from request urls such as scripts.get.<runtime> are not included)
+	const char *controller_grants[] = {
+		"logs.list", "logs.put",
+		"queries.list", "queries.get", "queries.execute",
+		"modules", "modules.list", "modules.get", "modules.put", "modules.post",
+		"modules.load", "modules.unload", "modules.enable", "modules.disable",
+		"settings.get", "metrics.list", "openmetrics.list",
+		"info.get", "info.get.version",
+		"login.get", "legacy", "public",
+		"scripts", "scripts.list.runtimes"
+	};
+}
+
+// Must be called with the mutex held (exclusively)
+void grant_store::register_grant(const std::string &check) {
+	if (grant_ids_.find(check) != grant_ids_.end()) {
+		return;
+	}
+	std::size_t id = grant_ids_.size();
+	grant_ids_[check] = id;
+	grant_list need = str::utils::split_lst(check, ".");
+	BOOST_FOREACH(compiled_role &role, compiled_roles_) {
+		role.granted.resize(id + 1);
+		BOOST_FOREACH(const grant_list &rule, role.rules) {
+			if (validate_grants(rule, need)) {
+				role.granted.set(id);
+				break;
+			}
+		}
+	}
+}
+
+// Must be called with the mutex held (exclusively)
+void grant_store::compile() {
+	compiled_roles_.clear();
+	user_roles_.clear();
+	boost::unordered_map<std::string, std::size_t> role_index;
+	typedef boost::unordered_map<std::string, grants>::value_type role_type;
+	BOOST_FOREACH(const role_type &r, roles) {
+		compiled_role role;
+		BOOST_FOREACH(const std::string &rule, r.second.rules) {
+			role.rules.push_back(str::utils::split_lst(rule, "."));
+		}
+		role_index[r.first] = compiled_roles_.size();
+		compiled_roles_.push_back(role);
+	}
+	typedef boost::unordered_map<std::string, std::string>::value_type user_type;
+	BOOST_FOREACH(const user_type &u, users) {
+		boost::unordered_map<std::string, std::size_t>::const_iterator cit = role_index.find(u.second);
+		if (cit != role_index.end()) {
+			user_roles_[u.first] = cit->second;
+		}
+	}
+	// The fixed grants checked by the controllers and the grants named in the rules get a bit so the table is bounded
+	grant_ids_.clear();
+	BOOST_FOREACH(const char *grant, controller_grants) {
+		register_grant(grant);
+	}
+	BOOST_FOREACH(const role_type &r, roles) {
+		BOOST_FOREACH(const std::string &rule, r.second.rules) {
+			register_grant(rule);
+		}
 	}
-	return roles[role];
 }
 
-bool grant_store::validate_grants(std::list<std::string> &grant, std::list<std::string> &need) {
+bool grant_store::validate_grants(const grant_list &grant, const grant_list &need) {
 	grant_list::const_iterator cg = grant.begin();
 	grant_list::const_iterator cn = need.begin();
 	while (cn != need.end()) {
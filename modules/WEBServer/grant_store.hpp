@@ -1,28 +1,51 @@
 #pragma once
 
+#include <boost/dynamic_bitset.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <list>
 #include <string>
+#include <vector>
 
 struct grants {
 	std::list<std::string> rules;
 };
-class grant_store {
+
+// Roles and the users assigned to them.
+//
+// The rules of each role are compiled into a bitset with one bit per grant checked by the controllers or named in
+// the configured rules (so wildcard rules such as logs.* are resolved up front) and validating those is a couple of
+// hash lookups and a bit test under a shared lock. Other grants (such as the ones built from request urls) are
+// matched against the rules of the role every time and never cached.
+class grant_store : boost::noncopyable {
+	typedef std::list<std::string> grant_list;
+	struct compiled_role {
+		std::list<grant_list> rules;
+		boost::dynamic_bitset<> granted;
+	};
+
 	boost::unordered_map<std::string, grants> roles;
 	boost::unordered_map<std::string, std::string> users;
+
+	boost::shared_mutex mutex_;
+	std::vector<compiled_role> compiled_roles_;
+	boost::unordered_map<std::string, std::size_t> user_roles_;
+	boost::unordered_map<std::string, std::size_t> grant_ids_;
+
 public:
 
-	void add_role(std::string &role, std::string &grant);
-	void add_user(std::string &user, std::string &role);
-	void remove_role(std::string &role);
-	void remove_user(std::string &uid);
+	void add_role(const std::string &role, const std::string &grant);
+	void add_user(const std::string &user, const std::string &role);
+	void remove_role(const std::string &role);
+	void remove_user(const std::string &uid);
 	void clear();
 
-	bool validate(const std::string &uid, std::string &check);
+	bool validate(const std::string &uid, const std::string &check);
 
 private:
-	typedef std::list<std::string> grant_list;
-	grants fetch_role(const std::string &uid);
-	bool validate_grants(grant_list &grant, grant_list &need);
-};
\ No newline at end of file
+	void register_grant(const std::string &check);
+	void compile();
+	static bool validate_grants(const grant_list &grant, const grant_list &need);
+};
@@ -4,6 +4,7 @@
 #include <nscapi/nscapi_protobuf_registry.hpp>
 
 #include <json_spirit.h>
+#include <json/stream_writer.hpp>
 
 #include <boost/foreach.hpp>
 
@@ -11,6 +12,15 @@
 #include "../CommandClient/CommandClient.h"
 
 namespace helpers {
+  template<class Writer>
+  inline void write_metadata(Writer &node, const ::google::protobuf::RepeatedPtrField<PB::Common::KeyValue> &metadata) {
+	  node.key("metadata").begin_object();
+	  BOOST_FOREACH(const PB::Common::KeyValue &kvp, metadata) {
+		  node.key(kvp.key()).value(kvp.value());
+	  }
+	  node.end_object();
+  }
+
   inline void parse_result(const ::google::protobuf::RepeatedPtrField<PB::Registry::RegistryResponseMessage::Response> &payload, Mongoose::StreamResponse &response, std::string task) {
     BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response &r, payload) {
       if (r.has_result() && r.result().code() == PB::Common::Result_StatusCodeType_STATUS_ERROR) {
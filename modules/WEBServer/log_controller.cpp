@@ -43,14 +43,35 @@ log_controller::log_controller(const int version, boost::shared_ptr<session_mana
 bool is_str_empty(const std::string& m) {
 	return m.empty();
 }
+
+json_spirit::Array render_log(const error_handler_interface::log_list &entries) {
+	json_spirit::Array root;
+	BOOST_FOREACH(const error_handler_interface::log_entry &e, entries) {
+		json_spirit::Object node;
+		node.insert(json_spirit::Object::value_type("sequence", e.sequence));
+		node.insert(json_spirit::Object::value_type("file", e.file));
+		node.insert(json_spirit::Object::value_type("line", e.line));
+		node.insert(json_spirit::Object::value_type("level", e.type));
+		node.insert(json_spirit::Object::value_type("date", e.date));
+		node.insert(json_spirit::Object::value_type("message", e.message));
+		root.push_back(node);
+	}
+	return root;
+}
+
 void log_controller::get_log(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
 	if (!session->is_loggedin("logs.list", request, response))
 		return;
 
-	json_spirit::Array root;
-
 	std::list<std::string> levels;
 	str::utils::split(levels, request.get("level", ""), ",");
+	levels.remove_if(&is_str_empty);
+	if (request.hasVariable("since") || request.hasVariable("tail")) {
+		get_log_since(request, levels, response);
+		return;
+	}
+
+	json_spirit::Array root;
 	std::size_t count = 0;
 	std::size_t page = str::stox<std::size_t>(request.get("page", "1"), 1);
 	std::size_t ipp = str::stox<std::size_t>(request.get("per_page", "10"), 10);
@@ -59,15 +80,7 @@ void log_controller::get_log(Mongoose::Request &request, boost::smatch &what, Mo
 		return;
 	}
 	std::size_t pos = (page-1)*ipp;
-	BOOST_FOREACH(const error_handler_interface::log_entry &e, session->get_log_data()->get_messages(levels, pos, ipp, count)) {
-		json_spirit::Object node;
-		node.insert(json_spirit::Object::value_type("file", e.file));
-		node.insert(json_spirit::Object::value_type("line", e.line));
-		node.insert(json_spirit::Object::value_type("level", e.type));
-		node.insert(json_spirit::Object::value_type("date", e.date));
-		node.insert(json_spirit::Object::value_type("message", e.message));
-		root.push_back(node);
-	}
+	root = render_log(session->get_log_data()->get_messages(levels, pos, ipp, count));
 	std::string base = request.get_host() + get_prefix() + "?page=";
 	std::string tail = "&per_page=" + str::xtos(ipp);
 	if (!levels.empty()) {
@@ -84,6 +97,30 @@ void log_controller::get_log(Mongoose::Request &request, boost::smatch &what, Mo
 	response.append(json_spirit::write(root));
 }
 
+// Cursor based polling: entries after a sequence number (or the newest entries) and optionally wait for new ones
+void log_controller::get_log_since(Mongoose::Request &request, const std::list<std::string> &levels, Mongoose::StreamResponse &response) {
+	const std::size_t max_limit = 1000;
+	const unsigned int max_wait = 30;
+
+	std::size_t limit = str::stox<std::size_t>(request.get("limit", "100"), 100);
+	unsigned int wait = str::stox<unsigned int>(request.get("wait", "0"), 0);
+	if (limit < 1 || limit > max_limit || wait > max_wait) {
+		response.setCodeBadRequest("Invalid request");
+		return;
+	}
+	unsigned long long sequence = 0;
+	error_handler_interface::log_list entries;
+	if (request.hasVariable("tail")) {
+		std::size_t tail = std::min(str::stox<std::size_t>(request.get("tail", "100"), 100), limit);
+		entries = session->get_log_data()->get_tail(levels, tail, sequence);
+	} else {
+		sequence = str::stox<unsigned long long>(request.get("since", "0"), 0);
+		entries = session->get_log_data()->get_since(levels, sequence, limit, wait * 1000);
+	}
+	response.setHeader("X-Log-Sequence", str::xtos(sequence));
+	response.append(json_spirit::write(render_log(entries)));
+}
+
 void log_controller::add_log(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
 	if (!session->is_loggedin("logs.put", request, response))
 		return;
@@ -28,4 +28,7 @@ public:
 	void get_log(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response);
 	void add_log(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response);
 
+private:
+	void get_log_since(Mongoose::Request &request, const std::list<std::string> &levels, Mongoose::StreamResponse &response);
+
 };
@@ -6,6 +6,7 @@
 #include <file_helpers.hpp>
 
 #include <json_spirit.h>
+#include <json/stream_writer.hpp>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
@@ -19,6 +20,32 @@
 #pragma warning(disable:4456)
 #endif
 
+namespace {
+	void write_module(json::writer<Mongoose::StreamResponse> &node, const PB::Registry::RegistryResponseMessage::Response::Inventory &i) {
+		bool loaded = false, enabled = false;
+		BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
+			if (kvp.key() == "loaded") {
+				loaded = kvp.value() == "true";
+			} else if (kvp.key() == "enabled") {
+				enabled = kvp.value() == "true";
+			}
+		}
+		node.member("name", i.name());
+		node.member("id", i.id());
+		node.member("title", i.info().title());
+		node.member("loaded", loaded);
+		node.member("enabled", enabled);
+		node.key("metadata").begin_object();
+		BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
+			if (kvp.key() != "loaded" && kvp.key() != "enabled") {
+				node.key(kvp.key()).value(kvp.value());
+			}
+		}
+		node.end_object();
+		node.member("description", i.info().description());
+	}
+}
+
 
 
 modules_controller::modules_controller(const int version, boost::shared_ptr<session_manager_interface> session, nscapi::core_wrapper* core, unsigned int plugin_id)
@@ -49,35 +76,20 @@ void modules_controller::get_modules(Mongoose::Request &request, boost::smatch &
 
   PB::Registry::RegistryResponseMessage pb_response;
   pb_response.ParseFromString(str_response);
-  json_spirit::Array root;
-
-  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response r, pb_response.payload()) {
-	  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory i, r.inventory()) {
-		  json_spirit::Object node;
-		  node["name"] = i.name();
-		  node["id"] = i.id();
-		  node["title"] = i.info().title();
-		  node["loaded"] = false;
-		  node["enabled"] = false;
-		  node["module_url"] = request.get_host() + "/api/v1/modules/" + i.name() + "/";
-		  json_spirit::Object keys;
-		  BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
-			  if (kvp.key() == "loaded") {
-				  node["loaded"] = kvp.value() == "true";
-			  } else if (kvp.key() == "enabled") {
-				  node["enabled"] = kvp.value() == "true";
-			  } else {
-				  keys[kvp.key()] = kvp.value();
-			  }
-		  }
-		  node["metadata"] = keys;
-		  node["description"] = i.info().description();
-		  node["load_url"] = get_base(request) + "/" + i.id() + "/commands/load";
-		  node["unload_url"] = get_base(request) + "/" + i.id() + "/commands/unload";
-		  root.push_back(node);
+  std::string base = get_base(request);
+  json::writer<Mongoose::StreamResponse> root(response);
+  root.begin_array();
+  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response &r, pb_response.payload()) {
+	  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory &i, r.inventory()) {
+		  root.begin_object();
+		  write_module(root, i);
+		  root.key("module_url").value(request.get_host() + "/api/v1/modules/" + i.name() + "/");
+		  root.key("load_url").value(base + "/" + i.id() + "/commands/load");
+		  root.key("unload_url").value(base + "/" + i.id() + "/commands/unload");
+		  root.end_object();
 	  }
   }
-  response.append(json_spirit::write(root));
+  root.end_array();
 }
 
 void modules_controller::get_module(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
@@ -99,38 +111,27 @@ void modules_controller::get_module(Mongoose::Request &request, boost::smatch &w
 
 	PB::Registry::RegistryResponseMessage pb_response;
 	pb_response.ParseFromString(str_response);
-	json_spirit::Object node;
-
-	BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response r, pb_response.payload()) {
+	const PB::Registry::RegistryResponseMessage::Response::Inventory *found = NULL;
+	BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response &r, pb_response.payload()) {
 		if (r.inventory_size() == 0) {
 			response.setCodeNotFound("Module not found: " + module);
 			return;
 		}
-		BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory i, r.inventory()) {
-			node["name"] = i.name();
-			node["id"] = i.id();
-			node["title"] = i.info().title();
-			node["loaded"] = false;
-			node["enabled"] = false;
-			json_spirit::Object keys;
-			BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
-				if (kvp.key() == "loaded") {
-					node["loaded"] = kvp.value() == "true";
-				} else if (kvp.key() == "enabled") {
-					node["enabled"] = kvp.value() == "true";
-				} else {
-					keys[kvp.key()] = kvp.value();
-				}
-			}
-			node["metadata"] = keys;
-			node["description"] = i.info().description();
-			node["load_url"] = get_base(request) + "/" + i.id() + "/commands/load";
-			node["unload_url"] = get_base(request) + "/" + i.id() + "/commands/unload";
-			node["enable_url"] = get_base(request) + "/" + i.id() + "/commands/enable";
-			node["disable_url"] = get_base(request) + "/" + i.id() + "/commands/disable";
+		BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory &i, r.inventory()) {
+			found = &i;
 		}
 	}
-	response.append(json_spirit::write(node));
+	json::writer<Mongoose::StreamResponse> node(response);
+	node.begin_object();
+	if (found != NULL) {
+		std::string base = get_base(request);
+		write_module(node, *found);
+		node.key("load_url").value(base + "/" + found->id() + "/commands/load");
+		node.key("unload_url").value(base + "/" + found->id() + "/commands/unload");
+		node.key("enable_url").value(base + "/" + found->id() + "/commands/enable");
+		node.key("disable_url").value(base + "/" + found->id() + "/commands/disable");
+	}
+	node.end_object();
 }
 
 void modules_controller::module_command(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
@@ -0,0 +1,169 @@
+#include "query_cache.hpp"
+
+#include <metrics/latency_histogram.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+
+namespace {
+	bool compare_keys(const std::pair<std::string, std::string> &a, const std::pair<std::string, std::string> &b) {
+		return a.first < b.first;
+	}}
+
+void query_cache::set_max_age(const std::string &query, unsigned int seconds) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	if (seconds == 0)
+		max_age_.erase(query);
+	else
+		max_age_[query] = seconds;
+}
+
+void query_cache::clear() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	max_age_.clear();
+	for (flight_map::iterator it = flights_.begin(); it != flights_.end();) {
+		if (it->second->done)
+			it = flights_.erase(it);
+		else
+			++it;
+	}
+}
+
+// Arguments are sorted on the key (keeping the order of repeated keys) so "a=1&b=2" and "b=2&a=1" share an entry
+std::string query_cache::make_key(const std::string &query, const arg_vector &args) {
+	arg_vector sorted = args;
+	std::stable_sort(sorted.begin(), sorted.end(), &compare_keys);
+	std::string key = query;
+	BOOST_FOREACH(const arg_vector::value_type &a, sorted) {
+		key.push_back('\0');
+		key += a.first;
+		if (!a.second.empty()) {
+			key.push_back('=');
+			key += a.second;
+		}
+	}
+	return key;
+}
+
+// Must be called with the mutex held
+unsigned int query_cache::get_max_age(const std::string &query) {
+	boost::unordered_map<std::string, unsigned int>::const_iterator cit = max_age_.find(query);
+	if (cit != max_age_.end())
+		return cit->second;
+	cit = max_age_.find("*");
+	if (cit != max_age_.end())
+		return cit->second;
+	return 0;
+}
+
+query_cache::status query_cache::execute(const std::string &query, const arg_vector &args, bool bypass, executor_type executor, std::string &response) {
+	std::string key;
+	flight_type f;
+	unsigned int max_age = 0;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (!bypass)
+			max_age = get_max_age(query);
+		if (max_age == 0) {
+			uncached_++;
+			lock.unlock();
+			executor(response);
+			return status_uncached;
+		}
+		key = make_key(query, args);
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+		flight_map::iterator it = flights_.find(key);
+		if (it != flights_.end()) {
+			flight_type existing = it->second;
+			if (!existing->done) {
+				coalesced_++;
+				while (!existing->done)
+					done_.wait(lock);
+				if (!existing->failed) {
+					response = existing->response;
+					return status_coalesced;
+				}
+				// The execution we waited for failed: try again (but without making others wait for us)
+				lock.unlock();
+				executor(response);
+				return status_uncached;
+			}
+			if (!existing->failed && existing->expires > now) {
+				hits_++;
+				response = existing->response;
+				return status_hit;
+			}
+		}
+		misses_++;
+		if (flights_.size() >= max_entries_)
+			purge(now);
+		f.reset(new flight());
+		flights_[key] = f;
+	}
+
+	std::string result;
+	bool ok = false;
+	try {
+		ok = executor(result);
+	} catch (...) {
+		abandon(key, f);
+		throw;
+	}
+	if (!ok) {
+		abandon(key, f);
+		response.swap(result);
+		return status_uncached;
+	}
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		f->response = result;
+		f->expires = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(max_age);
+		f->done = true;
+		done_.notify_all();
+	}
+	response.swap(result);
+	return status_miss;
+}
+
+// Marks a failed execution so waiting requests run the query themselves and drops it from the cache
+void query_cache::abandon(const std::string &key, flight_type f) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	failed_++;
+	f->failed = true;
+	f->done = true;
+	flight_map::iterator it = flights_.find(key);
+	if (it != flights_.end() && it->second == f)
+		flights_.erase(it);
+	done_.notify_all();
+}
+
+// Drops expired results and, if that is not enough, all results (queries still running are kept)
+void query_cache::purge(const boost::posix_time::ptime &now) {
+	for (flight_map::iterator it = flights_.begin(); it != flights_.end();) {
+		if (it->second->done && it->second->expires <= now)
+			it = flights_.erase(it);
+		else
+			++it;
+	}
+	if (flights_.size() < max_entries_)
+		return;
+	for (flight_map::iterator it = flights_.begin(); it != flights_.end();) {
+		if (it->second->done)
+			it = flights_.erase(it);
+		else
+			++it;
+	}
+}
+
+void query_cache::fetch_metrics(PB::Metrics::MetricsBundle *bundle) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	bundle->set_key("query_cache");
+	metrics::add_counter(bundle, "hits", hits_);
+	metrics::add_counter(bundle, "misses", misses_);
+	metrics::add_counter(bundle, "coalesced", coalesced_);
+	metrics::add_counter(bundle, "uncached", uncached_);
+	metrics::add_counter(bundle, "failed", failed_);
+	metrics::add_gauge(bundle, "entries", flights_.size());
+}
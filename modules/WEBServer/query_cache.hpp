@@ -0,0 +1,74 @@
+#pragma once
+
+#include <nscapi/nscapi_protobuf_metrics.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Results of queries executed through the REST API.
+//
+// Caching is opt-in per query (or "*" for all queries) with a max age in seconds. Results are keyed by the query and
+// its (normalized) arguments. Identical requests arriving while the query is running wait for that execution instead
+// of running the query again.
+class query_cache : boost::noncopyable {
+public:
+	typedef std::vector<std::pair<std::string, std::string> > arg_vector;
+	// Executes the query and stores the (serialized) response message, returns false if the query failed (failed
+	// results are never cached or shared with waiting requests)
+	typedef boost::function<bool(std::string&)> executor_type;
+	enum status {
+		status_uncached,
+		status_miss,
+		status_hit,
+		status_coalesced
+	};
+
+private:
+	struct flight {
+		bool done;
+		bool failed;
+		std::string response;
+		boost::posix_time::ptime expires;
+		flight() : done(false), failed(false) {}
+	};
+	typedef boost::shared_ptr<flight> flight_type;
+	typedef boost::unordered_map<std::string, flight_type> flight_map;
+
+	boost::mutex mutex_;
+	boost::condition_variable done_;
+	flight_map flights_;
+	boost::unordered_map<std::string, unsigned int> max_age_;
+	std::size_t max_entries_;
+
+	unsigned long long hits_;
+	unsigned long long misses_;
+	unsigned long long coalesced_;
+	unsigned long long uncached_;
+	unsigned long long failed_;
+
+public:
+	query_cache() : max_entries_(1000), hits_(0), misses_(0), coalesced_(0), uncached_(0), failed_(0) {}
+
+	void set_max_age(const std::string &query, unsigned int seconds);
+	void clear();
+
+	// Returns the cached response or runs the executor (at most once for concurrent identical requests)
+	status execute(const std::string &query, const arg_vector &args, bool bypass, executor_type executor, std::string &response);
+	void fetch_metrics(PB::Metrics::MetricsBundle *bundle);
+
+	static std::string make_key(const std::string &query, const arg_vector &args);
+
+private:
+	unsigned int get_max_age(const std::string &query);
+	void abandon(const std::string &key, flight_type f);
+	void purge(const boost::posix_time::ptime &now);
+};
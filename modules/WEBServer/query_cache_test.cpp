@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "query_cache.hpp"
+
+#include <str/xtos.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+namespace {
+	// Counts executions and, when told to, blocks until released
+	struct fake_query {
+		boost::mutex mutex;
+		boost::condition_variable cond;
+		int calls;
+		bool block;
+		bool result;
+		bool do_throw;
+		fake_query() : calls(0), block(false), result(true), do_throw(false) {}
+
+		bool execute(std::string &response) {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			calls++;
+			int call = calls;
+			while (block)
+				cond.wait(lock);
+			if (do_throw)
+				throw std::runtime_error("failed");
+			response = "response " + str::xtos(call);
+			return result;
+		}
+		void release() {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			block = false;
+			cond.notify_all();
+		}
+		int get_calls() {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			return calls;
+		}
+	};
+
+	double get_metric(query_cache &cache, const std::string &key) {
+		PB::Metrics::MetricsBundle bundle;
+		cache.fetch_metrics(&bundle);
+		BOOST_FOREACH(const PB::Metrics::Metric &m, bundle.value()) {
+			if (m.key() == key)
+				return m.has_counter_value() ? m.counter_value().value() : m.gauge_value().value();
+		}
+		return -1;
+	}
+
+	query_cache::status run(query_cache &cache, fake_query &q, std::string &response, const query_cache::arg_vector &args = query_cache::arg_vector(), bool bypass = false) {
+		return cache.execute("check_cpu", args, bypass, boost::bind(&fake_query::execute, &q, _1), response);
+	}
+
+	struct waiter {
+		query_cache &cache;
+		fake_query &q;
+		query_cache::status status;
+		std::string response;
+		waiter(query_cache &cache, fake_query &q) : cache(cache), q(q), status(query_cache::status_uncached) {}
+		void operator()() {
+			status = run(cache, q, response);
+		}
+	};
+
+	void wait_for_metric(query_cache &cache, const std::string &key, double value) {
+		for (int i = 0; i < 500 && get_metric(cache, key) != value; i++)
+			boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+	}
+}
+
+TEST(query_cache, uncached) {
+	query_cache cache;
+	fake_query q;
+	std::string response;
+	EXPECT_EQ(query_cache::status_uncached, run(cache, q, response));
+	EXPECT_EQ(query_cache::status_uncached, run(cache, q, response));
+	EXPECT_EQ(2, q.get_calls());
+	EXPECT_EQ("response 2", response);
+}
+
+TEST(query_cache, hit_and_miss) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 60);
+	fake_query q;
+	std::string response;
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ("response 1", response);
+	EXPECT_EQ(query_cache::status_hit, run(cache, q, response));
+	EXPECT_EQ("response 1", response);
+	EXPECT_EQ(1, q.get_calls());
+
+	// Other arguments are another entry, the order of the arguments does not matter
+	query_cache::arg_vector args;
+	args.push_back(std::make_pair("time", "5m"));
+	args.push_back(std::make_pair("show-all", ""));
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response, args));
+	std::reverse(args.begin(), args.end());
+	EXPECT_EQ(query_cache::status_hit, run(cache, q, response, args));
+	EXPECT_EQ(2, q.get_calls());
+
+	// A bypass runs the query without touching the cache
+	EXPECT_EQ(query_cache::status_uncached, run(cache, q, response, query_cache::arg_vector(), true));
+	EXPECT_EQ(3, q.get_calls());
+	EXPECT_EQ(query_cache::status_hit, run(cache, q, response));
+	EXPECT_EQ("response 1", response);
+
+	EXPECT_EQ(3, get_metric(cache, "hits"));
+	EXPECT_EQ(2, get_metric(cache, "misses"));
+}
+
+TEST(query_cache, wildcard) {
+	query_cache cache;
+	cache.set_max_age("*", 60);
+	fake_query q;
+	std::string response;
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ(query_cache::status_hit, run(cache, q, response));
+	cache.clear();
+	EXPECT_EQ(query_cache::status_uncached, run(cache, q, response));
+}
+
+TEST(query_cache, expiry) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 1);
+	fake_query q;
+	std::string response;
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ(query_cache::status_hit, run(cache, q, response));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(1100));
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ("response 2", response);
+}
+
+TEST(query_cache, failure_is_not_cached) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 60);
+	fake_query q;
+	q.result = false;
+	std::string response;
+	EXPECT_EQ(query_cache::status_uncached, run(cache, q, response));
+	// The caller still gets whatever the failed execution returned
+	EXPECT_EQ("response 1", response);
+	q.result = true;
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ("response 2", response);
+	EXPECT_EQ(1, get_metric(cache, "failed"));
+}
+
+TEST(query_cache, exception_is_not_cached) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 60);
+	fake_query q;
+	q.do_throw = true;
+	std::string response;
+	EXPECT_THROW(run(cache, q, response), std::runtime_error);
+	q.do_throw = false;
+	EXPECT_EQ(query_cache::status_miss, run(cache, q, response));
+	EXPECT_EQ(2, q.get_calls());
+}
+
+TEST(query_cache, coalescing) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 60);
+	fake_query q;
+	q.block = true;
+	waiter first(cache, q), second(cache, q);
+	boost::thread t1(boost::ref(first));
+	while (q.get_calls() == 0)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	boost::thread t2(boost::ref(second));
+	wait_for_metric(cache, "coalesced", 1);
+	q.release();
+	t1.join();
+	t2.join();
+	EXPECT_EQ(1, q.get_calls());
+	EXPECT_EQ(query_cache::status_miss, first.status);
+	EXPECT_EQ(query_cache::status_coalesced, second.status);
+	EXPECT_EQ("response 1", second.response);
+}
+
+TEST(query_cache, coalesced_failure_retries) {
+	query_cache cache;
+	cache.set_max_age("check_cpu", 60);
+	fake_query q;
+	q.block = true;
+	q.result = false;
+	waiter first(cache, q), second(cache, q);
+	boost::thread t1(boost::ref(first));
+	while (q.get_calls() == 0)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	boost::thread t2(boost::ref(second));
+	wait_for_metric(cache, "coalesced", 1);
+	q.release();
+	t1.join();
+	t2.join();
+	// The waiter ran the query itself instead of getting the failed result
+	EXPECT_EQ(2, q.get_calls());
+	EXPECT_EQ(query_cache::status_uncached, first.status);
+	EXPECT_EQ(query_cache::status_uncached, second.status);
+	EXPECT_EQ("response 2", second.response);
+	EXPECT_EQ(0, get_metric(cache, "entries"));
+}
@@ -8,9 +8,10 @@
 
 #include <str/xtos.hpp>
 
-#include <json_spirit.h>
+#include <json/stream_writer.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/regex.hpp>
 
@@ -40,27 +41,25 @@ void query_controller::get_queries(Mongoose::Request &request, boost::smatch &wh
 
   PB::Registry::RegistryResponseMessage pb_response;
   pb_response.ParseFromString(str_response);
-  json_spirit::Array root;
 
-  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response r, pb_response.payload()) {
-	  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory i, r.inventory()) {
-		  json_spirit::Object node;
-		  node["name"] = i.name();
+  std::string base = get_base(request);
+  json::writer<Mongoose::StreamResponse> root(response);
+  root.begin_array();
+  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response &r, pb_response.payload()) {
+	  BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory &i, r.inventory()) {
+		  root.begin_object();
+		  root.member("name", i.name());
 		  if (i.info().plugin_size() > 0) {
-			  node["plugin"] = i.info().plugin(0);
+			  root.member("plugin", i.info().plugin(0));
 		  }
-		  node["query_url"] = get_base(request) + "/" + i.name() + "/";
-		  node["title"] = i.info().title();
-		  json_spirit::Object keys;
-		  BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
-				keys[kvp.key()] = kvp.value();
-		  }
-		  node["metadata"] = keys;
-		  node["description"] = i.info().description();
-		  root.push_back(node);
+		  root.key("query_url").value(base + "/" + i.name() + "/");
+		  root.member("title", i.info().title());
+		  helpers::write_metadata(root, i.info().metadata());
+		  root.member("description", i.info().description());
+		  root.end_object();
 	  }
   }
-  response.append(json_spirit::write(root));
+  root.end_array();
 }
 
 void query_controller::get_query(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
@@ -82,27 +81,29 @@ void query_controller::get_query(Mongoose::Request &request, boost::smatch &what
 
 	PB::Registry::RegistryResponseMessage pb_response;
 	pb_response.ParseFromString(str_response);
-	json_spirit::Object node;
 
-	BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response r, pb_response.payload()) {
-		BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory i, r.inventory()) {
-			node["name"] = i.name();
-			if (i.info().plugin_size() > 0) {
-				node["plugin"] = i.info().plugin(0);
-			}
-			node["title"] = i.info().title();
-			node["execute_url"] = get_base(request) + "/" + i.name() + "/commands/execute";
-			node["execute_nagios_url"] = get_base(request) + "/" + i.name() + "/commands/execute_nagios";
-			json_spirit::Object keys;
-			BOOST_FOREACH(const PB::Common::KeyValue &kvp, i.info().metadata()) {
-				keys[kvp.key()] = kvp.value();
-			}
-			node["metadata"] = keys;
-			node["description"] = i.info().description();
+	const PB::Registry::RegistryResponseMessage::Response::Inventory *query = NULL;
+	BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response &r, pb_response.payload()) {
+		BOOST_FOREACH(const PB::Registry::RegistryResponseMessage::Response::Inventory &i, r.inventory()) {
+			query = &i;
 		}
 	}
 	response.setCodeOk();
-	response.append(json_spirit::write(node));
+	json::writer<Mongoose::StreamResponse> node(response);
+	node.begin_object();
+	if (query != NULL) {
+		std::string base = get_base(request);
+		node.member("name", query->name());
+		if (query->info().plugin_size() > 0) {
+			node.member("plugin", query->info().plugin(0));
+		}
+		node.member("title", query->info().title());
+		node.key("execute_url").value(base + "/" + query->name() + "/commands/execute");
+		node.key("execute_nagios_url").value(base + "/" + query->name() + "/commands/execute_nagios");
+		helpers::write_metadata(node, query->info().metadata());
+		node.member("description", query->info().description());
+	}
+	node.end_object();
 }
 
 void query_controller::query_command(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response) {
@@ -115,26 +116,31 @@ void query_controller::query_command(Mongoose::Request &request, boost::smatch &
 	std::string module = what.str(1);
 	std::string command = what.str(2);
 
+	// Clients can ask for a fresh result (the query cache is opt-in per query)
+	bool cached = request.readHeader("Cache-Control").find("no-cache") == std::string::npos;
 	if (command == "execute") {
 		if (request.readHeader("Accept") == "text/plain") {
-			execute_query_text(module, request.getVariablesVector(), response);
+			execute_query_text(module, request.getVariablesVector(), cached, response);
 		} else {
-			execute_query(module, request.getVariablesVector(), response);
+			execute_query(module, request.getVariablesVector(), cached, response);
 		}
 	} else if (command == "execute_nagios") {
 		if (request.readHeader("Accept") == "text/plain") {
-			execute_query_text(module, request.getVariablesVector(), response);
+			execute_query_text(module, request.getVariablesVector(), cached, response);
 		} else {
-			execute_query_nagios(module, request.getVariablesVector(), response);
+			execute_query_nagios(module, request.getVariablesVector(), cached, response);
 		}
 	} else {
 		response.setCodeNotFound("unknown command: " + command);
 	}
 }
 
+bool query_controller::run_core_query(const std::string &request, std::string &response) {
+	return core->query(request, response);
+}
 
-
-void query_controller::execute_query(std::string module, arg_vector args, Mongoose::StreamResponse &http_response) {
+// Runs the query (or fetches the result from the query cache)
+void query_controller::run_query(const std::string &module, const arg_vector &args, bool cached, PB::Commands::QueryResponseMessage &response, Mongoose::StreamResponse &http_response) {
 	PB::Commands::QueryRequestMessage qrm;
 	PB::Commands::QueryRequestMessage::Request *payload = qrm.add_payload();
 
@@ -145,102 +151,86 @@ void query_controller::execute_query(std::string module, arg_vector args, Mongoo
 		else
 			payload->add_arguments(e.first + "=" + e.second);
 	}
-	std::string pb_response, json_response;
-	core->query(qrm.SerializeAsString(), pb_response);
-	PB::Commands::QueryResponseMessage response;
+	std::string request = qrm.SerializeAsString(), pb_response;
+	query_cache::status status = session->get_query_cache().execute(module, args, !cached, boost::bind(&query_controller::run_core_query, this, boost::cref(request), _1), pb_response);
+	if (status == query_cache::status_hit || status == query_cache::status_coalesced) {
+		http_response.setHeader("X-Cache", "HIT");
+	} else if (status == query_cache::status_miss) {
+		http_response.setHeader("X-Cache", "MISS");
+	}
 	response.ParseFromString(pb_response);
+}
 
-	json_spirit::Object node;
+void query_controller::execute_query(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &http_response) {
+	PB::Commands::QueryResponseMessage response;
+	run_query(module, args, cached, response, http_response);
+
+	http_response.setCodeOk();
+	json::writer<Mongoose::StreamResponse> node(http_response);
+	node.begin_object();
 	BOOST_FOREACH(const PB::Commands::QueryResponseMessage::Response &r, response.payload()) {
-		node["command"] = r.command();
-		node["result"] = r.result();
-		json_spirit::Array lines;
+		node.member("command", r.command());
+		node.member("result", static_cast<int>(r.result()));
+		node.key("lines").begin_array();
 		BOOST_FOREACH(const PB::Commands::QueryResponseMessage::Response::Line &l, r.lines()) {
-			json_spirit::Object line;
-			line["message"] = l.message();
-
-
-			json_spirit::Object perf;
+			node.begin_object();
+			node.member("message", l.message());
+			node.key("perf").begin_object();
 			BOOST_FOREACH(const PB::Common::PerformanceData &p, l.perf()) {
-				json_spirit::Object pdata;
-
+				node.key(p.alias()).begin_object();
 				if (p.has_float_value()) {
-					pdata["value"] = p.float_value().value();
+					node.member("value", p.float_value().value());
 					if (p.float_value().has_minimum())
-						pdata["minimum"] = p.float_value().minimum().value();
+						node.member("minimum", p.float_value().minimum().value());
 					if (p.float_value().has_maximum())
-						pdata["maximum"] = p.float_value().maximum().value();
+						node.member("maximum", p.float_value().maximum().value());
 					if (p.float_value().has_warning())
-						pdata["warning"] = p.float_value().warning().value();
+						node.member("warning", p.float_value().warning().value());
 					if (p.float_value().has_critical())
-						pdata["critical"] = p.float_value().critical().value();
-					pdata["unit"] = p.float_value().unit();
+						node.member("critical", p.float_value().critical().value());
+					node.member("unit", p.float_value().unit());
 				}
 				if (p.has_string_value()) {
-					pdata["value"] = p.string_value().value();
+					node.member("value", p.string_value().value());
 				}
-				perf[p.alias()] = pdata;
+				node.end_object();
 			}
-			line["perf"] = perf;
-			lines.push_back(line);
+			node.end_object();
+			node.end_object();
 		}
-		node["lines"] = lines;
+		node.end_array();
 		break;
 	}
-	http_response.setCodeOk();
-	http_response.append(json_spirit::write(node));
+	node.end_object();
 }
 
-void query_controller::execute_query_nagios(std::string module, arg_vector args, Mongoose::StreamResponse &http_response) {
-	PB::Commands::QueryRequestMessage qrm;
-	PB::Commands::QueryRequestMessage::Request *payload = qrm.add_payload();
-
-	payload->set_command(module);
-	BOOST_FOREACH(const Mongoose::Request::arg_vector::value_type &e, args) {
-		if (e.second.empty())
-			payload->add_arguments(e.first);
-		else
-			payload->add_arguments(e.first + "=" + e.second);
-	}
-	std::string pb_response, json_response;
-	core->query(qrm.SerializeAsString(), pb_response);
+void query_controller::execute_query_nagios(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &http_response) {
 	PB::Commands::QueryResponseMessage response;
-	response.ParseFromString(pb_response);
+	run_query(module, args, cached, response, http_response);
 
-	json_spirit::Object node;
+	http_response.setCodeOk();
+	json::writer<Mongoose::StreamResponse> node(http_response);
+	node.begin_object();
 	BOOST_FOREACH(const PB::Commands::QueryResponseMessage::Response &r, response.payload()) {
-		node["command"] = r.command();
-		node["result"] = nscapi::plugin_helper::translateReturn(r.result());
-		json_spirit::Array lines;
+		node.member("command", r.command());
+		node.member("result", nscapi::plugin_helper::translateReturn(r.result()));
+		node.key("lines").begin_array();
 		BOOST_FOREACH(const PB::Commands::QueryResponseMessage::Response::Line &l, r.lines()) {
-			json_spirit::Object line;
-			line["message"] = l.message();
-			line["perf"] = nscapi::protobuf::functions::build_performance_data(l, nscapi::protobuf::functions::no_truncation);
-			lines.push_back(line);
+			node.begin_object();
+			node.member("message", l.message());
+			node.member("perf", nscapi::protobuf::functions::build_performance_data(l, nscapi::protobuf::functions::no_truncation));
+			node.end_object();
 		}
-		node["lines"] = lines;
+		node.end_array();
 		break;
 	}
-	http_response.setCodeOk();
-	http_response.append(json_spirit::write(node));
+	node.end_object();
 }
 
 
-void query_controller::execute_query_text(std::string module, arg_vector args, Mongoose::StreamResponse &http_response) {
-	PB::Commands::QueryRequestMessage qrm;
-	PB::Commands::QueryRequestMessage::Request *payload = qrm.add_payload();
-
-	payload->set_command(module);
-	BOOST_FOREACH(const Mongoose::Request::arg_vector::value_type &e, args) {
-		if (e.second.empty())
-			payload->add_arguments(e.first);
-		else
-			payload->add_arguments(e.first + "=" + e.second);
-	}
-	std::string pb_response, json_response;
-	core->query(qrm.SerializeAsString(), pb_response);
+void query_controller::execute_query_text(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &http_response) {
 	PB::Commands::QueryResponseMessage response;
-	response.ParseFromString(pb_response);
+	run_query(module, args, cached, response, http_response);
 
 	int code = 200;
 	std::string reason = "Ok";
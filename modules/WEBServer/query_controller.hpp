@@ -5,6 +5,7 @@
 #include <client/simple_client.hpp>
 
 #include <nscapi/nscapi_core_wrapper.hpp>
+#include <nscapi/nscapi_protobuf_command.hpp>
 
 #include <RegexController.h>
 #include <StreamResponse.h>
@@ -28,8 +29,12 @@ public:
 	void get_queries(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response);
 	void get_query(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response);
 	void query_command(Mongoose::Request &request, boost::smatch &what, Mongoose::StreamResponse &response);
-	void execute_query(std::string module, arg_vector args, Mongoose::StreamResponse &response);
-	void execute_query_nagios(std::string module, arg_vector args, Mongoose::StreamResponse &response);
-	void execute_query_text(std::string module, arg_vector args, Mongoose::StreamResponse &response);
+	void execute_query(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &response);
+	void execute_query_nagios(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &response);
+	void execute_query_text(std::string module, arg_vector args, bool cached, Mongoose::StreamResponse &response);
+
+private:
+	void run_query(const std::string &module, const arg_vector &args, bool cached, PB::Commands::QueryResponseMessage &response, Mongoose::StreamResponse &http_response);
+	bool run_core_query(const std::string &request, std::string &response);
 
 };
@@ -21,7 +21,7 @@ std::string decode_key(std::string encoded) {
 	return Mongoose::Helpers::decode_b64(encoded);
 }
 
-bool session_manager_interface::is_loggedin(std::string grant, Mongoose::Request &request, Mongoose::StreamResponse &response) {
+bool session_manager_interface::is_loggedin(const std::string &grant, Mongoose::Request &request, Mongoose::StreamResponse &response) {
 	std::list<std::string> errors;
 	if (!allowed_hosts.is_allowed(boost::asio::ip::address::from_string(request.getRemoteIp()), errors)) {
 // 		BOOST_FOREACH(const std::string &e, errors) {
@@ -37,12 +37,10 @@ bool session_manager_interface::is_loggedin(std::string grant, Mongoose::Request
 			auth = request.readHeader(HTTP_HDR_AUTH_LC);
 		}
 		if (boost::algorithm::starts_with(auth, "Basic ")) {
-			str::utils::token token = str::utils::split2(decode_key(auth.substr(6)), ":");
-			if (!validate_user(token.first, token.second)) {
+			if (!login_basic(auth, response)) {
 				response.setCodeForbidden("403 You're not allowed");
 				return false;
 			}
-			setup_token(token.first, response);
 			return can(grant, request, response);
 		} else if (boost::algorithm::starts_with(auth, "Bearer ")) {
 			std::string token = auth.substr(7);
@@ -58,13 +56,10 @@ bool session_manager_interface::is_loggedin(std::string grant, Mongoose::Request
 		}
 	}
 	if (request.hasVariable("Password")) {
-		std::string pwd = request.readHeader("Password");
-		std::string fake_user = "admin";
-		if (!validate_user(fake_user, pwd)) {
+		if (!login_password(request.readHeader("Password"), response)) {
 			response.setCodeForbidden("403 You're not allowed");
 			return false;
 		}
-		setup_token(fake_user, response);
 		return can(grant, request, response);
 	}
 	if (request.hasVariable("TOKEN")) {
@@ -77,13 +72,10 @@ bool session_manager_interface::is_loggedin(std::string grant, Mongoose::Request
 		return can(grant, request, response);
 	}
 	if (request.hasVariable("password")) {
-		std::string pwd = request.readHeader("password");
-		std::string fake_user = "admin";
-		if (!validate_user(fake_user, pwd)) {
+		if (!login_password(request.readHeader("password"), response)) {
 			response.setCodeForbidden("403 You're not allowed");
 			return false;
 		}
-		setup_token(fake_user, response);
 		return can(grant, request, response);
 	}
 
@@ -101,6 +93,48 @@ bool session_manager_interface::is_loggedin(std::string grant, Mongoose::Request
 	return can(grant, request, response);
 }
 
+// Clients sending credentials with every request get the token issued the first time (until the cache entry
+// or the token expires) so the header is only decoded and the password only checked once in a while.
+bool session_manager_interface::login_cached(const std::string &credential, Mongoose::StreamResponse &response) {
+	std::string user, token;
+	if (!credentials.lookup(credential, user, token) || !tokens.validate(token)) {
+		return false;
+	}
+	response.setCookie("token", token);
+	response.setCookie("uid", user);
+	return true;
+}
+
+bool session_manager_interface::login(const std::string &credential, const std::string &user, const std::string &password, Mongoose::StreamResponse &response) {
+	if (!validate_user(user, password)) {
+		return false;
+	}
+	std::string token = tokens.generate(user);
+	credentials.add(credential, user, token);
+	response.setCookie("token", token);
+	response.setCookie("uid", user);
+	return true;
+}
+
+bool session_manager_interface::login_basic(const std::string &auth, Mongoose::StreamResponse &response) {
+	if (login_cached(auth, response)) {
+		return true;
+	}
+	str::utils::token token = str::utils::split2(decode_key(auth.substr(6)), ":");
+	return login(auth, token.first, token.second, response);
+}
+
+bool session_manager_interface::login_password(const std::string &password, Mongoose::StreamResponse &response) {
+	if (password.empty()) {
+		return false;
+	}
+	// Prefixed so it can not be confused with an authorization header
+	std::string credential = "Password " + password;
+	if (login_cached(credential, response)) {
+		return true;
+	}
+	return login(credential, "admin", password, response);
+}
 
 std::list<std::string> session_manager_interface::boot() {
 	std::list<std::string> errors;
@@ -134,7 +168,7 @@ void session_manager_interface::get_user(const Mongoose::StreamResponse & respon
 	key = response.getCookie("token");
 }
 
-bool session_manager_interface::can(std::string grant, Mongoose::Request & request, Mongoose::StreamResponse & response) {
+bool session_manager_interface::can(const std::string &grant, Mongoose::Request & request, Mongoose::StreamResponse & response) {
 	std::string uid = response.getCookie("uid");
 	if (uid.empty()) {
 		if (tokens.can("anonymous", grant)) {
@@ -153,6 +187,7 @@ bool session_manager_interface::can(std::string grant, Mongoose::Request & reque
 void session_manager_interface::add_user(std::string user, std::string role, std::string password) {
 	tokens.add_user(user, role);
 	users[user] = password;
+	credentials.clear();
 }
 
 bool session_manager_interface::has_user(std::string user) const {
@@ -182,6 +217,9 @@ void session_manager_interface::set_metrics(std::string metrics, std::string met
 	metrics_store.set_list(metrics_list);
 	metrics_store.set_openmetrics(openmetrics);
 }
+query_cache& session_manager_interface::get_query_cache() {
+	return queries;
+}
 
 void session_manager_interface::add_log_message(bool is_error, error_handler_interface::log_entry entry) {
 	log_data->add_message(is_error, entry);
@@ -201,6 +239,11 @@ void session_manager_interface::set_allowed_hosts_cache(bool value) {
 	allowed_hosts.cached = value;
 }
 
+void session_manager_interface::set_token_limits(unsigned int ttl, std::size_t max_tokens, unsigned int credential_ttl) {
+	tokens.set_limits(ttl, max_tokens);
+	credentials.set_ttl(credential_ttl);
+}
+
 bool session_manager_interface::is_allowed(std::string ip) {
 	std::list<std::string> errors;
 	return allowed_hosts.is_allowed(boost::asio::ip::address::from_string(ip), errors);
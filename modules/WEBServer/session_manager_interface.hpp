@@ -2,6 +2,7 @@
 
 #include "error_handler_interface.hpp"
 #include "metrics_handler.hpp"
+#include "query_cache.hpp"
 #include "token_store.hpp"
 #include "metrics_handler.hpp"
 
@@ -20,12 +21,14 @@ private:
 
 	metrics_handler metrics_store;
 	token_store tokens;
+	credential_cache credentials;
+	query_cache queries;
 	socket_helpers::allowed_hosts_manager allowed_hosts;
 	boost::unordered_map<std::string, std::string> users;
 public:
 	session_manager_interface();
 
-	bool is_loggedin(std::string grant, Mongoose::Request &request, Mongoose::StreamResponse &response);
+	bool is_loggedin(const std::string &grant, Mongoose::Request &request, Mongoose::StreamResponse &response);
 
 	bool is_allowed(std::string ip);
 
@@ -37,6 +40,7 @@ public:
 	std::string get_metrics_v2();
 	std::string get_openmetrics();
 	void set_metrics(std::string metrics, std::string metrics_list, std::list<std::string> openmetrics);
+	query_cache& get_query_cache();
 
 	void add_log_message(bool is_error, error_handler_interface::log_entry entry);
 	error_handler_interface* get_log_data();
@@ -44,14 +48,21 @@ public:
 
 	void set_allowed_hosts(std::string host);
 	void set_allowed_hosts_cache(bool value);
+	void set_token_limits(unsigned int ttl, std::size_t max_tokens, unsigned int credential_ttl);
 
 	std::list<std::string> boot();
 	bool validate_user(const std::string user, const std::string &password);
 	void setup_token(std::string &user, Mongoose::StreamResponse & response);
 	void setup_user(std::string &token, Mongoose::StreamResponse & response);
-	bool can(std::string grant, Mongoose::Request & request, Mongoose::StreamResponse & response);
+	bool can(const std::string &grant, Mongoose::Request & request, Mongoose::StreamResponse & response);
 	void get_user(const Mongoose::StreamResponse & response, std::string &user, std::string &key) const;
 	void add_user(std::string user, std::string role, std::string password);
 	bool has_user(std::string user) const;
 	void add_grant(std::string role, std::string grant);
+
+private:
+	bool login(const std::string &credential, const std::string &user, const std::string &password, Mongoose::StreamResponse &response);
+	bool login_cached(const std::string &credential, Mongoose::StreamResponse &response);
+	bool login_basic(const std::string &auth, Mongoose::StreamResponse &response);
+	bool login_password(const std::string &password, Mongoose::StreamResponse &response);
 };
@@ -5,7 +5,7 @@
 #include <str/xtos.hpp>
 #include <file_helpers.hpp>
 
-#include <json_spirit.h>
+#include <json/stream_writer.hpp>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
@@ -59,16 +59,16 @@ void settings_controller::get(Mongoose::Request &request, boost::smatch &what, M
 		return;
 	}
 
-	json_spirit::Array node;
+	json::writer<Mongoose::StreamResponse> node(response);
+	node.begin_array();
 	BOOST_FOREACH(const PB::Settings::Node &s, rKeys.query().nodes()) {
-		json_spirit::Object rs;
-		rs["path"] = s.path();
-		rs["key"] = s.key();
-		rs["value"] = s.value();
-		node.push_back(rs);
+		node.begin_object();
+		node.member("path", s.path());
+		node.member("key", s.key());
+		node.member("value", s.value());
+		node.end_object();
 	}
-
-	response.append(json_spirit::write(node));
+	node.end_array();
 }
 
 
@@ -143,39 +143,40 @@ void settings_controller::get_desc(Mongoose::Request &request, boost::smatch &wh
 		}
 	}
 
-	json_spirit::Array node;
+	json::writer<Mongoose::StreamResponse> node(response);
+	node.begin_array();
+	std::string lookup_key;
 	BOOST_FOREACH(const PB::Settings::SettingsResponseMessage::Response::Inventory &s, rKeys.inventory()) {
-		json_spirit::Object rs;
-		rs["path"] = s.node().path();
-		rs["key"] = s.node().key();
+		node.begin_object();
+		node.member("path", s.node().path());
+		node.member("key", s.node().key());
 		if (values.size() > 0) {
-			values_type::const_iterator cit = values.find(s.node().path() + "$$$" + s.node().key());
+			lookup_key.assign(s.node().path()).append("$$$").append(s.node().key());
+			values_type::const_iterator cit = values.find(lookup_key);
 			if (cit != values.end()) {
-				rs["value"] = cit->second;
+				node.member("value", cit->second);
 			} else {
-				rs["value"] = s.info().default_value();
+				node.member("value", s.info().default_value());
 			}
 		}
-		rs["title"] = s.info().title();
-		rs["icon"] = s.info().icon();
-		rs["description"] = s.info().description();
-		rs["is_advanced_key"] = s.info().advanced();
-		rs["is_sample_key"] = s.info().sample();
-		rs["is_template_key"] = s.info().is_template();
-		rs["is_object"] = s.info().subkey();
-		rs["sample_usage"] = s.info().sample_usage();
-		rs["default_value"] = s.info().default_value();
-
-		json_spirit::Array plugins;
+		node.member("title", s.info().title());
+		node.member("icon", s.info().icon());
+		node.member("description", s.info().description());
+		node.member("is_advanced_key", s.info().advanced());
+		node.member("is_sample_key", s.info().sample());
+		node.member("is_template_key", s.info().is_template());
+		node.member("is_object", s.info().subkey());
+		node.member("sample_usage", s.info().sample_usage());
+		node.member("default_value", s.info().default_value());
+
+		node.key("plugins").begin_array();
 		BOOST_FOREACH(const ::std::string &p, s.info().plugin()) {
-			plugins.push_back(p);
+			node.value(p);
 		}
-		rs["plugins"] = plugins;
-
-		node.push_back(rs);
+		node.end_array();
+		node.end_object();
 	}
-
-	response.append(json_spirit::write(node));
+	node.end_array();
 }
 
 
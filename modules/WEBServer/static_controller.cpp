@@ -1,8 +1,12 @@
 #include "static_controller.hpp"
 
+#include <Helpers.h>
+
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <fstream>
+#include <sstream>
 
 #define BUF_SIZE 4096
 
@@ -26,6 +30,8 @@ std::string stripPath(std::string str) {
 StaticController::StaticController(boost::shared_ptr<session_manager_interface> session, std::string path) 
 	: session(session)
 	, base(path) 
+	, cache_size(0)
+	, max_cache_size(32 * 1024 * 1024)
 {}
 
 
@@ -36,11 +42,11 @@ Mongoose::Response* StaticController::handleRequest(Mongoose::Request &request)
   bool is_gif = boost::algorithm::ends_with(request.getUrl(), ".gif");
   bool is_png = boost::algorithm::ends_with(request.getUrl(), ".png");
   bool is_jpg = boost::algorithm::ends_with(request.getUrl(), ".jpg");
-  bool is_font = boost::algorithm::ends_with(request.getUrl(), ".ttf")
-    || boost::algorithm::ends_with(request.getUrl(), ".svg")
-    || boost::algorithm::ends_with(request.getUrl(), ".woff");
+  bool is_ttf = boost::algorithm::ends_with(request.getUrl(), ".ttf");
+  bool is_svg = boost::algorithm::ends_with(request.getUrl(), ".svg");
+  bool is_woff = boost::algorithm::ends_with(request.getUrl(), ".woff");
   Mongoose::StreamResponse *sr = new Mongoose::StreamResponse();
-  if (!is_js && !is_html && !is_css && !is_font && !is_jpg && !is_gif && !is_png) {
+  if (!is_js && !is_html && !is_css && !is_ttf && !is_svg && !is_woff && !is_jpg && !is_gif && !is_png) {
     sr->setCodeNotFound("Not found: " + request.getUrl());
     return sr;
   }
@@ -51,7 +57,8 @@ Mongoose::Response* StaticController::handleRequest(Mongoose::Request &request)
   }
 
   boost::filesystem::path file = base / path;
-  if (!boost::filesystem::is_regular_file(file)) {
+  cache_entry entry;
+  if (!get_file(path, file, is_js || is_css || is_html || is_ttf || is_svg, entry)) {
     sr->setCodeNotFound("Not found: " + path);
     return sr;
   }
@@ -60,8 +67,12 @@ Mongoose::Response* StaticController::handleRequest(Mongoose::Request &request)
     sr->setHeader("Content-Type", "application/javascript");
   else if (is_css)
     sr->setHeader("Content-Type", "text/css");
-  else if (is_font)
-    sr->setHeader("Content-Type", "text/html");
+  else if (is_ttf)
+    sr->setHeader("Content-Type", "font/ttf");
+  else if (is_svg)
+    sr->setHeader("Content-Type", "image/svg+xml");
+  else if (is_woff)
+    sr->setHeader("Content-Type", "font/woff");
   else if (is_gif)
     sr->setHeader("Content-Type", "image/gif");
   else if (is_jpg)
@@ -71,19 +82,83 @@ Mongoose::Response* StaticController::handleRequest(Mongoose::Request &request)
   else {
     sr->setHeader("Content-Type", "text/html");
   }
-  if (is_css || is_font || is_gif || is_png || is_jpg || is_js) {
+  if (!is_html) {
     sr->setHeader("Cache-Control", "max-age=3600"); //1 hour (60*60)
   }
+  sr->setHeader("ETag", entry.etag);
+  if (request.readHeader("If-None-Match") == entry.etag) {
+    sr->setCode(HTTP_NOT_MODIFIED, REASON_NOT_MODIFIED);
+    return sr;
+  }
+  sr->write(entry.content->c_str(), entry.content->size());
+  if (entry.gzip_content) {
+    sr->setGzipBody(entry.gzip_content);
+  }
+  return sr;
+}
+
+// Returns the (cached) file, it is re-read when it has been modified since it was cached
+bool StaticController::get_file(const std::string &path, const boost::filesystem::path &file, bool compress, cache_entry &entry) {
+  boost::system::error_code ec;
+  if (!boost::filesystem::is_regular_file(file, ec))
+    return false;
+  std::time_t modified = boost::filesystem::last_write_time(file, ec);
+  if (ec)
+    return false;
+  boost::uintmax_t size = boost::filesystem::file_size(file, ec);
+  if (ec)
+    return false;
+  {
+    boost::unique_lock<boost::mutex> lock(cache_mutex);
+    cache_map::const_iterator cit = cache.find(path);
+    if (cit != cache.end() && cit->second.modified == modified && cit->second.size == size) {
+      entry = cit->second;
+      return true;
+    }
+  }
+
   std::ifstream in(file.string().c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!in)
+    return false;
+  std::string content;
+  content.reserve(static_cast<std::size_t>(size));
   char buf[BUF_SIZE];
-
   do {
 	in.read(&buf[0], BUF_SIZE);
-	sr->write(&buf[0], in.gcount());
+	content.append(&buf[0], static_cast<std::size_t>(in.gcount()));
   } while (in.gcount() > 0);
   in.close();
-  return sr;
+
+  std::stringstream etag;
+  etag << "\"" << std::hex << size << "-" << modified << "\"";
+  entry.modified = modified;
+  entry.size = size;
+  entry.etag = etag.str();
+  entry.content.reset(new std::string(content));
+  entry.gzip_content.reset();
+  std::string compressed;
+  if (compress && Mongoose::Helpers::gzip(content, compressed) && compressed.size() < content.size()) {
+    entry.gzip_content.reset(new std::string(compressed));
+  }
+
+  std::size_t entry_size = entry.content->size() + (entry.gzip_content ? entry.gzip_content->size() : 0);
+  if (entry_size > max_cache_size / 4)
+    return true;
+  boost::unique_lock<boost::mutex> lock(cache_mutex);
+  cache_map::iterator it = cache.find(path);
+  if (it != cache.end()) {
+    cache_size -= it->second.content->size() + (it->second.gzip_content ? it->second.gzip_content->size() : 0);
+    cache.erase(it);
+  }
+  if (cache_size + entry_size > max_cache_size) {
+    cache.clear();
+    cache_size = 0;
+  }
+  cache[path] = entry;
+  cache_size += entry_size;
+  return true;
 }
+
 bool StaticController::handles(std::string method, std::string url) {
   return boost::algorithm::ends_with(url, ".js")
     || boost::algorithm::ends_with(url, ".css")
@@ -5,15 +5,37 @@
 #include <Controller.h>
 
 #include <boost/filesystem/operations.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
+#include <ctime>
 #include <string>
 
 class StaticController : public Mongoose::Controller {
+	// A file read from disk (and its gzip compressed version for text files)
+	struct cache_entry {
+		std::time_t modified;
+		boost::uintmax_t size;
+		std::string etag;
+		boost::shared_ptr<const std::string> content;
+		boost::shared_ptr<const std::string> gzip_content;
+	};
+	typedef boost::unordered_map<std::string, cache_entry> cache_map;
+
 	boost::shared_ptr<session_manager_interface> session;
 	boost::filesystem::path base;
+
+	boost::mutex cache_mutex;
+	cache_map cache;
+	std::size_t cache_size;
+	std::size_t max_cache_size;
 public:
 	StaticController(boost::shared_ptr<session_manager_interface> session, std::string path);
 
 	Mongoose::Response *handleRequest(Mongoose::Request &request);
 	bool handles(std::string method, std::string url);
-};
\ No newline at end of file
+
+private:
+	bool get_file(const std::string &path, const boost::filesystem::path &file, bool compress, cache_entry &entry);
+};
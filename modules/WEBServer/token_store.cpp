@@ -1,5 +1,14 @@
 #include "token_store.hpp"
 
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
+
+#ifdef USE_SSL
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#endif
+
 static const char alphanum[] = "0123456789" "ABCDEFGHIJKLMNOPQRSTUVWXYZ" "abcdefghijklmnopqrstuvwxyz";
 
 std::string token_store::generate_token(int len) {
@@ -9,15 +18,171 @@ std::string token_store::generate_token(int len) {
   return ret;
 }
 
-bool token_store::can(std::string uid, std::string grant) {
+void token_store::set_limits(unsigned int ttl_, std::size_t max_tokens) {
+	ttl = ttl_;
+	max_per_shard = max_tokens / shard_count;
+	if (max_per_shard == 0)
+		max_per_shard = 1;
+}
+
+token_store::shard& token_store::get_shard(const std::string &token) {
+	return shards[boost::hash<std::string>()(token) % shard_count];
+}
+
+bool token_store::lookup(const std::string &token, std::string *user) {
+	shard &s = get_shard(token);
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	boost::unique_lock<boost::mutex> lock(s.mutex);
+	token_map::iterator it = s.tokens.find(token);
+	if (it == s.tokens.end())
+		return false;
+	if (ttl > 0 && it->second.expires < now) {
+		s.lru.erase(it->second.lru);
+		s.tokens.erase(it);
+		return false;
+	}
+	it->second.expires = now + boost::posix_time::seconds(ttl);
+	s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+	if (user)
+		*user = it->second.user;
+	return true;
+}
+
+std::string token_store::generate(const std::string &user) {
+	std::string token = generate_token(32);
+	shard &s = get_shard(token);
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	boost::unique_lock<boost::mutex> lock(s.mutex);
+	purge(s, now);
+	token_map::iterator it = s.tokens.find(token);
+	if (it != s.tokens.end()) {
+		s.lru.erase(it->second.lru);
+	}
+	s.lru.push_front(token);
+	entry &e = s.tokens[token];
+	e.user = user;
+	e.expires = now + boost::posix_time::seconds(ttl);
+	e.lru = s.lru.begin();
+	return token;
+}
+
+void token_store::revoke(const std::string &token) {
+	shard &s = get_shard(token);
+	boost::unique_lock<boost::mutex> lock(s.mutex);
+	token_map::iterator it = s.tokens.find(token);
+	if (it != s.tokens.end()) {
+		s.lru.erase(it->second.lru);
+		s.tokens.erase(it);
+	}
+}
+
+std::size_t token_store::size() {
+	std::size_t ret = 0;
+	for (std::size_t i = 0; i < shard_count; i++) {
+		boost::unique_lock<boost::mutex> lock(shards[i].mutex);
+		ret += shards[i].tokens.size();
+	}
+	return ret;
+}
+
+// Drops expired tokens and makes room for one more (must be called with the shard locked)
+void token_store::purge(shard &s, const boost::posix_time::ptime &now) {
+	while (!s.lru.empty()) {
+		token_map::iterator it = s.tokens.find(s.lru.back());
+		bool expired = ttl > 0 && it->second.expires < now;
+		if (!expired && s.tokens.size() < max_per_shard)
+			break;
+		s.tokens.erase(it);
+		s.lru.pop_back();
+	}
+}
+
+bool token_store::can(const std::string &uid, const std::string &grant) {
 	return grants.validate(uid, grant);
 }
 
-void token_store::add_user(std::string user, std::string role) {
+void token_store::add_user(const std::string &user, const std::string &role) {
 	grants.add_user(user, role);
 }
 
-void token_store::add_grant(std::string role, std::string grant) {
+void token_store::add_grant(const std::string &role, const std::string &grant) {
 	grants.add_role(role, grant);
 }
 
+credential_cache::credential_cache() : ttl(30), max_entries(1000) {
+#ifdef USE_SSL
+	unsigned char buffer[32];
+	if (RAND_bytes(buffer, sizeof(buffer)) == 1)
+		key.assign(reinterpret_cast<const char*>(buffer), sizeof(buffer));
+#endif
+}
+
+bool credential_cache::digest(const std::string &credential, std::string &out) const {
+#ifdef USE_SSL
+	if (key.empty())
+		return false;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+	if (HMAC(EVP_sha256(), key.c_str(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char*>(credential.c_str()), credential.size(), md, &len) == NULL)
+		return false;
+	out.assign(reinterpret_cast<const char*>(md), len);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void credential_cache::set_ttl(unsigned int ttl_) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	ttl = ttl_;
+	entries.clear();
+	lru.clear();
+}
+
+bool credential_cache::lookup(const std::string &credential, std::string &user, std::string &token) {
+	std::string hash;
+	if (ttl == 0 || !digest(credential, hash))
+		return false;
+	boost::unique_lock<boost::mutex> lock(mutex);
+	entry_map::iterator it = entries.find(hash);
+	if (it == entries.end())
+		return false;
+	if (it->second.expires < boost::posix_time::microsec_clock::universal_time()) {
+		lru.erase(it->second.lru);
+		entries.erase(it);
+		return false;
+	}
+	lru.splice(lru.begin(), lru, it->second.lru);
+	user = it->second.user;
+	token = it->second.token;
+	return true;
+}
+
+void credential_cache::add(const std::string &credential, const std::string &user, const std::string &token) {
+	std::string hash;
+	if (ttl == 0 || !digest(credential, hash))
+		return;
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	boost::unique_lock<boost::mutex> lock(mutex);
+	entry_map::iterator it = entries.find(hash);
+	if (it == entries.end()) {
+		while (!lru.empty() && entries.size() >= max_entries) {
+			entries.erase(lru.back());
+			lru.pop_back();
+		}
+		lru.push_front(hash);
+		it = entries.insert(std::make_pair(hash, entry())).first;
+		it->second.lru = lru.begin();
+	} else {
+		lru.splice(lru.begin(), lru, it->second.lru);
+	}
+	it->second.user = user;
+	it->second.token = token;
+	it->second.expires = now + boost::posix_time::seconds(ttl);
+}
+
+void credential_cache::clear() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	entries.clear();
+	lru.clear();
+}
@@ -2,42 +2,100 @@
 
 #include "grant_store.hpp"
 
-#include <boost/unordered_set.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
+#include <list>
 #include <string>
 
-class token_store {
-	typedef boost::unordered_map<std::string, std::string> token_map;
+// Issued tokens (token -> user).
+//
+// Tokens expire when they have not been used for ttl seconds and the least recently used tokens are evicted
+// when there are more than max_tokens. The map is split in shards (each with its own lock) so concurrent
+// requests rarely contend.
+class token_store : boost::noncopyable {
+	typedef std::list<std::string> lru_list;
+	struct entry {
+		std::string user;
+		boost::posix_time::ptime expires;
+		lru_list::iterator lru;
+	};
+	typedef boost::unordered_map<std::string, entry> token_map;
+	struct shard {
+		boost::mutex mutex;
+		token_map tokens;
+		// Most recently used first, as every use extends the expiry the tail always expires first
+		lru_list lru;
+	};
+	static const std::size_t shard_count = 16;
 
-	token_map tokens;
+	shard shards[shard_count];
+	unsigned int ttl;
+	std::size_t max_per_shard;
 	grant_store grants;
 public:
+	token_store() : ttl(3600), max_per_shard(10000 / shard_count) {}
+
 	static std::string generate_token(int len);
 
+	void set_limits(unsigned int ttl, std::size_t max_tokens);
+
 	bool validate(const std::string &token) {
-		return tokens.find(token) != tokens.end();
+		return lookup(token, NULL);
 	}
-
-	std::string get(const std::string &token) const {
-		token_map::const_iterator cit = tokens.find(token);
-		if (cit != tokens.end()) {
-			return cit->second;
-		}
-		return "";
+	std::string get(const std::string &token) {
+		std::string user;
+		lookup(token, &user);
+		return user;
 	}
+	std::string generate(const std::string &user);
+	void revoke(const std::string &token);
+	std::size_t size();
 
-	std::string generate(std::string user) {
-		std::string token = generate_token(32);
-		tokens[token] = user;
-		return token;
-	}
+	bool can(const std::string &uid, const std::string &grant);
+	void add_user(const std::string &user, const std::string &role);
+	void add_grant(const std::string &role, const std::string &grant);
 
-	void revoke(const std::string &token) {
-		token_map::iterator it = tokens.find(token);
-		if (it != tokens.end())
-			tokens.erase(it);
-	}
-	bool can(std::string uid, std::string grant);
-	void add_user(std::string user, std::string role);
-	void add_grant(std::string role, std::string grant);
-};
\ No newline at end of file
+private:
+	shard& get_shard(const std::string &token);
+	bool lookup(const std::string &token, std::string *user);
+	void purge(shard &s, const boost::posix_time::ptime &now);
+};
+
+// Credentials (authorization headers) which have recently been verified and the token issued for them.
+// Entries are only kept for a short while so password checks (and token generation) are not repeated
+// for clients sending credentials with every request.
+//
+// Credentials are never stored, entries are keyed on a keyed digest (HMAC-SHA256 with a random per process key)
+// of the credential and the least recently used entries are evicted when there are more than max_entries.
+// Without SSL support there is no digest and nothing is cached.
+class credential_cache : boost::noncopyable {
+	typedef std::list<std::string> lru_list;
+	struct entry {
+		std::string user;
+		std::string token;
+		boost::posix_time::ptime expires;
+		lru_list::iterator lru;
+	};
+	typedef boost::unordered_map<std::string, entry> entry_map;
+
+	boost::mutex mutex;
+	entry_map entries;
+	// Most recently used first
+	lru_list lru;
+	unsigned int ttl;
+	std::size_t max_entries;
+	std::string key;
+public:
+	credential_cache();
+
+	void set_ttl(unsigned int ttl);
+	bool lookup(const std::string &credential, std::string &user, std::string &token);
+	void add(const std::string &credential, const std::string &user, const std::string &token);
+	void clear();
+
+private:
+	bool digest(const std::string &credential, std::string &out) const;
+};
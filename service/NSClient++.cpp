@@ -26,6 +26,7 @@
 
 #include <nscapi/nscapi_settings_helper.hpp>
 #include <settings/settings_core.hpp>
+#include <metrics/latency_histogram.hpp>
 #include <config.h>
 
 #include <boost/unordered_set.hpp>
@@ -304,6 +305,13 @@ bool NSClientT::boot_start_plugins(bool boot) {
 		LOG_ERROR_CORE("Unknown exception loading plugins");
 		return false;
 	}
+	try {
+		// Modules might have written values while starting so make sure readers get a fresh snapshot
+		if (!settings_manager::get_settings()->get_snapshot())
+			settings_manager::get_settings()->publish_snapshot();
+	} catch (const std::exception &e) {
+		LOG_ERROR_CORE_STD("Failed to publish settings snapshot: " + utf8::utf8_from_native(e.what()));
+	}
 	if (boot) {
 		settings_manager::get_core()->register_key(0xffff, "/settings/core", "settings maintenance interval", "Maintenance interval", "How often settings shall reload config if it has changed", "5m", true, false);
 		std::string smi = settings_manager::get_settings()->get_string("/settings/core", "settings maintenance interval", "5m");
@@ -494,6 +502,8 @@ PB::Metrics::MetricsBundle NSClientT::ownMetricsFetcher() {
 		m = bundle.add_value();
 		m->set_key("threads");
 		m->mutable_gauge_value()->set_value(threads);
+		metrics::add_latency(&bundle, "queue_wait", scheduler_.get_scheduler().get_queue_wait());
+		metrics::add_latency(&bundle, "run_time", scheduler_.get_scheduler().get_run_time());
 	} else {
 		PB::Metrics::Metric *m = bundle.add_value();
 		m->set_key("metrics.available");
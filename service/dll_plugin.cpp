@@ -23,6 +23,9 @@
 #include "NSCAPI.h"
 
 #include <str/xtos.hpp>
+#include <str/utils.hpp>
+
+#include <boost/foreach.hpp>
 
 /**
  * Default c-tor
@@ -42,6 +45,7 @@ nsclient::core::dll_plugin::dll_plugin(const unsigned int id, const boost::files
 	, fGetName(NULL)
 	, fGetVersion(NULL)
 	, fGetDescription(NULL)
+	, fGetDependencies(NULL)
 	, fHasCommandHandler(NULL)
 	, fHasMessageHandler(NULL)
 	, fHandleCommand(NULL)
@@ -271,7 +275,7 @@ NSCAPI::nagiosReturn nsclient::core::dll_plugin::handle_schedule(const std::stri
 	return handle_schedule(request.c_str(), request.size());
 }
 
-NSCAPI::nagiosReturn nsclient::core::dll_plugin::handleNotification(const char *channel, std::string &request, std::string &reply) {
+NSCAPI::nagiosReturn nsclient::core::dll_plugin::handleNotification(const char *channel, const std::string &request, std::string &reply) {
 	char *buffer = NULL;
 	unsigned int len = 0;
 	NSCAPI::nagiosReturn ret = handleNotification(channel, request.c_str(), request.size(), &buffer, &len);
@@ -406,6 +410,7 @@ void nsclient::core::dll_plugin::unload_dll() {
 	fGetName = NULL;
 	fGetVersion = NULL;
 	fGetDescription = NULL;
+	fGetDependencies = NULL;
 	fHasCommandHandler = NULL;
 	fHasMessageHandler = NULL;
 	fHandleCommand = NULL;
@@ -476,6 +481,9 @@ void nsclient::core::dll_plugin::loadRemoteProcs_(void) {
 		if (!fGetDescription)
 			throw plugin_exception(get_alias_or_name(), "Could not load NSGetModuleDescription");
 
+		// Optional: modules built before dependencies were introduced do not have it
+		fGetDependencies = (nscapi::plugin_api::lpGetDependencies)module_.load_proc("NSGetModuleDependencies");
+
 		fHasCommandHandler = (nscapi::plugin_api::lpHasCommandHandler)module_.load_proc("NSHasCommandHandler");
 		if (!fHasCommandHandler)
 			throw plugin_exception(get_alias_or_name(), "Could not load NSHasCommandHandler");
@@ -555,3 +563,23 @@ std::string nsclient::core::dll_plugin::get_version() {
 	getVersion(&major, &minor, &revision);
 	return str::xtos(major) + "." + str::xtos(minor) + "." + str::xtos(revision);
 }
+
+std::list<std::string> nsclient::core::dll_plugin::get_dependencies() {
+	std::list<std::string> ret;
+	if (fGetDependencies == NULL)
+		return ret;
+	char buffer[4096];
+	try {
+		if (!fGetDependencies(buffer, 4095))
+			return ret;
+	} catch (...) {
+		throw plugin_exception(get_alias_or_name(), "Unhandled exception in getDependencies.");
+	}
+	buffer[4095] = 0;
+	BOOST_FOREACH(std::string d, str::utils::split_lst(std::string(buffer), std::string(","))) {
+		boost::algorithm::trim(d);
+		if (!d.empty())
+			ret.push_back(d);
+	}
+	return ret;
+}
@@ -71,6 +71,7 @@ namespace nsclient {
 			nscapi::plugin_api::lpGetName fGetName;
 			nscapi::plugin_api::lpGetVersion fGetVersion;
 			nscapi::plugin_api::lpGetDescription fGetDescription;
+			nscapi::plugin_api::lpGetDependencies fGetDependencies;
 			nscapi::plugin_api::lpHasCommandHandler fHasCommandHandler;
 			nscapi::plugin_api::lpHasMessageHandler fHasMessageHandler;
 			nscapi::plugin_api::lpHandleCommand fHandleCommand;
@@ -101,7 +102,7 @@ namespace nsclient {
 			bool hasMessageHandler();
 			NSCAPI::nagiosReturn handleCommand(const std::string request, std::string &reply);
 			NSCAPI::nagiosReturn handle_schedule(const std::string &request);
-			NSCAPI::nagiosReturn handleNotification(const char *channel, std::string &request, std::string &reply);
+			NSCAPI::nagiosReturn handleNotification(const char *channel, const std::string &request, std::string &reply);
 			bool has_on_event();
 			NSCAPI::nagiosReturn on_event(const std::string &request);
 			NSCAPI::nagiosReturn fetchMetrics(std::string &request);
@@ -137,6 +138,7 @@ namespace nsclient {
 				handleMessage(payload.c_str(), static_cast<unsigned int>(payload.size()));
 			}
 			std::string get_version();
+			std::list<std::string> get_dependencies();
 
 		private:
 			void load_dll();
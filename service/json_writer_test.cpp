@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <json/stream_writer.hpp>
+
+#ifdef HAVE_JSON_SPIRIT
+#include <json_spirit.h>
+#endif
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <vector>
+
+// Counts allocations for the benchmark below
+static unsigned long long allocation_count = 0;
+void* operator new(std::size_t size) {
+	allocation_count++;
+	void *p = std::malloc(size == 0 ? 1 : size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+void operator delete(void *p) throw() {
+	std::free(p);
+}
+
+TEST(json_writer, structure) {
+	std::string out;
+	json::string_sink sink(out);
+	{
+		json::writer<json::string_sink> w(sink);
+		w.begin_object();
+		w.member("a", 1).member("b", "x");
+		w.key("c").begin_array().value(true).value(false).null().begin_object().end_object().begin_array().end_array().end_array();
+		w.key("d").begin_object().member("e", std::string("f")).end_object();
+		w.end_object();
+	}
+	EXPECT_EQ("{\"a\":1,\"b\":\"x\",\"c\":[true,false,null,{},[]],\"d\":{\"e\":\"f\"}}", out);
+}
+
+TEST(json_writer, escaping) {
+	std::string out;
+	json::string_sink sink(out);
+	{
+		json::writer<json::string_sink> w(sink);
+		w.value(std::string("q\"b\\n\nr\rt\t\x01\x1f z\xc3\xa5"));
+	}
+	EXPECT_EQ("\"q\\\"b\\\\n\\nr\\rt\\t\\u0001\\u001f z\xc3\xa5\"", out);
+}
+
+TEST(json_writer, numbers) {
+	std::string out;
+	json::string_sink sink(out);
+	{
+		json::writer<json::string_sink> w(sink);
+		w.begin_array();
+		w.value(0).value(-42).value(std::numeric_limits<long long>::min()).value(std::numeric_limits<unsigned long long>::max());
+		w.value(0.1).value(1.5).value(-2.0).value(1e300).value(1.0 / 3.0);
+		double zero = 0.0;
+		w.value(zero / zero).value(1.0 / zero);
+		w.end_array();
+	}
+	EXPECT_EQ("[0,-42,-9223372036854775808,18446744073709551615,0.1,1.5,-2,1e+300,0.33333333333333331,null,null]", out);
+}
+
+TEST(json_writer, large_output) {
+	std::string out;
+	json::string_sink sink(out);
+	std::string expected = "[";
+	std::string big(10000, 'x');
+	{
+		json::writer<json::string_sink> w(sink);
+		w.begin_array();
+		for (int i = 0; i < 1000; i++) {
+			w.value(i);
+			expected += (i == 0 ? "" : ",") + boost::lexical_cast<std::string>(i);
+		}
+		w.value(big);
+		w.end_array();
+	}
+	expected += ",\"" + big + "\"]";
+	EXPECT_EQ(expected, out);
+}
+
+namespace {
+	struct setting {
+		std::string path, key, value, title, description;
+	};
+	struct null_sink {
+		std::size_t size;
+		null_sink() : size(0) {}
+		void write(const char *, std::size_t len) {
+			size += len;
+		}
+	};
+}
+
+// Listing every settings key (as /api/v1/settings/descriptions does) with the streaming writer and with a json_spirit
+// document. Run with --gtest_also_run_disabled_tests.
+TEST(json_writer, DISABLED_benchmark) {
+	std::vector<setting> settings;
+	for (int i = 0; i < 20000; i++) {
+		setting s;
+		s.path = "/settings/some/path/" + boost::lexical_cast<std::string>(i / 10);
+		s.key = "key " + boost::lexical_cast<std::string>(i);
+		s.value = "value of the key";
+		s.title = "A title";
+		s.description = "A longer description of what the key does and how to use it.";
+		settings.push_back(s);
+	}
+
+	unsigned long long before = allocation_count;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	null_sink sink;
+	{
+		json::writer<null_sink> w(sink);
+		w.begin_array();
+		BOOST_FOREACH(const setting &s, settings) {
+			w.begin_object();
+			w.member("path", s.path).member("key", s.key).member("value", s.value);
+			w.member("title", s.title).member("description", s.description);
+			w.member("is_advanced_key", false).member("is_sample_key", false);
+			w.key("plugins").begin_array().value("WEBServer").end_array();
+			w.end_object();
+		}
+		w.end_array();
+	}
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+	std::cout << "json::writer: " << sink.size << " bytes, " << (allocation_count - before) << " allocations, " << elapsed.total_microseconds() << "us" << std::endl;
+	EXPECT_EQ(0, allocation_count - before);
+
+#ifdef HAVE_JSON_SPIRIT
+	before = allocation_count;
+	start = boost::posix_time::microsec_clock::universal_time();
+	std::string data;
+	{
+		json_spirit::Array node;
+		BOOST_FOREACH(const setting &s, settings) {
+			json_spirit::Object rs;
+			rs["path"] = s.path;
+			rs["key"] = s.key;
+			rs["value"] = s.value;
+			rs["title"] = s.title;
+			rs["description"] = s.description;
+			rs["is_advanced_key"] = false;
+			rs["is_sample_key"] = false;
+			json_spirit::Array plugins;
+			plugins.push_back("WEBServer");
+			rs["plugins"] = plugins;
+			node.push_back(rs);
+		}
+		data = json_spirit::write(node);
+	}
+	elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+	std::cout << "json_spirit: " << data.size() << " bytes, " << (allocation_count - before) << " allocations, " << elapsed.total_microseconds() << "us" << std::endl;
+#endif
+}
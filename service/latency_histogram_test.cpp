@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <metrics/latency_histogram.hpp>
+
+#include <gtest/gtest.h>
+
+TEST(latency_histogram, buckets) {
+	for (boost::uint64_t v = 0; v < 100000; v += 7) {
+		unsigned int i = metrics::latency_histogram::index_of(v);
+		EXPECT_LT(v, metrics::latency_histogram::upper_bound(i));
+		if (i > 0)
+			EXPECT_GE(v, metrics::latency_histogram::upper_bound(i - 1));
+	}
+	EXPECT_EQ(metrics::latency_histogram::bucket_count - 1, metrics::latency_histogram::index_of(0xffffffffffffffffULL));
+}
+
+TEST(latency_histogram, percentiles) {
+	metrics::latency_histogram h;
+	for (boost::uint64_t v = 1; v <= 1000; v++)
+		h.record(v * 1000);
+	metrics::latency_histogram::snapshot s = h.get_snapshot();
+	EXPECT_EQ(1000, s.count);
+	EXPECT_EQ(1000000, s.max);
+	EXPECT_EQ(500500, s.average());
+	EXPECT_NEAR(500000, s.percentile(0.5), 500000 / 8);
+	EXPECT_NEAR(990000, s.percentile(0.99), 990000 / 8);
+	EXPECT_EQ(1000000, s.percentile(1.0));
+	EXPECT_EQ(0, s.count_below(1000));
+	EXPECT_EQ(1000, s.count_below(2000000));
+}
+
+TEST(latency_histogram, registry_limit) {
+	metrics::latency_registry r(2);
+	r.record("a", 10);
+	r.record("b", 20);
+	r.record("c", 30);
+	r.record("d", 40);
+	r.record("a", 10);
+	metrics::latency_registry::map_instance all = r.get_all();
+	ASSERT_EQ(3, all->size());
+	EXPECT_EQ(2, all->find("a")->second->get_count());
+	EXPECT_EQ(2, all->find("other")->second->get_count());
+}
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notification_bus.hpp"
+
+#include <nscapi/nscapi_protobuf_functions.hpp>
+
+#include <str/xtos.hpp>
+#include <str/utils.hpp>
+#include <utf8.hpp>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace {
+	// The command (of the first result) in a submission, used to label the responses we create
+	std::string get_command(const std::string &request) {
+		PB::Commands::SubmitRequestMessage message;
+		if (!message.ParseFromString(request) || message.payload_size() == 0)
+			return "";
+		return message.payload(0).command();
+	}
+
+	std::string get_response_message(const std::string &response) {
+		PB::Commands::SubmitResponseMessage message;
+		if (!message.ParseFromString(response) || message.payload_size() == 0)
+			return "";
+		return message.payload(0).result().message();
+	}
+
+	void create_dropped_response(const std::string &command, std::string &buffer) {
+		PB::Commands::SubmitResponseMessage message;
+		PB::Commands::SubmitResponseMessage::Response *payload = message.add_payload();
+		payload->set_command(command);
+		payload->mutable_result()->set_message("Message dropped: queue full");
+		payload->mutable_result()->set_code(PB::Common::Result_StatusCodeType_STATUS_ERROR);
+		message.SerializeToString(&buffer);
+	}
+}
+
+void nsclient::core::notification_bus::configure(bool async, std::size_t queue_size, overflow_policy policy, unsigned int block_timeout_ms) {
+	stop();
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	async_ = async;
+	queue_size_ = queue_size == 0 ? 1 : queue_size;
+	policy_ = policy;
+	block_timeout_ms_ = block_timeout_ms;
+}
+
+NSCAPI::errorReturn nsclient::core::notification_bus::submit(const std::string &channel, const std::string &request, std::string &response) {
+	route_instance route;
+	bool async = true;
+	try {
+		route = resolve(channel);
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		async = async_;
+	} catch (const std::exception &e) {
+		LOG_ERROR_CORE("No handler for channel: " + channel + ": " + utf8::utf8_from_native(e.what()));
+		return NSCAPI::api_return_codes::hasFailed;
+	} catch (...) {
+		LOG_ERROR_CORE("No handler for channel: " + channel);
+		return NSCAPI::api_return_codes::hasFailed;
+	}
+
+	bool found = false;
+	item i;
+	if (async) {
+		i.request.reset(new std::string(request));
+		i.queued = boost::posix_time::microsec_clock::universal_time();
+	}
+	// Only parsed when we answer on behalf of the subscribers
+	std::string command;
+	bool has_command = false;
+	BOOST_FOREACH(const target &t, *route) {
+		if (!has_command && (async || t.special != channel_normal)) {
+			command = get_command(request);
+			has_command = true;
+		}
+		if (t.special == channel_noop) {
+			found = true;
+			nscapi::protobuf::functions::create_simple_submit_response_ok(*t.channel, command, "Message discarded", response);
+			continue;
+		}
+		if (t.special == channel_log) {
+			log_notification(request);
+			found = true;
+			nscapi::protobuf::functions::create_simple_submit_response_ok(*t.channel, command, "Message logged", response);
+			continue;
+		}
+		if (t.subscribers.empty())
+			continue;
+		found = true;
+		if (!async) {
+			BOOST_FOREACH(const subscriber_type &s, t.subscribers) {
+				metrics::stopwatch timer;
+				try {
+					s->plugin->handleNotification(t.channel->c_str(), request, response);
+				} catch (...) {
+					LOG_ERROR_CORE("Plugin throw exception: " + s->plugin->get_alias_or_name());
+				}
+				boost::posix_time::time_duration elapsed = timer.elapsed();
+				channel_latency_.record(*t.channel, elapsed);
+				subscriber_latency_.record(s->plugin->get_alias_or_name(), elapsed);
+			}
+			continue;
+		}
+		i.channel_id = t.channel_id;
+		i.channel = t.channel;
+		int accepted = 0;
+		BOOST_FOREACH(const subscriber_type &s, t.subscribers) {
+			if (enqueue(s, i))
+				accepted++;
+		}
+		if (accepted > 0)
+			nscapi::protobuf::functions::create_simple_submit_response_ok(*t.channel, command, "Message queued", response);
+		else
+			create_dropped_response(command, response);
+	}
+	if (!found) {
+		LOG_ERROR_CORE("No handler for channel: " + channel);
+		return NSCAPI::api_return_codes::hasFailed;
+	}
+	return NSCAPI::api_return_codes::isSuccess;
+}
+
+nsclient::core::notification_bus::route_instance nsclient::core::notification_bus::resolve(const std::string &channel) {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		std::map<std::string, route_instance>::const_iterator cit = routes_.find(channel);
+		if (cit != routes_.end())
+			return cit->second;
+	}
+
+	// Resolve outside our lock (the resolver takes the channel list lock)
+	std::list<std::pair<std::string, std::list<plugin_type> > > resolved;
+	BOOST_FOREACH(const std::string &c, str::utils::split_lst(channel, std::string(","))) {
+		std::string name = boost::algorithm::to_lower_copy(c);
+		if (name == "noop" || name == "log")
+			resolved.push_back(std::make_pair(c, std::list<plugin_type>()));
+		else
+			resolved.push_back(std::make_pair(c, resolver_(c)));
+	}
+
+	std::list<subscriber_type> started, replaced;
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	boost::shared_ptr<route_type> route(new route_type());
+	typedef std::pair<std::string, std::list<plugin_type> > resolved_type;
+	BOOST_FOREACH(const resolved_type &r, resolved) {
+		target t;
+		std::string key = boost::algorithm::to_lower_copy(r.first);
+		std::map<std::string, unsigned int>::const_iterator id = channel_ids_.find(key);
+		if (id == channel_ids_.end()) {
+			t.channel_id = static_cast<unsigned int>(channel_names_.size());
+			channel_ids_[key] = t.channel_id;
+			channel_names_.push_back(boost::shared_ptr<const std::string>(new std::string(r.first)));
+		} else {
+			t.channel_id = id->second;
+		}
+		t.channel = channel_names_[t.channel_id];
+		t.special = key == "noop" ? channel_noop : key == "log" ? channel_log : channel_normal;
+		BOOST_FOREACH(const plugin_type &p, r.second) {
+			if (p)
+				t.subscribers.push_back(get_subscriber(p, started, replaced));
+		}
+		route->push_back(t);
+	}
+	routes_[channel] = route;
+	lock.unlock();
+
+	// Dispatch threads are started and joined outside our lock (a stopping dispatcher might be waiting for a plugin)
+	BOOST_FOREACH(const subscriber_type &s, started) {
+		start_subscriber(s);
+	}
+	BOOST_FOREACH(const subscriber_type &s, replaced) {
+		stop_subscriber(s);
+	}
+	return route;
+}
+
+// Must be called with mutex_ held: new subscribers which need a dispatch thread are added to started and the ones
+// they replace (the plugin was reloaded) to replaced so the caller can start/stop them after releasing the lock.
+nsclient::core::notification_bus::subscriber_type nsclient::core::notification_bus::get_subscriber(plugin_type plugin, std::list<subscriber_type> &started, std::list<subscriber_type> &replaced) {
+	std::map<unsigned long, subscriber_type>::const_iterator it = subscribers_.find(plugin->get_id());
+	if (it != subscribers_.end() && it->second->plugin == plugin)
+		return it->second;
+	subscriber_type s(new subscriber(plugin, queue_size_, policy_, block_timeout_ms_));
+	if (async_)
+		started.push_back(s);
+	if (it != subscribers_.end())
+		replaced.push_back(it->second);
+	subscribers_[plugin->get_id()] = s;
+	return s;
+}
+
+void nsclient::core::notification_bus::start_subscriber(subscriber_type s) {
+	boost::unique_lock<boost::mutex> lock(s->mutex);
+	// Might have been stopped (by a reconfigure or another resolve) before we got here
+	if (!s->stop && !s->thread)
+		s->thread.reset(new boost::thread(boost::bind(&notification_bus::dispatch, this, s)));
+}
+
+bool nsclient::core::notification_bus::enqueue(subscriber_type s, const item &i) {
+	boost::unique_lock<boost::mutex> lock(s->mutex);
+	counters &c = s->stats[i.channel_id];
+	if (s->queue.size() >= s->queue_size && s->policy == overflow_block && !s->stop) {
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(s->block_timeout_ms);
+		while (s->queue.size() >= s->queue_size && !s->stop) {
+			if (!s->not_full.timed_wait(lock, deadline))
+				break;
+		}
+	}
+	if (s->stop || s->queue.size() >= s->queue_size) {
+		c.dropped++;
+		return false;
+	}
+	c.queued++;
+	s->queue.push_back(i);
+	s->not_empty.notify_one();
+	return true;
+}
+
+void nsclient::core::notification_bus::dispatch(subscriber_type s) {
+	while (true) {
+		item i;
+		{
+			boost::unique_lock<boost::mutex> lock(s->mutex);
+			while (s->queue.empty() && !s->stop)
+				s->not_empty.wait(lock);
+			if (s->stop)
+				return;
+			i = s->queue.front();
+			s->queue.pop_front();
+			s->not_full.notify_one();
+		}
+		metrics::stopwatch timer;
+		boost::posix_time::time_duration wait = timer.start - i.queued;
+		unsigned long long lag = wait.total_milliseconds();
+		queue_wait_.record(wait);
+		bool ok = false;
+		try {
+			std::string response;
+			ok = s->plugin->handleNotification(i.channel->c_str(), *i.request, response) == NSCAPI::api_return_codes::isSuccess;
+			// The sender was told the message was queued so failures are only seen in the log
+			if (!ok)
+				LOG_ERROR_CORE("Failed to deliver notification on " + *i.channel + " to " + s->plugin->get_alias_or_name() + ": " + get_response_message(response));
+		} catch (const std::exception &e) {
+			LOG_ERROR_CORE("Failed to deliver notification on " + *i.channel + " to " + s->plugin->get_alias_or_name() + ": " + utf8::utf8_from_native(e.what()));
+		} catch (...) {
+			LOG_ERROR_CORE("Failed to deliver notification on " + *i.channel + " to " + s->plugin->get_alias_or_name());
+		}
+		boost::posix_time::time_duration elapsed = timer.elapsed();
+		channel_latency_.record(*i.channel, elapsed);
+		subscriber_latency_.record(s->plugin->get_alias_or_name(), elapsed);
+		boost::unique_lock<boost::mutex> lock(s->mutex);
+		counters &c = s->stats[i.channel_id];
+		c.delivered++;
+		if (!ok)
+			c.failed++;
+		c.last_lag_ms = lag;
+		if (lag > c.max_lag_ms)
+			c.max_lag_ms = lag;
+	}
+}
+
+void nsclient::core::notification_bus::stop_subscriber(subscriber_type s) {
+	boost::shared_ptr<boost::thread> thread;
+	{
+		boost::unique_lock<boost::mutex> lock(s->mutex);
+		thread = s->thread;
+		s->stop = true;
+		BOOST_FOREACH(const item &i, s->queue) {
+			s->stats[i.channel_id].dropped++;
+		}
+		s->queue.clear();
+		s->not_empty.notify_all();
+		s->not_full.notify_all();
+	}
+	if (thread && thread->get_id() != boost::this_thread::get_id()) {
+		thread->join();
+	}
+}
+
+void nsclient::core::notification_bus::invalidate() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	routes_.clear();
+}
+
+void nsclient::core::notification_bus::remove_subscriber(unsigned long plugin_id) {
+	subscriber_type s;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		routes_.clear();
+		std::map<unsigned long, subscriber_type>::iterator it = subscribers_.find(plugin_id);
+		if (it == subscribers_.end())
+			return;
+		s = it->second;
+		subscribers_.erase(it);
+	}
+	stop_subscriber(s);
+}
+
+void nsclient::core::notification_bus::stop() {
+	std::map<unsigned long, subscriber_type> subscribers;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		routes_.clear();
+		subscribers.swap(subscribers_);
+	}
+	typedef std::map<unsigned long, subscriber_type>::value_type subscriber_entry;
+	BOOST_FOREACH(const subscriber_entry &e, subscribers) {
+		stop_subscriber(e.second);
+	}
+}
+
+PB::Metrics::MetricsBundle nsclient::core::notification_bus::get_metrics() {
+	PB::Metrics::MetricsBundle bundle;
+	bundle.set_key("notifications");
+	std::map<unsigned int, counters> channels;
+	PB::Metrics::MetricsBundle *subscribers = bundle.add_children();
+	subscribers->set_key("subscribers");
+
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	typedef std::map<unsigned long, subscriber_type>::value_type subscriber_entry;
+	BOOST_FOREACH(const subscriber_entry &e, subscribers_) {
+		boost::unique_lock<boost::mutex> slock(e.second->mutex);
+		unsigned long long dropped = 0;
+		typedef std::map<unsigned int, counters>::value_type counter_entry;
+		BOOST_FOREACH(const counter_entry &ce, e.second->stats) {
+			counters &c = channels[ce.first];
+			c.queued += ce.second.queued;
+			c.delivered += ce.second.delivered;
+			c.dropped += ce.second.dropped;
+			c.failed += ce.second.failed;
+			c.last_lag_ms = std::max(c.last_lag_ms, ce.second.last_lag_ms);
+			c.max_lag_ms = std::max(c.max_lag_ms, ce.second.max_lag_ms);
+			dropped += ce.second.dropped;
+		}
+		PB::Metrics::MetricsBundle *sb = subscribers->add_children();
+		sb->set_key(e.second->plugin->get_alias_or_name());
+		metrics::add_gauge(sb, "queue", e.second->queue.size());
+		metrics::add_counter(sb, "dropped", dropped);
+	}
+
+	PB::Metrics::MetricsBundle *cb = bundle.add_children();
+	cb->set_key("channels");
+	typedef std::map<unsigned int, counters>::value_type channel_entry;
+	BOOST_FOREACH(const channel_entry &e, channels) {
+		PB::Metrics::MetricsBundle *b = cb->add_children();
+		b->set_key(*channel_names_[e.first]);
+		metrics::add_counter(b, "queued", e.second.queued);
+		metrics::add_counter(b, "delivered", e.second.delivered);
+		metrics::add_counter(b, "dropped", e.second.dropped);
+		metrics::add_counter(b, "failed", e.second.failed);
+		metrics::add_gauge(b, "lag", e.second.last_lag_ms);
+		metrics::add_gauge(b, "max_lag", e.second.max_lag_ms);
+	}
+	lock.unlock();
+
+	PB::Metrics::MetricsBundle *lb = bundle.add_children();
+	lb->set_key("latency");
+	metrics::add_latency(lb, "channels", channel_latency_);
+	metrics::add_latency(lb, "subscribers", subscriber_latency_);
+	metrics::add_latency(lb, "queue_wait", queue_wait_);
+	return bundle;
+}
+
+void nsclient::core::notification_bus::log_notification(const std::string &request) {
+	PB::Commands::SubmitRequestMessage msg;
+	msg.ParseFromString(request);
+	for (int i = 0; i < msg.payload_size(); i++) {
+		LOG_INFO_CORE("Notification " + str::xtos(msg.payload(i).result()) + ": " + nscapi::protobuf::functions::query_data_to_nagios_string(msg.payload(i), nscapi::protobuf::functions::no_truncation));
+	}
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "plugin_list.hpp"
+
+#include <nsclient/logger/logger.hpp>
+#include <nscapi/nscapi_protobuf_metrics.hpp>
+#include <metrics/latency_histogram.hpp>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nsclient {
+	namespace core {
+
+		/**
+		 * Delivers notifications (submissions) to the plugins listening on a channel.
+		 *
+		 * Channel strings ("a,b,c") are resolved once into channel ids and subscriber lists and cached until
+		 * the listeners change. By default notifications are delivered on the thread of the sender which gets
+		 * the response from the subscriber. In async mode (opt-in) every subscriber has a bounded queue and a
+		 * dispatch thread so a slow subscriber only delays itself, when a queue is full the message is either
+		 * dropped or the sender blocks (for a limited time) depending on the overflow policy. The sender only
+		 * learns that the message was queued, delivery failures are logged.
+		 *
+		 * Sync stays the default since senders (such as the client modules forwarding a submission and scripts
+		 * checking the result) rely on getting the real response from the subscriber, which async mode can not
+		 * give them.
+		 */
+		class notification_bus : boost::noncopyable {
+		public:
+			typedef boost::function<std::list<plugin_type>(std::string)> resolver_type;
+			enum overflow_policy {
+				overflow_block,
+				overflow_drop
+			};
+
+		private:
+			struct counters {
+				unsigned long long queued;
+				unsigned long long delivered;
+				unsigned long long dropped;
+				unsigned long long failed;
+				unsigned long long last_lag_ms;
+				unsigned long long max_lag_ms;
+				counters() : queued(0), delivered(0), dropped(0), failed(0), last_lag_ms(0), max_lag_ms(0) {}
+			};
+			struct item {
+				unsigned int channel_id;
+				boost::shared_ptr<const std::string> channel;
+				boost::shared_ptr<const std::string> request;
+				boost::posix_time::ptime queued;
+				item() : channel_id(0) {}
+			};
+			struct subscriber : boost::noncopyable {
+				plugin_type plugin;
+				std::size_t queue_size;
+				overflow_policy policy;
+				unsigned int block_timeout_ms;
+
+				boost::mutex mutex;
+				boost::condition_variable not_empty;
+				boost::condition_variable not_full;
+				std::deque<item> queue;
+				bool stop;
+				std::map<unsigned int, counters> stats;
+				boost::shared_ptr<boost::thread> thread;
+
+				subscriber(plugin_type plugin, std::size_t queue_size, overflow_policy policy, unsigned int block_timeout_ms)
+					: plugin(plugin), queue_size(queue_size), policy(policy), block_timeout_ms(block_timeout_ms), stop(false) {}
+			};
+			typedef boost::shared_ptr<subscriber> subscriber_type;
+
+			enum special_channel {
+				channel_normal,
+				channel_noop,
+				channel_log
+			};
+			struct target {
+				unsigned int channel_id;
+				special_channel special;
+				boost::shared_ptr<const std::string> channel;
+				std::list<subscriber_type> subscribers;
+			};
+			typedef std::vector<target> route_type;
+			typedef boost::shared_ptr<const route_type> route_instance;
+
+			nsclient::logging::logger_instance logger_;
+			resolver_type resolver_;
+
+			boost::mutex mutex_;
+			bool async_;
+			std::size_t queue_size_;
+			overflow_policy policy_;
+			unsigned int block_timeout_ms_;
+			std::map<std::string, unsigned int> channel_ids_;
+			std::vector<boost::shared_ptr<const std::string> > channel_names_;
+			std::map<std::string, route_instance> routes_;
+			std::map<unsigned long, subscriber_type> subscribers_;
+			// Time spent in handleNotification and (async mode) time spent waiting in the queues
+			metrics::latency_registry channel_latency_;
+			metrics::latency_registry subscriber_latency_;
+			metrics::latency_histogram queue_wait_;
+
+		public:
+			notification_bus(nsclient::logging::logger_instance logger, resolver_type resolver)
+				: logger_(logger)
+				, resolver_(resolver)
+				, async_(false)
+				, queue_size_(1000)
+				, policy_(overflow_block)
+				, block_timeout_ms_(5000) {}
+			~notification_bus() {
+				stop();
+			}
+
+			// Stops all dispatch threads and applies the new configuration
+			void configure(bool async, std::size_t queue_size, overflow_policy policy, unsigned int block_timeout_ms);
+			NSCAPI::errorReturn submit(const std::string &channel, const std::string &request, std::string &response);
+			// Must be called when listeners are added or removed
+			void invalidate();
+			void remove_subscriber(unsigned long plugin_id);
+			// Stops all dispatch threads (messages still queued are dropped)
+			void stop();
+			PB::Metrics::MetricsBundle get_metrics();
+
+		private:
+			route_instance resolve(const std::string &channel);
+			subscriber_type get_subscriber(plugin_type plugin, std::list<subscriber_type> &started, std::list<subscriber_type> &replaced);
+			void start_subscriber(subscriber_type s);
+			bool enqueue(subscriber_type s, const item &i);
+			void dispatch(subscriber_type s);
+			void stop_subscriber(subscriber_type s);
+			void log_notification(const std::string &request);
+			nsclient::logging::logger_instance get_logger() {
+				return logger_;
+			}
+		};
+	}
+}
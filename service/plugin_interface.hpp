@@ -4,6 +4,7 @@
 #include <nsclient/logger/logger.hpp>
 
 #include <string>
+#include <list>
 
 #include <boost/filesystem/path.hpp>
 namespace nsclient {
@@ -48,11 +49,13 @@ namespace nsclient {
       virtual std::string getName() = 0;
       virtual std::string getDescription() = 0;
       virtual std::string get_version() = 0;
+      // Names (or aliases) of the modules which has to be started before this one
+      virtual std::list<std::string> get_dependencies() { return std::list<std::string>(); }
 
       virtual bool hasCommandHandler() = 0;
       virtual NSCAPI::nagiosReturn handleCommand(const std::string request, std::string &reply) = 0;
       virtual bool hasNotificationHandler() = 0;
-      virtual NSCAPI::nagiosReturn handleNotification(const char *channel, std::string &request, std::string &reply) = 0;
+      virtual NSCAPI::nagiosReturn handleNotification(const char *channel, const std::string &request, std::string &reply) = 0;
       virtual NSCAPI::nagiosReturn handle_schedule(const std::string &request) = 0;
       virtual bool hasMessageHandler() = 0;
       virtual void handleMessage(const char* data, unsigned int len) = 0;
@@ -53,6 +53,8 @@ nsclient::core::plugin_manager::plugin_manager(nsclient::core::path_instance pat
 	, plugin_list_(log_instance_)
 	, commands_(log_instance_)
 	, channels_(log_instance_)
+	, notifications_(log_instance_, boost::bind(&nsclient::channels::get, &channels_, _1))
+	, startup_(log_instance_)
 	, metrics_fetchers_(log_instance_)
 	, metrics_submitetrs_(log_instance_)
 	, plugin_cache_(log_instance_)
@@ -233,25 +235,8 @@ bool nsclient::core::plugin_manager::load_single_plugin(std::string plugin, std:
 }
 
 void nsclient::core::plugin_manager::start_plugins(NSCAPI::moduleLoadMode mode) {
-	std::set<long> broken;
-	BOOST_FOREACH(plugin_type plugin, plugin_list_.get_plugins()) {
-		LOG_DEBUG_CORE_STD("Loading plugin: " + plugin->getModule())
-		try {
-			if (!plugin->load_plugin(mode)) {
-				LOG_ERROR_CORE_STD("Plugin refused to load: " + plugin->getModule());
-				broken.insert(plugin->get_id());
-			}
-		} catch (const plugin_exception &e) {
-			broken.insert(plugin->get_id());
-			LOG_ERROR_CORE_STD("Could not load plugin: " + e.reason() + ": " + e.file());
-		} catch (const std::exception &e) {
-			broken.insert(plugin->get_id());
-			LOG_ERROR_CORE_STD("Could not load plugin: " + plugin->get_alias() + ": " + e.what());
-		} catch (...) {
-			broken.insert(plugin->get_id());
-			LOG_ERROR_CORE_STD("Could not load plugin: " + plugin->getModule());
-		}
-	}
+	configure_notifications();
+	std::set<long> broken = startup_.start(plugin_list_.get_plugins(), mode, get_load_threads());
 	BOOST_FOREACH(const long &id, broken) {
 		plugin_list_.remove(id);
 	}
@@ -260,6 +245,7 @@ void nsclient::core::plugin_manager::start_plugins(NSCAPI::moduleLoadMode mode)
  * Unload all plug-ins
  */
 void nsclient::core::plugin_manager::stop_plugins() {
+	notifications_.stop();
 	commands_.remove_all();
 	channels_.remove_all();
 	std::list<plugin_type> tmp = plugin_list_.get_plugins();
@@ -398,6 +384,9 @@ bool nsclient::core::plugin_manager::remove_plugin(const std::string name) {
 	unsigned int plugin_id = plugin->get_id();
 	plugin_list_.remove(plugin_id);
 	commands_.remove_plugin(plugin_id);
+	notifications_.remove_subscriber(plugin_id);
+	startup_.remove_timing(plugin->get_alias_or_name());
+	channels_.remove_plugin(plugin_id);
 	metrics_fetchers_.remove_plugin(plugin_id);
 	metrics_submitetrs_.remove_plugin(plugin_id);
 	plugin->unload_plugin();
@@ -499,7 +488,9 @@ NSCAPI::nagiosReturn nsclient::core::plugin_manager::execute_query(const std::st
 
 		BOOST_FOREACH(command_chunk_type::value_type &v, command_chunks) {
 			std::string local_response;
+			metrics::stopwatch timer;
 			int ret = v.second.plugin->handleCommand(v.second.request.SerializeAsString(), local_response);
+			record_latency(v.second.plugin, v.second.request, timer.elapsed());
 			if (ret != NSCAPI::cmd_return_codes::isSuccess) {
 				LOG_ERROR_CORE("Failed to execute command");
 			} else {
@@ -524,6 +515,19 @@ NSCAPI::nagiosReturn nsclient::core::plugin_manager::execute_query(const std::st
 	return NSCAPI::cmd_return_codes::isSuccess;
 }
 
+// A chunk with more than one command is executed in one call so the time is split evenly between the commands
+void nsclient::core::plugin_manager::record_latency(plugin_type plugin, const PB::Commands::QueryRequestMessage &request, boost::posix_time::time_duration elapsed) {
+	plugin_latency_.record(plugin->get_alias_or_name(), elapsed);
+	if (!request.header().command().empty()) {
+		command_latency_.record(request.header().command(), elapsed);
+	} else if (request.payload_size() > 0) {
+		boost::posix_time::time_duration share = elapsed / request.payload_size();
+		for (int i = 0; i < request.payload_size(); i++) {
+			command_latency_.record(request.payload(i).command(), share);
+		}
+	}
+}
+
 int nsclient::core::plugin_manager::load_and_run(std::string module, run_function fun, std::list<std::string> &errors) {
 	if (!module.empty()) {
 		plugin_type match = plugin_list_.find_by_module(module);
@@ -624,7 +628,11 @@ int nsclient::core::plugin_manager::simple_query(std::string module, std::string
 		return NSCAPI::query_return_codes::returnUNKNOWN;
 	}
 	std::string response;
+	metrics::stopwatch timer;
 	ret = plugin->handleCommand(request, response);
+	boost::posix_time::time_duration elapsed = timer.elapsed();
+	command_latency_.record(command, elapsed);
+	plugin_latency_.record(plugin->get_alias_or_name(), elapsed);
 	try {
 		std::string msg, perf;
 		ret = nscapi::protobuf::functions::parse_simple_query_response(response, msg, perf, -1);
@@ -696,52 +704,46 @@ NSCAPI::nagiosReturn nsclient::core::plugin_manager::exec_command(const char* ra
 
 void nsclient::core::plugin_manager::register_submission_listener(unsigned int plugin_id, const char* channel) {
 	channels_.register_listener(plugin_id, channel);
+	notifications_.invalidate();
 }
 
 NSCAPI::errorReturn nsclient::core::plugin_manager::send_notification(const char* channel, std::string &request, std::string &response) {
-	std::string schannel = channel;
-	bool found = false;
-	BOOST_FOREACH(std::string cur_chan, str::utils::split_lst(schannel, std::string(","))) {
-		if (cur_chan == "noop") {
-			found = true;
-			nscapi::protobuf::functions::create_simple_submit_response_ok(cur_chan, "TODO", "seems ok", response);
-			continue;
-		}
-		if (cur_chan == "log") {
-			PB::Commands::SubmitRequestMessage msg;
-			msg.ParseFromString(request);
-			for (int i = 0; i < msg.payload_size(); i++) {
-				LOG_INFO_CORE("Notification " + str::xtos(msg.payload(i).result()) + ": " + nscapi::protobuf::functions::query_data_to_nagios_string(msg.payload(i), nscapi::protobuf::functions::no_truncation));
-			}
-			found = true;
-			nscapi::protobuf::functions::create_simple_submit_response_ok(cur_chan, "TODO", "seems ok", response);
-			continue;
-		}
-		try {
-			BOOST_FOREACH(nsclient::plugin_type p, channels_.get(cur_chan)) {
-				try {
-					p->handleNotification(cur_chan.c_str(), request, response);
-				} catch (...) {
-					LOG_ERROR_CORE("Plugin throw exception: " + p->get_alias_or_name());
-				}
-				found = true;
-			}
-		} catch (nsclient::plugins_list_exception &e) {
-			LOG_ERROR_CORE("No handler for channel: " + schannel + ": " + utf8::utf8_from_native(e.what()));
-			return NSCAPI::api_return_codes::hasFailed;
-		} catch (const std::exception &e) {
-			LOG_ERROR_CORE("No handler for channel: " + schannel + ": " + utf8::utf8_from_native(e.what()));
-			return NSCAPI::api_return_codes::hasFailed;
-		} catch (...) {
-			LOG_ERROR_CORE("No handler for channel: " + schannel);
-			return NSCAPI::api_return_codes::hasFailed;
-		}
+	return notifications_.submit(channel, request, response);
+}
+
+unsigned int nsclient::core::plugin_manager::get_load_threads() {
+	int threads = 0;
+	try {
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "load threads", "Module load threads", "Number of threads used to start modules (modules are started once the modules they depend on have been started). 0 uses one thread per CPU (max 8) and 1 starts the modules one after the other.", "0", true, false);
+		threads = str::stox<int>(settings_manager::get_settings()->get_string("/settings/core", "load threads", "0"), threads);
+	} catch (settings::settings_exception e) {
+		LOG_ERROR_CORE_STD("Failed to read load threads: " + utf8::utf8_from_native(e.what()));
 	}
-	if (!found) {
-		LOG_ERROR_CORE("No handler for channel: " + schannel + " channels: " + channels_.to_string());
-		return NSCAPI::api_return_codes::hasFailed;
+	return threads < 0 ? 0 : static_cast<unsigned int>(threads);
+}
+
+void nsclient::core::plugin_manager::configure_notifications() {
+	std::string mode = "sync", policy = "block";
+	int queue_size = 1000, timeout = 5;
+	try {
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "notification mode", "Notification mode", "How notifications (submissions) are delivered to the modules listening on a channel: sync delivers them on the thread of the sender (which gets the result), async queues them and delivers them from a thread per module (the sender is only told the message was queued and delivery failures are logged).", "sync", true, false);
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "notification queue size", "Notification queue size", "Maximum number of notifications queued for each module (async mode).", "1000", true, false);
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "notification overflow", "Notification overflow policy", "What to do when the queue for a module is full: block waits (up to the notification timeout) for room in the queue, drop discards the notification.", "block", true, false);
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "notification timeout", "Notification timeout", "Maximum number of seconds a sender blocks when a queue is full before the notification is dropped.", "5", true, false);
+		mode = settings_manager::get_settings()->get_string("/settings/core", "notification mode", mode);
+		queue_size = str::stox<int>(settings_manager::get_settings()->get_string("/settings/core", "notification queue size", "1000"), queue_size);
+		policy = settings_manager::get_settings()->get_string("/settings/core", "notification overflow", policy);
+		timeout = str::stox<int>(settings_manager::get_settings()->get_string("/settings/core", "notification timeout", "5"), timeout);
+	} catch (settings::settings_exception e) {
+		LOG_ERROR_CORE_STD("Failed to read notification settings: " + utf8::utf8_from_native(e.what()));
 	}
-	return NSCAPI::api_return_codes::isSuccess;
+	if (mode != "async" && mode != "sync")
+		LOG_ERROR_CORE("Invalid notification mode: " + mode + " (using sync)");
+	if (policy != "block" && policy != "drop")
+		LOG_ERROR_CORE("Invalid notification overflow policy: " + policy + " (using block)");
+	notifications_.configure(mode == "async", queue_size < 1 ? 1 : queue_size,
+		policy == "drop" ? notification_bus::overflow_drop : notification_bus::overflow_block,
+		timeout < 0 ? 0 : timeout * 1000);
 }
 
 
@@ -818,6 +820,13 @@ void nsclient::core::plugin_manager::process_metrics(PB::Metrics::MetricsBundle
 	metrics_fetcher f;
 	metrics_fetchers_.do_all(boost::bind(&metrics_fetcher::fetch, &f, _1));
 	f.get_root()->add_bundles()->CopyFrom(bundle);
+	f.add_bundle(notifications_.get_metrics());
+	f.add_bundle(startup_.get_metrics());
+	PB::Metrics::MetricsBundle latency;
+	latency.set_key("latency");
+	metrics::add_latency(&latency, "commands", command_latency_);
+	metrics::add_latency(&latency, "plugins", plugin_latency_);
+	f.add_bundle(latency);
 	f.render();
 	metrics_submitetrs_.do_all(boost::bind(&metrics_fetcher::digest, &f, _1));
 }
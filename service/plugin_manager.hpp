@@ -22,6 +22,8 @@
 #include "master_plugin_list.hpp"
 #include "commands.hpp"
 #include "channels.hpp"
+#include "notification_bus.hpp"
+#include "startup_scheduler.hpp"
 #include "routers.hpp"
 #include "scheduler_handler.hpp"
 #include "plugin_cache.hpp"
@@ -32,6 +34,7 @@
 #include <nscapi/nscapi_protobuf_metrics.hpp>
 
 #include <settings/settings_core.hpp>
+#include <metrics/latency_histogram.hpp>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem/path.hpp>
@@ -90,12 +93,16 @@ namespace nsclient {
 			nsclient::logging::logger_instance log_instance_;
 			nsclient::commands commands_;
 			nsclient::channels channels_;
+			nsclient::core::notification_bus notifications_;
+			nsclient::core::startup_scheduler startup_;
 			nsclient::simple_plugins_list metrics_fetchers_;
 			nsclient::simple_plugins_list metrics_submitetrs_;
 			nsclient::core::plugin_cache plugin_cache_;
 			nsclient::event_subscribers event_subscribers_;
 			nsclient::core::master_plugin_list plugin_list_;
 			nsclient::core::path_instance path_;
+			metrics::latency_registry command_latency_;
+			metrics::latency_registry plugin_latency_;
 
 		public:
 			plugin_manager(nsclient::core::path_instance path_, nsclient::logging::logger_instance log_instance);
@@ -121,6 +128,8 @@ namespace nsclient {
 			bool load_single_plugin(std::string plugin, std::string alias = "", bool start = false);
 			void start_plugins(NSCAPI::moduleLoadMode mode);
 			void stop_plugins();
+			void configure_notifications();
+			unsigned int get_load_threads();
 			plugin_type only_load_module(std::string module, std::string alias, bool &loaded);
 
 
@@ -154,6 +163,7 @@ namespace nsclient {
 			boost::optional<boost::filesystem::path> find_file(std::string file_name);
 			bool contains_plugin(nsclient::core::plugin_manager::plugin_alias_list_type &ret, std::string alias, std::string plugin);
 			std::string get_plugin_module_name(unsigned int plugin_id);
+			void record_latency(plugin_type plugin, const PB::Commands::QueryRequestMessage &request, boost::posix_time::time_duration elapsed);
 
 			plugin_type add_plugin(std::string file_name, std::string alias);
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <socket/prefix_trie.hpp>
+
+#include <boost/asio/ip/address.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+	bool contains(const socket_helpers::prefix_trie<4> &trie, const std::string &address) {
+		boost::asio::ip::address_v4::bytes_type b = boost::asio::ip::address_v4::from_string(address).to_bytes();
+		return trie.contains(&b[0]);
+	}
+	void insert(socket_helpers::prefix_trie<4> &trie, const std::string &address, std::size_t bits) {
+		boost::asio::ip::address_v4::bytes_type b = boost::asio::ip::address_v4::from_string(address).to_bytes();
+		trie.insert(&b[0], bits);
+	}
+}
+
+TEST(prefix_trie, empty) {
+	socket_helpers::prefix_trie<4> trie;
+	EXPECT_TRUE(trie.empty());
+	EXPECT_FALSE(contains(trie, "127.0.0.1"));
+}
+
+TEST(prefix_trie, host) {
+	socket_helpers::prefix_trie<4> trie;
+	insert(trie, "127.0.0.1", 32);
+	EXPECT_TRUE(contains(trie, "127.0.0.1"));
+	EXPECT_FALSE(contains(trie, "127.0.0.2"));
+	EXPECT_FALSE(contains(trie, "128.0.0.1"));
+}
+
+TEST(prefix_trie, prefixes) {
+	socket_helpers::prefix_trie<4> trie;
+	insert(trie, "10.0.0.0", 8);
+	insert(trie, "192.168.4.0", 22);
+	insert(trie, "172.16.1.129", 25);
+	EXPECT_TRUE(contains(trie, "10.255.1.2"));
+	EXPECT_FALSE(contains(trie, "11.0.0.1"));
+	EXPECT_TRUE(contains(trie, "192.168.4.1"));
+	EXPECT_TRUE(contains(trie, "192.168.7.255"));
+	EXPECT_FALSE(contains(trie, "192.168.8.0"));
+	EXPECT_FALSE(contains(trie, "192.168.3.255"));
+	EXPECT_TRUE(contains(trie, "172.16.1.128"));
+	EXPECT_TRUE(contains(trie, "172.16.1.255"));
+	EXPECT_FALSE(contains(trie, "172.16.1.127"));
+}
+
+TEST(prefix_trie, overlapping) {
+	socket_helpers::prefix_trie<4> trie;
+	insert(trie, "10.1.2.3", 32);
+	insert(trie, "10.0.0.0", 8);
+	insert(trie, "10.1.0.0", 16);
+	EXPECT_TRUE(contains(trie, "10.1.2.3"));
+	EXPECT_TRUE(contains(trie, "10.2.0.1"));
+	EXPECT_EQ(3u, trie.size());
+}
+
+TEST(prefix_trie, everything) {
+	socket_helpers::prefix_trie<4> trie;
+	insert(trie, "0.0.0.0", 0);
+	EXPECT_TRUE(contains(trie, "1.2.3.4"));
+	EXPECT_TRUE(contains(trie, "255.255.255.255"));
+}
+
+TEST(prefix_trie, v6) {
+	socket_helpers::prefix_trie<16> trie;
+	boost::asio::ip::address_v6::bytes_type net = boost::asio::ip::address_v6::from_string("2001:db8::").to_bytes();
+	trie.insert(&net[0], 32);
+	boost::asio::ip::address_v6::bytes_type inside = boost::asio::ip::address_v6::from_string("2001:db8:1::1").to_bytes();
+	boost::asio::ip::address_v6::bytes_type outside = boost::asio::ip::address_v6::from_string("2001:db9::1").to_bytes();
+	EXPECT_TRUE(trie.contains(&inside[0]));
+	EXPECT_FALSE(trie.contains(&outside[0]));
+}
@@ -246,6 +246,17 @@ namespace nsclient {
 				}
 			}
 			if (fetch_keys) {
+				settings::snapshot_ptr snapshot = settings_manager::get_settings()->get_snapshot();
+				const settings::settings_snapshot::section *section = snapshot ? snapshot->find_section(path) : NULL;
+				if (section) {
+					BOOST_FOREACH(const settings::settings_snapshot::entry &e, section->keys) {
+						PB::Settings::Node *node = rpp->add_nodes();
+						node->set_path(path);
+						node->set_key(e.key);
+						node->set_value(e.value.string_value);
+					}
+					return;
+				}
 				BOOST_FOREACH(const std::string &key, settings_manager::get_settings()->get_keys(path)) {
 					PB::Settings::Node *node = rpp->add_nodes();
 					node->set_path(path);
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "startup_scheduler.hpp"
+
+#include <metrics/latency_histogram.hpp>
+#include <str/xtos.hpp>
+#include <utf8.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <map>
+
+namespace {
+	const unsigned int max_threads = 8;
+
+	std::string normalize(std::string name) {
+		boost::algorithm::to_lower(name);
+		if (boost::algorithm::ends_with(name, ".dll") || boost::algorithm::ends_with(name, ".zip"))
+			name = name.substr(0, name.length() - 4);
+		else if (boost::algorithm::ends_with(name, ".so"))
+			name = name.substr(0, name.length() - 3);
+		return name;
+	}
+
+	unsigned long long elapsed_ms(const boost::posix_time::ptime &start) {
+		return (boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds();
+	}
+}
+
+struct nsclient::core::startup_scheduler::run_state {
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::deque<std::size_t> ready;
+	std::size_t running;
+	std::size_t remaining;
+	std::vector<timing> timings;
+	std::set<long> broken;
+	boost::posix_time::ptime start;
+
+	run_state(std::size_t count) : running(0), remaining(count), timings(count), start(boost::posix_time::microsec_clock::universal_time()) {}
+};
+
+void nsclient::core::startup_scheduler::build(std::vector<node> &nodes) {
+	std::map<std::string, std::list<std::size_t> > names;
+	std::map<std::string, std::size_t> last_instance;
+	std::vector<std::set<std::size_t> > depends_on(nodes.size());
+	for (std::size_t i = 0; i < nodes.size(); i++) {
+		std::string module = normalize(nodes[i].plugin->getModule());
+		names[module].push_back(i);
+		if (!nodes[i].plugin->get_alias().empty() && normalize(nodes[i].plugin->get_alias()) != module)
+			names[normalize(nodes[i].plugin->get_alias())].push_back(i);
+
+		std::map<std::string, std::size_t>::const_iterator it = last_instance.find(module);
+		if (it != last_instance.end())
+			depends_on[i].insert(it->second);
+		last_instance[module] = i;
+	}
+	for (std::size_t i = 0; i < nodes.size(); i++) {
+		std::list<std::string> dependencies;
+		try {
+			dependencies = nodes[i].plugin->get_dependencies();
+		} catch (const std::exception &e) {
+			LOG_ERROR_CORE_STD("Failed to get dependencies for " + nodes[i].plugin->get_alias_or_name() + ": " + utf8::utf8_from_native(e.what()));
+		}
+		BOOST_FOREACH(const std::string &d, dependencies) {
+			std::map<std::string, std::list<std::size_t> >::const_iterator it = names.find(normalize(d));
+			if (it == names.end()) {
+				LOG_DEBUG_CORE_STD(nodes[i].plugin->get_alias_or_name() + " depends on " + d + " which is not loaded");
+				continue;
+			}
+			BOOST_FOREACH(std::size_t j, it->second) {
+				if (j != i)
+					depends_on[i].insert(j);
+			}
+		}
+	}
+	for (std::size_t i = 0; i < nodes.size(); i++) {
+		nodes[i].pending = depends_on[i].size();
+		BOOST_FOREACH(std::size_t j, depends_on[i]) {
+			nodes[j].dependents.push_back(i);
+		}
+	}
+}
+
+std::set<long> nsclient::core::startup_scheduler::start(const std::list<plugin_type> &plugins, NSCAPI::moduleLoadMode mode, unsigned int threads) {
+	std::vector<node> nodes(plugins.size());
+	std::size_t i = 0;
+	BOOST_FOREACH(const plugin_type &p, plugins) {
+		nodes[i++].plugin = p;
+	}
+	build(nodes);
+
+	run_state state(nodes.size());
+	for (i = 0; i < nodes.size(); i++) {
+		if (nodes[i].pending == 0)
+			state.ready.push_back(i);
+	}
+
+	if (threads == 0)
+		threads = std::min(std::max(boost::thread::hardware_concurrency(), 1u), max_threads);
+	threads = static_cast<unsigned int>(std::min<std::size_t>(threads, nodes.size()));
+	if (threads <= 1) {
+		worker(state, nodes, mode);
+	} else {
+		LOG_DEBUG_CORE("Loading " + str::xtos(nodes.size()) + " plugins using " + str::xtos(threads) + " threads");
+		boost::thread_group workers;
+		for (unsigned int t = 0; t < threads; t++)
+			workers.create_thread(boost::bind(&startup_scheduler::worker, this, boost::ref(state), boost::ref(nodes), mode));
+		workers.join_all();
+	}
+
+	unsigned long long total = elapsed_ms(state.start);
+	LOG_DEBUG_CORE("Loaded " + str::xtos(nodes.size()) + " plugins in " + str::xtos(total) + "ms");
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		timings_.clear();
+		timings_.insert(timings_.end(), state.timings.begin(), state.timings.end());
+		total_ms_ = total;
+		threads_ = std::max(threads, 1u);
+	}
+	return state.broken;
+}
+
+void nsclient::core::startup_scheduler::worker(run_state &state, std::vector<node> &nodes, NSCAPI::moduleLoadMode mode) {
+	boost::unique_lock<boost::mutex> lock(state.mutex);
+	while (true) {
+		while (state.ready.empty() && state.remaining > 0 && state.running > 0)
+			state.cond.wait(lock);
+		if (state.remaining == 0)
+			break;
+		if (state.ready.empty()) {
+			// Nothing is running and nothing can run: the rest has circular dependencies so we just start the first one
+			for (std::size_t i = 0; i < nodes.size(); i++) {
+				if (!nodes[i].started) {
+					LOG_ERROR_CORE_STD("Circular dependency detected for: " + nodes[i].plugin->get_alias_or_name());
+					nodes[i].pending = 0;
+					state.ready.push_back(i);
+					break;
+				}
+			}
+			continue;
+		}
+		std::size_t current = state.ready.front();
+		state.ready.pop_front();
+		nodes[current].started = true;
+		state.running++;
+		timing &t = state.timings[current];
+		t.wait_ms = elapsed_ms(state.start);
+
+		lock.unlock();
+		bool loaded = load(nodes[current].plugin, mode, t);
+		lock.lock();
+
+		if (!loaded)
+			state.broken.insert(nodes[current].plugin->get_id());
+		state.running--;
+		state.remaining--;
+		BOOST_FOREACH(std::size_t d, nodes[current].dependents) {
+			if (nodes[d].pending > 0 && --nodes[d].pending == 0 && !nodes[d].started)
+				state.ready.push_back(d);
+		}
+		state.cond.notify_all();
+	}
+}
+
+bool nsclient::core::startup_scheduler::load(plugin_type plugin, NSCAPI::moduleLoadMode mode, timing &t) {
+	t.alias = plugin->get_alias_or_name();
+	t.module = plugin->getModule();
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	LOG_DEBUG_CORE_STD("Loading plugin: " + t.module);
+	try {
+		if (plugin->load_plugin(mode)) {
+			t.loaded = true;
+		} else {
+			LOG_ERROR_CORE_STD("Plugin refused to load: " + t.module);
+		}
+	} catch (const plugin_exception &e) {
+		LOG_ERROR_CORE_STD("Could not load plugin: " + e.reason() + ": " + e.file());
+	} catch (const std::exception &e) {
+		LOG_ERROR_CORE_STD("Could not load plugin: " + plugin->get_alias() + ": " + e.what());
+	} catch (...) {
+		LOG_ERROR_CORE_STD("Could not load plugin: " + t.module);
+	}
+	t.load_ms = elapsed_ms(start);
+	return t.loaded;
+}
+
+void nsclient::core::startup_scheduler::add_timing(const timing &t) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	timings_.push_back(t);
+}
+
+void nsclient::core::startup_scheduler::remove_timing(const std::string &alias) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	for (std::list<timing>::iterator it = timings_.begin(); it != timings_.end();) {
+		if (it->alias == alias)
+			it = timings_.erase(it);
+		else
+			++it;
+	}
+}
+
+std::list<nsclient::core::startup_scheduler::timing> nsclient::core::startup_scheduler::get_timings() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	return timings_;
+}
+
+PB::Metrics::MetricsBundle nsclient::core::startup_scheduler::get_metrics() {
+	PB::Metrics::MetricsBundle bundle;
+	bundle.set_key("startup");
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	metrics::add_gauge(&bundle, "time", total_ms_);
+	metrics::add_gauge(&bundle, "threads", threads_);
+	PB::Metrics::MetricsBundle *modules = bundle.add_children();
+	modules->set_key("modules");
+	BOOST_FOREACH(const timing &t, timings_) {
+		PB::Metrics::MetricsBundle *b = modules->add_children();
+		b->set_key(t.alias);
+		metrics::add_gauge(b, "load_time", t.load_ms);
+		metrics::add_gauge(b, "wait_time", t.wait_ms);
+		metrics::add_gauge(b, "loaded", t.loaded ? 1 : 0);
+	}
+	return bundle;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "plugin_interface.hpp"
+
+#include <NSCAPI.h>
+#include <nsclient/logger/logger.hpp>
+#include <nscapi/nscapi_protobuf_metrics.hpp>
+
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace nsclient {
+	namespace core {
+
+		/**
+		 * Starts (loads) plugins concurrently.
+		 *
+		 * A plugin is started once all the plugins it depends on (NSGetModuleDependencies or the modules listed in a
+		 * zip module) have been started. Instances of the same module are always started one after the other
+		 * since the module code keeps per instance state in a shared (unlocked) table.
+		 * The time each plugin took to start is kept and published as metrics.
+		 */
+		class startup_scheduler : boost::noncopyable {
+		public:
+			typedef boost::shared_ptr<nsclient::core::plugin_interface> plugin_type;
+			struct timing {
+				std::string alias;
+				std::string module;
+				unsigned long long load_ms;
+				unsigned long long wait_ms;
+				bool loaded;
+				timing() : load_ms(0), wait_ms(0), loaded(false) {}
+			};
+
+		private:
+			struct node {
+				plugin_type plugin;
+				std::list<std::size_t> dependents;
+				std::size_t pending;
+				bool started;
+				node() : pending(0), started(false) {}
+			};
+			struct run_state;
+
+			nsclient::logging::logger_instance logger_;
+			boost::mutex mutex_;
+			std::list<timing> timings_;
+			unsigned long long total_ms_;
+			unsigned int threads_;
+
+		public:
+			startup_scheduler(nsclient::logging::logger_instance logger) : logger_(logger), total_ms_(0), threads_(0) {}
+
+			// Loads all plugins (using up to threads concurrent threads) and returns the ids of the plugins which failed to load
+			std::set<long> start(const std::list<plugin_type> &plugins, NSCAPI::moduleLoadMode mode, unsigned int threads);
+			// Records a plugin started outside of start() (i.e. loaded at runtime)
+			void add_timing(const timing &t);
+			void remove_timing(const std::string &alias);
+			std::list<timing> get_timings();
+			PB::Metrics::MetricsBundle get_metrics();
+
+		private:
+			void build(std::vector<node> &nodes);
+			void worker(run_state &state, std::vector<node> &nodes, NSCAPI::moduleLoadMode mode);
+			bool load(plugin_type plugin, NSCAPI::moduleLoadMode mode, timing &t);
+			nsclient::logging::logger_instance get_logger() {
+				return logger_;
+			}
+		};
+	}
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "startup_scheduler.hpp"
+
+#include <str/xtos.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+	struct null_logger : public nsclient::logging::logger {
+		void trace(const std::string &, const char*, const int, const std::string &) {}
+		void debug(const std::string &, const char*, const int, const std::string &) {}
+		void info(const std::string &, const char*, const int, const std::string &) {}
+		void warning(const std::string &, const char*, const int, const std::string &) {}
+		void error(const std::string &, const char*, const int, const std::string &) {}
+		void critical(const std::string &, const char*, const int, const std::string &) {}
+		bool should_trace() const { return false; }
+		bool should_debug() const { return false; }
+		bool should_info() const { return false; }
+		bool should_warning() const { return false; }
+		bool should_error() const { return false; }
+		bool should_critical() const { return false; }
+		void raw(const std::string &) {}
+		void add_subscriber(nsclient::logging::logging_subscriber_instance) {}
+		void clear_subscribers() {}
+		bool startup() { return true; }
+		bool shutdown() { return true; }
+		void destroy() {}
+		void configure() {}
+		void set_log_level(std::string) {}
+		std::string get_log_level() const { return "error"; }
+		void set_backend(std::string) {}
+	};
+
+	// Records the order plugins are started in and how many instances of each module run at the same time
+	struct load_log {
+		boost::mutex mutex;
+		std::vector<std::string> events;
+		std::map<std::string, int> running;
+		std::map<std::string, int> max_running;
+		int total_running;
+		int max_total_running;
+		load_log() : total_running(0), max_total_running(0) {}
+
+		std::size_t find(const std::string &event) {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			for (std::size_t i = 0; i < events.size(); i++) {
+				if (events[i] == event)
+					return i;
+			}
+			return events.size();
+		}
+		bool has(const std::string &event) {
+			return find(event) != events.size();
+		}
+		std::size_t count() {
+			boost::unique_lock<boost::mutex> lock(mutex);
+			return events.size();
+		}
+		// True if a finished loading before b started
+		bool before(const std::string &a, const std::string &b) {
+			return has("done " + a) && has("start " + b) && find("done " + a) < find("start " + b);
+		}
+	};
+
+	class fake_plugin : public nsclient::core::plugin_interface {
+		std::string module_;
+		std::list<std::string> dependencies_;
+		load_log &log_;
+		int delay_ms_;
+		bool ok_;
+	public:
+		fake_plugin(unsigned int id, const std::string &alias, const std::string &module, const std::string &dependencies, load_log &log, int delay_ms = 10, bool ok = true)
+			: plugin_interface(id, alias), module_(module), log_(log), delay_ms_(delay_ms), ok_(ok) {
+			if (!dependencies.empty())
+				dependencies_.push_back(dependencies);
+		}
+
+		bool load_plugin(NSCAPI::moduleLoadMode) {
+			{
+				boost::unique_lock<boost::mutex> lock(log_.mutex);
+				log_.events.push_back("start " + get_alias_or_name());
+				int &r = ++log_.running[module_];
+				log_.max_running[module_] = std::max(log_.max_running[module_], r);
+				log_.max_total_running = std::max(log_.max_total_running, ++log_.total_running);
+			}
+			boost::this_thread::sleep(boost::posix_time::milliseconds(delay_ms_));
+			{
+				boost::unique_lock<boost::mutex> lock(log_.mutex);
+				log_.events.push_back("done " + get_alias_or_name());
+				log_.running[module_]--;
+				log_.total_running--;
+			}
+			return ok_;
+		}
+		std::list<std::string> get_dependencies() { return dependencies_; }
+		std::string getModule() { return module_; }
+
+		void unload_plugin() {}
+		std::string getName() { return module_; }
+		std::string getDescription() { return ""; }
+		std::string get_version() { return ""; }
+		bool hasCommandHandler() { return false; }
+		NSCAPI::nagiosReturn handleCommand(const std::string, std::string &) { return 0; }
+		bool hasNotificationHandler() { return false; }
+		NSCAPI::nagiosReturn handleNotification(const char *, const std::string &, std::string &) { return 0; }
+		NSCAPI::nagiosReturn handle_schedule(const std::string &) { return 0; }
+		bool hasMessageHandler() { return false; }
+		void handleMessage(const char*, unsigned int) {}
+		bool has_on_event() { return false; }
+		NSCAPI::nagiosReturn on_event(const std::string &) { return 0; }
+		bool hasMetricsFetcher() { return false; }
+		NSCAPI::nagiosReturn fetchMetrics(std::string &) { return 0; }
+		bool hasMetricsSubmitter() { return false; }
+		NSCAPI::nagiosReturn submitMetrics(const std::string &) { return 0; }
+		bool has_command_line_exec() { return false; }
+		int commandLineExec(bool, std::string &, std::string &) { return 0; }
+		bool has_routing_handler() { return false; }
+		bool route_message(const char *, const char*, unsigned int, char **, char **, unsigned int *) { return false; }
+		bool is_duplicate(boost::filesystem::path, std::string) { return false; }
+		void on_log_message(std::string &) {}
+	};
+
+	typedef nsclient::core::startup_scheduler::plugin_type plugin_type;
+
+	std::set<long> run(const std::list<plugin_type> &plugins, unsigned int threads, nsclient::core::startup_scheduler *scheduler = NULL) {
+		nsclient::core::startup_scheduler local(boost::make_shared<null_logger>());
+		return (scheduler ? scheduler : &local)->start(plugins, NSCAPI::normalStart, threads);
+	}
+}
+
+TEST(startup_scheduler, dependencies_start_first) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "WEBServer", "CheckSystem", log)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "", "CheckSystem.dll", "", log, 30)));
+	plugins.push_back(plugin_type(new fake_plugin(3, "", "CheckDisk", "", log)));
+	EXPECT_TRUE(run(plugins, 4).empty());
+	EXPECT_EQ(6u, log.count());
+	EXPECT_TRUE(log.before("CheckSystem.dll", "WEBServer"));
+}
+
+TEST(startup_scheduler, cycle) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "A", "B", log)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "", "B", "A", log)));
+	plugins.push_back(plugin_type(new fake_plugin(3, "", "C", "B", log)));
+	plugins.push_back(plugin_type(new fake_plugin(4, "", "D", "", log)));
+	// Everything is still started (once) when the dependencies are circular
+	EXPECT_TRUE(run(plugins, 4).empty());
+	const char *names[] = { "A", "B", "C", "D" };
+	BOOST_FOREACH(const char *n, names) {
+		EXPECT_TRUE(log.has(std::string("done ") + n)) << n;
+	}
+	EXPECT_EQ(8u, log.count());
+	EXPECT_TRUE(log.before("B", "C"));
+}
+
+TEST(startup_scheduler, missing_dependency) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "A", "NotLoaded", log)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "", "B", "A", log)));
+	EXPECT_TRUE(run(plugins, 2).empty());
+	EXPECT_TRUE(log.before("A", "B"));
+}
+
+TEST(startup_scheduler, same_module_is_serialized) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	for (unsigned int i = 0; i < 4; i++)
+		plugins.push_back(plugin_type(new fake_plugin(i + 1, "instance" + str::xtos(i), "CheckExternalScripts", "", log, 20)));
+	plugins.push_back(plugin_type(new fake_plugin(10, "", "Other", "", log, 40)));
+	EXPECT_TRUE(run(plugins, 4).empty());
+	EXPECT_EQ(1, log.max_running["CheckExternalScripts"]);
+	// In the order they were listed
+	EXPECT_TRUE(log.before("instance0", "instance1"));
+	EXPECT_TRUE(log.before("instance1", "instance2"));
+	EXPECT_TRUE(log.before("instance2", "instance3"));
+	// Other modules still run concurrently
+	EXPECT_EQ(2, log.max_total_running);
+}
+
+TEST(startup_scheduler, depending_on_alias) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "Client", "my_server", log)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "my_server", "Server", "", log, 30)));
+	EXPECT_TRUE(run(plugins, 2).empty());
+	EXPECT_TRUE(log.before("my_server", "Client"));
+}
+
+TEST(startup_scheduler, failed_plugins) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "A", "", log, 1, false)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "", "B", "A", log)));
+	nsclient::core::startup_scheduler scheduler(boost::make_shared<null_logger>());
+	std::set<long> broken = run(plugins, 2, &scheduler);
+	ASSERT_EQ(1u, broken.size());
+	EXPECT_EQ(1, *broken.begin());
+	EXPECT_TRUE(log.before("A", "B"));
+
+	std::list<nsclient::core::startup_scheduler::timing> timings = scheduler.get_timings();
+	ASSERT_EQ(2u, timings.size());
+	EXPECT_EQ("A", timings.front().alias);
+	EXPECT_FALSE(timings.front().loaded);
+	EXPECT_TRUE(timings.back().loaded);
+}
+
+TEST(startup_scheduler, single_thread) {
+	load_log log;
+	std::list<plugin_type> plugins;
+	plugins.push_back(plugin_type(new fake_plugin(1, "", "A", "B", log)));
+	plugins.push_back(plugin_type(new fake_plugin(2, "", "B", "", log)));
+	EXPECT_TRUE(run(plugins, 1).empty());
+	EXPECT_EQ(1, log.max_total_running);
+	EXPECT_TRUE(log.before("B", "A"));
+}
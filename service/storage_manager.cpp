@@ -4,14 +4,50 @@
 #include <str/xtos.hpp>
 
 #include <boost/thread/locks.hpp>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/io/coded_stream.h>
 
 #include <fstream>
+#include <iterator>
+
+const std::size_t nsclient::core::storage_manager::shard_count;
+
+namespace {
+	// Journal record: [payload length][crc32 of type+payload][type][payload (a serialized Block)]
+	const std::size_t record_header_size = 9;
+	// The journal is compacted when it is larger than this and larger than the snapshot
+	const unsigned long long min_compact_size = 1024 * 1024;
+
+	void set_u32(std::string &buffer, std::size_t pos, unsigned int value) {
+		for (int i = 0; i < 4; i++)
+			buffer[pos + i] = static_cast<char>((value >> (i * 8)) & 0xff);
+	}
+	unsigned int get_u32(const std::string &buffer, std::size_t pos) {
+		unsigned int value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= static_cast<unsigned int>(static_cast<unsigned char>(buffer[pos + i])) << (i * 8);
+		return value;
+	}
+	unsigned int record_crc(const char *data, std::size_t length) {
+		boost::crc_32_type crc;
+		crc.process_bytes(data, length);
+		return crc.checksum();
+	}
+	void ensure_path(const std::string &file) {
+		std::string path = file_helpers::meta::get_path(file);
+		if (!file_helpers::checks::is_file(path)) {
+			boost::filesystem::create_directories(path);
+		}
+	}
+}
 
 std::string mk_key(const std::string &plugin_name, const std::string &context, const std::string key = "") {
 	return plugin_name + "." + context + "." + key;
@@ -26,10 +62,35 @@ bool read_chunk(::google::protobuf::io::CodedInputStream &stream, T &obj) {
 	obj.ParseFromString(tmp);
 	return true;
 }
+
+nsclient::core::storage_manager::shard& nsclient::core::storage_manager::get_shard(const std::string &prefix) {
+	return shards_[boost::hash<std::string>()(prefix) % shard_count];
+}
+
+nsclient::core::storage_manager::~storage_manager() {
+	boost::shared_ptr<boost::thread> thread;
+	{
+		boost::unique_lock<boost::mutex> lock(journal_mutex_);
+		thread = compact_thread_;
+	}
+	if (thread)
+		thread->join();
+}
+
 void nsclient::core::storage_manager::load() {
+	boost::unique_lock<boost::mutex> lock(journal_mutex_);
+	load_snapshot();
+	// Left behind by an interrupted compaction: its records are older than the ones in the current journal
+	replay_journal(get_old_journalname());
+	journal_size_ = replay_journal(get_journalname());
+}
+
+void nsclient::core::storage_manager::load_snapshot() {
 	std::string file = get_filename();
 
 	std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+	if (!in.good())
+		return;
 
 	typedef boost::shared_ptr<google::protobuf::io::ZeroCopyInputStream> istr_type;
 	typedef boost::shared_ptr<google::protobuf::io::CodedInputStream> codedstr_type;
@@ -47,36 +108,149 @@ void nsclient::core::storage_manager::load() {
 			LOG_ERROR_CORE("Failed to read block " + str::xtos(i) + " from storage.");
 			continue;
 		}
-		storage_[mk_key(block.owner(), block.entry().context(), block.entry().key())] = storage_item(block.owner(), block.entry());
+		apply(record_put, block);
 	}
+	snapshot_size_ = coded_in->CurrentPosition();
+}
+
+unsigned long long nsclient::core::storage_manager::replay_journal(const std::string &file) {
+	std::string data;
+	{
+		std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+		if (!in.good())
+			return 0;
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	std::size_t pos = 0;
+	long long count = 0;
+	while (pos + record_header_size <= data.size()) {
+		std::size_t length = get_u32(data, pos);
+		if (pos + record_header_size + length > data.size())
+			break;
+		if (record_crc(&data[pos + 8], length + 1) != get_u32(data, pos + 4))
+			break;
+		::PB::Storage::Storage::Block block;
+		if (!block.ParseFromArray(&data[pos + record_header_size], static_cast<int>(length)))
+			break;
+		apply(static_cast<record_type>(data[pos + 8]), block);
+		pos += record_header_size + length;
+		count++;
+	}
+	if (pos < data.size()) {
+		// Most likely a partial write when we crashed: drop the tail so new records are not appended after garbage
+		LOG_ERROR_CORE("Ignoring " + str::xtos(data.size() - pos) + " bytes of corrupt storage journal after " + str::xtos(count) + " records");
+		try {
+			boost::filesystem::resize_file(file, pos);
+		} catch (const std::exception &e) {
+			LOG_ERROR_CORE("Failed to truncate storage journal: " + utf8::utf8_from_native(e.what()));
+		}
+	}
+	if (count > 0)
+		LOG_DEBUG_CORE("Replayed " + str::xtos(count) + " records from " + file);
+	return pos;
+}
+
+void nsclient::core::storage_manager::apply(record_type type, const ::PB::Storage::Storage::Block &block) {
+	std::string prefix = mk_key(block.owner(), block.entry().context());
+	shard &s = get_shard(prefix);
+	boost::unique_lock<boost::shared_mutex> writeLock(s.mutex);
+	if (type == record_delete)
+		s.items.erase(prefix + block.entry().key());
+	else
+		s.items[prefix + block.entry().key()] = storage_item(block.owner(), block.entry());
 }
 
 void nsclient::core::storage_manager::put(std::string plugin_name, const ::PB::Storage::Storage_Entry& entry) {
-	boost::unique_lock<boost::shared_mutex> writeLock(m_mutexRW, boost::get_system_time() + boost::posix_time::seconds(5));
+	std::string prefix = mk_key(plugin_name, entry.context());
+	shard &s = get_shard(prefix);
+	boost::unique_lock<boost::shared_mutex> writeLock(s.mutex, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!writeLock.owns_lock()) {
 		LOG_ERROR_CORE("FATAL ERROR: Could not get write-mutex.");
 		return;
 	}
-	std::string key = mk_key(plugin_name, entry.context(), entry.key());
-	storage_[key] = storage_item(plugin_name, entry);
+	s.items[prefix + entry.key()] = storage_item(plugin_name, entry);
+	// Still holding the shard lock so the journal sees writes to a key in the same order as the index
+	append(record_put, plugin_name, entry);
+}
+
+void nsclient::core::storage_manager::remove(std::string plugin_name, std::string context, std::string key) {
+	std::string prefix = mk_key(plugin_name, context);
+	shard &s = get_shard(prefix);
+	boost::unique_lock<boost::shared_mutex> writeLock(s.mutex, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!writeLock.owns_lock()) {
+		LOG_ERROR_CORE("FATAL ERROR: Could not get write-mutex.");
+		return;
+	}
+	if (s.items.erase(prefix + key) == 0)
+		return;
+	::PB::Storage::Storage_Entry entry;
+	entry.set_context(context);
+	entry.set_key(key);
+	append(record_delete, plugin_name, entry);
 }
 
 nsclient::core::storage_manager::entry_list nsclient::core::storage_manager::get(std::string plugin_name, std::string context) {
 	entry_list ret;
-	boost::shared_lock<boost::shared_mutex> readLock(m_mutexRW, boost::get_system_time() + boost::posix_time::seconds(5));
+	std::string key = mk_key(plugin_name, context);
+	shard &s = get_shard(key);
+	boost::shared_lock<boost::shared_mutex> readLock(s.mutex, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!readLock.owns_lock()) {
 		LOG_ERROR_CORE("FATAL ERROR: Could not get read-mutex.");
 		return ret;
 	}
-	std::string key = mk_key(plugin_name, context);
-	BOOST_FOREACH(const storage_type::value_type &v, storage_) {
-		if (boost::algorithm::starts_with(v.first, key)) {
-			ret.push_back(v.second.entry);
-		}
+	for (storage_type::const_iterator it = s.items.lower_bound(key); it != s.items.end() && boost::algorithm::starts_with(it->first, key); ++it) {
+		ret.push_back(it->second.entry);
 	}
 	return ret;
 }
 
+void nsclient::core::storage_manager::append(record_type type, const std::string &owner, const ::PB::Storage::Storage_Entry& entry) {
+	boost::unique_lock<boost::mutex> lock(journal_mutex_);
+	try {
+		::PB::Storage::Storage::Block block;
+		block.set_owner(owner);
+		block.mutable_entry()->CopyFrom(entry);
+
+		record_buffer_.assign(record_header_size, '\0');
+		block.AppendToString(&record_buffer_);
+		std::size_t length = record_buffer_.size() - record_header_size;
+		record_buffer_[8] = static_cast<char>(type);
+		set_u32(record_buffer_, 0, static_cast<unsigned int>(length));
+		set_u32(record_buffer_, 4, record_crc(&record_buffer_[8], length + 1));
+
+		if (!journal_.is_open()) {
+			std::string file = get_journalname();
+			ensure_path(file);
+			journal_.clear();
+			journal_.open(file.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+		}
+		journal_.write(record_buffer_.c_str(), record_buffer_.size());
+		journal_.flush();
+		if (!journal_.good()) {
+			LOG_ERROR_CORE("Failed to write to storage journal: " + get_journalname());
+			journal_.close();
+			return;
+		}
+		journal_size_ += record_buffer_.size();
+	} catch (const std::exception &e) {
+		LOG_ERROR_CORE("Failed to write to storage journal: " + utf8::utf8_from_native(e.what()));
+		return;
+	}
+	if (!compacting_ && journal_size_ > std::max(min_compact_size, snapshot_size_)) {
+		try {
+			// compacting_ is cleared as the last thing the previous thread does so this join does not block
+			if (compact_thread_)
+				compact_thread_->join();
+			compacting_ = true;
+			compact_thread_.reset(new boost::thread(boost::bind(&storage_manager::background_compact, this)));
+		} catch (const std::exception &e) {
+			compacting_ = false;
+			LOG_ERROR_CORE("Failed to start storage compaction: " + utf8::utf8_from_native(e.what()));
+		}
+	}
+}
+
 template<typename T> 
 bool write_chunk(::google::protobuf::io::CodedOutputStream &stream, const T &obj) {
 	std::string tmp;
@@ -87,13 +261,54 @@ bool write_chunk(::google::protobuf::io::CodedOutputStream &stream, const T &obj
 }
 
 void nsclient::core::storage_manager::save() {
+	compact();
+}
+
+void nsclient::core::storage_manager::background_compact() {
+	compact();
+	boost::unique_lock<boost::mutex> lock(journal_mutex_);
+	compacting_ = false;
+}
+
+void nsclient::core::storage_manager::rotate_journal() {
+	// Called with the journal lock held, the next append reopens the journal
+	journal_.close();
+	journal_.clear();
+	journal_size_ = 0;
+	std::string journal = get_journalname();
+	std::string old = get_old_journalname();
+	if (!boost::filesystem::exists(journal))
+		return;
+	if (boost::filesystem::exists(old)) {
+		// A previous compaction failed: keep its records in front of ours
+		{
+			std::ifstream in(journal.c_str(), std::ios::in | std::ios::binary);
+			std::ofstream out(old.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+			out << in.rdbuf();
+			out.flush();
+			if (!out.good())
+				throw std::runtime_error("Failed to append journal to " + old);
+		}
+		boost::filesystem::remove(journal);
+	} else {
+		boost::filesystem::rename(journal, old);
+	}
+}
+
+void nsclient::core::storage_manager::compact() {
+	boost::unique_lock<boost::mutex> compact_lock(compact_mutex_);
 	try {
+		{
+			// Records written from here on go to a new journal. They may also end up in the snapshot, which is
+			// fine as replaying them again gives the same result.
+			boost::unique_lock<boost::mutex> lock(journal_mutex_);
+			rotate_journal();
+		}
+		long long entries = 0;
+		unsigned long long snapshot_size = 0;
 		{
 			std::string file = get_tmpname();
-			std::string path = file_helpers::meta::get_path(file);
-			if (!file_helpers::checks::is_file(path)) {
-				boost::filesystem::create_directories(path);
-			}
+			ensure_path(file);
 			std::ofstream out(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
 
 			typedef boost::shared_ptr<google::protobuf::io::ZeroCopyOutputStream> istr_type;
@@ -101,25 +316,39 @@ void nsclient::core::storage_manager::save() {
 			istr_type raw_out = istr_type(new ::google::protobuf::io::OstreamOutputStream(&out));
 			codedstr_type coded_out = codedstr_type(new ::google::protobuf::io::CodedOutputStream(raw_out.get()));
 
+			std::list<std::string> blocks;
+			for (std::size_t i = 0; i < shard_count; i++) {
+				boost::shared_lock<boost::shared_mutex> readLock(shards_[i].mutex);
+				BOOST_FOREACH(const storage_type::value_type &v, shards_[i].items) {
+					::PB::Storage::Storage::Block block;
+					block.set_owner(v.second.owner);
+					block.mutable_entry()->CopyFrom(v.second.entry);
+					blocks.push_back(block.SerializeAsString());
+				}
+			}
+			entries = static_cast<long long>(blocks.size());
+
 			::PB::Storage::Storage::File header;
 			header.set_version(1);
-			header.set_entries(storage_.size());
+			header.set_entries(entries);
 			if (!write_chunk<>(*coded_out, header)) {
 				LOG_ERROR_CORE("Failed to write header to storage.");
 				return;
 			}
-
-			BOOST_FOREACH(const storage_type::value_type &v, storage_) {
-				::PB::Storage::Storage::Block block;
-				block.set_owner(v.second.owner);
-				block.mutable_entry()->CopyFrom(v.second.entry);
-				if (!write_chunk(*coded_out, block)) {
-					LOG_ERROR_CORE("Failed to write block to storage.");
-					return;
-				}
+			BOOST_FOREACH(const std::string &b, blocks) {
+				coded_out->WriteVarint32(static_cast<uint32_t>(b.size()));
+				coded_out->WriteString(b);
 			}
+			if (coded_out->HadError()) {
+				LOG_ERROR_CORE("Failed to write blocks to storage.");
+				return;
+			}
+			snapshot_size = coded_out->ByteCount();
 		}
 		boost::filesystem::rename(get_tmpname(), get_filename());
+		boost::filesystem::remove(get_old_journalname());
+		boost::unique_lock<boost::mutex> lock(journal_mutex_);
+		snapshot_size_ = snapshot_size;
 	} catch (const std::exception &e) {
 		LOG_ERROR_CORE("Failed to save settings: " + utf8::utf8_from_native(e.what()));
 	} catch (...) {
@@ -128,9 +357,20 @@ void nsclient::core::storage_manager::save() {
 
 }
 
+std::string nsclient::core::storage_manager::get_data_file(const std::string &name) {
+	if (!folder_.empty())
+		return (boost::filesystem::path(folder_) / name).string();
+	return path_->expand_path("${data-path}/" + name);
+}
 std::string nsclient::core::storage_manager::get_filename() {
-	return path_->expand_path("${data-path}/nsclient.db");
+	return get_data_file("nsclient.db");
 }
 std::string nsclient::core::storage_manager::get_tmpname() {
-	return path_->expand_path("${data-path}/nsclient.tmp");
+	return get_data_file("nsclient.tmp");
+}
+std::string nsclient::core::storage_manager::get_journalname() {
+	return get_data_file("nsclient.journal");
+}
+std::string nsclient::core::storage_manager::get_old_journalname() {
+	return get_data_file("nsclient.journal.old");
 }
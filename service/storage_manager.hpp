@@ -6,11 +6,16 @@
 #include <nsclient/logger/logger.hpp>
 #include <nscapi/nscapi_protobuf_storage.hpp>
 
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 
+#include <fstream>
 #include <string>
 #include <list>
+#include <map>
 
 namespace nsclient {
 	namespace core {
@@ -44,33 +49,81 @@ namespace nsclient {
 			}
 		};
 
+		/**
+		 * Persistent key/value storage for modules.
+		 *
+		 * The data is kept in a snapshot (nsclient.db) and a journal (nsclient.journal). Every put/remove updates
+		 * the in-memory index and appends a small record (with a CRC) to the journal while still holding the shard
+		 * lock, so records for a key reach the journal in the same order as they reach the index.
+		 * When the journal grows large compared to the snapshot a background thread compacts it (save does the
+		 * same synchronously): the journal is moved aside (nsclient.journal.old), the live set is written as a new
+		 * snapshot and the old journal is removed. Replaying the old and then the new journal over any snapshot
+		 * taken after the move gives the same result, so a crash at any point loses nothing.
+		 * The index is split into shards (by owner and context) so concurrent readers and writers only contend
+		 * when they use the same shard.
+		 */
 		class storage_manager {
 		public:
 			typedef std::map<std::string, storage_item> storage_type;
-			typedef std::list<std::string> key_list_type;
 			typedef std::list<PB::Storage::Storage_Entry> entry_list;
 
 		private:
+			static const std::size_t shard_count = 16;
+			struct shard {
+				boost::shared_mutex mutex;
+				storage_type items;
+			};
+			enum record_type {
+				record_put = 1,
+				record_delete = 2
+			};
+
 			nsclient::core::path_instance path_;
+			// Used instead of ${data-path} when set
+			std::string folder_;
 			nsclient::logging::logger_instance logger_;
-			storage_type storage_;
-			key_list_type deleted_;
-			bool has_read_;
-			boost::shared_mutex m_mutexRW;
-			
+			shard shards_[shard_count];
+
+			// Lock order: shard, then journal_mutex_
+			boost::mutex journal_mutex_;
+			std::ofstream journal_;
+			unsigned long long journal_size_;
+			unsigned long long snapshot_size_;
+			std::string record_buffer_;
+			// Serializes compactions (background and save)
+			boost::mutex compact_mutex_;
+			bool compacting_;
+			boost::shared_ptr<boost::thread> compact_thread_;
+
 		public:
-			storage_manager(nsclient::core::path_instance path_, nsclient::logging::logger_instance logger) : path_(path_), logger_(logger), has_read_(false) {}
+			storage_manager(nsclient::core::path_instance path_, nsclient::logging::logger_instance logger) : path_(path_), logger_(logger), journal_size_(0), snapshot_size_(0), compacting_(false) {}
+			// Keeps the files in the given folder (used by the unit tests)
+			storage_manager(const std::string &folder, nsclient::logging::logger_instance logger) : folder_(folder), logger_(logger), journal_size_(0), snapshot_size_(0), compacting_(false) {}
+			~storage_manager();
 			void load();
 			void put(std::string plugin_name, const ::PB::Storage::Storage_Entry& entry);
+			void remove(std::string plugin_name, std::string context, std::string key);
 			entry_list get(std::string plugin_name, std::string context);
+			// Writes a new snapshot and truncates the journal
 			void save();
 
 		private:
 			nsclient::logging::logger_instance get_logger() {
 				return logger_;
 			}
+			shard& get_shard(const std::string &prefix);
+			void load_snapshot();
+			unsigned long long replay_journal(const std::string &file);
+			void apply(record_type type, const ::PB::Storage::Storage::Block &block);
+			void append(record_type type, const std::string &owner, const ::PB::Storage::Storage_Entry& entry);
+			void compact();
+			void background_compact();
+			void rotate_journal();
+			std::string get_data_file(const std::string &name);
 			std::string get_filename();
 			std::string get_tmpname();
+			std::string get_journalname();
+			std::string get_old_journalname();
 		};
 		typedef boost::shared_ptr<storage_manager> storage_manager_instance;
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2004-2016 Michael Medin
+ *
+ * This file is part of NSClient++ - https://nsclient.org
+ *
+ * NSClient++ is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * NSClient++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with NSClient++.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "storage_manager.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+
+#include <str/xtos.hpp>
+
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+	struct null_logger : public nsclient::logging::logger {
+		void trace(const std::string &, const char*, const int, const std::string &) {}
+		void debug(const std::string &, const char*, const int, const std::string &) {}
+		void info(const std::string &, const char*, const int, const std::string &) {}
+		void warning(const std::string &, const char*, const int, const std::string &) {}
+		void error(const std::string &, const char*, const int, const std::string &) {}
+		void critical(const std::string &, const char*, const int, const std::string &) {}
+		bool should_trace() const { return false; }
+		bool should_debug() const { return false; }
+		bool should_info() const { return false; }
+		bool should_warning() const { return false; }
+		bool should_error() const { return false; }
+		bool should_critical() const { return false; }
+		void raw(const std::string &) {}
+		void add_subscriber(nsclient::logging::logging_subscriber_instance) {}
+		void clear_subscribers() {}
+		bool startup() { return true; }
+		bool shutdown() { return true; }
+		void destroy() {}
+		void configure() {}
+		void set_log_level(std::string) {}
+		std::string get_log_level() const { return "error"; }
+		void set_backend(std::string) {}
+	};
+
+	class storage_test : public ::testing::Test {
+	protected:
+		boost::filesystem::path folder;
+		nsclient::logging::logger_instance logger;
+
+		void SetUp() {
+			folder = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("nscp-storage-%%%%-%%%%-%%%%");
+			boost::filesystem::create_directories(folder);
+			logger = boost::make_shared<null_logger>();
+		}
+		void TearDown() {
+			boost::filesystem::remove_all(folder);
+		}
+
+		boost::shared_ptr<nsclient::core::storage_manager> open() {
+			boost::shared_ptr<nsclient::core::storage_manager> ret(new nsclient::core::storage_manager(folder.string(), logger));
+			ret->load();
+			return ret;
+		}
+		std::string file(const std::string &name) {
+			return (folder / name).string();
+		}
+		bool exists(const std::string &name) {
+			return boost::filesystem::exists(folder / name);
+		}
+		boost::uintmax_t size(const std::string &name) {
+			return boost::filesystem::file_size(folder / name);
+		}
+	};
+
+	PB::Storage::Storage_Entry make_entry(const std::string &context, const std::string &key, const std::string &value) {
+		PB::Storage::Storage_Entry entry;
+		entry.set_context(context);
+		entry.set_key(key);
+		entry.set_value(value);
+		return entry;
+	}
+
+	typedef std::map<std::string, std::string> values_type;
+	values_type values(nsclient::core::storage_manager &storage, const std::string &plugin, const std::string &context) {
+		values_type ret;
+		BOOST_FOREACH(const PB::Storage::Storage_Entry &e, storage.get(plugin, context)) {
+			ret[e.key()] = e.value();
+		}
+		return ret;
+	}
+}
+
+TEST_F(storage_test, replay_after_append) {
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		storage->put("p1", make_entry("ctx", "a", "1"));
+		storage->put("p1", make_entry("ctx", "b", "2"));
+		storage->put("p1", make_entry("ctx", "a", "3"));
+		storage->put("p2", make_entry("ctx", "a", "4"));
+		storage->remove("p1", "ctx", "b");
+	}
+	EXPECT_FALSE(exists("nsclient.db"));
+	EXPECT_TRUE(exists("nsclient.journal"));
+
+	boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+	values_type p1 = values(*storage, "p1", "ctx");
+	ASSERT_EQ(1u, p1.size());
+	EXPECT_EQ("3", p1["a"]);
+	values_type p2 = values(*storage, "p2", "ctx");
+	ASSERT_EQ(1u, p2.size());
+	EXPECT_EQ("4", p2["a"]);
+}
+
+TEST_F(storage_test, truncated_last_record) {
+	boost::uintmax_t first = 0;
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		storage->put("p1", make_entry("ctx", "a", "1"));
+		first = size("nsclient.journal");
+		storage->put("p1", make_entry("ctx", "b", "2"));
+	}
+	// A partial write of the last record
+	boost::filesystem::resize_file(folder / "nsclient.journal", size("nsclient.journal") - 3);
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		values_type v = values(*storage, "p1", "ctx");
+		ASSERT_EQ(1u, v.size());
+		EXPECT_EQ("1", v["a"]);
+		// The tail is dropped so new records are not appended after garbage
+		EXPECT_EQ(first, size("nsclient.journal"));
+		storage->put("p1", make_entry("ctx", "c", "3"));
+	}
+	boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+	values_type v = values(*storage, "p1", "ctx");
+	ASSERT_EQ(2u, v.size());
+	EXPECT_EQ("1", v["a"]);
+	EXPECT_EQ("3", v["c"]);
+}
+
+TEST_F(storage_test, corrupt_last_record) {
+	boost::uintmax_t first = 0;
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		storage->put("p1", make_entry("ctx", "a", "1"));
+		first = size("nsclient.journal");
+		storage->put("p1", make_entry("ctx", "b", "2"));
+	}
+	{
+		// Flip a bit in the payload of the last record (fails the crc)
+		std::fstream f(file("nsclient.journal").c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		f.seekg(-1, std::ios::end);
+		char c = static_cast<char>(f.get());
+		f.seekp(-1, std::ios::end);
+		f.put(static_cast<char>(c ^ 0x01));
+	}
+	boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+	values_type v = values(*storage, "p1", "ctx");
+	ASSERT_EQ(1u, v.size());
+	EXPECT_EQ("1", v["a"]);
+	EXPECT_EQ(first, size("nsclient.journal"));
+}
+
+TEST_F(storage_test, old_journal_is_replayed_first) {
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		storage->put("p1", make_entry("ctx", "a", "old"));
+		storage->put("p1", make_entry("ctx", "b", "old"));
+		storage->put("p1", make_entry("ctx", "c", "old"));
+	}
+	// A compaction which was interrupted after moving the journal aside
+	boost::filesystem::rename(folder / "nsclient.journal", folder / "nsclient.journal.old");
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		storage->put("p1", make_entry("ctx", "a", "new"));
+		storage->remove("p1", "ctx", "b");
+	}
+	EXPECT_TRUE(exists("nsclient.journal.old"));
+
+	boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+	values_type v = values(*storage, "p1", "ctx");
+	ASSERT_EQ(2u, v.size());
+	EXPECT_EQ("new", v["a"]);
+	EXPECT_EQ("old", v["c"]);
+}
+
+TEST_F(storage_test, compaction_keeps_live_state) {
+	values_type expected;
+	{
+		boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+		for (int i = 0; i < 50; i++) {
+			storage->put("p1", make_entry("ctx", "key" + str::xtos(i % 10), "v" + str::xtos(i)));
+		}
+		storage->remove("p1", "ctx", "key3");
+		storage->remove("p1", "ctx", "key7");
+		storage->put("p2", make_entry("other", "x", "y"));
+		expected = values(*storage, "p1", "ctx");
+		ASSERT_EQ(8u, expected.size());
+
+		storage->save();
+		EXPECT_TRUE(exists("nsclient.db"));
+		EXPECT_FALSE(exists("nsclient.journal"));
+		EXPECT_FALSE(exists("nsclient.journal.old"));
+		EXPECT_EQ(expected, values(*storage, "p1", "ctx"));
+
+		// Writes after the compaction go to a new journal on top of the snapshot
+		storage->put("p1", make_entry("ctx", "key0", "after"));
+		expected["key0"] = "after";
+	}
+	EXPECT_TRUE(exists("nsclient.journal"));
+
+	boost::shared_ptr<nsclient::core::storage_manager> storage = open();
+	EXPECT_EQ(expected, values(*storage, "p1", "ctx"));
+	values_type p2 = values(*storage, "p2", "other");
+	ASSERT_EQ(1u, p2.size());
+	EXPECT_EQ("y", p2["x"]);
+}
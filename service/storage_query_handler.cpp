@@ -28,6 +28,8 @@ namespace nsclient {
 					parse_get(r.id(), r.get(), response);
 				} else if (r.has_put()) {
 					parse_put(r.id(), r.put(), response);
+				} else if (r.has_remove()) {
+					parse_remove(r.id(), r.remove(), response);
 				} else {
 					LOG_ERROR_CORE("Storage query: Unsupported action");
 				}
@@ -54,6 +56,14 @@ namespace nsclient {
 			storage_->put(plugin_name, q.entry());
 
 		}
+		void storage_query_handler::parse_remove(const long long plugin_id, const PB::Storage::StorageRequestMessage::Request::Remove &q, PB::Storage::StorageResponseMessage &response) {
+			std::string plugin_name = "";
+			nsclient::core::plugin_manager::plugin_type plugin = plugins_->find_plugin(plugin_id);
+			if (plugin) {
+				plugin_name = plugin->get_alias_or_name();
+			}
+			storage_->remove(plugin_name, q.context(), q.key());
+		}
 
 		plugin_cache_item storage_query_handler::inventory_plugin_on_disk(nsclient::core::plugin_cache::plugin_cache_list_type &list, std::string plugin) {
 			plugin_cache_item itm;
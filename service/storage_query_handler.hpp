@@ -28,6 +28,7 @@ namespace nsclient {
 
 			void parse_get(const long long plugin_id, const PB::Storage::StorageRequestMessage::Request::Get &q, PB::Storage::StorageResponseMessage &response);
 			void parse_put(const long long plugin_id, const PB::Storage::StorageRequestMessage::Request::Put &q, PB::Storage::StorageResponseMessage &response);
+			void parse_remove(const long long plugin_id, const PB::Storage::StorageRequestMessage::Request::Remove &q, PB::Storage::StorageResponseMessage &response);
 
 			//void find_plugins_on_disk(boost::unordered_set<std::string> &unique_instances, const PB::Storage::StorageRequestMessage::Request::Inventory &q, PB::Storage::StorageResponseMessage::Response* rp);
 
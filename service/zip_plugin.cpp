@@ -264,7 +264,7 @@ NSCAPI::nagiosReturn nsclient::core::zip_plugin::handle_schedule(const std::stri
 	throw plugin_exception(get_alias_or_name(), "cannot handle schedule");
 }
 
-NSCAPI::nagiosReturn nsclient::core::zip_plugin::handleNotification(const char *, std::string &, std::string &) {
+NSCAPI::nagiosReturn nsclient::core::zip_plugin::handleNotification(const char *, const std::string &, std::string &) {
 	throw plugin_exception(get_alias_or_name(), "cannot handle commands");
 }
 
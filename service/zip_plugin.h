@@ -98,7 +98,7 @@ namespace nsclient {
 			bool hasMessageHandler() { return false; }
 			NSCAPI::nagiosReturn handleCommand(const std::string request, std::string &reply);
 			NSCAPI::nagiosReturn handle_schedule(const std::string &request);
-			NSCAPI::nagiosReturn handleNotification(const char *channel, std::string &request, std::string &reply);
+			NSCAPI::nagiosReturn handleNotification(const char *channel, const std::string &request, std::string &reply);
 			bool has_on_event() { return false; }
 			NSCAPI::nagiosReturn on_event(const std::string &request);
 			NSCAPI::nagiosReturn fetchMetrics(std::string &request);
@@ -119,6 +119,9 @@ namespace nsclient {
 
 			void on_log_message(std::string &) {}
 			std::string get_version();
+			std::list<std::string> get_dependencies() {
+				return std::list<std::string>(modules_.begin(), modules_.end());
+			}
 
 		private:
 			nsclient::logging::logger_instance get_logger() {
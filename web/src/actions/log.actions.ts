@@ -18,4 +18,10 @@ export class LogActions {
         );
     }
 
+    // Long polls for new entries (resolves when there are new entries or the server side wait expires)
+    static follow() {
+        return (dispatch: (action: LogAction) => void) => LogService.follow()
+            .then((log: LogEntry[]) => dispatch({ type: LogConstants.LIST.SUCCESS, log }));
+    }
+
 }
@@ -25,7 +25,14 @@ const Component = function (props: any) {
     const [selected, setSelected] = React.useState<LogEntry | undefined>(undefined);
 
     useEffect(() => {
-        dispatch(LogActions.list());
+        let active = true;
+        const poll = () => {
+            if (active) {
+                dispatch(LogActions.follow()).then(poll, () => setTimeout(poll, 5000));
+            }
+        };
+        poll();
+        return () => { active = false; };
     }, []);
 
 
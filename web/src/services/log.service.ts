@@ -4,6 +4,7 @@ export enum LogLevels {
 }
 export interface LogEntry {
 
+    sequence: number;
     date: Date;
     file: string;
     level: LogLevels;
@@ -13,16 +14,43 @@ export interface LogEntry {
 
 export class LogService {
 
+    static readonly maxEntries = 1000;
     static cachedList = new CachedValue<LogEntry[]>();
+    static sequence = 0;
+
     static list(refresh: boolean): Promise<LogEntry[]> {
         if (!refresh && LogService.cachedList.isCached()) {
             return Promise.resolve(LogService.cachedList.get());
+        } else if (!LogService.cachedList.isCached()) {
+            return LogService.fetch(`/logs?tail=${LogService.maxEntries}&limit=${LogService.maxEntries}`);
         } else {
-            return fetch(getUrl('/logs'), getGetHeader())
-                .then(handleResponse)
-                .then(logs => {
-                    return LogService.cachedList.set(logs);
-                });
+            return LogService.follow(0);
+        }
+    }
+
+    // Fetches the entries logged since the last call, waits (up to wait seconds) for new entries if there are none
+    static follow(wait: number = 25): Promise<LogEntry[]> {
+        if (!LogService.cachedList.isCached()) {
+            return LogService.list(false);
         }
+        return LogService.fetch(`/logs?since=${LogService.sequence}&limit=${LogService.maxEntries}&wait=${wait}`);
+    }
+
+    static fetch(url: string): Promise<LogEntry[]> {
+        return fetch(getUrl(url), getGetHeader())
+            .then(response => {
+                const sequence = response.headers.get('X-Log-Sequence');
+                if (sequence) {
+                    LogService.sequence = Number(sequence);
+                }
+                return handleResponse(response);
+            })
+            .then((logs: LogEntry[]) => {
+                const previous = LogService.cachedList.isCached() ? LogService.cachedList.get() : [];
+                // A refresh can overlap with a long poll so skip what we already have
+                const last = previous.length > 0 ? previous[previous.length - 1].sequence : 0;
+                const added = logs.filter(entry => entry.sequence > last);
+                return LogService.cachedList.set(previous.concat(added).slice(-LogService.maxEntries));
+            });
     }
 }